@@ -0,0 +1,33 @@
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Headless benchmark runner for the simulation core; needs no window or GPU.
+// Run it from the repository root so res/bodies.txt is found.
+int main(int argc, char** argv)
+{
+    int ticks = SIMULATION_BENCHMARK_TICKS;
+    double maxTickMilliseconds = 0.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--benchmark-nbody")
+            return runNBodyBenchmark();
+        if (argument == "--benchmark-spatial-hash")
+            return runSpatialHashBenchmark();
+        if (argument == "--ticks" && i + 1 < argc)
+            ticks = atoi(argv[++i]);
+        else if (argument == "--max-tick-ms" && i + 1 < argc)
+            maxTickMilliseconds = atof(argv[++i]);
+        else
+        {
+            printf("Usage: %s [--ticks N] [--max-tick-ms MS] | --benchmark-nbody | --benchmark-spatial-hash\n", argv[0]);
+            return 2;
+        }
+    }
+
+    return runSimulationBenchmark(ticks, maxTickMilliseconds);
+}
@@ -24,31 +24,85 @@ void main()
 #shader fragment
 #version 330 core
 
+// Compiled as one program per permutation (see the PERMUTATION constants in Main.cpp):
+// UNLIT_LINE for the orbit lines, EMISSIVE for the sun, VIRTUAL_TEXTURE for bodies drawn from
+// virtual texture tiles, and none of them for lit, textured bodies
+
 layout(location = 0) out vec4 color;
 
 in vec3 Normal;  // Interpolated normal from the vertex shader
 in vec3 FragPos; // Fragment position
 in vec2 TexCoord; // Interpolated texture coordinates
 
-// Uniforms for lighting
-uniform vec3 lightPos;    // Light position (static)
-uniform vec3 viewPos;     // Camera position (for specular calculation)
-uniform vec3 lightColor;  // Light color
-uniform sampler2D textureSampler; // Texture sampler
+#ifdef UNLIT_LINE
 
-// New uniform for orbit color
 uniform vec3 orbitColor; // Color of the orbit lines
 uniform float orbitAlpha; // Alpha value for the orbit lines
 
-// New uniform to determine if the fragment is part of an orbit line
-uniform bool isOrbitLine; // Boolean to indicate if this fragment is an orbit line
+void main()
+{
+    color = vec4(orbitColor, orbitAlpha); // Set the alpha value for opacity
+}
+
+#else
+
+uniform sampler2D textureSampler; // Texture sampler
+
+#ifdef VIRTUAL_TEXTURE
+#include "VirtualTexture.glsl"
+
+// Virtual texture of the body, sampled instead of textureSampler where a tile covers it
+uniform sampler2D virtualCache;       // Physical cache of resident tiles
+uniform sampler2D virtualIndirection; // Slot and level of the finest resident tile covering each tile
+uniform float virtualCacheSlots;      // Slots on each side of the cache
 
+// Function to sample the virtual texture at the level the screen footprint asks for, or the finest
+// resident level above it. Alpha is zero where no tile is resident yet.
+vec4 sampleVirtualTexture(vec2 texCoord)
+{
+    vec2 uv = virtualUv(texCoord);
+    int level = virtualLevel(texCoord, 0.0);
+    ivec2 tile = virtualTile(uv, level);
+    vec4 entry = texelFetch(virtualIndirection, ivec2(tile.x, virtualLevels[level].z + tile.y), 0);
+    if (entry.a == 0.0)
+        return vec4(0.0);
+
+    // Position within the resident tile, which may be coarser than the one asked for
+    int residentLevel = int(entry.b * 255.0 + 0.5);
+    vec2 residentSize = virtualLevelSize(residentLevel);
+    vec2 residentTile = vec2(virtualTile(uv, residentLevel));
+    vec2 within = clamp(uv * residentSize - residentTile * VIRTUAL_TILE_PAYLOAD, 0.0, VIRTUAL_TILE_PAYLOAD);
+    vec2 slot = floor(entry.rg * 255.0 + 0.5);
+    vec2 physical = (slot * VIRTUAL_TILE_SIZE + VIRTUAL_TILE_BORDER + within) / (virtualCacheSlots * VIRTUAL_TILE_SIZE);
+    return vec4(textureLod(virtualCache, physical, 0.0).rgb, 1.0);
+}
+#endif
+
+#ifdef EMISSIVE
 // Emission properties
 uniform vec3 emissionColor; // Color of the emission from the sun's surface
 uniform float emissionStrength; // Strength of the emission effect
+#else
+// Uniforms for lighting
+uniform vec3 lightPos;    // Light position (static)
+uniform vec3 viewPos;     // Camera position (for specular calculation)
+uniform vec3 lightColor;  // Light color
+#endif
 
 void main()
 {
+    // Fetch the texture color
+    vec3 textureColor = texture(textureSampler, TexCoord).rgb;
+#ifdef VIRTUAL_TEXTURE
+    vec4 virtualColor = sampleVirtualTexture(TexCoord);
+    if (virtualColor.a > 0.0)
+        textureColor = virtualColor.rgb;
+#endif
+
+#ifdef EMISSIVE
+    // The light source is not lit by itself; it shows its texture and glows
+    color = vec4(textureColor + emissionColor * emissionStrength, 1.0);
+#else
     // Ambient lighting
     float ambientStrength = 0.1;
     vec3 ambient = ambientStrength * lightColor;
@@ -68,17 +122,8 @@ void main()
 
     // Combine results
     vec3 result = (ambient + diffuse + specular);
+    color = vec4(result * textureColor, 1.0);
+#endif
+}
 
-    // Fetch the texture color
-    vec3 textureColor = texture(textureSampler, TexCoord).rgb;
-
-    // Check if the fragment is part of an orbit line
-    if (isOrbitLine) {
-        // Use orbit color for orbit lines
-        color = vec4(orbitColor, orbitAlpha); // Set the alpha value for opacity
-    } else {
-        // Apply emission effect
-        vec3 emittedLight = emissionColor * emissionStrength; // Compute the emitted light
-        color = vec4(result * textureColor + emittedLight, 1.0); // Combine with the existing color
-    }
-}
\ No newline at end of file
+#endif
@@ -0,0 +1,45 @@
+#shader vertex
+#version 330 core
+
+layout(location = 0) in vec3 position;
+layout(location = 2) in vec2 texCoord;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec2 TexCoord;
+
+void main()
+{
+    TexCoord = texCoord;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
+
+#shader fragment
+#version 330 core
+
+// Virtual texture tile feedback: each pixel names the tile its fragment would sample, packed as
+// decodeVirtualFeedback reads it, or zero where no virtual texture is drawn
+layout(location = 0) out vec4 color;
+
+in vec2 TexCoord;
+
+#include "VirtualTexture.glsl"
+
+uniform int virtualTextureIndex;  // Index in the tile cache, or -1
+uniform float virtualLodBias;     // Makes up for rendering at a fraction of the screen's resolution
+
+void main()
+{
+    if (virtualTextureIndex < 0) {
+        color = vec4(0.0);
+        return;
+    }
+
+    // The same level and tile as sampleVirtualTexture in Basic.shader picks
+    int level = virtualLevel(TexCoord, virtualLodBias);
+    ivec2 tile = virtualTile(virtualUv(TexCoord), level);
+    color = vec4(float(tile.x & 255), float(tile.y & 255), float((tile.x >> 8) | ((tile.y >> 8) << 4)),
+        float(level | ((virtualTextureIndex + 1) << 4))) / 255.0;
+}
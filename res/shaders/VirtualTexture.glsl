@@ -0,0 +1,36 @@
+// Layout of the virtual texture being drawn, shared by Basic.shader and Feedback.shader so both
+// pick the same level and tile for a fragment
+uniform vec2 virtualSize;             // Level 0, in texels
+uniform int virtualLevelCount;
+uniform ivec3 virtualLevels[16];      // Tiles across, tiles down and first indirection row of each level
+
+const float VIRTUAL_TILE_SIZE = 128.0;
+const float VIRTUAL_TILE_BORDER = 4.0;
+const float VIRTUAL_TILE_PAYLOAD = 120.0;
+
+// Function to wrap columns and clamp rows, as the tiles were cut
+vec2 virtualUv(vec2 texCoord)
+{
+    return vec2(fract(texCoord.x), clamp(texCoord.y, 0.0, 1.0));
+}
+
+// Function to pick the level the screen footprint of a fragment asks for
+int virtualLevel(vec2 texCoord, float lodBias)
+{
+    vec2 dx = dFdx(texCoord * virtualSize);
+    vec2 dy = dFdy(texCoord * virtualSize);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + lodBias;
+    return clamp(int(floor(lod)), 0, virtualLevelCount - 1);
+}
+
+// Function to get the size of a level, in texels
+vec2 virtualLevelSize(int level)
+{
+    return max(floor(virtualSize / exp2(float(level))), 1.0);
+}
+
+// Function to find the tile of a level that covers a point
+ivec2 virtualTile(vec2 uv, int level)
+{
+    return min(ivec2(uv * virtualLevelSize(level) / VIRTUAL_TILE_PAYLOAD), virtualLevels[level].xy - 1);
+}
@@ -0,0 +1,182 @@
+#include "AssetPack.h"
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Function to round an offset up to the blob alignment
+static uint64_t alignBlob(uint64_t offset)
+{
+    return (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+}
+
+// Function to get the blob size an entry's own fields call for, or 0 if they are invalid
+static uint64_t expectedBlobSize(const AssetEntry& entry)
+{
+    if (entry.type == ASSET_TEXTURE)
+    {
+        bool alpha = entry.format == ASSET_FORMAT_DXT5;
+        if ((entry.format != ASSET_FORMAT_DXT1 && !alpha) || entry.width < 1 || entry.height < 1 ||
+            entry.width > 65536 || entry.height > 65536 || int(entry.mipLevels) != mipLevelCount(int(entry.width), int(entry.height)))
+            return 0;
+
+        uint64_t size = 0;
+        for (uint32_t level = 0; level < entry.mipLevels; ++level)
+            size += compressedLevelBytes(std::max(int(entry.width >> level), 1), std::max(int(entry.height >> level), 1), alpha);
+        return size;
+    }
+    if (entry.type == ASSET_MESH)
+        return uint64_t(entry.vertexCount) * entry.vertexStride + uint64_t(entry.indexCount) * sizeof(uint32_t);
+    return entry.size;
+}
+
+AssetPackInput makeAssetInput(const std::string& name, uint32_t type)
+{
+    AssetPackInput input;
+    memset(&input.entry, 0, sizeof(input.entry));
+    strncpy(input.entry.name, name.c_str(), sizeof(input.entry.name) - 1);
+    input.entry.type = type;
+    return input;
+}
+
+bool stampAssetSource(AssetEntry& entry)
+{
+    return readFileStamp(entry.name, entry.sourceSize, entry.sourceModified);
+}
+
+bool writeAssetPack(const std::string& filePath, const std::vector<AssetPackInput>& assets)
+{
+    std::vector<AssetEntry> toc;
+    toc.reserve(assets.size());
+
+    // Lay out the blobs, giving assets with the same bytes the same blob
+    std::vector<const AssetPackInput*> blobs;
+    std::vector<uint64_t> blobOffsets;
+    uint64_t offset = alignBlob(sizeof(AssetPackHeader) + assets.size() * sizeof(AssetEntry));
+    for (const AssetPackInput& asset : assets)
+    {
+        AssetEntry entry = asset.entry;
+        if (strnlen(entry.name, sizeof(entry.name)) == sizeof(entry.name) || entry.name[0] == '\0')
+        {
+            std::cerr << "Invalid asset name in " << filePath << std::endl;
+            return false;
+        }
+        entry.size = asset.data.size();
+
+        size_t blob = 0;
+        while (blob < blobs.size() && !(blobs[blob]->entry.type == entry.type && blobs[blob]->data == asset.data))
+            ++blob;
+        if (blob == blobs.size())
+        {
+            blobs.push_back(&asset);
+            blobOffsets.push_back(offset);
+            offset = alignBlob(offset + entry.size);
+        }
+        entry.offset = blobOffsets[blob];
+
+        if (expectedBlobSize(entry) != entry.size)
+        {
+            std::cerr << "Asset " << entry.name << " does not match its description" << std::endl;
+            return false;
+        }
+        toc.push_back(entry);
+    }
+
+    AssetPackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(toc.size());
+    header.fileSize = offset;
+
+    // The pack is assembled in memory and renamed into place, so a failed or interrupted write
+    // leaves the previous pack (or none) rather than a truncated one the next run would map.
+    // Blobs go in offset order; the gaps between them stay zero.
+    std::vector<unsigned char> bytes(size_t(header.fileSize), 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    if (!toc.empty())
+        memcpy(bytes.data() + sizeof(header), toc.data(), toc.size() * sizeof(AssetEntry));
+    for (size_t blob = 0; blob < blobs.size(); ++blob)
+    {
+        if (!blobs[blob]->data.empty())
+            memcpy(bytes.data() + blobOffsets[blob], blobs[blob]->data.data(), blobs[blob]->data.size());
+    }
+
+#ifdef _WIN32
+    // Renaming onto an existing file fails on Windows, and writeFileAtomically would keep it
+    std::remove(filePath.c_str());
+#endif
+    return writeFileAtomically(filePath, bytes);
+}
+
+bool AssetPack::open(const std::string& filePath)
+{
+    close();
+    if (!file.open(filePath))
+        return false;
+
+    AssetPackHeader header;
+    if (file.size() < sizeof(header))
+    {
+        close();
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+
+    if (memcmp(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic)) != 0 || header.version != ASSET_PACK_VERSION ||
+        header.fileSize != file.size() || header.entryCount > (file.size() - sizeof(header)) / sizeof(AssetEntry))
+    {
+        std::cerr << "Not a valid asset pack: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    // The table of contents is used in place; every blob must lie inside the file
+    toc = reinterpret_cast<const AssetEntry*>(file.data() + sizeof(header));
+    entryCount = header.entryCount;
+    for (size_t i = 0; i < entryCount; ++i)
+    {
+        const AssetEntry& entry = toc[i];
+        if (entry.offset % ASSET_PACK_ALIGNMENT != 0 || entry.offset > file.size() || entry.size > file.size() - entry.offset ||
+            strnlen(entry.name, sizeof(entry.name)) == sizeof(entry.name) || expectedBlobSize(entry) != entry.size)
+        {
+            std::cerr << "Corrupt asset pack entry " << i << " in " << filePath << std::endl;
+            close();
+            return false;
+        }
+        names[std::string(entry.name) + '\n' + std::to_string(entry.type)] = i;
+    }
+    return true;
+}
+
+void AssetPack::close()
+{
+    file.close();
+    toc = nullptr;
+    entryCount = 0;
+    names.clear();
+}
+
+std::vector<std::string> AssetPack::staleAssets() const
+{
+    std::vector<std::string> stale;
+    for (size_t i = 0; i < entryCount; ++i)
+    {
+        const AssetEntry& entry = toc[i];
+        if (entry.sourceSize == 0 && entry.sourceModified == 0)
+            continue;
+        uint64_t size;
+        int64_t modified;
+        if (!readFileStamp(entry.name, size, modified) || size != entry.sourceSize || modified != entry.sourceModified)
+            stale.push_back(entry.name);
+    }
+    return stale;
+}
+
+const AssetEntry* AssetPack::find(const std::string& name, uint32_t type) const
+{
+    auto found = names.find(name + '\n' + std::to_string(type));
+    return found != names.end() ? &toc[found->second] : nullptr;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Single file holding the app's startup assets, ready to use: textures as compressed mip chains,
+// shader sources and prebuilt mesh buffers. The file is memory-mapped, so startup opens one file
+// and hands blobs straight to GL without copying them first.
+//
+// Binary layout (little-endian): AssetPackHeader, AssetEntry[entryCount] (the table of contents),
+// then the blobs, each starting on a multiple of ASSET_PACK_ALIGNMENT so a blob is page-aligned
+// in the mapping. Entries with identical contents share one blob. Each entry records the size and
+// modification time of the file it was built from, so a pack older than its sources is noticed.
+const char ASSET_PACK_MAGIC[8] = { 'S', 'O', 'L', 'P', 'A', 'C', 'K', '1' };
+const uint32_t ASSET_PACK_VERSION = 2;
+const uint64_t ASSET_PACK_ALIGNMENT = 4096;
+const char ASSET_PACK_PATH[] = "res/assets.pack";
+
+// Kinds of asset
+const uint32_t ASSET_TEXTURE = 1;   // Mip levels from largest to 1x1, each DXT-compressed
+const uint32_t ASSET_SHADER = 2;    // Source text
+const uint32_t ASSET_MESH = 3;      // Interleaved float vertices, then 32-bit indices
+
+// Texture formats
+const uint32_t ASSET_FORMAT_DXT1 = 1;
+const uint32_t ASSET_FORMAT_DXT5 = 2;
+
+struct AssetPackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t fileSize;
+    uint64_t reserved;
+};
+
+// Table of contents record
+struct AssetEntry
+{
+    char name[64];          // Path the asset is loaded by, such as textures/earth.jpg
+    uint32_t type;          // ASSET_TEXTURE, ASSET_SHADER or ASSET_MESH
+    uint32_t format;        // Texture: ASSET_FORMAT_*
+    uint32_t width;         // Texture size
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t vertexCount;   // Mesh
+    uint32_t vertexStride;  // Mesh: bytes per vertex
+    uint32_t indexCount;    // Mesh
+    uint64_t contentHash;   // hashBytes of the source file, so identical textures can be shared
+    uint64_t offset;        // Of the blob from the start of the file
+    uint64_t size;          // Of the blob in bytes
+    uint64_t sourceSize;    // Of the file the asset was built from; both 0 for generated assets
+    int64_t sourceModified; // readFileStamp time of that file
+    uint64_t reserved;
+};
+
+static_assert(sizeof(AssetEntry) == 144, "AssetEntry is part of the file format");
+
+// An asset to write: its entry (offset and size are filled in by writeAssetPack) and its blob
+struct AssetPackInput
+{
+    AssetEntry entry;
+    std::vector<unsigned char> data;
+};
+
+// Function to start an asset to write, with a zeroed entry of the given name and type
+AssetPackInput makeAssetInput(const std::string& name, uint32_t type);
+
+// Function to record the size and modification time of the file an asset is built from, which is
+// the file its name gives. Returns false if the file is missing.
+bool stampAssetSource(AssetEntry& entry);
+
+// Function to write an asset pack. Returns false if a name is too long or the file cannot be written.
+bool writeAssetPack(const std::string& filePath, const std::vector<AssetPackInput>& assets);
+
+// Mapped asset pack
+class AssetPack
+{
+public:
+    // Function to map and check a pack, replacing any open one. Returns false if it is missing or
+    // malformed, in which case the app loads the loose files instead.
+    bool open(const std::string& filePath);
+
+    // Function to unmap the pack
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+
+    // Function to find an asset by name and type. Returns nullptr if the pack does not have it.
+    const AssetEntry* find(const std::string& name, uint32_t type) const;
+
+    // Function to list the assets whose source files changed or went missing since the pack was
+    // built. Generated assets are never stale.
+    std::vector<std::string> staleAssets() const;
+
+    // Function to get an asset's blob inside the mapping
+    const unsigned char* data(const AssetEntry& entry) const { return file.data() + entry.offset; }
+
+    size_t size() const { return entryCount; }
+    const AssetEntry* entries() const { return toc; }
+
+private:
+    MappedFile file;
+    const AssetEntry* toc = nullptr;
+    size_t entryCount = 0;
+    std::unordered_map<std::string, size_t> names;
+};
@@ -0,0 +1,359 @@
+#include "Benchmarks.h"
+#include "Kepler.h"
+#include "NBody.h"
+#include "Parallel.h"
+#include "SolarSystem.h"
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Benchmark scene in units where G = 1 and the sun has unit mass
+static const double BENCHMARK_JUPITER_MASS = 9.5e-4;
+static const double BENCHMARK_JUPITER_RADIUS = 5.2;
+static const double BENCHMARK_BELT_INNER_RADIUS = 2.2;
+static const double BENCHMARK_BELT_OUTER_RADIUS = 3.3;
+static const double BENCHMARK_BELT_MASS = 1e-6; // Total, exaggerated so the mutual forces matter
+static const double BENCHMARK_TIME_STEP = 0.01;
+
+// Energy drift check parameters
+static const size_t DRIFT_PARTICLES = 2000;
+static const int DRIFT_STEPS = 2000;
+static const double DRIFT_TOLERANCE = 1e-5;
+
+// Spatial hash benchmark parameters
+static const double HASH_CELL_SIZE = 0.02;
+static const float HASH_MAX_PARTICLE_RADIUS = 0.005f;
+static const size_t HASH_CHECK_PARTICLES = 5000;
+static const size_t HASH_CHECK_QUERIES = 200;
+static const size_t HASH_BENCHMARK_PARTICLES = 1000000;
+static const int HASH_BENCHMARK_REBUILDS = 10;
+static const size_t HASH_BENCHMARK_QUERIES = 100000;
+
+// Simulation benchmark parameters
+static const double SIMULATION_BENCHMARK_TICK = 1.0 / 60.0; // Simulated seconds per tick, as in the app at 1x
+static const int SIMULATION_BENCHMARK_LARGE_POPULATION = 100000; // Belt and ring size for the scaled-up run
+static const int SIMULATION_BENCHMARK_NBODY_DIVISOR = 10; // The N-body run does this many times fewer ticks
+
+// Function to set up a sun, a Jupiter-like planet and a belt of particles on Keplerian orbits
+static void createBenchmarkScene(NBodyState& state, size_t particleCount)
+{
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double TWO_PI = 6.28318530717958647692;
+
+    KeplerBatch orbits;
+    reserveOrbits(orbits, particleCount + 1);
+
+    OrbitalElements jupiter = { BENCHMARK_JUPITER_RADIUS, 0.048, 0.023, 1.75, 4.78, 0.6, 0.0 };
+    jupiter.meanMotion = sqrt((1.0 + BENCHMARK_JUPITER_MASS) / pow(jupiter.semiMajorAxis, 3.0));
+    addOrbit(orbits, jupiter);
+
+    for (size_t i = 0; i < particleCount; ++i)
+    {
+        OrbitalElements elements;
+        elements.semiMajorAxis = BENCHMARK_BELT_INNER_RADIUS + (BENCHMARK_BELT_OUTER_RADIUS - BENCHMARK_BELT_INNER_RADIUS) * unit(random);
+        elements.eccentricity = 0.15 * unit(random);
+        elements.inclination = 0.2 * unit(random);
+        elements.ascendingNode = TWO_PI * unit(random);
+        elements.argumentOfPeriapsis = TWO_PI * unit(random);
+        elements.meanAnomalyAtEpoch = TWO_PI * unit(random);
+        elements.meanMotion = sqrt(1.0 / pow(elements.semiMajorAxis, 3.0));
+        addOrbit(orbits, elements);
+    }
+
+    Vec3Array positions, velocities;
+    propagateOrbits(orbits, 0.0, positions, &velocities);
+
+    state = NBodyState();
+    addBody(state, glm::dvec3(0.0), glm::dvec3(0.0), 1.0, true);
+    addBody(state, positions[0], velocities[0], BENCHMARK_JUPITER_MASS, true);
+    for (size_t i = 1; i < positions.size(); ++i)
+        addBody(state, positions[i], velocities[i], BENCHMARK_BELT_MASS / particleCount, false);
+}
+
+// Function to time a number of leapfrog steps and print the throughput
+static void benchmarkSteps(size_t particleCount, int steps)
+{
+    NBodyState state;
+    BarnesHutSettings settings;
+    BarnesHutTree tree;
+    NBodyTimings timings, total;
+
+    createBenchmarkScene(state, particleCount);
+    computeGravity(state, settings, tree);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step)
+    {
+        leapfrogStep(state, BENCHMARK_TIME_STEP, settings, tree, &timings);
+        total.treeBuild += timings.treeBuild;
+        total.forces += timings.forces;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%8zu particles: %8.3f steps/s  (tree build %.2f ms, forces %.2f ms per step, %zu nodes)\n",
+        particleCount, steps / seconds, total.treeBuild / steps, total.forces / steps, tree.nodes.size());
+}
+
+int runNBodyBenchmark()
+{
+    printf("Barnes-Hut benchmark on %zu threads, opening angle %.2f\n", parallelThreadCount(), BarnesHutSettings().openingAngle);
+
+    benchmarkSteps(100000, 10);
+    benchmarkSteps(1000000, 3);
+
+    // Energy drift over a couple of thousand steps
+    NBodyState state;
+    BarnesHutSettings settings;
+    BarnesHutTree tree;
+    createBenchmarkScene(state, DRIFT_PARTICLES);
+    computeGravity(state, settings, tree);
+
+    double initialEnergy = totalEnergy(state);
+    for (int step = 0; step < DRIFT_STEPS; ++step)
+        leapfrogStep(state, BENCHMARK_TIME_STEP, settings, tree);
+    double drift = fabs((totalEnergy(state) - initialEnergy) / initialEnergy);
+
+    bool passed = drift < DRIFT_TOLERANCE;
+    printf("Energy drift after %d steps with %zu particles: %.3e (%s, tolerance %.0e)\n",
+        DRIFT_STEPS, DRIFT_PARTICLES, drift, passed ? "ok" : "FAILED", DRIFT_TOLERANCE);
+
+    return passed ? 0 : 1;
+}
+
+// Function to fill a belt of particle positions and radii for the spatial hash benchmark
+static void createBeltParticles(size_t particleCount, Vec3Array& positions, std::vector<float>& radii)
+{
+    std::mt19937 random(6789);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const double TWO_PI = 6.28318530717958647692;
+
+    KeplerBatch orbits;
+    reserveOrbits(orbits, particleCount);
+    for (size_t i = 0; i < particleCount; ++i)
+    {
+        OrbitalElements elements;
+        elements.semiMajorAxis = BENCHMARK_BELT_INNER_RADIUS + (BENCHMARK_BELT_OUTER_RADIUS - BENCHMARK_BELT_INNER_RADIUS) * unit(random);
+        elements.eccentricity = 0.15 * unit(random);
+        elements.inclination = 0.2 * unit(random);
+        elements.ascendingNode = TWO_PI * unit(random);
+        elements.argumentOfPeriapsis = TWO_PI * unit(random);
+        elements.meanAnomalyAtEpoch = TWO_PI * unit(random);
+        elements.meanMotion = 0.0;
+        addOrbit(orbits, elements);
+    }
+    propagateOrbits(orbits, 0.0, positions);
+
+    radii.resize(particleCount);
+    for (float& radius : radii)
+        radius = HASH_MAX_PARTICLE_RADIUS * float(unit(random));
+}
+
+// Function to compare the hash queries and collision pass with brute force. Returns the number of mismatches.
+static size_t checkSpatialHash()
+{
+    Vec3Array positions;
+    std::vector<float> radii;
+    createBeltParticles(HASH_CHECK_PARTICLES, positions, radii);
+
+    // A coarse cell so the small set still has several particles per cell
+    SpatialHash hash;
+    buildSpatialHash(positions, HASH_CELL_SIZE * 10.0, hash);
+
+    // The collision radii are scaled up to match the coarser cell
+    for (float& radius : radii)
+        radius *= 10.0f;
+
+    size_t mismatches = 0;
+    std::mt19937 random(42);
+    std::uniform_int_distribution<size_t> pick(0, HASH_CHECK_PARTICLES - 1);
+    std::vector<uint32_t> found;
+
+    for (size_t query = 0; query < HASH_CHECK_QUERIES; ++query)
+    {
+        glm::dvec3 center = positions[pick(random)] + glm::dvec3(0.01, -0.02, 0.005);
+        double radius = 0.05 + 0.001 * double(query);
+
+        found.clear();
+        queryRadius(hash, center, radius, found);
+        std::sort(found.begin(), found.end());
+
+        std::vector<uint32_t> expected;
+        uint32_t expectedNearest = 0;
+        double expectedDistance = 1e300;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            double distance = glm::length(positions[i] - center);
+            if (distance <= radius)
+                expected.push_back(static_cast<uint32_t>(i));
+            if (distance < expectedDistance)
+            {
+                expectedDistance = distance;
+                expectedNearest = static_cast<uint32_t>(i);
+            }
+        }
+        if (found != expected)
+            ++mismatches;
+
+        uint32_t nearest;
+        double distance;
+        if (!findNearest(hash, center, 1.0, nearest, distance) || nearest != expectedNearest)
+            ++mismatches;
+    }
+
+    std::vector<CollisionPair> collisions;
+    findCollisions(hash, radii, collisions);
+
+    std::vector<CollisionPair> expected;
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        for (size_t j = i + 1; j < positions.size(); ++j)
+        {
+            double reach = double(radii[i]) + double(radii[j]);
+            glm::dvec3 offset = positions[j] - positions[i];
+            if (glm::dot(offset, offset) < reach * reach)
+                expected.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(j) });
+        }
+    }
+
+    bool sameCollisions = collisions.size() == expected.size();
+    for (size_t i = 0; sameCollisions && i < expected.size(); ++i)
+        sameCollisions = collisions[i].first == expected[i].first && collisions[i].second == expected[i].second;
+    if (!sameCollisions)
+        ++mismatches;
+
+    printf("Brute-force check: %zu particles, %zu queries, %zu collisions, %zu mismatches\n",
+        HASH_CHECK_PARTICLES, HASH_CHECK_QUERIES, expected.size(), mismatches);
+    return mismatches;
+}
+
+int runSpatialHashBenchmark()
+{
+    printf("Spatial hash benchmark on %zu threads, cell size %.3f\n", parallelThreadCount(), HASH_CELL_SIZE);
+
+    size_t mismatches = checkSpatialHash();
+
+    Vec3Array positions;
+    std::vector<float> radii;
+    createBeltParticles(HASH_BENCHMARK_PARTICLES, positions, radii);
+
+    SpatialHash hash;
+    auto start = std::chrono::steady_clock::now();
+    for (int rebuild = 0; rebuild < HASH_BENCHMARK_REBUILDS; ++rebuild)
+        buildSpatialHash(positions, HASH_CELL_SIZE, hash);
+    double rebuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / HASH_BENCHMARK_REBUILDS;
+
+    // Queries are independent, so spread them over the worker pool like the simulation would
+    std::vector<size_t> resultCounts(HASH_BENCHMARK_QUERIES);
+    start = std::chrono::steady_clock::now();
+    parallelFor(HASH_BENCHMARK_QUERIES, 256, [&](size_t begin, size_t end)
+    {
+        std::vector<uint32_t> found;
+        for (size_t query = begin; query < end; ++query)
+        {
+            found.clear();
+            resultCounts[query] = queryRadius(hash, positions[(query * 7919) % positions.size()], HASH_CELL_SIZE, found);
+        }
+    });
+    double radiusSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t totalFound = 0;
+    for (size_t resultCount : resultCounts)
+        totalFound += resultCount;
+
+    start = std::chrono::steady_clock::now();
+    parallelFor(HASH_BENCHMARK_QUERIES, 256, [&](size_t begin, size_t end)
+    {
+        for (size_t query = begin; query < end; ++query)
+        {
+            uint32_t nearest;
+            double distance;
+            glm::dvec3 point = positions[(query * 7919) % positions.size()] + glm::dvec3(HASH_CELL_SIZE * 0.5);
+            findNearest(hash, point, HASH_CELL_SIZE * 4.0, nearest, distance);
+        }
+    });
+    double nearestSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<CollisionPair> collisions;
+    start = std::chrono::steady_clock::now();
+    findCollisions(hash, radii, collisions);
+    double collisionSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%8zu particles: rebuild %.2f ms (%zu slots)\n", positions.size(), rebuildSeconds * 1000.0, hash.cellStart.size() - 1);
+    printf("Radius queries:  %.2f M/s (%.1f particles each)\n",
+        HASH_BENCHMARK_QUERIES / radiusSeconds * 1e-6, double(totalFound) / HASH_BENCHMARK_QUERIES);
+    printf("Nearest queries: %.2f M/s\n", HASH_BENCHMARK_QUERIES / nearestSeconds * 1e-6);
+    printf("Collision pass:  %.2f ms (%zu pairs)\n", collisionSeconds * 1000.0, collisions.size());
+
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Function to step a solar system for a number of ticks and print the time per tick. Returns the mean in milliseconds.
+static double benchmarkTicks(const char* label, SolarSystem& system, int ticks, double tickLength)
+{
+    std::vector<double> tickMilliseconds;
+    tickMilliseconds.reserve(ticks);
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        auto start = std::chrono::steady_clock::now();
+        stepSolarSystem(system, tickLength);
+        tickMilliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    double total = 0.0;
+    for (double milliseconds : tickMilliseconds)
+        total += milliseconds;
+    double mean = total / ticks;
+
+    std::sort(tickMilliseconds.begin(), tickMilliseconds.end());
+    double worst = tickMilliseconds[std::min(size_t(ticks * 0.95), tickMilliseconds.size() - 1)];
+
+    size_t bodies = system.planetOrbits.size() + system.asteroidOrbits.size() + system.ringAsteroidOrbits.size();
+    printf("%-22s %7zu bodies: %8.3f ms/tick (p95 %.3f ms), %8.2f M body updates/s, %zu + %zu touching\n",
+        label, bodies, mean, worst, bodies * ticks / (total * 1e-3) * 1e-6, system.beltCollisions.size(), system.ringCollisions.size());
+    return mean;
+}
+
+// Function to create a solar system with the given belt and ring sizes and a fixed seed
+static bool createBenchmarkSolarSystem(int asteroids, int ringAsteroids, SolarSystem& system)
+{
+    SolarSystemSettings settings;
+    settings.ephemerisPath.clear(); // Propagate the planets rather than write a table next to the assets
+    settings.asteroidCount = asteroids;
+    settings.ringAsteroidCount = ringAsteroids;
+    settings.seed = 12345;
+    return createSolarSystem(settings, system);
+}
+
+int runSimulationBenchmark(int ticks, double maxTickMilliseconds)
+{
+    ticks = std::max(ticks, 1);
+    printf("Simulation benchmark on %zu threads, %d ticks of %.4f s\n", parallelThreadCount(), ticks, SIMULATION_BENCHMARK_TICK);
+
+    SolarSystem appScale;
+    if (!createBenchmarkSolarSystem(NUM_ASTEROIDS, NUM_RING_ASTEROIDS, appScale))
+        return 1;
+    double appTick = benchmarkTicks("Kepler", appScale, ticks, SIMULATION_BENCHMARK_TICK);
+    benchmarkTicks("Kepler, 1000x warp", appScale, ticks, SIMULATION_BENCHMARK_TICK * 1000.0);
+
+    seekSolarSystem(appScale, 0.0);
+    appScale.nbodyEnabled = true;
+    benchmarkTicks("N-body", appScale, std::max(ticks / SIMULATION_BENCHMARK_NBODY_DIVISOR, 1), SIMULATION_BENCHMARK_TICK);
+
+    SolarSystem large;
+    if (!createBenchmarkSolarSystem(SIMULATION_BENCHMARK_LARGE_POPULATION, SIMULATION_BENCHMARK_LARGE_POPULATION, large))
+        return 1;
+    benchmarkTicks("Kepler", large, ticks, SIMULATION_BENCHMARK_TICK);
+
+    if (maxTickMilliseconds > 0.0 && appTick > maxTickMilliseconds)
+    {
+        printf("Kepler tick of %.3f ms exceeds the budget of %.3f ms\n", appTick, maxTickMilliseconds);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Function to time Barnes-Hut steps for large belts and check energy drift on a small one.
+// Returns 0 if the drift check passed.
+int runNBodyBenchmark();
+
+// Function to time spatial hash rebuilds, queries and the collision pass at a million particles,
+// after checking them against brute force on a small set. Returns 0 if the check passed.
+int runSpatialHashBenchmark();
+
+const int SIMULATION_BENCHMARK_TICKS = 600; // Default tick count, ten seconds of the app at 1x
+
+// Function to step the headless solar system (bodies from res/bodies.txt) at the app's size and
+// at 100k belt and ring particles, printing the time per tick. Returns 0 unless the mean
+// Kepler tick at the app's size exceeds maxTickMilliseconds (ignored when zero).
+int runSimulationBenchmark(int ticks, double maxTickMilliseconds = 0.0);
@@ -0,0 +1,136 @@
+#include "Bodies.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+
+    BodyName makeName(const std::string& name)
+    {
+        BodyName bodyName;
+        std::memset(bodyName.text, 0, sizeof(bodyName.text));
+        std::strncpy(bodyName.text, name.c_str(), sizeof(bodyName.text) - 1);
+        return bodyName;
+    }
+}
+
+void registerBodyComponents()
+{
+    componentMask<BodyName, Orbit, Appearance, Spin, Mass, Satellite, StateSlot, SceneNode, MajorBody, BeltAsteroid, RingParticle>();
+}
+
+uint32_t textureIndex(BodyCatalog& catalog, const std::string& path)
+{
+    for (size_t i = 0; i < catalog.texturePaths.size(); ++i)
+    {
+        if (catalog.texturePaths[i] == path)
+            return uint32_t(i);
+    }
+
+    catalog.texturePaths.push_back(path);
+    return uint32_t(catalog.texturePaths.size() - 1);
+}
+
+bool loadBodies(const std::string& filePath, EcsWorld& world, BodyCatalog& catalog)
+{
+    std::ifstream stream(filePath);
+    if (!stream)
+    {
+        std::cerr << "Failed to open body file: " << filePath << std::endl;
+        return false;
+    }
+
+    uint32_t majorBodies = 0;
+    int lineNumber = 0;
+    std::string line;
+    while (getline(stream, line))
+    {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        std::string kind, name, texture;
+        float radius;
+        if (!(fields >> kind >> name >> texture >> radius))
+        {
+            std::cerr << "Malformed body in " << filePath << ":" << lineNumber << ": " << line << std::endl;
+            return false;
+        }
+
+        Appearance appearance = { textureIndex(catalog, texture), radius };
+
+        if (kind == "body")
+        {
+            double inclination, node, periapsisLongitude, meanLongitude;
+            float spin;
+            double mass;
+            OrbitalElements elements;
+            if (!(fields >> elements.semiMajorAxis >> elements.eccentricity >> inclination >> node >> periapsisLongitude
+                         >> meanLongitude >> elements.meanMotion >> spin >> mass))
+            {
+                std::cerr << "Malformed body in " << filePath << ":" << lineNumber << ": " << line << std::endl;
+                return false;
+            }
+
+            // Longitudes are measured from the reference direction; the propagator wants angles from the node and periapsis
+            elements.inclination = inclination * DEGREES_TO_RADIANS;
+            elements.ascendingNode = node * DEGREES_TO_RADIANS;
+            elements.argumentOfPeriapsis = (periapsisLongitude - node) * DEGREES_TO_RADIANS;
+            elements.meanAnomalyAtEpoch = (meanLongitude - periapsisLongitude) * DEGREES_TO_RADIANS;
+
+            world.create(makeName(name), MajorBody(), StateSlot{ majorBodies++ }, Orbit{ elements }, appearance, Spin{ spin },
+                         Mass{ mass }, SceneNode());
+        }
+        else if (kind == "moon")
+        {
+            std::string parentName;
+            Satellite satellite;
+            if (!(fields >> parentName >> satellite.orbitRadius >> satellite.orbitSpeed))
+            {
+                std::cerr << "Malformed moon in " << filePath << ":" << lineNumber << ": " << line << std::endl;
+                return false;
+            }
+
+            satellite.parent = findBody(world, parentName);
+            if (satellite.parent == NO_ENTITY)
+            {
+                std::cerr << "Unknown parent " << parentName << " in " << filePath << ":" << lineNumber << std::endl;
+                return false;
+            }
+
+            world.create(makeName(name), satellite, appearance, SceneNode());
+        }
+        else
+        {
+            std::cerr << "Unknown body kind in " << filePath << ":" << lineNumber << ": " << kind << std::endl;
+            return false;
+        }
+    }
+
+    if (majorBodies == 0)
+    {
+        std::cerr << "No bodies in " << filePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+Entity findBody(EcsWorld& world, const std::string& name)
+{
+    Entity found = NO_ENTITY;
+    world.forEach<BodyName>([&](size_t count, const Entity* entities, BodyName* names)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (name == names[i].text)
+                found = entities[i];
+        }
+    });
+    return found;
+}
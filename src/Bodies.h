@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Ecs.h"
+#include "Kepler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Components shared by every body in the scene
+
+struct BodyName
+{
+    char text[16];
+};
+
+// Keplerian orbit around the body's primary
+struct Orbit
+{
+    OrbitalElements elements;
+};
+
+struct Appearance
+{
+    uint32_t texture;   // Index into BodyCatalog::texturePaths
+    float radius;       // Scale of the unit sphere
+};
+
+// Rotation about the body's Y axis
+struct Spin
+{
+    float rate;         // Radians per simulated second
+};
+
+struct Mass
+{
+    double solarMasses;
+};
+
+// Circular orbit around another entity, for moons
+struct Satellite
+{
+    Entity parent;
+    float orbitRadius;
+    float orbitSpeed;   // Radians per simulated second
+};
+
+// Index of the body in its population's orbit batch and state arrays
+struct StateSlot
+{
+    uint32_t index;
+};
+
+// Nodes of the body in the scene's transform graph
+struct SceneNode
+{
+    uint32_t frame;     // Position; children such as moons hang off it
+    uint32_t body;      // Spin and scale, not inherited
+};
+
+// Population tags; each population is propagated as one orbit batch
+struct MajorBody {};    // The sun and planets (SimulationState::planetPositions)
+struct BeltAsteroid {}; // SimulationState::asteroidPositions
+struct RingParticle {}; // SimulationState::ringAsteroidPositions
+
+// Texture paths referenced by Appearance components, without duplicates
+struct BodyCatalog
+{
+    std::vector<std::string> texturePaths;
+};
+
+// Function to register every body component type, so worlds can be restored before any is used
+void registerBodyComponents();
+
+// Function to get the index of a texture path in the catalog, adding it if it is new
+uint32_t textureIndex(BodyCatalog& catalog, const std::string& path);
+
+// Function to load the sun, planets and moons from a text file. Lines are either
+//   body name texture radius a e inclination node periLongitude meanLongitude meanMotion spin mass
+//   moon name texture radius parent orbitRadius orbitSpeed
+// with angles in degrees and rates in radians per second. The first body is the primary the
+// others orbit; moons must follow their parent. Returns false if the file is missing or malformed.
+bool loadBodies(const std::string& filePath, EcsWorld& world, BodyCatalog& catalog);
+
+// Function to find a body by name; returns NO_ENTITY if there is none
+Entity findBody(EcsWorld& world, const std::string& name);
+
+// Function to list the entities of a population in StateSlot order
+template<typename Population>
+std::vector<Entity> populationBySlot(EcsWorld& world)
+{
+    std::vector<std::pair<uint32_t, Entity>> slots;
+    world.forEach<Population, StateSlot>([&](size_t count, const Entity* entities, Population*, StateSlot* slot)
+    {
+        for (size_t i = 0; i < count; ++i)
+            slots.push_back(std::make_pair(slot[i].index, entities[i]));
+    });
+    std::sort(slots.begin(), slots.end());
+
+    std::vector<Entity> entities;
+    for (const std::pair<uint32_t, Entity>& slot : slots)
+        entities.push_back(slot.second);
+    return entities;
+}
+
+// Function to build a population's orbit batch, in StateSlot order
+template<typename Population>
+void gatherOrbits(EcsWorld& world, KeplerBatch& orbits)
+{
+    std::vector<Entity> entities = populationBySlot<Population>(world);
+    orbits = KeplerBatch();
+    reserveOrbits(orbits, entities.size());
+    for (Entity entity : entities)
+        addOrbit(orbits, world.get<Orbit>(entity)->elements);
+}
+
+// Function to gather a population's sphere radii, indexed by StateSlot
+template<typename Population>
+void gatherRadii(EcsWorld& world, std::vector<float>& radii)
+{
+    radii.assign(world.count<Population, StateSlot>(), 0.0f);
+    world.forEach<Population, StateSlot, Appearance>([&](size_t count, const Entity*, Population*, StateSlot* slot, Appearance* appearance)
+    {
+        for (size_t i = 0; i < count; ++i)
+            radii[slot[i].index] = appearance[i].radius;
+    });
+}
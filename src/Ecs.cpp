@@ -0,0 +1,231 @@
+#include "Ecs.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+namespace
+{
+    struct ComponentType
+    {
+        size_t size;
+        size_t alignment;
+        const char* name;
+    };
+
+    // Registered types never change, so only registration needs the lock
+    std::mutex registryMutex;
+    ComponentType componentTypes[MAX_COMPONENT_TYPES];
+    size_t componentTypeCount = 0;
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Function to lay the columns of an archetype out in a chunk; returns the bytes used
+    size_t layoutChunk(EcsArchetype& archetype, uint32_t capacity)
+    {
+        size_t offset = 0;
+        archetype.entityOffset = 0;
+        offset += capacity * sizeof(Entity);
+
+        for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+        {
+            archetype.columnOffset[component] = 0;
+            if ((archetype.mask & (ComponentMask(1) << component)) == 0 || componentSize(component) == 0)
+                continue;
+
+            offset = alignUp(offset, ECS_CACHE_LINE);
+            archetype.columnOffset[component] = uint32_t(offset);
+            offset += capacity * componentSize(component);
+        }
+
+        return offset;
+    }
+}
+
+size_t registerComponentType(size_t size, size_t alignment, const char* name)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (componentTypeCount >= MAX_COMPONENT_TYPES || alignment > ECS_CACHE_LINE)
+    {
+        std::cerr << "Unsupported ECS component type" << std::endl;
+        std::abort();
+    }
+
+    componentTypes[componentTypeCount] = { size, alignment, name };
+    return componentTypeCount++;
+}
+
+size_t componentSize(size_t component)
+{
+    return componentTypes[component].size;
+}
+
+const char* componentName(size_t component)
+{
+    return componentTypes[component].name;
+}
+
+size_t findComponentType(const char* name)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (size_t component = 0; component < componentTypeCount; ++component)
+    {
+        if (std::strcmp(componentTypes[component].name, name) == 0)
+            return component;
+    }
+    return MAX_COMPONENT_TYPES;
+}
+
+uint32_t EcsWorld::findArchetype(ComponentMask mask)
+{
+    for (size_t i = 0; i < archetypes.size(); ++i)
+    {
+        if (archetypes[i].mask == mask)
+            return uint32_t(i);
+    }
+
+    EcsArchetype archetype;
+    archetype.mask = mask;
+
+    // Start from the capacity the bytes per entity allow, then shrink until the padding fits too
+    size_t bytesPerEntity = sizeof(Entity);
+    for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+    {
+        if (mask & (ComponentMask(1) << component))
+            bytesPerEntity += componentSize(component);
+    }
+
+    uint32_t capacity = uint32_t(ECS_CHUNK_SIZE / bytesPerEntity);
+    while (capacity > 1 && layoutChunk(archetype, capacity) > ECS_CHUNK_SIZE)
+        --capacity;
+
+    // Entities too large for a chunk get an oversized chunk of their own rather than failing
+    if (capacity == 0)
+        capacity = 1;
+    archetype.capacity = capacity;
+    archetype.chunkBytes = uint32_t(std::max(ECS_CHUNK_SIZE, layoutChunk(archetype, capacity)));
+
+    archetypes.push_back(std::move(archetype));
+    return uint32_t(archetypes.size() - 1);
+}
+
+Entity EcsWorld::createEntity(ComponentMask mask)
+{
+    uint32_t archetypeIndex = findArchetype(mask);
+    EcsArchetype& archetype = archetypes[archetypeIndex];
+
+    // Append to the last chunk, starting a new one when it is full
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity)
+    {
+        EcsChunk chunk;
+        chunk.storage.reset(new unsigned char[archetype.chunkBytes + ECS_CACHE_LINE]);
+        chunk.data = reinterpret_cast<unsigned char*>(alignUp(reinterpret_cast<size_t>(chunk.storage.get()), ECS_CACHE_LINE));
+        archetype.chunks.push_back(std::move(chunk));
+    }
+
+    Entity entity;
+    if (!freeEntities.empty())
+    {
+        entity = freeEntities.back();
+        freeEntities.pop_back();
+    }
+    else
+    {
+        entity = Entity(locations.size());
+        locations.push_back(EntityLocation());
+    }
+
+    uint32_t chunkIndex = uint32_t(archetype.chunks.size() - 1);
+    EcsChunk& chunk = archetype.chunks[chunkIndex];
+    uint32_t row = chunk.count++;
+
+    entityColumn(archetype, chunk)[row] = entity;
+    for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+    {
+        size_t size = (mask & (ComponentMask(1) << component)) ? componentSize(component) : 0;
+        if (size > 0)
+            std::memset(chunk.data + archetype.columnOffset[component] + row * size, 0, size);
+    }
+
+    locations[entity] = { archetypeIndex, chunkIndex, row };
+    return entity;
+}
+
+void EcsWorld::destroyEntity(Entity entity)
+{
+    if (!isAlive(entity))
+        return;
+
+    EntityLocation location = locations[entity];
+    EcsArchetype& archetype = archetypes[location.archetype];
+    EcsChunk& chunk = archetype.chunks[location.chunk];
+    EcsChunk& lastChunk = archetype.chunks.back();
+    uint32_t lastRow = lastChunk.count - 1;
+
+    // Move the archetype's last entity into the hole
+    if (&chunk != &lastChunk || location.row != lastRow)
+    {
+        Entity moved = entityColumn(archetype, lastChunk)[lastRow];
+        entityColumn(archetype, chunk)[location.row] = moved;
+        for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+        {
+            size_t size = (archetype.mask & (ComponentMask(1) << component)) ? componentSize(component) : 0;
+            if (size > 0)
+            {
+                std::memcpy(chunk.data + archetype.columnOffset[component] + location.row * size,
+                            lastChunk.data + archetype.columnOffset[component] + lastRow * size, size);
+            }
+        }
+        locations[moved] = location;
+    }
+
+    if (--lastChunk.count == 0)
+        archetype.chunks.pop_back();
+
+    locations[entity].archetype = NO_ENTITY;
+    freeEntities.push_back(entity);
+}
+
+void* EcsWorld::componentData(Entity entity, size_t component)
+{
+    if (!isAlive(entity))
+        return nullptr;
+
+    const EntityLocation& location = locations[entity];
+    EcsArchetype& archetype = archetypes[location.archetype];
+    if ((archetype.mask & (ComponentMask(1) << component)) == 0)
+        return nullptr;
+
+    EcsChunk& chunk = archetype.chunks[location.chunk];
+    return chunk.data + archetype.columnOffset[component] + location.row * componentSize(component);
+}
+
+void EcsWorld::runChunks(size_t count, const std::function<void(size_t)>& body)
+{
+    parallelFor(count, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            body(i);
+    });
+}
+
+void EcsWorld::restore(std::vector<EcsArchetype> restoredArchetypes, std::vector<EntityLocation> restoredLocations, std::vector<Entity> restoredFreeEntities)
+{
+    archetypes = std::move(restoredArchetypes);
+    locations = std::move(restoredLocations);
+    freeEntities = std::move(restoredFreeEntities);
+}
+
+size_t EcsWorld::chunkCount() const
+{
+    size_t total = 0;
+    for (const EcsArchetype& archetype : archetypes)
+        total += archetype.chunks.size();
+    return total;
+}
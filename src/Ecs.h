@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+// Small archetype-based entity component system. Entities with the same set of components share
+// an archetype, whose entities are packed into fixed-size chunks holding one cache-line-aligned
+// column per component. Systems iterate the chunks of every archetype that has the components
+// they ask for, touching only those columns.
+//
+// Components must be trivially copyable: entities are moved between rows with memcpy.
+// Empty structs work as tags; they take part in matching but get no column.
+
+typedef uint32_t Entity;
+typedef uint64_t ComponentMask;
+
+const Entity NO_ENTITY = 0xFFFFFFFFu;
+const size_t MAX_COMPONENT_TYPES = 64;
+const size_t ECS_CHUNK_SIZE = 16 * 1024;
+const size_t ECS_CACHE_LINE = 64;
+
+// Function to register a component type and get its id (use componentId<T>() instead)
+size_t registerComponentType(size_t size, size_t alignment, const char* name);
+
+// Function to get the size of a registered component type
+size_t componentSize(size_t component);
+
+// Function to get the name a component type was registered with (its type_info name), which
+// unlike the id does not depend on registration order
+const char* componentName(size_t component);
+
+// Function to find a registered component type by name; returns MAX_COMPONENT_TYPES if none matches
+size_t findComponentType(const char* name);
+
+// Function to get the id of a component type, registering it on first use
+template<typename T>
+size_t componentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Components must be trivially copyable");
+    static const size_t id = registerComponentType(std::is_empty<T>::value ? 0 : sizeof(T), alignof(T), typeid(T).name());
+    return id;
+}
+
+// Function to get the mask of a set of component types
+template<typename... Components>
+ComponentMask componentMask()
+{
+    ComponentMask mask = 0;
+    (void)std::initializer_list<int>{ (mask |= ComponentMask(1) << componentId<Components>(), 0)... };
+    return mask;
+}
+
+// Fixed-size block of entities of one archetype
+struct EcsChunk
+{
+    std::unique_ptr<unsigned char[]> storage;   // Empty when the chunk lives in memory owned elsewhere
+    unsigned char* data = nullptr;              // storage aligned to a cache line
+    uint32_t count = 0;
+};
+
+// All entities with exactly the same set of components
+struct EcsArchetype
+{
+    ComponentMask mask = 0;
+    uint32_t capacity = 0;                      // Entities per chunk
+    uint32_t chunkBytes = 0;                    // Bytes allocated per chunk
+    uint32_t entityOffset = 0;                  // Offset of the entity id column in a chunk
+    uint32_t columnOffset[MAX_COMPONENT_TYPES]; // Offset of each component column in a chunk
+    std::vector<EcsChunk> chunks;
+};
+
+class EcsWorld
+{
+public:
+    EcsWorld() = default;
+    EcsWorld(const EcsWorld&) = delete;
+    EcsWorld& operator=(const EcsWorld&) = delete;
+
+    // Function to create an entity with the given components, all zero-initialised
+    Entity createEntity(ComponentMask mask);
+
+    // Function to create an entity and set its components
+    template<typename... Components>
+    Entity create(const Components&... values)
+    {
+        Entity entity = createEntity(componentMask<Components...>());
+        (void)std::initializer_list<int>{ (*get<Components>(entity) = values, 0)... };
+        return entity;
+    }
+
+    // Function to destroy an entity; the archetype's last entity moves into its row so chunks stay packed
+    void destroyEntity(Entity entity);
+
+    bool isAlive(Entity entity) const { return entity < locations.size() && locations[entity].archetype != NO_ENTITY; }
+
+    // Function to get a component of an entity, or nullptr if it does not have one
+    template<typename T>
+    T* get(Entity entity)
+    {
+        return static_cast<T*>(componentData(entity, componentId<T>()));
+    }
+
+    template<typename T>
+    bool has(Entity entity) const
+    {
+        return isAlive(entity) && (archetypes[locations[entity].archetype].mask & componentMask<T>()) != 0;
+    }
+
+    // Function to call function(count, entities, columns...) for every chunk whose archetype has
+    // all of the listed components
+    template<typename... Components, typename Function>
+    void forEach(Function function)
+    {
+        ComponentMask required = componentMask<Components...>();
+        for (EcsArchetype& archetype : archetypes)
+        {
+            if ((archetype.mask & required) != required)
+                continue;
+
+            for (EcsChunk& chunk : archetype.chunks)
+            {
+                if (chunk.count > 0)
+                    function(size_t(chunk.count), entityColumn(archetype, chunk), column<Components>(archetype, chunk)...);
+            }
+        }
+    }
+
+    // Function like forEach that spreads the matching chunks over the worker pool
+    template<typename... Components, typename Function>
+    void parallelForEach(Function function)
+    {
+        ComponentMask required = componentMask<Components...>();
+        std::vector<std::pair<EcsArchetype*, EcsChunk*>> matches;
+        for (EcsArchetype& archetype : archetypes)
+        {
+            if ((archetype.mask & required) != required)
+                continue;
+            for (EcsChunk& chunk : archetype.chunks)
+            {
+                if (chunk.count > 0)
+                    matches.push_back(std::make_pair(&archetype, &chunk));
+            }
+        }
+
+        runChunks(matches.size(), [&](size_t i)
+        {
+            EcsArchetype& archetype = *matches[i].first;
+            EcsChunk& chunk = *matches[i].second;
+            function(size_t(chunk.count), entityColumn(archetype, chunk), column<Components>(archetype, chunk)...);
+        });
+    }
+
+    // Function to count the entities that have all of the listed components
+    template<typename... Components>
+    size_t count()
+    {
+        size_t total = 0;
+        forEach<Components...>([&](size_t chunkCount, const Entity*, Components*...) { total += chunkCount; });
+        return total;
+    }
+
+    size_t entityCount() const { return locations.size() - freeEntities.size(); }
+    size_t archetypeCount() const { return archetypes.size(); }
+    size_t chunkCount() const;
+
+    struct EntityLocation
+    {
+        uint32_t archetype;
+        uint32_t chunk;
+        uint32_t row;
+    };
+
+    // Raw world data, for snapshots
+    const std::vector<EcsArchetype>& archetypeList() const { return archetypes; }
+    const std::vector<EntityLocation>& locationList() const { return locations; }
+    const std::vector<Entity>& freeList() const { return freeEntities; }
+
+    // Function to replace the whole world with archetypes whose chunks may point into memory owned
+    // elsewhere, such as a mapped snapshot; that memory must stay writable and outlive the world
+    void restore(std::vector<EcsArchetype> restoredArchetypes, std::vector<EntityLocation> restoredLocations, std::vector<Entity> restoredFreeEntities);
+
+private:
+    uint32_t findArchetype(ComponentMask mask);
+    void* componentData(Entity entity, size_t component);
+    void runChunks(size_t count, const std::function<void(size_t)>& body);
+
+    Entity* entityColumn(EcsArchetype& archetype, EcsChunk& chunk)
+    {
+        return reinterpret_cast<Entity*>(chunk.data + archetype.entityOffset);
+    }
+
+    template<typename T>
+    T* column(EcsArchetype& archetype, EcsChunk& chunk)
+    {
+        return reinterpret_cast<T*>(chunk.data + archetype.columnOffset[componentId<T>()]);
+    }
+
+    std::vector<EcsArchetype> archetypes;
+    std::vector<EntityLocation> locations;
+    std::vector<Entity> freeEntities;
+};
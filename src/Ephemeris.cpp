@@ -0,0 +1,309 @@
+#include "Ephemeris.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const double PI = 3.14159265358979323846;
+
+void fitEphemeris(const std::function<glm::dvec3(size_t body, double time)>& positionAt, const std::vector<double>& segmentLengths,
+                  double startTime, double endTime, int coefficientCount, Ephemeris& ephemeris)
+{
+    double span = endTime - startTime;
+    size_t terms = static_cast<size_t>(coefficientCount);
+
+    ephemeris.file.close();
+    ephemeris.startTime = startTime;
+    ephemeris.endTime = endTime;
+    ephemeris.bodies.clear();
+
+    uint64_t offset = 0;
+    for (double segmentLength : segmentLengths)
+    {
+        // Round to whole segments over the span
+        uint32_t segmentCount = static_cast<uint32_t>(std::max(1.0, ceil(span / std::min(segmentLength, span) - 1e-9)));
+        EphemerisBody body = { span / segmentCount, segmentCount, static_cast<uint32_t>(terms), offset };
+        ephemeris.bodies.push_back(body);
+        offset += uint64_t(segmentCount) * 3 * terms;
+    }
+    ephemeris.storage.assign(static_cast<size_t>(offset), 0.0);
+
+    // Chebyshev nodes on [-1, 1] and the cosine table of the discrete transform
+    std::vector<double> nodes(terms), basis(terms * terms);
+    for (size_t k = 0; k < terms; ++k)
+    {
+        nodes[k] = cos(PI * (k + 0.5) / terms);
+        for (size_t j = 0; j < terms; ++j)
+            basis[j * terms + k] = cos(PI * j * (k + 0.5) / terms);
+    }
+
+    for (size_t bodyIndex = 0; bodyIndex < ephemeris.bodies.size(); ++bodyIndex)
+    {
+        const EphemerisBody& body = ephemeris.bodies[bodyIndex];
+
+        // Segments are independent, so fit them in parallel
+        parallelFor(body.segmentCount, 16, [&](size_t firstSegment, size_t lastSegment)
+        {
+            std::vector<glm::dvec3> samples(terms);
+            for (size_t segment = firstSegment; segment < lastSegment; ++segment)
+            {
+                double segmentStart = startTime + segment * body.segmentLength;
+                for (size_t k = 0; k < terms; ++k)
+                    samples[k] = positionAt(bodyIndex, segmentStart + 0.5 * (nodes[k] + 1.0) * body.segmentLength);
+
+                double* target = &ephemeris.storage[static_cast<size_t>(body.offset) + segment * 3 * terms];
+                for (size_t j = 0; j < terms; ++j)
+                {
+                    glm::dvec3 sum(0.0);
+                    for (size_t k = 0; k < terms; ++k)
+                        sum += samples[k] * basis[j * terms + k];
+
+                    double weight = (j == 0 ? 1.0 : 2.0) / terms;
+                    target[j] = sum.x * weight;
+                    target[terms + j] = sum.y * weight;
+                    target[2 * terms + j] = sum.z * weight;
+                }
+            }
+        });
+    }
+
+    ephemeris.coefficients = ephemeris.storage.data();
+}
+
+bool writeEphemeris(const std::string& filePath, const Ephemeris& ephemeris)
+{
+    std::ofstream stream(filePath, std::ios::binary);
+    if (!stream)
+        return false;
+
+    EphemerisFileHeader header;
+    memcpy(header.magic, EPHEMERIS_MAGIC, sizeof(header.magic));
+    header.version = EPHEMERIS_VERSION;
+    header.bodyCount = static_cast<uint32_t>(ephemeris.bodies.size());
+    header.startTime = ephemeris.startTime;
+    header.endTime = ephemeris.endTime;
+
+    size_t coefficientCount = 0;
+    for (const EphemerisBody& body : ephemeris.bodies)
+        coefficientCount = std::max(coefficientCount, static_cast<size_t>(body.offset) + size_t(body.segmentCount) * 3 * body.coefficientCount);
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(ephemeris.bodies.data()), ephemeris.bodies.size() * sizeof(EphemerisBody));
+    stream.write(reinterpret_cast<const char*>(ephemeris.coefficients), coefficientCount * sizeof(double));
+    return static_cast<bool>(stream);
+}
+
+bool loadEphemeris(const std::string& filePath, Ephemeris& ephemeris)
+{
+    ephemeris.bodies.clear();
+    ephemeris.storage.clear();
+    ephemeris.coefficients = nullptr;
+
+    if (!ephemeris.file.open(filePath))
+        return false;
+
+    const unsigned char* data = ephemeris.file.data();
+    size_t size = ephemeris.file.size();
+
+    EphemerisFileHeader header;
+    if (size < sizeof(header))
+    {
+        ephemeris.file.close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    size_t coefficientsStart = sizeof(header) + size_t(header.bodyCount) * sizeof(EphemerisBody);
+    if (memcmp(header.magic, EPHEMERIS_MAGIC, sizeof(header.magic)) != 0 || header.version != EPHEMERIS_VERSION || size < coefficientsStart)
+    {
+        std::cerr << "Not a valid ephemeris file: " << filePath << std::endl;
+        ephemeris.file.close();
+        return false;
+    }
+
+    // Every body's coefficients must lie inside the file
+    size_t coefficientCount = (size - coefficientsStart) / sizeof(double);
+    std::vector<EphemerisBody> bodies(header.bodyCount);
+    memcpy(bodies.data(), data + sizeof(header), bodies.size() * sizeof(EphemerisBody));
+    for (const EphemerisBody& body : bodies)
+    {
+        uint64_t end = body.offset + uint64_t(body.segmentCount) * 3 * body.coefficientCount;
+        if (body.segmentCount == 0 || body.coefficientCount == 0 || !(body.segmentLength > 0.0) || end > coefficientCount)
+        {
+            std::cerr << "Truncated ephemeris file: " << filePath << std::endl;
+            ephemeris.file.close();
+            return false;
+        }
+    }
+
+    ephemeris.startTime = header.startTime;
+    ephemeris.endTime = header.endTime;
+    ephemeris.bodies = std::move(bodies);
+    ephemeris.coefficients = reinterpret_cast<const double*>(data + coefficientsStart);
+    return true;
+}
+
+glm::dvec3 ephemerisPosition(const Ephemeris& ephemeris, size_t bodyIndex, double time)
+{
+    const EphemerisBody& body = ephemeris.bodies[bodyIndex];
+
+    // Find the segment and map the time onto [-1, 1]
+    double offset = (time - ephemeris.startTime) / body.segmentLength;
+    double segment = std::min(std::max(floor(offset), 0.0), double(body.segmentCount - 1));
+    double tau = std::min(std::max(2.0 * (offset - segment) - 1.0, -1.0), 1.0);
+
+    size_t terms = body.coefficientCount;
+    const double* x = ephemeris.coefficients + body.offset + static_cast<size_t>(segment) * 3 * terms;
+    const double* y = x + terms;
+    const double* z = y + terms;
+
+    // Clenshaw recurrence on all three axes at once
+    double twoTau = 2.0 * tau;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0, z1 = 0.0, z2 = 0.0;
+    for (size_t j = terms - 1; j > 0; --j)
+    {
+        double x0 = twoTau * x1 - x2 + x[j];
+        double y0 = twoTau * y1 - y2 + y[j];
+        double z0 = twoTau * z1 - z2 + z[j];
+        x2 = x1; x1 = x0;
+        y2 = y1; y1 = y0;
+        z2 = z1; z1 = z0;
+    }
+
+    return glm::dvec3(tau * x1 - x2 + x[0], tau * y1 - y2 + y[0], tau * z1 - z2 + z[0]);
+}
+
+void evaluateEphemeris(const Ephemeris& ephemeris, double time, Vec3Array& positions)
+{
+    positions.resize(ephemeris.size());
+    for (size_t i = 0; i < ephemeris.size(); ++i)
+    {
+        glm::dvec3 position = ephemerisPosition(ephemeris, i, time);
+        positions.x[i] = position.x;
+        positions.y[i] = position.y;
+        positions.z[i] = position.z;
+    }
+}
+
+// Samples of one body from a Horizons table, in scene units
+struct HorizonsSamples
+{
+    std::vector<double> time;
+    std::vector<glm::dvec3> position;
+    std::vector<glm::dvec3> velocity;   // Empty if the table has no velocity columns
+};
+
+// Function to read the $$SOE..$$EOE block of a Horizons vector table in CSV format
+static bool readHorizonsVectors(const std::string& filePath, const HorizonsImportSettings& settings, HorizonsSamples& samples)
+{
+    std::ifstream stream(filePath);
+    if (!stream)
+    {
+        std::cerr << "Failed to open Horizons table: " << filePath << std::endl;
+        return false;
+    }
+
+    bool inData = false;
+    bool hasVelocity = true;
+    std::string line;
+    while (getline(stream, line))
+    {
+        if (line.compare(0, 5, "$$SOE") == 0) { inData = true; continue; }
+        if (line.compare(0, 5, "$$EOE") == 0) break;
+        if (!inData)
+            continue;
+
+        // JDTDB, Calendar Date, X, Y, Z[, VX, VY, VZ, ...]
+        std::vector<std::string> fields;
+        std::istringstream columns(line);
+        std::string field;
+        while (getline(columns, field, ','))
+            fields.push_back(field);
+        if (fields.size() < 5)
+            continue;
+
+        // Horizons' ecliptic y maps onto scene z, as for the Keplerian orbits
+        double julianDay = atof(fields[0].c_str());
+        glm::dvec3 position(atof(fields[2].c_str()), atof(fields[4].c_str()), atof(fields[3].c_str()));
+        samples.time.push_back((julianDay - settings.epochJulianDay) * settings.secondsPerDay);
+        samples.position.push_back(position * settings.unitsPerAu);
+
+        hasVelocity = hasVelocity && fields.size() >= 8;
+        if (hasVelocity)
+        {
+            glm::dvec3 velocity(atof(fields[5].c_str()), atof(fields[7].c_str()), atof(fields[6].c_str()));
+            samples.velocity.push_back(velocity * (settings.unitsPerAu / settings.secondsPerDay));
+        }
+    }
+
+    if (!hasVelocity)
+        samples.velocity.clear();
+
+    if (samples.time.size() < 2)
+    {
+        std::cerr << "No vector samples in Horizons table: " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to interpolate Horizons samples with a cubic Hermite spline, using the tabulated
+// velocities as tangents when present and finite differences otherwise
+static glm::dvec3 interpolateSamples(const HorizonsSamples& samples, double time)
+{
+    size_t count = samples.time.size();
+    size_t upper = std::upper_bound(samples.time.begin(), samples.time.end(), time) - samples.time.begin();
+    size_t i = std::min(std::max<size_t>(upper, 1), count - 1) - 1;
+
+    double t0 = samples.time[i], t1 = samples.time[i + 1];
+    double h = t1 - t0;
+    double s = std::min(std::max((time - t0) / h, 0.0), 1.0);
+
+    auto tangent = [&](size_t k)
+    {
+        if (!samples.velocity.empty())
+            return samples.velocity[k];
+        size_t previous = k > 0 ? k - 1 : k;
+        size_t next = k + 1 < count ? k + 1 : k;
+        return (samples.position[next] - samples.position[previous]) / (samples.time[next] - samples.time[previous]);
+    };
+
+    double s2 = s * s, s3 = s2 * s;
+    return (2.0 * s3 - 3.0 * s2 + 1.0) * samples.position[i] + (s3 - 2.0 * s2 + s) * h * tangent(i)
+         + (-2.0 * s3 + 3.0 * s2) * samples.position[i + 1] + (s3 - s2) * h * tangent(i + 1);
+}
+
+bool importHorizonsVectors(const std::vector<std::string>& filePaths, const HorizonsImportSettings& settings, Ephemeris& ephemeris)
+{
+    std::vector<HorizonsSamples> bodies(filePaths.size());
+    for (size_t i = 0; i < filePaths.size(); ++i)
+    {
+        if (!readHorizonsVectors(filePaths[i], settings, bodies[i]))
+            return false;
+    }
+    if (bodies.empty())
+        return false;
+
+    // Only the time range every table covers
+    double startTime = bodies[0].time.front(), endTime = bodies[0].time.back();
+    for (const HorizonsSamples& samples : bodies)
+    {
+        startTime = std::max(startTime, samples.time.front());
+        endTime = std::min(endTime, samples.time.back());
+    }
+    if (!(endTime > startTime))
+    {
+        std::cerr << "Horizons tables do not overlap in time" << std::endl;
+        return false;
+    }
+
+    std::vector<double> segmentLengths(bodies.size(), settings.segmentLength);
+    fitEphemeris([&](size_t body, double time) { return interpolateSamples(bodies[body], time); },
+                 segmentLengths, startTime, endTime, settings.coefficientCount, ephemeris);
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Kepler.h"
+#include "MappedFile.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Binary ephemeris file layout (little-endian, every double 8-byte aligned):
+//   EphemerisFileHeader
+//   EphemerisBody[bodyCount]
+//   double coefficients[]   per body, per segment: x[coefficientCount], y[...], z[...]
+const char EPHEMERIS_MAGIC[8] = { 'E', 'P', 'H', 'E', 'M', 'C', 'H', 'B' };
+const uint32_t EPHEMERIS_VERSION = 1;
+
+struct EphemerisFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t bodyCount;
+    double startTime;
+    double endTime;
+};
+
+// Where one body's trajectory lives in the coefficient block. Each body has its own segment
+// length, so fast inner planets do not force short segments on the outer ones.
+struct EphemerisBody
+{
+    double segmentLength;       // Simulated seconds covered by each polynomial
+    uint32_t segmentCount;
+    uint32_t coefficientCount;  // Chebyshev coefficients per axis
+    uint64_t offset;            // Index of the body's first coefficient in the coefficient block
+};
+
+// Trajectories of a set of bodies as piecewise Chebyshev polynomials over [startTime, endTime].
+// The coefficients either live in storage (after fitting) or in a read-only file mapping.
+struct Ephemeris
+{
+    double startTime = 0.0;
+    double endTime = 0.0;
+    std::vector<EphemerisBody> bodies;
+    const double* coefficients = nullptr;
+
+    std::vector<double> storage;
+    MappedFile file;
+
+    size_t size() const { return bodies.size(); }
+    bool covers(double time) const { return !bodies.empty() && time >= startTime && time <= endTime; }
+};
+
+// Function to fit an ephemeris to a position function. Each body gets segments of its own
+// length (clamped to the span), with coefficientCount Chebyshev terms per axis.
+void fitEphemeris(const std::function<glm::dvec3(size_t body, double time)>& positionAt, const std::vector<double>& segmentLengths,
+                  double startTime, double endTime, int coefficientCount, Ephemeris& ephemeris);
+
+// Function to write an ephemeris to a binary file. Returns false on failure.
+bool writeEphemeris(const std::string& filePath, const Ephemeris& ephemeris);
+
+// Function to memory-map an ephemeris file and validate its layout. Returns false if the file
+// is missing or malformed, leaving the ephemeris empty.
+bool loadEphemeris(const std::string& filePath, Ephemeris& ephemeris);
+
+// Function to evaluate one body's position; times outside the table are clamped to its ends
+glm::dvec3 ephemerisPosition(const Ephemeris& ephemeris, size_t body, double time);
+
+// Function to evaluate every body in the table at the given time
+void evaluateEphemeris(const Ephemeris& ephemeris, double time, Vec3Array& positions);
+
+// Settings for importing JPL Horizons vector tables into scene units
+struct HorizonsImportSettings
+{
+    double epochJulianDay = 2451545.0;  // Julian day that maps to simulation time zero (J2000)
+    double secondsPerDay = 86400.0;     // Simulated seconds per day
+    double unitsPerAu = 1.0;            // Scene units per astronomical unit
+    double segmentLength = 86400.0 * 8; // Simulated seconds per polynomial segment
+    int coefficientCount = 12;
+};
+
+// Function to build an ephemeris from JPL Horizons vector tables (CSV output, one file per
+// body, positions in AU between $$SOE and $$EOE). The samples are joined with cubic Hermite
+// splines before fitting, so the table is only as good as the sample spacing allows.
+// Returns false if a file is missing or has fewer than two samples.
+bool importHorizonsVectors(const std::vector<std::string>& filePaths, const HorizonsImportSettings& settings, Ephemeris& ephemeris);
@@ -0,0 +1,239 @@
+#include "FileWatcher.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+// One entry of a directory listing
+struct DirectoryEntry
+{
+    std::string name;
+    bool isDirectory;
+    int64_t size;
+    int64_t modified;   // In the platform's own units; only compared
+};
+
+// Function to list a directory, without "." and ".."
+static std::vector<DirectoryEntry> listDirectory(const std::string& directory)
+{
+    std::vector<DirectoryEntry> entries;
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE)
+        return entries;
+    do
+    {
+        std::string name = found.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        bool isDirectory = (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        int64_t size = int64_t(found.nFileSizeHigh) << 32 | found.nFileSizeLow;
+        int64_t modified = int64_t(found.ftLastWriteTime.dwHighDateTime) << 32 | found.ftLastWriteTime.dwLowDateTime;
+        entries.push_back({ name, isDirectory, size, modified });
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    DIR* listing = opendir(directory.c_str());
+    if (listing == nullptr)
+        return entries;
+    while (dirent* found = readdir(listing))
+    {
+        std::string name = found->d_name;
+        struct stat status;
+        if (name == "." || name == ".." || stat((directory + "/" + name).c_str(), &status) != 0)
+            continue;
+        entries.push_back({ name, S_ISDIR(status.st_mode), int64_t(status.st_size), int64_t(status.st_mtime) * 1000000000 +
+#ifdef __APPLE__
+            status.st_mtimespec.tv_nsec });
+#else
+            status.st_mtim.tv_nsec });
+#endif
+    }
+    closedir(listing);
+#endif
+    return entries;
+}
+
+bool FileWatcher::start(const std::vector<std::string>& directories, const std::vector<std::string>& ignored)
+{
+    stop();
+    roots = directories;
+    ignoredDirectories = ignored;
+    stopping = false;
+
+#ifdef __linux__
+    notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify < 0)
+    {
+        std::cerr << "Failed to start inotify" << std::endl;
+        return false;
+    }
+    for (const std::string& directory : roots)
+        addWatches(directory);
+    if (watches.empty())
+    {
+        close(notify);
+        notify = -1;
+        return false;
+    }
+#else
+    // Files already there are the baseline, not changes
+    stamps.clear();
+    for (const std::string& directory : roots)
+        scan(directory, stamps);
+#endif
+
+    thread = std::thread(&FileWatcher::run, this);
+    return true;
+}
+
+void FileWatcher::stop()
+{
+    if (thread.joinable())
+    {
+        stopping = true;
+        thread.join();
+    }
+#ifdef __linux__
+    if (notify >= 0)
+        close(notify);
+#endif
+    notify = -1;
+    watches.clear();
+    stamps.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    changed.clear();
+}
+
+std::vector<std::string> FileWatcher::takeChanged()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<std::string> settled;
+    auto settledBefore = std::chrono::steady_clock::now() - std::chrono::milliseconds(FILE_WATCH_SETTLE_MS);
+    for (auto file = changed.begin(); file != changed.end();)
+    {
+        if (file->second <= settledBefore)
+        {
+            settled.push_back(file->first);
+            file = changed.erase(file);
+        }
+        else
+            ++file;
+    }
+    return settled;
+}
+
+bool FileWatcher::isIgnored(const std::string& directory) const
+{
+    for (const std::string& ignored : ignoredDirectories)
+    {
+        if (directory == ignored)
+            return true;
+    }
+    return false;
+}
+
+void FileWatcher::record(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    changed[path] = std::chrono::steady_clock::now();
+}
+
+void FileWatcher::addWatches(const std::string& directory)
+{
+#ifdef __linux__
+    if (isIgnored(directory))
+        return;
+    int watch = inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch < 0)
+        return;
+    watches[watch] = directory;
+    for (const DirectoryEntry& entry : listDirectory(directory))
+    {
+        if (entry.isDirectory)
+            addWatches(directory + "/" + entry.name);
+    }
+#else
+    (void)directory;
+#endif
+}
+
+void FileWatcher::scan(const std::string& directory, std::map<std::string, FileStamp>& found) const
+{
+    if (isIgnored(directory))
+        return;
+    for (const DirectoryEntry& entry : listDirectory(directory))
+    {
+        std::string path = directory + "/" + entry.name;
+        if (entry.isDirectory)
+            scan(path, found);
+        else
+            found[path] = { entry.size, entry.modified };
+    }
+}
+
+void FileWatcher::run()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[16384];
+    while (!stopping)
+    {
+        pollfd ready = { notify, POLLIN, 0 };
+        if (poll(&ready, 1, FILE_WATCH_POLL_MS) <= 0)
+            continue;
+
+        ssize_t length;
+        while ((length = read(notify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* next = buffer; next < buffer + length;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(next);
+                next += sizeof(inotify_event) + event->len;
+                auto watch = watches.find(event->wd);
+                if (watch == watches.end() || event->len == 0)
+                    continue;
+
+                // New directories are watched too; files are reported once written or moved in
+                std::string path = watch->second + "/" + event->name;
+                if (event->mask & IN_ISDIR)
+                {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                        addWatches(path);
+                }
+                else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                    record(path);
+            }
+        }
+    }
+#else
+    while (!stopping)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FILE_WATCH_POLL_MS));
+        std::map<std::string, FileStamp> current;
+        for (const std::string& directory : roots)
+            scan(directory, current);
+        for (const auto& file : current)
+        {
+            auto previous = stamps.find(file.first);
+            if (previous == stamps.end() || previous->second != file.second)
+                record(file.first);
+        }
+        stamps.swap(current);
+    }
+#endif
+}
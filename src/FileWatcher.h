@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How long a file must go unwritten before it is reported, so an editor's save (often a truncate
+// and several writes, or a write to a temporary file and a rename) is reported once, complete
+const int FILE_WATCH_SETTLE_MS = 100;
+
+// How often the watcher thread checks whether it should stop, and rescans where there is no inotify
+const int FILE_WATCH_POLL_MS = 100;
+
+// Watches directory trees for files that are written or moved in, on a thread of its own. On
+// Linux the thread blocks on inotify; elsewhere it compares the files' modification times and
+// sizes every FILE_WATCH_POLL_MS. Paths are reported as the watched directory joined to the path
+// below it with '/', so "res" reports "res/shaders/Basic.shader".
+class FileWatcher
+{
+public:
+    FileWatcher() = default;
+    ~FileWatcher() { stop(); }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Function to start watching directories and every directory below them, except the ignored
+    // ones (given the same way, such as "textures/cache"). Returns false if none can be watched.
+    bool start(const std::vector<std::string>& directories, const std::vector<std::string>& ignored);
+
+    // Function to stop the thread; the changes not yet taken are dropped
+    void stop();
+
+    bool isWatching() const { return thread.joinable(); }
+
+    // Function to take the files changed since the last call that have settled, each once
+    std::vector<std::string> takeChanged();
+
+private:
+    // Size and modification time of a file, for the polling watcher
+    struct FileStamp
+    {
+        int64_t size;
+        int64_t modified;
+        bool operator!=(const FileStamp& other) const { return size != other.size || modified != other.modified; }
+    };
+
+    bool isIgnored(const std::string& directory) const;
+    void record(const std::string& path);
+    void addWatches(const std::string& directory);
+    void scan(const std::string& directory, std::map<std::string, FileStamp>& stamps) const;
+    void run();
+
+    std::vector<std::string> roots;
+    std::vector<std::string> ignoredDirectories;
+    std::thread thread;
+    std::atomic<bool> stopping{ false };
+
+    std::mutex mutex;
+    std::map<std::string, std::chrono::steady_clock::time_point> changed;  // By path, when last written
+
+    // Owned by the thread once it starts
+    int notify = -1;                            // inotify descriptor, on Linux
+    std::map<int, std::string> watches;         // Directory of each inotify watch
+    std::map<std::string, FileStamp> stamps;    // Last scan, without inotify
+};
@@ -0,0 +1,42 @@
+#include "FloatingOrigin.h"
+#include "Parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLOATING_ORIGIN_SSE2 1
+#endif
+
+// Function to subtract the origin from one column and narrow it to float
+static void offsetColumn(const double* source, double origin, float* target, size_t count)
+{
+    size_t i = 0;
+
+#ifdef FLOATING_ORIGIN_SSE2
+    // Four doubles in, four floats out per iteration; the subtraction happens in double
+    __m128d originPair = _mm_set1_pd(origin);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 low = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(source + i), originPair));
+        __m128 high = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(source + i + 2), originPair));
+        _mm_storeu_ps(target + i, _mm_movelh_ps(low, high));
+    }
+#endif
+
+    for (; i < count; ++i)
+        target[i] = static_cast<float>(source[i] - origin);
+}
+
+void toCameraRelative(const Vec3Array& positions, const glm::dvec3& origin, RelativePositions& relative)
+{
+    size_t count = positions.size();
+    relative.x.resize(count);
+    relative.y.resize(count);
+    relative.z.resize(count);
+
+    parallelFor(count, 16384, [&](size_t begin, size_t end)
+    {
+        offsetColumn(positions.x.data() + begin, origin.x, relative.x.data() + begin, end - begin);
+        offsetColumn(positions.y.data() + begin, origin.y, relative.y.data() + begin, end - begin);
+        offsetColumn(positions.z.data() + begin, origin.z, relative.z.data() + begin, end - begin);
+    });
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Kepler.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Positions relative to the camera in single precision, as structure-of-arrays.
+// Keeping world positions in double and only handing the GPU small camera-relative
+// offsets avoids float jitter at astronomical distances.
+struct RelativePositions
+{
+    std::vector<float> x, y, z;
+
+    size_t size() const { return x.size(); }
+    glm::vec3 operator[](size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+};
+
+// Function to convert double-precision positions to float offsets from the given origin
+void toCameraRelative(const Vec3Array& positions, const glm::dvec3& origin, RelativePositions& relative);
@@ -0,0 +1,68 @@
+#include "ImageDecodeQueue.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+void ImageDecodeQueue::submit(size_t index, const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++decoding;
+    }
+
+    parallelSubmit([this, index, path]()
+    {
+        DecodedImage image;
+        image.index = index;
+        image.path = path;
+
+        auto start = std::chrono::steady_clock::now();
+        image.decoded = decoder(path, image);
+        image.decodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Notify under the lock: once it is released the queue may be destroyed
+        std::lock_guard<std::mutex> lock(mutex);
+        done.push_back(std::move(image));
+        --decoding;
+        finished.notify_all();
+    });
+}
+
+bool ImageDecodeQueue::poll(DecodedImage& image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (done.empty())
+        return false;
+
+    image = std::move(done.front());
+    done.pop_front();
+    return true;
+}
+
+void ImageDecodeQueue::waitForAll()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return decoding == 0; });
+}
+
+size_t ImageDecodeQueue::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return decoding + done.size();
+}
+
+void flipImageRows(unsigned char* pixels, int width, int height, int channels)
+{
+    size_t rowBytes = size_t(width) * channels;
+    std::vector<unsigned char> row(rowBytes);
+    for (int y = 0; y < height / 2; ++y)
+    {
+        unsigned char* top = pixels + y * rowBytes;
+        unsigned char* bottom = pixels + (height - 1 - y) * rowBytes;
+        std::copy(top, top + rowBytes, row.begin());
+        std::copy(bottom, bottom + rowBytes, top);
+        std::copy(row.begin(), row.end(), bottom);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "MipChain.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Image decoded to CPU memory, waiting to be uploaded on the GL thread
+struct DecodedImage
+{
+    size_t index = 0;           // Caller's slot for the image, such as its texture table index
+    std::string path;
+    bool decoded = false;       // False if the file was missing or could not be decoded
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::shared_ptr<unsigned char> pixels;  // Rows bottom to top, as glTexImage2D expects
+    MipChain mips;              // Levels below pixels, if the decoder built them
+    uint64_t contentHash = 0;   // Hash of the source file's bytes, if the decoder computes one
+    std::vector<unsigned char> compressed;  // Compressed file such as a cooked DDS, uploaded instead of pixels when set
+    bool shared = false;        // Same contents as an image already loading, so nothing was decoded
+    double decodeMilliseconds = 0.0;
+};
+
+// Function that decodes an image file, filling in the size, channels and pixels or compressed data.
+// Returns false on failure.
+typedef std::function<bool(const std::string& path, DecodedImage& image)> ImageDecoder;
+
+// Decodes image files on the worker pool (see parallelSubmit) and hands the results back in
+// completion order, so the GL thread can upload each one as soon as it is ready. The decoder
+// runs on worker threads and must not touch GL.
+class ImageDecodeQueue
+{
+public:
+    explicit ImageDecodeQueue(ImageDecoder decoder) : decoder(std::move(decoder)) {}
+    ~ImageDecodeQueue() { waitForAll(); }
+
+    ImageDecodeQueue(const ImageDecodeQueue&) = delete;
+    ImageDecodeQueue& operator=(const ImageDecodeQueue&) = delete;
+
+    // Function to queue a file for decoding
+    void submit(size_t index, const std::string& path);
+
+    // Function to take one finished image without waiting. Returns false if none is ready.
+    bool poll(DecodedImage& image);
+
+    // Function to block until every submitted image has finished decoding
+    void waitForAll();
+
+    // Number of images submitted but not yet taken with poll
+    size_t pending() const;
+
+private:
+    ImageDecoder decoder;
+    mutable std::mutex mutex;
+    std::condition_variable finished;
+    std::deque<DecodedImage> done;
+    size_t decoding = 0;
+};
+
+// Function to flip an image's rows in place, for decoders that produce them top to bottom
+void flipImageRows(unsigned char* pixels, int width, int height, int channels);
@@ -0,0 +1,270 @@
+#include "Kepler.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const double PI = 3.14159265358979323846;
+static const double TWO_PI = 2.0 * PI;
+static const double DEGREES_TO_RADIANS = PI / 180.0;
+
+// Number of bodies solved together; sized so the scratch arrays stay in L1
+static const size_t KEPLER_BLOCK_SIZE = 256;
+
+// Function to round to the nearest integer with plain arithmetic (valid for |x| < 2^51).
+// floor() is a library call on baseline x86-64 and would stop the loops from vectorizing.
+static inline double roundNearest(double x)
+{
+    const double ROUNDING_MAGIC = 6755399441055744.0; // 1.5 * 2^52
+    return (x + ROUNDING_MAGIC) - ROUNDING_MAGIC;
+}
+
+// Function to compute sine and cosine without branches or library calls, so loops using it
+// can be vectorized. Reduces the angle by pi/2 and evaluates Taylor series on [-pi/4, pi/4],
+// which is accurate to a few ulp for the angle range the propagator produces.
+static inline void sinCos(double angle, double& sine, double& cosine)
+{
+    const double TWO_OVER_PI = 0.63661977236758134308;
+    const double PI_OVER_2_HIGH = 1.57079632679489655800;
+    const double PI_OVER_2_LOW = 6.12323399573676603587e-17;
+
+    double quadrant = roundNearest(angle * TWO_OVER_PI);
+    double r = (angle - quadrant * PI_OVER_2_HIGH) - quadrant * PI_OVER_2_LOW;
+    double r2 = r * r;
+
+    double s = r * (1.0 + r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040 + r2 * (1.0 / 362880
+             + r2 * (-1.0 / 39916800 + r2 * (1.0 / 6227020800 + r2 * (-1.0 / 1307674368000))))))));
+    double c = 1.0 + r2 * (-1.0 / 2 + r2 * (1.0 / 24 + r2 * (-1.0 / 720 + r2 * (1.0 / 40320
+             + r2 * (-1.0 / 3628800 + r2 * (1.0 / 479001600 + r2 * (-1.0 / 87178291200 + r2 * (1.0 / 20922789888000))))))));
+
+    // Rotate the result into the right quadrant
+    double q = quadrant - 4.0 * roundNearest(quadrant * 0.25 - 0.375);
+    bool odd = (q == 1.0) || (q == 3.0);
+    double sinValue = odd ? c : s;
+    double cosValue = odd ? s : c;
+    sine = (q >= 2.0) ? -sinValue : sinValue;
+    cosine = (q == 1.0 || q == 2.0) ? -cosValue : cosValue;
+}
+
+void addOrbit(KeplerBatch& batch, const OrbitalElements& elements)
+{
+    double a = elements.semiMajorAxis;
+    double e = elements.eccentricity;
+
+    double cosNode = cos(elements.ascendingNode), sinNode = sin(elements.ascendingNode);
+    double cosPeri = cos(elements.argumentOfPeriapsis), sinPeri = sin(elements.argumentOfPeriapsis);
+    double cosInc = cos(elements.inclination), sinInc = sin(elements.inclination);
+
+    // Perifocal basis in ecliptic coordinates (x, y in the reference plane, z towards the pole)
+    double pEclX = cosNode * cosPeri - sinNode * sinPeri * cosInc;
+    double pEclY = sinNode * cosPeri + cosNode * sinPeri * cosInc;
+    double pEclZ = sinPeri * sinInc;
+    double qEclX = -cosNode * sinPeri - sinNode * cosPeri * cosInc;
+    double qEclY = -sinNode * sinPeri + cosNode * cosPeri * cosInc;
+    double qEclZ = cosPeri * sinInc;
+
+    batch.semiMajorAxis.push_back(a);
+    batch.semiMinorAxis.push_back(a * sqrt(1.0 - e * e));
+    batch.eccentricity.push_back(e);
+    batch.meanAnomaly.push_back(elements.meanAnomalyAtEpoch);
+    batch.meanMotion.push_back(elements.meanMotion);
+
+    // The scene uses y as the pole, so the ecliptic y axis maps onto scene z
+    batch.px.push_back(pEclX);
+    batch.py.push_back(pEclZ);
+    batch.pz.push_back(pEclY);
+    batch.qx.push_back(qEclX);
+    batch.qy.push_back(qEclZ);
+    batch.qz.push_back(qEclY);
+}
+
+std::array<DoubleColumn*, KEPLER_COLUMN_COUNT> keplerColumns(KeplerBatch& batch)
+{
+    return { { &batch.semiMajorAxis, &batch.semiMinorAxis, &batch.eccentricity, &batch.meanAnomaly, &batch.meanMotion,
+               &batch.px, &batch.py, &batch.pz, &batch.qx, &batch.qy, &batch.qz } };
+}
+
+std::array<const DoubleColumn*, KEPLER_COLUMN_COUNT> keplerColumns(const KeplerBatch& batch)
+{
+    return { { &batch.semiMajorAxis, &batch.semiMinorAxis, &batch.eccentricity, &batch.meanAnomaly, &batch.meanMotion,
+               &batch.px, &batch.py, &batch.pz, &batch.qx, &batch.qy, &batch.qz } };
+}
+
+void reserveOrbits(KeplerBatch& batch, size_t count)
+{
+    for (DoubleColumn* column : keplerColumns(batch))
+        column->reserve(count);
+}
+
+// Function to solve Kepler's equation and evaluate positions for bodies [begin, end).
+// Every step is a branch-free loop over a block so the compiler can vectorize it.
+static void propagateRange(const KeplerBatch& batch, double time, Vec3Array& positions, Vec3Array* velocities, int iterations, size_t begin, size_t end)
+{
+    double meanAnomaly[KEPLER_BLOCK_SIZE];
+    double eccentricAnomaly[KEPLER_BLOCK_SIZE];
+    double sinAnomaly[KEPLER_BLOCK_SIZE];
+    double cosAnomaly[KEPLER_BLOCK_SIZE];
+
+    for (size_t base = begin; base < end; base += KEPLER_BLOCK_SIZE)
+    {
+        size_t count = std::min(KEPLER_BLOCK_SIZE, end - base);
+        const double* e = batch.eccentricity.data() + base;
+
+        const double* m0 = batch.meanAnomaly.data() + base;
+        const double* meanMotion = batch.meanMotion.data() + base;
+
+        // Mean anomaly wrapped into [-pi, pi]
+        for (size_t i = 0; i < count; ++i)
+        {
+            double m = m0[i] + meanMotion[i] * time;
+            meanAnomaly[i] = m - TWO_PI * roundNearest(m * (1.0 / TWO_PI));
+        }
+
+        // Danby's starting guess, good enough for Halley to converge for any e < 1
+        for (size_t i = 0; i < count; ++i)
+            eccentricAnomaly[i] = meanAnomaly[i] + (meanAnomaly[i] < 0.0 ? -0.85 : 0.85) * e[i];
+
+        // Fixed number of Halley steps on f(E) = E - e sin E - M
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                double sinE, cosE;
+                sinCos(eccentricAnomaly[i], sinE, cosE);
+                double f = eccentricAnomaly[i] - e[i] * sinE - meanAnomaly[i];
+                double df = 1.0 - e[i] * cosE;
+                double d2f = e[i] * sinE;
+                eccentricAnomaly[i] -= 2.0 * f * df / (2.0 * df * df - f * d2f);
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            sinCos(eccentricAnomaly[i], sinAnomaly[i], cosAnomaly[i]);
+
+        // Position in the perifocal frame, rotated into the scene
+        const double* a = batch.semiMajorAxis.data() + base;
+        const double* b = batch.semiMinorAxis.data() + base;
+        const double* px = batch.px.data() + base;
+        const double* py = batch.py.data() + base;
+        const double* pz = batch.pz.data() + base;
+        const double* qx = batch.qx.data() + base;
+        const double* qy = batch.qy.data() + base;
+        const double* qz = batch.qz.data() + base;
+        double* __restrict outX = positions.x.data() + base;
+        double* __restrict outY = positions.y.data() + base;
+        double* __restrict outZ = positions.z.data() + base;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            double alongP = a[i] * (cosAnomaly[i] - e[i]);
+            double alongQ = b[i] * sinAnomaly[i];
+
+            outX[i] = alongP * px[i] + alongQ * qx[i];
+            outY[i] = alongP * py[i] + alongQ * qy[i];
+            outZ[i] = alongP * pz[i] + alongQ * qz[i];
+        }
+
+        if (velocities == nullptr)
+            continue;
+
+        // Time derivative of the position, using dE/dt = n / (1 - e cos E)
+        double* __restrict velX = velocities->x.data() + base;
+        double* __restrict velY = velocities->y.data() + base;
+        double* __restrict velZ = velocities->z.data() + base;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            double anomalyRate = meanMotion[i] / (1.0 - e[i] * cosAnomaly[i]);
+            double alongP = -a[i] * sinAnomaly[i] * anomalyRate;
+            double alongQ = b[i] * cosAnomaly[i] * anomalyRate;
+
+            velX[i] = alongP * px[i] + alongQ * qx[i];
+            velY[i] = alongP * py[i] + alongQ * qy[i];
+            velZ[i] = alongP * pz[i] + alongQ * qz[i];
+        }
+    }
+}
+
+void propagateOrbits(const KeplerBatch& batch, double time, Vec3Array& positions, Vec3Array* velocities, int iterations)
+{
+    positions.resize(batch.size());
+    if (velocities != nullptr)
+        velocities->resize(batch.size());
+
+    parallelFor(batch.size(), KEPLER_BLOCK_SIZE * 4, [&](size_t begin, size_t end)
+    {
+        propagateRange(batch, time, positions, velocities, iterations, begin, end);
+    });
+}
+
+glm::dvec3 orbitPoint(const KeplerBatch& batch, size_t index, double eccentricAnomaly)
+{
+    double alongP = batch.semiMajorAxis[index] * (cos(eccentricAnomaly) - batch.eccentricity[index]);
+    double alongQ = batch.semiMinorAxis[index] * sin(eccentricAnomaly);
+
+    return glm::dvec3(alongP * batch.px[index] + alongQ * batch.qx[index],
+                      alongP * batch.py[index] + alongQ * batch.qy[index],
+                      alongP * batch.pz[index] + alongQ * batch.qz[index]);
+}
+
+glm::dvec3 orbitPosition(const KeplerBatch& batch, size_t index, double time, int iterations)
+{
+    double e = batch.eccentricity[index];
+    double m = batch.meanAnomaly[index] + batch.meanMotion[index] * time;
+    double meanAnomaly = m - TWO_PI * roundNearest(m * (1.0 / TWO_PI));
+
+    double eccentricAnomaly = meanAnomaly + (meanAnomaly < 0.0 ? -0.85 : 0.85) * e;
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        double sinE, cosE;
+        sinCos(eccentricAnomaly, sinE, cosE);
+        double f = eccentricAnomaly - e * sinE - meanAnomaly;
+        double df = 1.0 - e * cosE;
+        double d2f = e * sinE;
+        eccentricAnomaly -= 2.0 * f * df / (2.0 * df * df - f * d2f);
+    }
+    return orbitPoint(batch, index, eccentricAnomaly);
+}
+
+double meanMotionForSemiMajorAxis(double semiMajorAxis, double referenceRadius, double referenceMeanMotion)
+{
+    return referenceMeanMotion * pow(semiMajorAxis / referenceRadius, -1.5);
+}
+
+size_t loadOrbitalElements(const std::string& filePath, std::vector<OrbitalElements>& orbits, double referenceRadius, double referenceMeanMotion)
+{
+    std::ifstream stream(filePath);
+    if (!stream)
+        return 0;
+
+    size_t loaded = 0;
+    std::string line;
+    while (getline(stream, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        OrbitalElements elements;
+        double inclination, node, periapsis, meanAnomaly;
+        if (!(fields >> elements.semiMajorAxis >> elements.eccentricity >> inclination >> node >> periapsis >> meanAnomaly))
+        {
+            std::cerr << "Skipping malformed orbit in " << filePath << ": " << line << std::endl;
+            continue;
+        }
+
+        elements.inclination = inclination * DEGREES_TO_RADIANS;
+        elements.ascendingNode = node * DEGREES_TO_RADIANS;
+        elements.argumentOfPeriapsis = periapsis * DEGREES_TO_RADIANS;
+        elements.meanAnomalyAtEpoch = meanAnomaly * DEGREES_TO_RADIANS;
+        elements.meanMotion = meanMotionForSemiMajorAxis(elements.semiMajorAxis, referenceRadius, referenceMeanMotion);
+
+        orbits.push_back(elements);
+        ++loaded;
+    }
+
+    return loaded;
+}
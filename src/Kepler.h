@@ -0,0 +1,119 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Fixed number of Halley iterations used when solving Kepler's equation
+const int KEPLER_ITERATIONS = 4;
+
+// Classical orbital elements (angles in radians, mean motion in radians per second)
+struct OrbitalElements
+{
+    double semiMajorAxis;
+    double eccentricity;
+    double inclination;
+    double ascendingNode;
+    double argumentOfPeriapsis;
+    double meanAnomalyAtEpoch;
+    double meanMotion;
+};
+
+// Column of doubles that either owns its values or views values owned elsewhere (such as a
+// mapped snapshot). Appending to a view copies it into owned storage first.
+class DoubleColumn
+{
+public:
+    size_t size() const { return view != nullptr ? viewSize : values.size(); }
+    const double* data() const { return view != nullptr ? view : values.data(); }
+    double operator[](size_t i) const { return data()[i]; }
+    bool isView() const { return view != nullptr; }
+
+    void push_back(double value) { detach(); values.push_back(value); }
+    void reserve(size_t count) { detach(); values.reserve(count); }
+
+    // Function to view count values that outlive the column, dropping any owned values
+    void setView(const double* first, size_t count)
+    {
+        std::vector<double>().swap(values);
+        view = first;
+        viewSize = count;
+    }
+
+private:
+    void detach()
+    {
+        if (view != nullptr)
+            values.assign(view, view + viewSize);
+        view = nullptr;
+        viewSize = 0;
+    }
+
+    std::vector<double> values;
+    const double* view = nullptr;
+    size_t viewSize = 0;
+};
+
+// Orbits stored as structure-of-arrays, reduced to the constants the propagator needs.
+// The reference plane is the scene's x-z plane, with +y as the pole. Each orbit's plane is tilted
+// out of it by the inclination about the line of nodes, which the ascending node turns about the
+// pole from +x; the argument of periapsis then places periapsis within the orbit plane. P and Q
+// hold the result, so the propagator only needs the in-plane positions.
+struct KeplerBatch
+{
+    DoubleColumn semiMajorAxis;  // a
+    DoubleColumn semiMinorAxis;  // b = a * sqrt(1 - e^2)
+    DoubleColumn eccentricity;   // e
+    DoubleColumn meanAnomaly;    // M0 at t = 0
+    DoubleColumn meanMotion;     // n
+
+    // Unit vectors towards periapsis (P) and 90 degrees ahead of it in the orbit plane (Q)
+    DoubleColumn px, py, pz;
+    DoubleColumn qx, qy, qz;
+
+    size_t size() const { return semiMajorAxis.size(); }
+};
+
+// Positions (or velocities) of a batch of bodies as structure-of-arrays
+struct Vec3Array
+{
+    std::vector<double> x, y, z;
+
+    void resize(size_t count) { x.resize(count); y.resize(count); z.resize(count); }
+    size_t size() const { return x.size(); }
+    glm::dvec3 operator[](size_t i) const { return glm::dvec3(x[i], y[i], z[i]); }
+};
+
+// Function to append an orbit to a batch
+void addOrbit(KeplerBatch& batch, const OrbitalElements& elements);
+
+// Function to get every column of a batch in declaration order, for code that treats them alike
+const size_t KEPLER_COLUMN_COUNT = 11;
+std::array<DoubleColumn*, KEPLER_COLUMN_COUNT> keplerColumns(KeplerBatch& batch);
+std::array<const DoubleColumn*, KEPLER_COLUMN_COUNT> keplerColumns(const KeplerBatch& batch);
+
+// Function to reserve space for a number of orbits
+void reserveOrbits(KeplerBatch& batch, size_t count);
+
+// Function to evaluate every orbit in the batch at the given time. Velocities are only
+// computed when an output array is given.
+void propagateOrbits(const KeplerBatch& batch, double time, Vec3Array& positions, Vec3Array* velocities = nullptr, int iterations = KEPLER_ITERATIONS);
+
+// Function to get a point on an orbit from its eccentric anomaly (used to draw orbit lines)
+glm::dvec3 orbitPoint(const KeplerBatch& batch, size_t index, double eccentricAnomaly);
+
+// Function to evaluate one orbit of a batch at the given time, solving Kepler's equation as
+// propagateOrbits does, for callers that need single bodies rather than the whole batch
+glm::dvec3 orbitPosition(const KeplerBatch& batch, size_t index, double time, int iterations = KEPLER_ITERATIONS);
+
+// Function to get the mean motion of a circular-ish orbit of radius a from Kepler's third law,
+// anchored to a reference orbit with known radius and mean motion
+double meanMotionForSemiMajorAxis(double semiMajorAxis, double referenceRadius, double referenceMeanMotion);
+
+// Function to load orbital elements from a text file, one body per line:
+//   a e inclination ascendingNode argumentOfPeriapsis meanAnomaly   (angles in degrees)
+// The mean motion of each body is derived from the reference orbit. Returns the number of bodies appended.
+size_t loadOrbitalElements(const std::string& filePath, std::vector<OrbitalElements>& orbits, double referenceRadius, double referenceMeanMotion);
@@ -7,23 +7,65 @@
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"   // ImGui GLFW backend
 #include "backends/imgui_impl_opengl3.h"   // ImGui OpenGL3 backend
-
+#include "AssetPack.h"
+#include "Benchmarks.h"
+#include "Bodies.h"
+#include "Ecs.h"
+#include "Ephemeris.h"
+#include "FileWatcher.h"
+#include "FloatingOrigin.h"
+#include "ImageDecodeQueue.h"
+#include "Kepler.h"
+#include "NBody.h"
+#include "Parallel.h"
+#include "ProgramCache.h"
+#include "Replay.h"
+#include "ShaderPreprocessor.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "SolarSystem.h"
+#include "SpatialHash.h"
+#include "StartupProfiler.h"
+#include "TextureCache.h"
+#include "TextureManager.h"
+#include "TextureStreaming.h"
+#include "TextureUploads.h"
+#include "TransformGraph.h"
+#include "VirtualTexture.h"
+
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
 #include <vector>
 #include <array>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <chrono>
+#include <cstring>
 #include <cstdlib> // For rand() and srand()
+#ifdef _WIN32
+#include <malloc.h> // For alloca()
+#else
+#include <alloca.h>
+#endif
 #include <ctime>   // For time()
 
 // Define the window dimensions
 const int WINDOW_WIDTH = 800, WINDOW_HEIGHT = 600;
+const float FIELD_OF_VIEW = 45.0f; // Vertical, in degrees
 const std::string WINDOW_TITLE = "3D Solar System";
 
-// Define the mathematical constants
+// Define the mathematical constants (glibc's <cmath> already has them as macros)
+#ifndef M_PI
 const float M_PI = 3.14159265358979323846f;
+#endif
+#ifndef M_PI_2
 const float M_PI_2 = M_PI / 2.0f;
+#endif
 
 // Define the text instruction position
 const int TEXT_INSTRUCTION_WIDTH = 250;
@@ -36,14 +78,14 @@ const int TEXT_INSTRUCTION_POS_Y = 10;
 const float CAMERA_PARAMETERS_MARGIN_TOP = 20.0f;
 const float CAMERA_PARAMETERS_MARGIN_RIGHT = 40.0f;
 
-// Define the initial camera position
-glm::vec3 initialCameraPos = glm::vec3(-27.55f, 11.88f, 5.53f);
+// Define the initial camera position (world positions are kept in double precision)
+glm::dvec3 initialCameraPos = glm::dvec3(-27.55, 11.88, 5.53);
 float initialYaw = -5.10f;
 float initialPitch = -25.50f;
 glm::vec3 initialCameraFront = glm::normalize(glm::vec3(0.90f, -0.43f, -0.08f));
 
 // Define the current camera position
-glm::vec3 cameraPos = glm::vec3(-27.55f, 11.88f, 5.53f);
+glm::dvec3 cameraPos = glm::dvec3(-27.55, 11.88, 5.53);
 float cameraYaw = -5.10f;
 float cameraPitch = -25.50f;
 glm::vec3 cameraFront = glm::normalize(glm::vec3(0.90f, -0.43f, -0.08f));
@@ -51,157 +93,97 @@ glm::vec3 cameraFront = glm::normalize(glm::vec3(0.90f, -0.43f, -0.08f));
 // Define the camera up vector and speed
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 float cameraSpeed = 0.1f; 
+const float CAMERA_MOVE_RATE = 6.0f; // Units per second at a camera speed of 1
 
 // Define the mouse sensitivity
 float lastX = WINDOW_WIDTH / 2.0f;  // Last x-coordinate of the mouse
 float lastY = WINDOW_HEIGHT / 2.0f; // Last y-coordinate of the mouse
 bool firstMouse = true;  // Flag to ignore the first mouse movement
 bool cameraMovementEnabled = true; // Camera movement toggle
+bool replayActive = false; // A recording drives the camera instead of the mouse and keyboard
 
 // Define the mouse sensitivity
 float mouseSensitivity = 0.1f;
 
-// Define an array to hold texture IDs
-std::array<unsigned int, 12> textureIds;
-
-// Define the paths and scale factors for the textures
-const std::array<std::string, 12> texturePaths = {
-    "textures/sun.jpg",
-    "textures/mercury.jpg",
-    "textures/venus.jpg",
-    "textures/earth.jpg",
-    "textures/mars.jpg",
-    "textures/jupiter.jpg",
-    "textures/saturn.jpg",
-    "textures/uranus.jpg",
-    "textures/neptune.jpg",
-    "textures/asteroid.jpg",
-    "textures/moon.jpg",
-    "textures/saturn_ring.png"
-};
-
-// Define the scales for each planet
-const std::array<float, 9> scales = {
-    2.0f, // Sun
-    0.2f, // Mercury
-    0.45f, // Venus
-    0.5f, // Earth
-    0.5f, // Mars
-    1.5f, // Jupiter
-    1.0f, // Saturn
-    1.0f, // Uranus
-    1.0f  // Neptune
+// Define the texture IDs, indexed like BodyCatalog::texturePaths
+std::vector<unsigned int> textureIds;
+std::vector<size_t> textureEntries; // The TextureManager texture behind each slot
+TextureManager textureManager; // Shares textures between identical paths and identical files
+GLuint placeholderTexture = 0; // Bound in place of textures that are still decoding
+AssetPack assetPack; // Mapped res/assets.pack; assets it lacks are loaded from their own files
+TextureStreamer textureStreamer; // Which mip levels of the compressed textures are resident
+int textureBudgetMiB = int(DEFAULT_TEXTURE_BUDGET_MIB); // GPU memory the streamed textures may use
+
+// Compressed mip chain a streamed texture uploads its levels from: in the mapped asset pack, or in
+// a cooked DDS file kept in memory
+struct StreamedTexture {
+    CookedTextureInfo info;
+    const unsigned char* mapped = nullptr;
+    std::vector<unsigned char> dds;
+    int uploadedBase = 0; // Finest level whose data has been issued; the streamer may be ahead of it
 };
-
-// Define the positions for each planet
-const std::array<float, 9> positions = {
-    0.0f,  // Sun
-    2.0f,  // Mercury
-    4.0f,  // Venus
-    6.0f,  // Earth
-    8.0f,  // Mars
-    10.0f, // Jupiter
-    12.0f, // Saturn
-    14.0f, // Uranus
-    16.0f  // Neptune
+std::map<size_t, StreamedTexture> streamedTextures; // By TextureManager texture
+
+// Texture data goes to the GPU a budgeted amount per frame, staged through a mapped buffer
+UploadScheduler textureUploads;
+int uploadBudgetMiB = int(DEFAULT_UPLOAD_BUDGET_MIB);
+StagingRing uploadRing; // Space in uploadBuffer, by frame
+GLuint uploadBuffer = 0; // Persistently mapped pixel unpack buffer; 0 without ARB_buffer_storage
+unsigned char* uploadMapping = nullptr;
+std::deque<std::pair<uint64_t, GLsync>> uploadFences; // Fence after each frame's staged uploads
+size_t uploadedBytesThisFrame = 0;
+std::set<size_t> texturesAwaitingUpload; // Created, but with no level uploaded yet to sample
+const unsigned char PLACEHOLDER_COLOR[3] = { 128, 128, 128 };
+
+// Virtual textures, for the texture slots that have a tiled file built by --build-virtual-textures.
+// A low-resolution feedback pass finds the tiles in view; workers copy them out of the mapped
+// files and they are uploaded into the physical cache under the same budget as other textures.
+std::vector<std::unique_ptr<VirtualTexture>> virtualTextures; // By VirtualTileCache texture
+std::vector<int> virtualTextureSlots; // VirtualTileCache texture of each texture slot, or -1
+std::vector<GLuint> virtualIndirectionTextures; // By VirtualTileCache texture
+VirtualTileCache virtualTiles;
+GLuint virtualCacheTexture = 0;
+GLuint feedbackFramebuffer = 0, feedbackColor = 0, feedbackDepth = 0;
+GLuint feedbackBuffers[2] = { 0, 0 }; // Read back into alternately and mapped a frame later, so the read does not stall
+uint64_t feedbackFrames = 0;
+bool virtualTexturing = true;
+const int FEEDBACK_DIVISOR = 8; // The feedback pass renders at this fraction of the window's size
+const size_t MAX_VIRTUAL_TILE_LOADS = 32; // Tiles started loading per frame
+const size_t VIRTUAL_TILE_UPLOAD_OWNER = SIZE_MAX; // Uploads of tiles, told apart from those of texture slots
+
+// Hot reload: shaders and textures edited while the app runs are rebuilt on their own
+FileWatcher assetWatcher; // Watches res/ and textures/
+std::set<std::string> assetsChangedOnDisk; // Read from their own files from now on, not from the asset pack
+struct ReloadingTexture {
+    size_t previous; // Texture the slot keeps showing until the reloaded one is ready
+    std::string path;
+    std::chrono::steady_clock::time_point start;
 };
-
-// Orbital radii (distance from the Sun) for each planet
-const std::array<float, 9> orbitalRadii = {
-    0.0f,  // Sun has no orbit
-    2.0f,  // Mercury
-    4.0f,  // Venus
-    6.0f,  // Earth
-    8.0f,  // Mars
-    14.0f, // Jupiter (adjusted to be beyond the asteroid belt)
-    16.0f, // Saturn
-    18.0f, // Uranus
-    20.0f  // Neptune
-};
-
-// Orbital speeds for each planet (in radians per second)
-const std::array<float, 9> angularVelocities = {
-    0.0f,    // Sun
-    0.033f,  // Mercury
-    0.023f,  // Venus
-    0.017f,  // Earth
-    0.013f,  // Mars
-    0.01f,   // Jupiter
-    0.007f,  // Saturn
-    0.004f,  // Uranus
-    0.003f   // Neptune
-};
-
-// Rotation speeds for each planet (in radians per second)
-const std::array<float, 9> rotationSpeeds = {
-    0.0f,    // Sun
-    0.25f,   // Mercury
-    0.125f,  // Venus
-    0.15f,   // Earth
-    0.1f,    // Mars
-    0.075f,  // Jupiter
-    0.05f,   // Saturn
-    0.025f,  // Uranus
-    0.0225f  // Neptune
+std::map<size_t, ReloadingTexture> reloadingTextures; // By texture slot
+std::string lastReloadPath;
+double lastReloadMilliseconds = 0.0;
+size_t reloadCount = 0;
+
+// Frames of the scene's transform graph that are not owned by a body
+struct SceneFrames {
+    uint32_t primary; // The body everything else orbits
+    uint32_t ring;    // Saturn's ring particles are relative to it
 };
 
 // Global time variable
 float deltaTime = 0.0f; // Time between frames
-float lastFrame = 0.0f; // Time of the last frame
-
-// Define constants for the asteroid belt
-const int NUM_ASTEROIDS = 5000;
-const float ASTEROID_MIN_RADIUS = 0.001f;
-const float ASTEROID_MAX_RADIUS = 0.030f; 
-const float BELT_INNER_RADIUS = 10.0f; // Between Mars (8.0f) and Jupiter (14.0f)
-const float BELT_OUTER_RADIUS = 12.0f;
-const float MIN_ROTATION_SPEED = 0.0001f;
-const float MAX_ROTATION_SPEED = 0.001f;
-
-// Moon parameters
-const float moonScale = 0.15f;
-const float moonOrbitRadius = 0.75f; // Distance from Earth
-const float moonOrbitSpeed = 0.05f; // Speed of orbit around Earth
-
-// Constants for Saturn's ring
-const int NUM_RING_ASTEROIDS = 5000; // Number of small asteroids in the ring
-const float RING_INNER_RADIUS = 0.75f; // Inner radius of the ring
-const float RING_OUTER_RADIUS = 1.0f; // Outer radius of the ring
-const float RING_ASTEROID_MIN_RADIUS = 0.001f; // Minimum radius of the asteroids
-const float RING_ASTEROID_MAX_RADIUS = 0.010f; // Maximum radius of the asteroids
-const float RING_ASTEROID_MIN_ORBIT_SPEED = 0.001f; // Minimum orbit speed of the asteroids
-const float RING_ASTEROID_MAX_ORBIT_SPEED = 0.01f; // Maximum orbit speed of the asteroids
-
-// Load texture function
-GLuint loadTexture(const char* filePath) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Load the texture using SOIL
-    int width, height;
-    unsigned char* image = SOIL_load_image(filePath, &width, &height, 0, SOIL_LOAD_RGB);
-
-    if (image == nullptr) {
-        std::cerr << "Failed to load texture: " << filePath << std::endl;
-        return 0;
-    }
+double lastFrame = 0.0; // Time of the last frame
 
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Upload the texture to GPU
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    glGenerateMipmap(GL_TEXTURE_2D);
+// Fixed simulation timestep, independent of the frame rate
+const double SIMULATION_TIME_STEP = 1.0 / 60.0; // Real seconds per tick
+const int MAX_SIMULATION_TICKS_PER_FRAME = 8; // Real time beyond this is dropped
+const double MAX_INTERPOLATED_TIME_SCALE = 100.0; // Above this, ticks are too far apart to blend
 
-    // Free the image memory
-    SOIL_free_image_data(image);
+// N-body gravity mode parameters
+float nbodyOpeningAngle = 0.5f; // Barnes-Hut opening angle
 
-    return textureID;
-}
+// Define the proximity query parameters
+const double NEAREST_ASTEROID_RANGE = 5.0; // How far from the camera to look for the nearest asteroid
 
 // Function to handle window resizing
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -210,48 +192,24 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-// Function to parse shader files
-struct ShaderProgramSource
-{
-    std::string VertexSource;
-    std::string FragmentSource;
-};
-
-static ShaderProgramSource ParseShader(const std::string& filepath)
-{
-    std::ifstream stream(filepath);
-
-    enum class ShaderType
-    {
-        NONE = -1, VERTEX = 0, FRAGMENT = 1
-    };
-
-    std::string line;
-    std::stringstream ss[2];
-	ShaderType type = ShaderType::NONE;
-    while (getline(stream, line))
-    {
-        if (line.find("#shader") != std::string::npos)
-        {
-            if (line.find("vertex") != std::string::npos)
-            {
-                type = ShaderType::VERTEX;
-            } 
-            else if (line.find("fragment") != std::string::npos)
-            {
-                type = ShaderType::FRAGMENT;
-            }
-        }
-        else
-        {
-            ss[(int)type] << line << "\n";
-        }
+// Function to read a text asset from the asset pack, or from its own file when the pack lacks it.
+// Returns false if neither has it.
+bool readTextAsset(const std::string& path, uint32_t type, std::string& text) {
+    const AssetEntry* entry = assetsChangedOnDisk.count(path) == 0 ? assetPack.find(path, type) : nullptr;
+    if (entry != nullptr) {
+        text.assign(reinterpret_cast<const char*>(assetPack.data(*entry)), size_t(entry->size));
+        return true;
     }
 
-    return { ss[0].str(), ss[1].str() };
+    std::vector<unsigned char> bytes;
+    if (!readFileBytes(path, bytes))
+        return false;
+    text.assign(bytes.begin(), bytes.end());
+    return true;
 }
 
-// Function to compile shaders
+// Function to compile shaders. Nothing is queried, so the driver can compile in the background;
+// a shader that fails makes its program fail to link, and detachShaders prints why.
 static unsigned int CompileShader(unsigned int type, const std::string& source)
 {
     unsigned int id = glCreateShader(type);
@@ -259,21 +217,32 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
     glShaderSource(id, 1, &src, nullptr);
 	glCompileShader(id);
 
-	int result;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &result);
-    if (result == GL_FALSE)
+    return id;
+}
+
+// Function to detach a program's shaders, which frees them, printing the log of any that did not compile
+static void detachShaders(unsigned int program)
+{
+    GLuint shaders[2];
+    GLsizei count = 0;
+    glGetAttachedShaders(program, 2, &count, shaders);
+    for (GLsizei i = 0; i < count; ++i)
     {
-        int length;
-		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-        char* message = (char*)alloca(length * sizeof(char));
-        glGetShaderInfoLog(id, length, &length, message);
-        std::cout << "Failed to compile " << ( type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader!" << std::endl;
-        std::cout << message << std::endl;
-		glDeleteShader(id);
-		return 0;
+        int result;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &result);
+        if (result == GL_FALSE)
+        {
+            int length, type;
+            glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &length);
+            glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+            char* message = (char*)alloca(std::max(length, 1) * sizeof(char));
+            message[0] = '\0';
+            glGetShaderInfoLog(shaders[i], length, &length, message);
+            std::cout << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader!" << std::endl;
+            std::cout << message << std::endl;
+        }
+        glDetachShader(program, shaders[i]);
     }
-
-    return id;
 }
 
 // Function to create a shader program
@@ -285,15 +254,186 @@ static unsigned int CreateShader(const std::string& vertexShader, const std::str
 
     glAttachShader(program, vs);
 	glAttachShader(program, fs);
+	if (GLEW_ARB_get_program_binary)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); // For the program cache
 	glLinkProgram(program);
-	glValidateProgram(program);
 
+	// Flagged for deletion; they go when finishProgramBuilds detaches them
 	glDeleteShader(vs);
 	glDeleteShader(fs);
 
 	return program;
 }
 
+// Function to get the real milliseconds since a point in time
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Shader program builds, for the startup report
+size_t programsCompiled = 0, programsFromCache = 0;
+double programMilliseconds = 0.0;           // From submitting the startup programs until the last was built
+double slowestProgramMilliseconds = 0.0;    // Longest single build
+bool parallelShaderCompile = false;         // The driver compiles on its own threads (KHR/ARB_parallel_shader_compile)
+
+// Function to get a GL string, or an empty one if the driver has none
+std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value != nullptr ? reinterpret_cast<const char*>(value) : "";
+}
+
+// Function to check that a program linked, printing its log if not
+bool programLinked(GLuint program, const std::string& name) {
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == GL_TRUE)
+        return true;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::string message(std::max(length, 1), '\0');
+    glGetProgramInfoLog(program, length, nullptr, &message[0]);
+    std::cerr << "Failed to link " << name << std::endl << message.c_str() << std::endl;
+    return false;
+}
+
+// A program the driver is still compiling and linking, or loading from the program cache
+struct ProgramBuild {
+    std::string name;
+    std::string vertexSource, fragmentSource;
+    uint64_t key;
+    std::string cachePath;
+    GLuint program;
+    bool fromCache; // Loaded with glProgramBinary; compiled from the sources if the driver refuses it
+    std::chrono::steady_clock::time_point start;
+    std::function<void(GLuint)> finished; // Given the program, or 0 if it did not link
+};
+std::vector<ProgramBuild> programBuilds;
+
+// Function to start building a program, loading the driver's binary from the program cache when
+// this driver has built the same sources before, otherwise compiling them. Nothing waits for the
+// driver: finishProgramBuilds hands the program to finished once it is built. A build already
+// running under the same name is dropped, as its sources are out of date.
+void startProgramBuild(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource, std::function<void(GLuint)> finished) {
+    for (auto build = programBuilds.begin(); build != programBuilds.end(); ++build) {
+        if (build->name == name) {
+            glDeleteProgram(build->program);
+            programBuilds.erase(build);
+            break;
+        }
+    }
+
+    ProgramBuild build;
+    build.name = name;
+    build.vertexSource = vertexSource;
+    build.fragmentSource = fragmentSource;
+    build.key = programCacheKey(vertexSource, fragmentSource, glString(GL_VENDOR), glString(GL_RENDERER), glString(GL_VERSION));
+    build.cachePath = programCachePath(PROGRAM_CACHE_DIRECTORY, build.key);
+    build.start = std::chrono::steady_clock::now();
+    build.finished = finished;
+
+    GLint binaryFormats = 0;
+    if (GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    uint32_t format;
+    std::vector<unsigned char> binary;
+    build.fromCache = binaryFormats > 0 && readProgramBinary(build.cachePath, build.key, format, binary);
+    if (build.fromCache) {
+        build.program = glCreateProgram();
+        glProgramBinary(build.program, format, binary.data(), GLsizei(binary.size()));
+    }
+    else
+        build.program = CreateShader(vertexSource, fragmentSource);
+    programBuilds.push_back(build);
+}
+
+// Function to finish the program builds the driver has completed, caching the binaries of the ones
+// it compiled. Without parallel compilation the driver is not asked and every build is waited for.
+// Returns the number still building.
+size_t finishProgramBuilds() {
+    for (size_t i = 0; i < programBuilds.size();) {
+        ProgramBuild& build = programBuilds[i];
+        if (parallelShaderCompile) {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed == GL_FALSE) {
+                ++i;
+                continue;
+            }
+        }
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(build.program, GL_LINK_STATUS, &linked);
+        if (linked == GL_FALSE && build.fromCache) {
+            // The driver no longer accepts the binary, so it is compiled again and checked next time
+            glDeleteProgram(build.program);
+            build.program = CreateShader(build.vertexSource, build.fragmentSource);
+            build.fromCache = false;
+            continue;
+        }
+
+        GLuint program = build.program;
+        detachShaders(program);
+        if (!programLinked(program, build.name)) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+        else if (build.fromCache)
+            ++programsFromCache;
+        else {
+            ++programsCompiled;
+            GLint length = 0;
+            if (GLEW_ARB_get_program_binary)
+                glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length > 0) {
+                GLenum binaryFormat;
+                std::vector<unsigned char> binary(static_cast<size_t>(length));
+                glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+                binary.resize(size_t(length));
+                if (!createDirectory(PROGRAM_CACHE_DIRECTORY) || !writeProgramBinary(build.cachePath, build.key, binaryFormat, binary))
+                    std::cerr << "Failed to write program cache: " << build.cachePath << std::endl;
+            }
+        }
+#ifndef NDEBUG
+        if (program != 0)
+            glValidateProgram(program); // Only a debugging aid, and it checks against whatever state is bound now
+#endif
+        slowestProgramMilliseconds = std::max(slowestProgramMilliseconds, millisecondsSince(build.start));
+
+        // Taken out first, as finished may start another build
+        std::function<void(GLuint)> finished = build.finished;
+        programBuilds.erase(programBuilds.begin() + i);
+        finished(program);
+    }
+    return programBuilds.size();
+}
+
+// Function to check whether a program is being built
+bool isProgramBuilding(const std::string& name) {
+    for (const ProgramBuild& build : programBuilds) {
+        if (build.name == name)
+            return true;
+    }
+    return false;
+}
+
+// Shader and sphere mesh, loaded by these names from the asset pack
+const char SHADER_PATH[] = "res/shaders/Basic.shader";
+const char FEEDBACK_SHADER_PATH[] = "res/shaders/Feedback.shader"; // Virtual texture tile feedback
+const char SHADER_DIRECTORY[] = "res/shaders/"; // Where their includes live too
+
+// Programs compiled from Basic.shader, each with only the code its draws need
+const ShaderPermutation LIT_PERMUTATION = { "lit", {} };                                              // Textured, lit by the sun
+const ShaderPermutation LIT_VIRTUAL_PERMUTATION = { "lit-virtual", { "VIRTUAL_TEXTURE" } };           // From virtual texture tiles
+const ShaderPermutation EMISSIVE_PERMUTATION = { "emissive", { "EMISSIVE" } };                        // The sun: unlit, glowing
+const ShaderPermutation EMISSIVE_VIRTUAL_PERMUTATION = { "emissive-virtual", { "EMISSIVE", "VIRTUAL_TEXTURE" } };
+const ShaderPermutation LINE_PERMUTATION = { "line", { "UNLIT_LINE" } };                              // Orbit lines
+const ShaderPermutation DEFAULT_PERMUTATION = { "default", {} };                                      // Shaders with no variants
+const char SPHERE_MESH_NAME[] = "meshes/sphere";
+const float SPHERE_RADIUS = 0.5f;
+const unsigned int SPHERE_RINGS = 20;
+const unsigned int SPHERE_SECTORS = 20;
+
 // Function to generate sphere vertices and indices
 void generateSphere(float radius, unsigned int rings, unsigned int sectors, std::vector<float>& vertices, std::vector<unsigned int>& indices) {
     float const R = 1.0f / (float)(rings - 1);
@@ -346,8 +486,17 @@ void generateSphere(float radius, unsigned int rings, unsigned int sectors, std:
 }
 
 // Function to handle mouse movement
+// Function to get the camera's view direction from its yaw and pitch (in degrees)
+glm::vec3 cameraFrontFromAngles(float yaw, float pitch) {
+    glm::vec3 front;
+    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
+    front.y = sin(glm::radians(pitch));
+    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
+    return glm::normalize(front);
+}
+
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    if (!cameraMovementEnabled) return; // Do not update if movement is disabled
+    if (!cameraMovementEnabled || replayActive) return; // Do not update if movement is disabled
 
     if (firstMouse) {
         lastX = xpos;
@@ -371,11 +520,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     if (cameraPitch < -89.0f) cameraPitch = -89.0f;
 
     // Update camera front vector
-    glm::vec3 front;
-    front.x = cos(glm::radians(cameraYaw)) * cos(glm::radians(cameraPitch));
-    front.y = sin(glm::radians(cameraPitch));
-    front.z = sin(glm::radians(cameraYaw)) * cos(glm::radians(cameraPitch));
-    cameraFront = glm::normalize(front);
+    cameraFront = cameraFrontFromAngles(cameraYaw, cameraPitch);
 }
 
 // Function to handle key presses
@@ -392,214 +537,1304 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
 }
 
-// Function to load textures
-void loadTextures() {
-    for (size_t i = 0; i < texturePaths.size(); ++i) {
-        textureIds[i] = SOIL_load_OGL_texture(
-            texturePaths[i].c_str(),
-            SOIL_LOAD_AUTO,
-            SOIL_CREATE_NEW_ID,
-            SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS
-        );
-
-        if (textureIds[i] == 0) {
-            std::cerr << "Failed to load texture: " << texturePaths[i] << std::endl;
+// Function to get the camera keys held down, as REPLAY_KEY_* bits
+uint32_t heldCameraKeys(GLFWwindow* window) {
+    uint32_t keys = 0;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) keys |= REPLAY_KEY_FORWARD;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) keys |= REPLAY_KEY_BACK;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) keys |= REPLAY_KEY_LEFT;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) keys |= REPLAY_KEY_RIGHT;
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) keys |= REPLAY_KEY_RESET;
+    return keys;
+}
+
+// Function to record the input and camera of a frame
+ReplayFrame recordFrame(GLFWwindow* window, double time, double frameTime, uint32_t keys, const SimulationClock& clock) {
+    ReplayFrame frame = {};
+    frame.time = time;
+    frame.frameTime = frameTime;
+    glfwGetCursorPos(window, &frame.cursorX, &frame.cursorY);
+    frame.cameraX = cameraPos.x;
+    frame.cameraY = cameraPos.y;
+    frame.cameraZ = cameraPos.z;
+    frame.cameraYaw = cameraYaw;
+    frame.cameraPitch = cameraPitch;
+    frame.timeScale = float(clock.timeScale);
+    frame.keys = keys;
+    frame.paused = clock.paused;
+    return frame;
+}
+
+// Function to set the camera and clock from a recorded frame
+void applyReplayFrame(const ReplayFrame& frame, SimulationClock& clock) {
+    cameraPos = glm::dvec3(frame.cameraX, frame.cameraY, frame.cameraZ);
+    cameraYaw = frame.cameraYaw;
+    cameraPitch = frame.cameraPitch;
+    cameraFront = cameraFrontFromAngles(cameraYaw, cameraPitch);
+    clock.timeScale = frame.timeScale;
+    clock.paused = frame.paused != 0;
+}
+
+// Function to load a texture from the DDS cache, or decode it with SOIL and cook it into the cache
+// the first time; runs on a worker thread, so no GL calls. The image index is its TextureManager id.
+bool decodeImageFile(const std::string& path, DecodedImage& image) {
+    std::vector<unsigned char> source;
+    if (!readFileBytes(path, source))
+        return false;
+
+    // A file with the same bytes as one already loading shares its texture
+    uint64_t contentHash = hashBytes(source.data(), source.size());
+    image.contentHash = contentHash;
+    if (textureManager.claimContent(image.index, contentHash) != image.index) {
+        image.shared = true;
+        return true;
+    }
+
+    std::string cachePath = textureCachePath(TEXTURE_CACHE_DIRECTORY, contentHash);
+    CookedTextureInfo info;
+    if (readFileBytes(cachePath, image.compressed) && readCookedTextureInfo(image.compressed, info)) {
+        image.width = info.width;
+        image.height = info.height;
+        image.channels = info.alpha ? 4 : 3;
+        return true;
+    }
+
+    unsigned char* pixels = SOIL_load_image_from_memory(source.data(), int(source.size()), &image.width, &image.height, &image.channels, SOIL_LOAD_AUTO);
+    if (pixels == nullptr)
+        return false;
+
+    // Flipped before cooking: SOIL cannot flip DDS files it loads directly
+    flipImageRows(pixels, image.width, image.height, image.channels); // What SOIL_FLAG_INVERT_Y did
+    image.pixels.reset(pixels, SOIL_free_image_data);
+
+    // The pixels and their mips are kept, so the texture is still uploaded if cooking or writing fails
+    if (!buildMipChain(pixels, image.width, image.height, image.channels, image.mips) ||
+        !cookTexture(pixels, image.width, image.height, image.channels, image.mips, image.compressed))
+        image.compressed.clear();
+    else if (!writeFileAtomically(cachePath, image.compressed))
+        std::cerr << "Failed to write texture cache: " << cachePath << std::endl;
+    return true;
+}
+
+// Function to copy a virtual texture tile out of its mapped file; runs on a worker thread, so the
+// disk reads stay off the GL thread. The image index is the tile id.
+bool loadVirtualTile(const std::string&, DecodedImage& image) {
+    uint32_t tile = uint32_t(image.index);
+    const unsigned char* texels = virtualTextures[virtualTileTexture(tile)]->tile(virtualTileLevel(tile), virtualTileX(tile), virtualTileY(tile));
+    if (texels == nullptr)
+        return false;
+    image.width = VIRTUAL_TILE_SIZE;
+    image.height = VIRTUAL_TILE_SIZE;
+    image.channels = 4;
+    image.pixels.reset(new unsigned char[VIRTUAL_TILE_BYTES], std::default_delete<unsigned char[]>());
+    memcpy(image.pixels.get(), texels, VIRTUAL_TILE_BYTES);
+    return true;
+}
+
+// Function to create the 1x1 texture shown until a texture has been decoded
+GLuint createPlaceholderTexture() {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER_COLOR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Function to record how long a hot reload took, for the overlay
+void reportReload(const std::string& path, double milliseconds) {
+    lastReloadPath = path;
+    lastReloadMilliseconds = milliseconds;
+    ++reloadCount;
+    std::cout << "Reloaded " << path << " in " << milliseconds << " ms" << std::endl;
+}
+
+// Function to release a texture slot's reference, deleting the texture once nothing uses it
+void releaseTexture(size_t entry) {
+    entry = textureManager.resolve(entry);
+    GLuint texture = textureManager.release(entry);
+    if (texture == 0)
+        return;
+    textureUploads.cancel(entry);
+    glDeleteTextures(1, &texture);
+    textureStreamer.remove(entry);
+    streamedTextures.erase(entry);
+    texturesAwaitingUpload.erase(entry);
+}
+
+// Function to check whether a texture has a level uploaded to sample
+bool isTextureReady(size_t entry) {
+    return textureManager.handle(entry) != 0 && texturesAwaitingUpload.count(entry) == 0;
+}
+
+// Function to point every texture slot at its shared texture, or at the placeholder while it loads.
+// A reloading slot keeps its previous texture until the new one is ready, then lets it go.
+void refreshTextureIds() {
+    for (size_t i = 0; i < textureEntries.size(); ++i) {
+        textureEntries[i] = textureManager.resolve(textureEntries[i]);
+        size_t shown = textureEntries[i];
+        auto reloading = reloadingTextures.find(i);
+        if (reloading != reloadingTextures.end()) {
+            if (isTextureReady(textureEntries[i])) {
+                reportReload(reloading->second.path, millisecondsSince(reloading->second.start));
+                releaseTexture(reloading->second.previous);
+                reloadingTextures.erase(reloading);
+            }
+            else
+                shown = textureManager.resolve(reloading->second.previous);
+        }
+        textureIds[i] = isTextureReady(shown) ? textureManager.handle(shown) : placeholderTexture;
+    }
+}
+
+// Function to get the start of a streamed texture's mip chain, largest level first
+const unsigned char* mipChain(const StreamedTexture& streamed) {
+    if (streamed.mapped != nullptr)
+        return streamed.mapped;
+    return streamed.dds.data() + streamed.dds.size() - streamed.info.dataBytes;
+}
+
+// Function to create the staging buffer: a persistently mapped pixel unpack buffer holding a few
+// frames of upload budget. Without ARB_buffer_storage, uploads are issued from client memory.
+void createUploadBuffer() {
+    if (!GLEW_ARB_buffer_storage) {
+        std::cout << "No ARB_buffer_storage: textures upload from client memory" << std::endl;
+        return;
+    }
+
+    size_t capacity = UPLOAD_FRAMES_IN_FLIGHT * size_t(uploadBudgetMiB) * 1048576;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &uploadBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+    uploadMapping = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (uploadMapping == nullptr) {
+        glDeleteBuffers(1, &uploadBuffer);
+        uploadBuffer = 0;
+        return;
+    }
+    uploadRing.reset(capacity);
+}
+
+// Function to get the most bytes one queued upload may hold: the frame's budget, and no more than
+// a frame's share of the staging ring
+size_t uploadBandBytes() {
+    size_t budget = size_t(uploadBudgetMiB) * 1048576;
+    if (uploadBuffer != 0)
+        budget = std::min(budget, uploadRing.capacity() / UPLOAD_FRAMES_IN_FLIGHT);
+    return budget;
+}
+
+// Function to let a texture sample down to a level whose data has just been issued; the levels
+// arrive smallest first, so the texture sharpens as they come in. Expects the texture bound.
+void levelUploaded(size_t entry, int level) {
+    auto streamed = streamedTextures.find(entry);
+    if (streamed != streamedTextures.end())
+        streamed->second.uploadedBase = std::min(streamed->second.uploadedBase, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    texturesAwaitingUpload.erase(entry);
+}
+
+// Function to queue one mip level, whose storage already exists, for upload in bands of rows
+// (of 4x4 blocks when compressed) that fit the upload budget
+void enqueueLevel(size_t entry, GLuint texture, int level, int width, int height, GLenum format, bool compressed,
+    const unsigned char* data, size_t rowBytes, const std::shared_ptr<const void>& keepAlive) {
+    int rowHeight = compressed ? 4 : 1;
+    int rows = (height + rowHeight - 1) / rowHeight;
+    int rowsPerBand = int(std::max<size_t>(1, uploadBandBytes() / rowBytes));
+    for (int row = 0; row < rows; row += rowsPerBand) {
+        int bandRows = std::min(rowsPerBand, rows - row);
+        int y = row * rowHeight;
+        int bandHeight = std::min(bandRows * rowHeight, height - y);
+        bool last = row + bandRows == rows;
+
+        StagedUpload upload;
+        upload.owner = entry;
+        upload.level = level;
+        upload.data = data + size_t(row) * rowBytes;
+        upload.bytes = size_t(bandRows) * rowBytes;
+        upload.keepAlive = keepAlive;
+        GLsizei bytes = GLsizei(upload.bytes);
+        upload.issue = [=](const void* pixels) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            if (compressed)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, bandHeight, format, bytes, pixels);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, bandHeight, format, GL_UNSIGNED_BYTE, pixels);
+            if (last)
+                levelUploaded(entry, level);
         };
-    };
+        textureUploads.enqueue(std::move(upload));
+    }
+}
+
+// Function to allocate mip levels [first, last) of a streamed texture and queue their data,
+// smallest level first. Expects the texture bound.
+void enqueueMipLevels(size_t entry, GLuint texture, const StreamedTexture& streamed, int first, int last) {
+    const CookedTextureInfo& info = streamed.info;
+    GLenum format = info.alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    std::vector<const unsigned char*> levels;
+    const unsigned char* data = mipChain(streamed);
+    for (int level = 0; level < last; ++level) {
+        levels.push_back(data);
+        data += compressedLevelBytes(std::max(info.width >> level, 1), std::max(info.height >> level, 1), info.alpha);
+    }
+
+    for (int level = last - 1; level >= first; --level) {
+        int width = std::max(info.width >> level, 1);
+        int height = std::max(info.height >> level, 1);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, GLsizei(compressedLevelBytes(width, height, info.alpha)), nullptr);
+        enqueueLevel(entry, texture, level, width, height, format, true, levels[level], compressedLevelBytes(width, 4, info.alpha), nullptr);
+    }
+}
+
+// Function to create a compressed texture with only its smallest mips resident; the streamer
+// uploads finer levels once the texture is seen up close. The pack's mapping is used without a copy.
+// The caller reports it resident with residentTextureBytes.
+GLuint createStreamedTexture(size_t entry, StreamedTexture streamed) {
+    int baseLevel = textureStreamer.add(entry, streamed.info);
+    streamed.uploadedBase = streamed.info.mipLevels;
+    streamedTextures[entry] = std::move(streamed);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    enqueueMipLevels(entry, texture, streamedTextures[entry], baseLevel, streamedTextures[entry].info.mipLevels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, streamedTextures[entry].info.mipLevels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, streamedTextures[entry].info.mipLevels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    texturesAwaitingUpload.insert(entry);
+    return texture;
+}
+
+// Function to get the memory of a streamed texture's resident levels
+size_t residentTextureBytes(size_t entry) {
+    return TextureStreamer::chainBytes(streamedTextures[entry].info, textureStreamer.residentBase(entry));
+}
+
+// Function to apply the streamer's decisions from the last frame's requests: queue the levels it
+// refines to and free the ones it evicts
+void streamTextures() {
+    for (const TextureStreamStep& step : textureStreamer.update(size_t(textureBudgetMiB) * 1048576)) {
+        auto streamed = streamedTextures.find(step.id);
+        GLuint texture = textureManager.handle(step.id);
+        if (streamed == streamedTextures.end() || texture == 0)
+            continue;
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (step.baseLevel < step.previousBase) {
+            enqueueMipLevels(step.id, texture, streamed->second, step.baseLevel, step.previousBase);
+        }
+        else {
+            // Levels still queued are dropped; sampling stops at the new base, or at the finest
+            // level that has arrived if that is coarser, before the levels are redefined as empty
+            textureUploads.cancel(step.id, step.baseLevel);
+            streamed->second.uploadedBase = std::max(streamed->second.uploadedBase, step.baseLevel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, std::min(streamed->second.uploadedBase, streamed->second.info.mipLevels - 1));
+            GLenum format = streamed->second.info.alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            for (int level = step.previousBase; level < step.baseLevel; ++level)
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, format, 0, 0, 0, 0, nullptr);
+        }
+        textureManager.setGpuBytes(step.id, residentTextureBytes(step.id));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Function to issue this frame's share of the queued texture uploads, staged through the ring
+void issueTextureUploads() {
+    // Reuse the staging space of frames the GPU has finished reading
+    while (!uploadFences.empty()) {
+        GLenum status = glClientWaitSync(uploadFences.front().second, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(uploadFences.front().second);
+        uploadRing.retire(uploadFences.front().first);
+        uploadFences.pop_front();
+    }
+
+    uploadedBytesThisFrame = 0;
+    if (textureUploads.pendingCount() == 0)
+        return;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    uploadedBytesThisFrame = textureUploads.issue(size_t(uploadBudgetMiB) * 1048576, uploadBuffer != 0 ? &uploadRing : nullptr, uploadMapping);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uint64_t frame = uploadRing.endFrame();
+    if (uploadBuffer != 0 && uploadedBytesThisFrame > 0)
+        uploadFences.push_back(std::make_pair(frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
+    refreshTextureIds();
+}
+
+// Function to create the textures decoded since the last call and queue their data for upload;
+// GL calls stay on this thread. Returns the number of textures created.
+size_t uploadDecodedTextures(ImageDecodeQueue& decodeQueue) {
+    size_t uploaded = 0;
+    DecodedImage image;
+    while (decodeQueue.poll(image)) {
+        // A texture reloaded again, or a set replaced, before it was decoded has been released;
+        // its image is dropped here rather than given a texture nothing would ever delete
+        if (!textureManager.holds(image.index))
+            continue;
+        if (!image.decoded) {
+            std::cerr << "Failed to load texture: " << image.path << std::endl;
+            continue;
+        }
+        if (image.shared)
+            continue; // The texture with the same bytes is uploaded for both
+
+        // Uncompressed RGBA with mipmaps, the baseline the compression is measured against
+        size_t uncompressedBytes = size_t(image.width) * image.height * 4 * 4 / 3;
+
+        // Cooked textures are streamed from their mip chain, or handed to SOIL to decompress
+        // when the GPU cannot sample DXT
+        CookedTextureInfo info;
+        if (GLEW_EXT_texture_compression_s3tc && readCookedTextureInfo(image.compressed, info)) {
+            StreamedTexture streamed;
+            streamed.info = info;
+            streamed.dds = std::move(image.compressed);
+            GLuint texture = createStreamedTexture(image.index, std::move(streamed));
+            textureManager.setResident(image.index, texture, residentTextureBytes(image.index), uncompressedBytes, image.decodeMilliseconds);
+            ++uploaded;
+            continue;
+        }
+        if (!image.compressed.empty()) {
+            GLuint texture = SOIL_load_OGL_texture_from_memory(image.compressed.data(), int(image.compressed.size()),
+                SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, SOIL_FLAG_DDS_LOAD_DIRECT | SOIL_FLAG_TEXTURE_REPEATS);
+            if (texture != 0 && readCookedTextureInfo(image.compressed, info)) {
+                textureManager.setResident(image.index, texture, info.dataBytes, uncompressedBytes, image.decodeMilliseconds);
+                ++uploaded;
+                continue;
+            }
+            if (texture != 0)
+                glDeleteTextures(1, &texture);
+            if (!image.pixels) {
+                std::cerr << "Failed to upload cached texture: " << image.path << " (" << SOIL_last_result() << ")" << std::endl;
+                continue;
+            }
+        }
+
+        static const GLenum formats[] = { GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+        GLenum format = formats[std::min(std::max(image.channels, 1), 4)];
+
+        // The queued uploads keep the pixels and the mips the workers built until they are issued
+        std::shared_ptr<DecodedImage> source = std::make_shared<DecodedImage>(std::move(image));
+        int levelCount = int(source->mips.levels.size()) + 1;
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (int level = levelCount - 1; level >= 0; --level) {
+            int width = level == 0 ? source->width : source->mips.levels[level - 1].width;
+            int height = level == 0 ? source->height : source->mips.levels[level - 1].height;
+            const unsigned char* pixels = level == 0 ? source->pixels.get() : source->mips.level(level - 1);
+            glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+            enqueueLevel(source->index, texture, level, width, height, format, false, pixels, size_t(width) * source->channels, source);
+        }
+
+        // Grey images are shown as grey rather than red
+        if (source->channels <= 2) {
+            GLint swizzle[] = { GL_RED, GL_RED, GL_RED, source->channels == 2 ? GL_GREEN : GL_ONE };
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levelCount - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        texturesAwaitingUpload.insert(source->index);
+        textureManager.setResident(source->index, texture, uncompressedBytes, uncompressedBytes, source->decodeMilliseconds);
+        ++uploaded;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    refreshTextureIds();
+    return uploaded;
+}
+
+// Function to start loading textures, releasing the previous set. Paths the previous set already
+// held keep their textures, and textures in the asset pack are uploaded at once; the other slots
+// show the placeholder until the workers have decoded them and uploadDecodedTextures replaces it.
+void loadTextures(const std::vector<std::string>& texturePaths, ImageDecodeQueue& decodeQueue) {
+    // Finish the previous set first, so textures it shares with the new one are resident
+    decodeQueue.waitForAll();
+    uploadDecodedTextures(decodeQueue);
+
+    if (placeholderTexture == 0)
+        placeholderTexture = createPlaceholderTexture();
+    if (!createDirectory(TEXTURE_CACHE_DIRECTORY))
+        std::cerr << "Failed to create texture cache: " << TEXTURE_CACHE_DIRECTORY << std::endl;
+
+    // Acquire the new set before releasing the old one
+    std::vector<size_t> previousEntries;
+    previousEntries.swap(textureEntries);
+    bool packedTextures = assetPack.isOpen() && GLEW_EXT_texture_compression_s3tc;
+    for (const std::string& path : texturePaths) {
+        bool isNew;
+        size_t entry = textureManager.acquire(path, isNew);
+        textureEntries.push_back(entry);
+        if (!isNew)
+            continue;
+
+        // Packed textures need no decoding, so they are uploaded now
+        const AssetEntry* packed = packedTextures && assetsChangedOnDisk.count(path) == 0 ? assetPack.find(path, ASSET_TEXTURE) : nullptr;
+        if (packed == nullptr) {
+            decodeQueue.submit(entry, path);
+            continue;
+        }
+        if (textureManager.claimContent(entry, packed->contentHash) != entry)
+            continue;
+        auto uploadStart = std::chrono::steady_clock::now();
+        StreamedTexture streamed;
+        streamed.info = { int(packed->width), int(packed->height), int(packed->mipLevels), packed->format == ASSET_FORMAT_DXT5, size_t(packed->size) };
+        streamed.mapped = assetPack.data(*packed);
+        GLuint texture = createStreamedTexture(entry, std::move(streamed));
+        textureManager.setResident(entry, texture, residentTextureBytes(entry), size_t(packed->width) * packed->height * 4 * 4 / 3, millisecondsSince(uploadStart));
+    }
+    for (size_t entry : previousEntries)
+        releaseTexture(entry);
+    for (const auto& reloading : reloadingTextures)
+        releaseTexture(reloading.second.previous);
+    reloadingTextures.clear();
+
+    textureIds.assign(texturePaths.size(), placeholderTexture);
+    refreshTextureIds();
+}
+
+// Function to load a texture file again after it changed on disk, into every slot that uses it.
+// Only that file is decoded; its slots show the old texture until the new one has been uploaded.
+void reloadTexture(const std::string& path, const std::vector<std::string>& texturePaths, ImageDecodeQueue& decodeQueue) {
+    textureManager.forgetPath(path);
+    for (size_t i = 0; i < texturePaths.size(); ++i) {
+        if (texturePaths[i] != path)
+            continue;
+
+        bool isNew;
+        size_t entry = textureManager.acquire(path, isNew);
+        if (isNew)
+            decodeQueue.submit(entry, path);
+
+        // A slot reloaded again before the last reload finished still shows the texture it had
+        auto reloading = reloadingTextures.find(i);
+        if (reloading == reloadingTextures.end())
+            reloadingTextures[i] = { textureEntries[i], path, std::chrono::steady_clock::now() };
+        else {
+            releaseTexture(textureEntries[i]);
+            reloading->second.start = std::chrono::steady_clock::now();
+        }
+        textureEntries[i] = entry;
+    }
+    refreshTextureIds();
+}
+
+// Programs built from shader permutations, each on its first use
+ShaderPermutationCache shaderPrograms;
+
+// Uniforms every program is given once per frame, the first time it is used in that frame
+struct FrameUniforms {
+    uint64_t frame = 0;
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 lightPos = glm::vec3(0.0f); // The sun, relative to the camera
 };
+FrameUniforms frameUniforms;
+std::map<GLuint, uint64_t> programFrames; // Frame each program last had its frame uniforms set
+
+// Function to take a finished permutation into the cache. A rebuild that failed keeps the previous
+// program; one that succeeded replaces it.
+void finishPermutation(const std::string& path, const ShaderPermutation& permutation, const std::vector<std::string>& files,
+    GLuint program, std::chrono::steady_clock::time_point start) {
+    uint32_t previous = 0;
+    bool rebuilt = shaderPrograms.find(path, permutation.name, previous);
+    if (rebuilt && program == 0) {
+        std::cerr << "Failed to reload " << path << " (" << permutation.name << "); keeping the previous program" << std::endl;
+        return;
+    }
 
-// Function to render spheres
-void renderSpheres(GLuint shader, GLuint modelLoc, GLuint sphereVao, const std::vector<unsigned int>& sphereIndices) {
-    float currentTime = glfwGetTime();
+    if (previous != 0) {
+        glDeleteProgram(previous);
+        programFrames.erase(previous); // GL may hand the name out again
+    }
+    shaderPrograms.insert(path, permutation, program, files);
+    if (rebuilt)
+        reportReload(path + " (" + permutation.name + ")", millisecondsSince(start));
+}
 
-    for (size_t i = 0; i < textureIds.size() - 1; ++i) { // Exclude moon for now
-        glBindTexture(GL_TEXTURE_2D, textureIds[i]); // Bind the current texture
+// Function to preprocess one permutation of a shader file and start building it; it joins the
+// cache once it is built
+void startPermutationBuild(const std::string& path, const ShaderPermutation& permutation) {
+    auto start = std::chrono::steady_clock::now();
+    PreprocessedShader source;
+    std::string error;
+    auto reader = [](const std::string& file, std::string& text) { return readTextAsset(file, ASSET_SHADER, text); };
+    bool preprocessed = preprocessShader(path, permutation.defines, reader, source, error);
+    std::vector<std::string> files = source.files.empty() ? std::vector<std::string>{ path } : source.files;
+    if (!preprocessed) {
+        std::cerr << "Failed to preprocess " << path << " (" << permutation.name << "): " << error << std::endl;
+        finishPermutation(path, permutation, files, 0, start);
+        return;
+    }
+    startProgramBuild(path + " (" + permutation.name + ")", source.vertexSource, source.fragmentSource, [=](GLuint program) {
+        finishPermutation(path, permutation, files, program, start);
+    });
+}
 
-        // Calculate angle and position for orbiting planets
-        float angle = angularVelocities[i] * currentTime; // Calculate angle based on orbital speed
-        float x = orbitalRadii[i] * cos(angle); // X position based on angle
-        float z = orbitalRadii[i] * sin(angle); // Z position based on angle
+// Function to get the program of a shader permutation, starting its build the first time it is
+// asked for. Returns 0 until it is built, and if it failed to build; a failed build is not tried
+// again until one of its files changes.
+GLuint shaderProgram(const std::string& path, const ShaderPermutation& permutation) {
+    uint32_t program;
+    if (shaderPrograms.find(path, permutation.name, program))
+        return program;
+    if (!isProgramBuilding(path + " (" + permutation.name + ")"))
+        startPermutationBuild(path, permutation);
+    return 0;
+}
 
-        // Create the model matrix for the current planet
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z)); // Position based on orbit
-        model = glm::scale(model, glm::vec3(scales[i])); // Scale the planet
+// Function to bind the program of a shader permutation, giving it this frame's uniforms if it has
+// not had them yet. Returns 0, leaving no program bound, if it is not built.
+GLuint useShader(const std::string& path, const ShaderPermutation& permutation) {
+    GLuint program = shaderProgram(path, permutation);
+    glUseProgram(program);
+    if (program == 0)
+        return 0;
 
-        // Calculate rotation based on time
-        float rotationAngle = rotationSpeeds[i] * currentTime; // Rotation angle based on rotation speed
-        model = glm::rotate(model, rotationAngle, glm::vec3(0.0f, 1.0f, 0.0f)); // Rotate around Y axis
+    uint64_t& frame = programFrames[program];
+    if (frame == frameUniforms.frame)
+        return program;
+    frame = frameUniforms.frame;
+
+    // Uniforms a permutation compiled out have no location, and setting them does nothing
+    glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(frameUniforms.view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(frameUniforms.projection));
+    glUniform3fv(glGetUniformLocation(program, "lightPos"), 1, glm::value_ptr(frameUniforms.lightPos)); // Light comes from the sun
+    glUniform3f(glGetUniformLocation(program, "viewPos"), 0.0f, 0.0f, 0.0f); // The camera is the origin
+    glUniform3f(glGetUniformLocation(program, "lightColor"), 1.0f, 1.0f, 1.0f); // White light
+    glUniform3f(glGetUniformLocation(program, "orbitColor"), 1.0f, 1.0f, 1.0f); // White orbit lines, tinted by glColor
+    glUniform1f(glGetUniformLocation(program, "orbitAlpha"), 0.25f);
+    glUniform3f(glGetUniformLocation(program, "emissionColor"), 1.0f, 0.65f, 0.0f); // Orange-ish yellow
+    glUniform1f(glGetUniformLocation(program, "emissionStrength"), 0.10f);
+    glUniform1i(glGetUniformLocation(program, "textureSampler"), 0);
+    glUniform1i(glGetUniformLocation(program, "virtualCache"), 1);
+    glUniform1i(glGetUniformLocation(program, "virtualIndirection"), 2);
+    glUniform1f(glGetUniformLocation(program, "virtualCacheSlots"), float(VIRTUAL_CACHE_SLOTS));
+    return program;
+}
 
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model)); // Send the model matrix to the shader
+// Function to create the physical tile cache and the feedback framebuffer, with the pixel pack
+// buffers its tiles are read back through
+void createVirtualTextureCache() {
+    int cacheSize = VIRTUAL_CACHE_SLOTS * VIRTUAL_TILE_SIZE;
+    glGenTextures(1, &virtualCacheTexture);
+    glBindTexture(GL_TEXTURE_2D, virtualCacheTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSize, cacheSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    int width = WINDOW_WIDTH / FEEDBACK_DIVISOR, height = WINDOW_HEIGHT / FEEDBACK_DIVISOR;
+    glGenTextures(1, &feedbackColor);
+    glBindTexture(GL_TEXTURE_2D, feedbackColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenRenderbuffers(1, &feedbackDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &feedbackFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Feedback framebuffer is incomplete; virtual textures are off" << std::endl;
+        virtualTexturing = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        glUniform1i(glGetUniformLocation(shader, "textureSampler"), 0); // Assuming your shader uses "textureSampler"
+    glGenBuffers(2, feedbackBuffers);
+    for (GLuint buffer : feedbackBuffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
-        glBindVertexArray(sphereVao); // Use the same VAO for sphere geometry
-        glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0); // Draw the sphere
+// Function to open the virtual textures of a set of texture slots, forgetting the previous set's
+// tiles. Slots without a virtual texture file keep using their ordinary texture.
+void loadVirtualTextures(const std::vector<std::string>& texturePaths, ImageDecodeQueue& tileQueue) {
+    // The workers read the mapped files, so they finish before the files close
+    tileQueue.waitForAll();
+    DecodedImage loaded;
+    while (tileQueue.poll(loaded)) {}
+    textureUploads.cancel(VIRTUAL_TILE_UPLOAD_OWNER);
+    if (!virtualIndirectionTextures.empty())
+        glDeleteTextures(GLsizei(virtualIndirectionTextures.size()), virtualIndirectionTextures.data());
+    virtualIndirectionTextures.clear();
+    virtualTextures.clear();
+    virtualTiles.reset(VIRTUAL_CACHE_SLOTS);
+    virtualTextureSlots.assign(texturePaths.size(), -1);
+
+    // Slots with the same path share a virtual texture
+    std::map<std::string, int> opened;
+    for (size_t i = 0; i < texturePaths.size(); ++i) {
+        std::string path = virtualTexturePath(VIRTUAL_TEXTURE_DIRECTORY, texturePaths[i]);
+        auto found = opened.find(path);
+        if (found != opened.end()) {
+            virtualTextureSlots[i] = found->second;
+            continue;
+        }
 
-        glBindVertexArray(0);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+        std::unique_ptr<VirtualTexture> texture(new VirtualTexture());
+        if (!texture->open(path))
+            continue;
+        int index = virtualTiles.addTexture(texture->levels());
+        if (index < 0) {
+            std::cerr << "Too many virtual textures; " << path << " is not used" << std::endl;
+            break;
+        }
+        std::cout << "Virtual texture " << path << ": " << texture->width() << "x" << texture->height() << std::endl;
+        virtualTextures.push_back(std::move(texture));
+        opened[path] = index;
+        virtualTextureSlots[i] = index;
+
+        int width, height;
+        virtualTiles.indirectionSize(index, width, height);
+        GLuint indirection;
+        glGenTextures(1, &indirection);
+        glBindTexture(GL_TEXTURE_2D, indirection);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        virtualIndirectionTextures.push_back(indirection);
     }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    // Render the moon orbiting Earth
-    glBindTexture(GL_TEXTURE_2D, textureIds[9]); // Bind the moon texture
+// Function to start loading the tiles the last feedback asked for, and to give the tiles that
+// finished loading a cache slot and queue their upload
+void loadVirtualTiles(ImageDecodeQueue& tileQueue) {
+    for (uint32_t tile : virtualTiles.takeMissing(MAX_VIRTUAL_TILE_LOADS))
+        tileQueue.submit(tile, std::string());
+
+    DecodedImage loaded;
+    while (tileQueue.poll(loaded)) {
+        uint32_t tile = uint32_t(loaded.index);
+        if (!loaded.decoded) {
+            virtualTiles.cancel(tile);
+            continue;
+        }
+        int slot = virtualTiles.place(tile);
+        if (slot < 0)
+            continue;
+
+        StagedUpload upload;
+        upload.owner = VIRTUAL_TILE_UPLOAD_OWNER;
+        upload.data = loaded.pixels.get();
+        upload.bytes = VIRTUAL_TILE_BYTES;
+        upload.keepAlive = loaded.pixels;
+        int x = slot % virtualTiles.slotsPerSide() * VIRTUAL_TILE_SIZE;
+        int y = slot / virtualTiles.slotsPerSide() * VIRTUAL_TILE_SIZE;
+        upload.issue = [=](const void* pixels) {
+            glBindTexture(GL_TEXTURE_2D, virtualCacheTexture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VIRTUAL_TILE_SIZE, VIRTUAL_TILE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            virtualTiles.setResident(tile);
+        };
+        textureUploads.enqueue(std::move(upload));
+    }
+    virtualTiles.endFrame();
+}
 
-    // Calculate Earth's position
-    float earthAngle = angularVelocities[3] * currentTime;
-    float earthX = orbitalRadii[3] * cos(earthAngle);
-    float earthZ = orbitalRadii[3] * sin(earthAngle);
+// Function to upload the indirection tables whose tiles changed, after the frame's uploads
+void updateVirtualIndirection() {
+    std::vector<unsigned char> table;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t i = 0; i < virtualIndirectionTextures.size(); ++i) {
+        if (!virtualTiles.updateIndirection(int(i), table))
+            continue;
+        int width, height;
+        virtualTiles.indirectionSize(int(i), width, height);
+        glBindTexture(GL_TEXTURE_2D, virtualIndirectionTextures[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, table.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    // Calculate Moon's position relative to Earth
-    float moonAngle = moonOrbitSpeed * currentTime;
-    float moonX = earthX + moonOrbitRadius * cos(moonAngle);
-    float moonZ = earthZ + moonOrbitRadius * sin(moonAngle);
+// Function to get the virtual texture a texture slot samples, or -1
+int virtualTextureOf(size_t slot) {
+    return virtualTexturing && slot < virtualTextureSlots.size() ? virtualTextureSlots[slot] : -1;
+}
 
-    // Create the model matrix for the moon
-    glm::mat4 moonModel = glm::translate(glm::mat4(1.0f), glm::vec3(moonX, 0.0f, moonZ));
-    moonModel = glm::scale(moonModel, glm::vec3(moonScale));
+// Function to set the shape of a virtual texture's levels in a shader that samples it
+void setVirtualTextureUniforms(GLuint shader, int texture) {
+    const std::vector<VirtualLevel>& levels = virtualTextures[texture]->levels();
+    std::vector<GLint> grids;
+    for (const VirtualLevel& level : levels) {
+        grids.push_back(level.tilesX);
+        grids.push_back(level.tilesY);
+        grids.push_back(level.tableRow);
+    }
+    glUniform2f(glGetUniformLocation(shader, "virtualSize"), float(virtualTextures[texture]->width()), float(virtualTextures[texture]->height()));
+    glUniform1i(glGetUniformLocation(shader, "virtualLevelCount"), GLint(levels.size()));
+    glUniform3iv(glGetUniformLocation(shader, "virtualLevels"), GLsizei(levels.size()), grids.data());
+}
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(moonModel)); // Send the model matrix to the shader
+// Function to render the tile feedback of the bodies at a fraction of the window's resolution,
+// then request the tiles named in the previous frame's feedback, which has had a frame to arrive
+void renderVirtualFeedback(GLuint sphereVao, GLsizei sphereIndexCount, EcsWorld& world, const TransformGraph& sceneGraph, const glm::dvec3& origin) {
+    GLuint feedbackShader = shaderProgram(FEEDBACK_SHADER_PATH, DEFAULT_PERMUTATION);
+    if (feedbackShader == 0)
+        return; // No tiles are requested until it builds
+    int width = WINDOW_WIDTH / FEEDBACK_DIVISOR, height = WINDOW_HEIGHT / FEEDBACK_DIVISOR;
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // To zero, which names no tile
+    glDisable(GL_BLEND); // The packed ids must be written as they are
 
+    useShader(FEEDBACK_SHADER_PATH, DEFAULT_PERMUTATION);
+    glUniform1f(glGetUniformLocation(feedbackShader, "virtualLodBias"), -log2(float(FEEDBACK_DIVISOR)));
+    GLint modelLoc = glGetUniformLocation(feedbackShader, "model");
+    GLint indexLoc = glGetUniformLocation(feedbackShader, "virtualTextureIndex");
     glBindVertexArray(sphereVao);
-    glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
+    world.forEach<SceneNode, Appearance>([&](size_t count, const Entity*, SceneNode* node, Appearance* appearance) {
+        for (size_t i = 0; i < count; ++i) {
+            // Bodies without a virtual texture are drawn too, so they hide what is behind them
+            int texture = virtualTextureOf(appearance[i].texture);
+            glUniform1i(indexLoc, texture);
+            if (texture >= 0)
+                setVirtualTextureUniforms(feedbackShader, texture);
+            glm::mat4 model = relativeTransform(sceneGraph, node[i].body, origin);
+            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+        }
+    });
+    glBindVertexArray(0);
+
+    // Read this frame's feedback into one buffer and decode last frame's from the other
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[feedbackFrames % 2]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    if (feedbackFrames > 0) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[(feedbackFrames + 1) % 2]);
+        size_t pixels = size_t(width) * height;
+        const unsigned char* feedback = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels * 4, GL_MAP_READ_BIT));
+        if (feedback != nullptr) {
+            std::vector<uint32_t> tiles;
+            decodeVirtualFeedback(feedback, pixels, tiles);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            for (uint32_t tile : tiles)
+                virtualTiles.request(tile);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++feedbackFrames;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Function to render the spheres of every body in the scene graph, the primary glowing and the rest
+// lit by it, each with the permutation of Basic.shader its texture needs
+void renderSpheres(GLuint sphereVao, GLsizei sphereIndexCount, EcsWorld& world, const TransformGraph& sceneGraph, uint32_t primaryFrame, const glm::dvec3& origin) {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, virtualCacheTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(sphereVao); // Use the same VAO for sphere geometry
+    GLuint boundShader = 0;
+    GLint modelLoc = -1;
+
+    world.forEach<SceneNode, Appearance>([&](size_t count, const Entity*, SceneNode* node, Appearance* appearance) {
+        for (size_t i = 0; i < count; ++i) {
+            int virtualTexture = virtualTextureOf(appearance[i].texture);
+            const ShaderPermutation& permutation = node[i].frame == primaryFrame
+                ? (virtualTexture >= 0 ? EMISSIVE_VIRTUAL_PERMUTATION : EMISSIVE_PERMUTATION)
+                : (virtualTexture >= 0 ? LIT_VIRTUAL_PERMUTATION : LIT_PERMUTATION);
+            GLuint shader = shaderProgram(SHADER_PATH, permutation);
+            if (shader == 0)
+                continue; // Failed to build; reported when it was built
+            if (shader != boundShader) {
+                useShader(SHADER_PATH, permutation);
+                boundShader = shader;
+                modelLoc = glGetUniformLocation(shader, "model");
+            }
+
+            glBindTexture(GL_TEXTURE_2D, textureIds[appearance[i].texture]); // Bind the body's texture
+
+            // The model matrix comes from the scene graph, relative to the camera
+            glm::mat4 model = relativeTransform(sceneGraph, node[i].body, origin);
+            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model)); // Send the model matrix to the shader
+
+            // A virtual texture brings in its own tiles; otherwise ask for as much texture detail
+            // as the body covers on screen
+            if (virtualTexture >= 0) {
+                setVirtualTextureUniforms(shader, virtualTexture);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, virtualIndirectionTextures[virtualTexture]);
+                glActiveTexture(GL_TEXTURE0);
+            }
+            else {
+                float radius = SPHERE_RADIUS * glm::length(glm::vec3(model[0]));
+                float distance = std::max(glm::length(glm::vec3(model[3])), radius);
+                double screenPixels = radius / distance * WINDOW_HEIGHT / tan(glm::radians(FIELD_OF_VIEW) / 2.0);
+                textureStreamer.request(textureEntries[appearance[i].texture], screenPixels);
+            }
+
+            glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0); // Draw the sphere
+        }
+    });
 
     glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 };
 
-// Function to draw orbit lines
-void drawOrbit(float radius, int segments) {
+// Function to draw orbit lines around a parent frame, relative to the given origin
+void drawOrbit(const KeplerBatch& orbits, size_t index, int segments, const glm::dmat4& parentWorld, const glm::dvec3& origin) {
     glBegin(GL_LINE_STRIP);
     for (int i = 0; i <= segments; i++) {
-        float theta = 2.0f * M_PI * float(i) / float(segments);
-        float x = radius * cosf(theta);
-        float z = radius * sinf(theta);
-        glVertex3f(x, 0.0f, z);
+        float eccentricAnomaly = 2.0f * M_PI * float(i) / float(segments);
+        glm::dvec3 worldPoint = glm::dvec3(parentWorld * glm::dvec4(orbitPoint(orbits, index, eccentricAnomaly), 1.0));
+        glm::vec3 point = glm::vec3(worldPoint - origin);
+        glVertex3f(point.x, point.y, point.z);
     }
     glEnd();
 };
 
-// Function to draw the moon's orbit around the Earth
-void drawMoonOrbit(float earthX, float earthZ, float radius, int segments) {
+// Function to draw a moon's circular orbit around its parent's frame, relative to the given origin
+void drawMoonOrbit(const glm::dmat4& parentWorld, float radius, int segments, const glm::dvec3& origin) {
     glBegin(GL_LINE_STRIP);
     for (int i = 0; i <= segments; i++) {
         float theta = 2.0f * M_PI * float(i) / float(segments);
-        float x = earthX + radius * cosf(theta);
-        float z = earthZ + radius * sinf(theta);
-        glVertex3f(x, 0.0f, z);
+        glm::dvec3 worldPoint = glm::dvec3(parentWorld * glm::dvec4(radius * cosf(theta), 0.0, radius * sinf(theta), 1.0));
+        glm::vec3 point = glm::vec3(worldPoint - origin);
+        glVertex3f(point.x, point.y, point.z);
     }
     glEnd();
 }
 
-// Function to generate random float between min and max
-float randomFloat(float min, float max) {
-    return min + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (max - min)));
+// Function to build the scene's transform hierarchy: primary -> planets -> moons and ring
+void buildSceneGraph(EcsWorld& world, TransformGraph& sceneGraph, SceneFrames& frames) {
+    // The primary's frame is the root; the other major bodies orbit it
+    std::vector<Entity> majorBodies = populationBySlot<MajorBody>(world);
+    frames.primary = addTransform(sceneGraph, NO_PARENT);
+    world.get<SceneNode>(majorBodies[0])->frame = frames.primary;
+    for (size_t i = 1; i < majorBodies.size(); ++i)
+        world.get<SceneNode>(majorBodies[i])->frame = addTransform(sceneGraph, frames.primary);
+
+    // Moons hang off their parent's frame; parents are created first, so they already have one
+    world.forEach<Satellite, SceneNode>([&](size_t count, const Entity*, Satellite* satellite, SceneNode* node) {
+        for (size_t i = 0; i < count; ++i)
+            node[i].frame = addTransform(sceneGraph, world.get<SceneNode>(satellite[i].parent)->frame);
+    });
+
+    // Spin and size live on separate child nodes so they are not inherited by moons and rings
+    world.forEach<SceneNode, Appearance>([&](size_t count, const Entity*, SceneNode* node, Appearance* appearance) {
+        for (size_t i = 0; i < count; ++i)
+            node[i].body = addTransform(sceneGraph, node[i].frame, glm::scale(glm::dmat4(1.0), glm::dvec3(appearance[i].radius)));
+    });
+
+    Entity ringParent = findBody(world, RING_PARENT);
+    frames.ring = addTransform(sceneGraph, ringParent != NO_ENTITY ? world.get<SceneNode>(ringParent)->frame : frames.primary);
 }
 
-// Function to generate asteroid data
-void generateAsteroids(std::vector<glm::vec3>& positions, std::vector<float>& sizes, std::vector<float>& rotationSpeeds) {
-    srand(static_cast<unsigned int>(time(0))); // Seed for random number generation
+// Function to pose the scene graph for a simulation state and update its world transforms
+void updateSceneGraph(EcsWorld& world, TransformGraph& sceneGraph, const SimulationState& state) {
+    // Major bodies other than the primary are placed relative to it
+    glm::dvec3 primaryPosition = state.planetPositions[0];
+    world.forEach<MajorBody, StateSlot, SceneNode>([&](size_t count, const Entity*, MajorBody*, StateSlot* slot, SceneNode* node) {
+        for (size_t i = 0; i < count; ++i) {
+            glm::dvec3 position = state.planetPositions[slot[i].index];
+            glm::dvec3 offset = slot[i].index == 0 ? position : position - primaryPosition;
+            setLocalTransform(sceneGraph, node[i].frame, glm::translate(glm::dmat4(1.0), offset));
+        }
+    });
+
+    // Rotation based on time, around the Y axis
+    world.forEach<SceneNode, Spin, Appearance>([&](size_t count, const Entity*, SceneNode* node, Spin* spin, Appearance* appearance) {
+        for (size_t i = 0; i < count; ++i) {
+            double rotationAngle = fmod(spin[i].rate * state.time, 2.0 * M_PI);
+            glm::dmat4 body = glm::rotate(glm::dmat4(1.0), rotationAngle, glm::dvec3(0.0, 1.0, 0.0));
+            setLocalTransform(sceneGraph, node[i].body, glm::scale(body, glm::dvec3(appearance[i].radius)));
+        }
+    });
+
+    // Moons' positions relative to their parents
+    world.forEach<Satellite, SceneNode>([&](size_t count, const Entity*, Satellite* satellite, SceneNode* node) {
+        for (size_t i = 0; i < count; ++i) {
+            double angle = fmod(satellite[i].orbitSpeed * state.time, 2.0 * M_PI);
+            double radius = satellite[i].orbitRadius;
+            setLocalTransform(sceneGraph, node[i].frame, glm::translate(glm::dmat4(1.0), glm::dvec3(radius * cos(angle), 0.0, radius * sin(angle))));
+        }
+    });
 
-    for (int i = 0; i < NUM_ASTEROIDS; ++i) {
-        float angle = randomFloat(0.0f, 2.0f * M_PI);
-        float distance = randomFloat(BELT_INNER_RADIUS, BELT_OUTER_RADIUS);
-        float x = distance * cos(angle);
-        float z = distance * sin(angle);
-        float y = randomFloat(-0.5f, 0.5f); // Small vertical variation
+    updateTransforms(sceneGraph);
+}
 
-        positions.push_back(glm::vec3(x, y, z));
-        sizes.push_back(randomFloat(ASTEROID_MIN_RADIUS, ASTEROID_MAX_RADIUS));
-        rotationSpeeds.push_back(randomFloat(MIN_ROTATION_SPEED, MAX_ROTATION_SPEED));
+// Function to import JPL Horizons vector tables (one per body, in AU) into an ephemeris file,
+// scaled so Earth's orbit matches the scene's
+int importPlanetEphemeris(const std::string& outputPath, const std::vector<std::string>& tablePaths, double referenceRadius, double referenceMeanMotion) {
+    HorizonsImportSettings settings;
+    settings.unitsPerAu = referenceRadius;
+    settings.secondsPerDay = 2.0 * M_PI / referenceMeanMotion / 365.25;
+    settings.segmentLength = 8.0 * settings.secondsPerDay;
+    settings.coefficientCount = EPHEMERIS_COEFFICIENTS;
+
+    Ephemeris ephemeris;
+    if (!importHorizonsVectors(tablePaths, settings, ephemeris) || !writeEphemeris(outputPath, ephemeris)) {
+        std::cerr << "Failed to import ephemeris into " << outputPath << std::endl;
+        return 1;
     }
+
+    std::cout << "Imported " << ephemeris.size() << " bodies covering " << ephemeris.startTime << " to " << ephemeris.endTime << " s" << std::endl;
+    return 0;
 }
 
-// Function to update asteroid positions
-void updateAsteroids(std::vector<glm::vec3>& positions, const std::vector<float>& rotationSpeeds) {
-    for (size_t i = 0; i < positions.size(); ++i) {
-        float angle = atan2(positions[i].z, positions[i].x);
-        float distance = glm::length(glm::vec2(positions[i].x, positions[i].z));
-        angle += rotationSpeeds[i];
+// Function to cook every texture into the DDS cache without opening a window
+int cookTextures(const std::vector<std::string>& texturePaths) {
+    if (!createDirectory(TEXTURE_CACHE_DIRECTORY)) {
+        std::cerr << "Failed to create texture cache: " << TEXTURE_CACHE_DIRECTORY << std::endl;
+        return 1;
+    }
 
-        positions[i].x = distance * cos(angle);
-        positions[i].z = distance * sin(angle);
+    ImageDecodeQueue cookQueue(decodeImageFile);
+    for (const std::string& path : texturePaths) {
+        bool isNew;
+        size_t entry = textureManager.acquire(path, isNew);
+        if (isNew)
+            cookQueue.submit(entry, path);
     }
+    cookQueue.waitForAll();
+
+    int failures = 0;
+    DecodedImage image;
+    while (cookQueue.poll(image)) {
+        if (image.shared) {
+            std::cout << image.path << ": same contents as another texture" << std::endl;
+            continue;
+        }
+        if (!image.decoded || image.compressed.empty()) {
+            std::cerr << "Failed to cook texture: " << image.path << std::endl;
+            ++failures;
+            continue;
+        }
+        std::cout << image.path << ": " << image.width << "x" << image.height << (image.pixels ? " cooked" : " already cached")
+            << " in " << image.decodeMilliseconds << " ms, " << image.compressed.size() << " bytes" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
 }
 
-// Function to render asteroids
-void renderAsteroids(GLuint shader, GLuint modelLoc, GLuint sphereVao, const std::vector<unsigned int>& sphereIndices, GLuint asteroidTexture, const std::vector<glm::vec3>& positions, const std::vector<float>& sizes) {
-    glBindTexture(GL_TEXTURE_2D, asteroidTexture);
-
-    for (size_t i = 0; i < positions.size(); ++i) {
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
-        model = glm::scale(model, glm::vec3(sizes[i]));
+// Function to cut every texture into a virtual texture file, which the app then samples in
+// tiles instead of the ordinary texture
+int buildVirtualTextures(const std::vector<std::string>& texturePaths) {
+    if (!createDirectory(VIRTUAL_TEXTURE_DIRECTORY)) {
+        std::cerr << "Failed to create virtual texture directory: " << VIRTUAL_TEXTURE_DIRECTORY << std::endl;
+        return 1;
+    }
 
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    int failures = 0;
+    std::set<std::string> built;
+    for (const std::string& path : texturePaths) {
+        if (!built.insert(path).second)
+            continue;
+        auto buildStart = std::chrono::steady_clock::now();
+        int width, height, channels;
+        unsigned char* pixels = SOIL_load_image(path.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+        if (pixels == nullptr) {
+            std::cerr << "Failed to load texture: " << path << std::endl;
+            ++failures;
+            continue;
+        }
+        flipImageRows(pixels, width, height, channels);
+        std::string outputPath = virtualTexturePath(VIRTUAL_TEXTURE_DIRECTORY, path);
+        bool written = writeVirtualTexture(outputPath, pixels, width, height, channels);
+        SOIL_free_image_data(pixels);
+        if (!written) {
+            std::cerr << "Failed to write virtual texture: " << outputPath << std::endl;
+            ++failures;
+            continue;
+        }
+        std::vector<VirtualLevel> levels = virtualLevels(width, height);
+        std::cout << outputPath << ": " << width << "x" << height << ", " << levels.size() << " levels, " << levels.back().firstTile + 1
+            << " tiles in " << millisecondsSince(buildStart) << " ms" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
 
-        glBindVertexArray(sphereVao);
-        glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
+// Function to build the asset pack from the textures, the shader and the sphere mesh
+int packAssets(const std::string& outputPath, const std::vector<std::string>& texturePaths) {
+    if (!createDirectory(TEXTURE_CACHE_DIRECTORY)) {
+        std::cerr << "Failed to create texture cache: " << TEXTURE_CACHE_DIRECTORY << std::endl;
+        return 1;
     }
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-}
+    // Textures are cooked through the DDS cache. Plain indices are submitted rather than
+    // TextureManager ids, so identical files are not merged here; the pack shares their blob.
+    std::vector<AssetPackInput> assets(texturePaths.size());
+    ImageDecodeQueue packQueue(decodeImageFile);
+    for (size_t i = 0; i < texturePaths.size(); ++i)
+        packQueue.submit(i, texturePaths[i]);
+    packQueue.waitForAll();
+
+    DecodedImage image;
+    while (packQueue.poll(image)) {
+        CookedTextureInfo info;
+        if (!image.decoded || !readCookedTextureInfo(image.compressed, info)) {
+            std::cerr << "Failed to pack texture: " << image.path << std::endl;
+            return 1;
+        }
 
-// Function to generate asteroid positions and speeds for Saturn's ring
-void generateRingAsteroids(std::vector<glm::vec3>& positions, std::vector<float>& sizes, std::vector<float>& orbitSpeeds) {
-    srand(static_cast<unsigned int>(time(0))); // Seed for random number generation
+        // The mip chain without the DDS header
+        AssetPackInput& texture = assets[image.index];
+        texture = makeAssetInput(image.path, ASSET_TEXTURE);
+        if (!stampAssetSource(texture.entry)) {
+            std::cerr << "Failed to pack texture: " << image.path << std::endl;
+            return 1;
+        }
+        texture.entry.format = info.alpha ? ASSET_FORMAT_DXT5 : ASSET_FORMAT_DXT1;
+        texture.entry.width = info.width;
+        texture.entry.height = info.height;
+        texture.entry.mipLevels = info.mipLevels;
+        texture.entry.contentHash = image.contentHash;
+        texture.data.assign(image.compressed.end() - info.dataBytes, image.compressed.end());
+    }
 
-    for (int i = 0; i < NUM_RING_ASTEROIDS; ++i) {
-        float angle = randomFloat(0.0f, 2.0f * M_PI);
-        float distance = randomFloat(RING_INNER_RADIUS, RING_OUTER_RADIUS);
-        float x = distance * cos(angle);
-        float z = distance * sin(angle);
-        float y = randomFloat(-0.01f, 0.01f); // Small vertical variation for thickness
+    // The shader files and everything they include, each once
+    std::vector<std::string> shaderFiles;
+    for (const char* shaderPath : { SHADER_PATH, FEEDBACK_SHADER_PATH }) {
+        PreprocessedShader source;
+        std::string error;
+        auto reader = [](const std::string& file, std::string& text) {
+            std::vector<unsigned char> bytes;
+            if (!readFileBytes(file, bytes))
+                return false;
+            text.assign(bytes.begin(), bytes.end());
+            return true;
+        };
+        if (!preprocessShader(shaderPath, {}, reader, source, error)) {
+            std::cerr << "Failed to read shader: " << error << std::endl;
+            return 1;
+        }
+        for (const std::string& file : source.files) {
+            if (std::find(shaderFiles.begin(), shaderFiles.end(), file) == shaderFiles.end())
+                shaderFiles.push_back(file);
+        }
+    }
+    for (const std::string& shaderFile : shaderFiles) {
+        AssetPackInput shader = makeAssetInput(shaderFile, ASSET_SHADER);
+        stampAssetSource(shader.entry);
+        readFileBytes(shaderFile, shader.data); // Already read once by the preprocessor
+        assets.push_back(shader);
+    }
 
-        positions.push_back(glm::vec3(x, y, z));
-        sizes.push_back(randomFloat(RING_ASTEROID_MIN_RADIUS, RING_ASTEROID_MAX_RADIUS));
-        orbitSpeeds.push_back(randomFloat(RING_ASTEROID_MIN_ORBIT_SPEED, RING_ASTEROID_MAX_ORBIT_SPEED));
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    generateSphere(SPHERE_RADIUS, SPHERE_RINGS, SPHERE_SECTORS, vertices, indices);
+    AssetPackInput sphere = makeAssetInput(SPHERE_MESH_NAME, ASSET_MESH);
+    sphere.entry.vertexStride = 8 * sizeof(float);
+    sphere.entry.vertexCount = uint32_t(vertices.size() / 8);
+    sphere.entry.indexCount = uint32_t(indices.size());
+    const unsigned char* vertexBytes = reinterpret_cast<const unsigned char*>(vertices.data());
+    const unsigned char* indexBytes = reinterpret_cast<const unsigned char*>(indices.data());
+    sphere.data.assign(vertexBytes, vertexBytes + vertices.size() * sizeof(float));
+    sphere.data.insert(sphere.data.end(), indexBytes, indexBytes + indices.size() * sizeof(unsigned int));
+    assets.push_back(sphere);
+
+    if (!writeAssetPack(outputPath, assets)) {
+        std::cerr << "Failed to write asset pack: " << outputPath << std::endl;
+        return 1;
     }
+    std::cout << "Packed " << assets.size() << " assets into " << outputPath << std::endl;
+    return 0;
 }
 
-// Function to render Saturn's ring asteroids
-void renderSaturnRingAsteroids(GLuint shader, GLuint modelLoc, GLuint sphereVao, const std::vector<unsigned int>& sphereIndices, GLuint asteroidTexture, const std::vector<glm::vec3>& positions, const std::vector<float>& sizes, float saturnX, float saturnZ) {
-    glBindTexture(GL_TEXTURE_2D, asteroidTexture);
-
-    for (size_t i = 0; i < positions.size(); ++i) {
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(saturnX, 0.0f, saturnZ) + positions[i]);
-        model = glm::scale(model, glm::vec3(sizes[i]));
+// Function to render a population of small bodies at their camera-relative positions
+template<typename Population>
+void renderPopulation(GLuint sphereVao, GLsizei sphereIndexCount, EcsWorld& world, const RelativePositions& positions) {
+    GLuint shader = useShader(SHADER_PATH, LIT_PERMUTATION);
+    if (shader == 0)
+        return;
+    GLint modelLoc = glGetUniformLocation(shader, "model");
+    glBindVertexArray(sphereVao);
+    GLuint boundTexture = 0;
+
+    world.forEach<Population, StateSlot, Appearance>([&](size_t count, const Entity*, Population*, StateSlot* slot, Appearance* appearance) {
+        for (size_t i = 0; i < count; ++i) {
+            GLuint texture = textureIds[appearance[i].texture];
+            if (texture != boundTexture) {
+                glBindTexture(GL_TEXTURE_2D, texture);
+                boundTexture = texture;
+            }
 
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[slot[i].index]);
+            model = glm::scale(model, glm::vec3(appearance[i].radius));
 
-        glBindVertexArray(sphereVao);
-        glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
-    }
+            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+            glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+        }
+    });
 
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-// Function to rotate a point around the Y-axis
-glm::vec3 rotateAroundYAxis(const glm::vec3& point, float angle) {
-    glm::mat4 rotationMatrix = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
-    glm::vec4 rotatedPoint = rotationMatrix * glm::vec4(point, 1.0f);
-    return glm::vec3(rotatedPoint);
-}
+int main(int argc, char** argv)
+{
+    // Startup is timed from here to the first frame and to the last texture upload, and phase by
+    // phase up to the first frame
+    auto processStart = std::chrono::steady_clock::now();
+    StartupProfiler startup;
+
+    // Headless benchmarks
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--benchmark-nbody")
+            return runNBodyBenchmark();
+        if (std::string(argv[i]) == "--benchmark-spatial-hash")
+            return runSpatialHashBenchmark();
+        if (std::string(argv[i]) == "--benchmark-simulation")
+            return runSimulationBenchmark(i + 1 < argc ? atoi(argv[i + 1]) : SIMULATION_BENCHMARK_TICKS);
+    }
 
-// Update asteroid positions to simulate orbiting
-void updateAsteroidPositions(std::vector<glm::vec3>& positions, const std::vector<float>& orbitSpeeds, float deltaTime) {
-    for (size_t i = 0; i < positions.size(); ++i) {
-        float angle = orbitSpeeds[i] * deltaTime; // Calculate rotation angle based on individual speed and time
-        positions[i] = rotateAroundYAxis(positions[i], angle);
+    // Load the bodies and generate the belt and ring; the offline tools do not need the ephemeris file
+    bool offlineTool = argc >= 2 && (std::string(argv[1]) == "--generate-ephemeris" || std::string(argv[1]) == "--import-ephemeris" ||
+        std::string(argv[1]) == "--cook-textures" || std::string(argv[1]) == "--pack-assets" || std::string(argv[1]) == "--build-virtual-textures");
+    SolarSystemSettings solarSystemSettings;
+    if (offlineTool)
+        solarSystemSettings.ephemerisPath.clear();
+
+    // Input recording and replay; both fix the belt seed so the replay sees the same scene.
+    // Without a file, a replay runs the standard flythrough.
+    InputRecording recording;
+    std::string recordPath;
+    bool benchmarkReplay = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        bool hasPath = i + 1 < argc && argv[i + 1][0] != '-';
+        if (argument == "--record" && hasPath)
+            recordPath = argv[i + 1];
+        if (argument == "--replay" || argument == "--benchmark-replay") {
+            if (!hasPath)
+                makeStandardFlythrough(recording);
+            else if (!loadRecording(argv[i + 1], recording))
+                return -1;
+            replayActive = !recording.frames.empty();
+            benchmarkReplay = argument == "--benchmark-replay";
+        }
+    }
+    if (replayActive || !recordPath.empty())
+        solarSystemSettings.seed = recording.seed;
+
+    // Startup profile: a JSON copy of the report, and budgets that end the run after the first
+    // frame, with a non-zero exit code if any phase went over its budget
+    std::string startupReportPath;
+    std::map<std::string, double> startupBudgets;
+    bool checkStartupBudgets = false;
+    bool startupOverBudget = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        bool hasPath = i + 1 < argc && argv[i + 1][0] != '-';
+        if (argument == "--startup-report" && hasPath)
+            startupReportPath = argv[i + 1];
+        if (argument == "--startup-budget") {
+            if (!readStartupBudget(hasPath ? argv[i + 1] : STARTUP_BUDGET_PATH, startupBudgets))
+                return 1;
+            checkStartupBudgets = true;
+        }
+    }
+    solarSystemSettings.profiler = &startup;
+
+    // --restore resumes from a snapshot instead of generating a new system
+    SolarSystem solarSystem;
+    SimulationClock simulationClock;
+    if (argc >= 3 && std::string(argv[1]) == "--restore") {
+        ScopedStartupPhase phase(&startup, "restore-snapshot");
+        if (!loadSnapshot(argv[2], solarSystemSettings.ephemerisPath, solarSystem, simulationClock))
+            return -1;
+    }
+    else if (!createSolarSystem(solarSystemSettings, solarSystem))
+        return -1;
+    EcsWorld& world = solarSystem.world;
+    const KeplerBatch& planetOrbits = solarSystem.planetOrbits;
+
+    // Offline ephemeris tools
+    if (argc >= 2 && std::string(argv[1]) == "--generate-ephemeris") {
+        Ephemeris ephemeris;
+        buildPlanetEphemeris(planetOrbits, ephemeris);
+        std::string outputPath = argc >= 3 ? argv[2] : PLANET_EPHEMERIS_PATH;
+        if (!writeEphemeris(outputPath, ephemeris)) {
+            std::cerr << "Failed to write ephemeris: " << outputPath << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << ephemeris.storage.size() << " coefficients to " << outputPath << std::endl;
+        return 0;
+    }
+    if (argc >= 4 && std::string(argv[1]) == "--import-ephemeris")
+        return importPlanetEphemeris(argv[2], std::vector<std::string>(argv + 3, argv + argc), solarSystem.referenceRadius, solarSystem.referenceMeanMotion);
+
+    // Offline texture cooker; the app also cooks missing textures as it loads them
+    if (argc >= 2 && std::string(argv[1]) == "--cook-textures")
+        return cookTextures(solarSystem.catalog.texturePaths);
+    if (argc >= 2 && std::string(argv[1]) == "--pack-assets")
+        return packAssets(argc >= 3 ? argv[2] : ASSET_PACK_PATH, solarSystem.catalog.texturePaths);
+    if (argc >= 2 && std::string(argv[1]) == "--build-virtual-textures")
+        return buildVirtualTextures(solarSystem.catalog.texturePaths);
+
+    // One mapping for the textures, shader and sphere mesh; without it they load from their own files
+    // A pack older than the files it was built from is rebuilt; if that fails, the changed files
+    // are read on their own and the rest still come from the old pack
+    startup.begin("asset-pack");
+    if (assetPack.open(ASSET_PACK_PATH)) {
+        std::vector<std::string> stale = assetPack.staleAssets();
+        if (!stale.empty()) {
+            std::cout << "Rebuilding " << ASSET_PACK_PATH << ": " << stale.size() << " source files changed, such as " << stale.front() << std::endl;
+            assetPack.close();
+            if (packAssets(ASSET_PACK_PATH, solarSystem.catalog.texturePaths) == 0 && assetPack.open(ASSET_PACK_PATH))
+                stale = assetPack.staleAssets();
+            else
+                assetPack.open(ASSET_PACK_PATH);
+            assetsChangedOnDisk.insert(stale.begin(), stale.end());
+        }
+        if (assetPack.isOpen())
+            std::cout << "Loading assets from " << ASSET_PACK_PATH << std::endl;
+    }
+    startup.end();
+
+    // GPU memory for the streamed mip levels of the compressed textures, and texture data
+    // uploaded per frame
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--texture-budget")
+            textureBudgetMiB = std::max(atoi(argv[i + 1]), 1);
+        if (std::string(argv[i]) == "--upload-budget")
+            uploadBudgetMiB = std::max(atoi(argv[i + 1]), 1);
     }
-}
 
-int main(void)
-{
     GLFWwindow* window;
 
     /* Initialize the library */
+    startup.begin("glfw-init");
     if (!glfwInit())
         return -1;
 
     /* Create a windowed mode window and its OpenGL context */
+    startup.begin("window");
     window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE.c_str(), NULL, NULL);
     if (!window)
     {
@@ -609,13 +1844,21 @@ int main(void)
 
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(benchmarkReplay ? 0 : 1); // The replay benchmark measures frames without waiting for vsync
 
+    startup.begin("glew-init");
     if (glewInit() != GLEW_OK)
         std::cout << "Failed to initialize GLEW" << std::endl;
 
 	std::cout << glGetString(GL_VERSION) << std::endl;
 
+    // Let the driver compile on as many threads as it likes, so programs submitted together build at once
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    parallelShaderCompile = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+
     // Set the window resize callback
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
@@ -631,10 +1874,28 @@ int main(void)
     // Setup initial viewport size
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
-    // Create sphere
+    // Create sphere, taking the prebuilt buffers straight from the asset pack when it has them
+    startup.begin("sphere-mesh");
     std::vector<float> sphereVertices;
     std::vector<unsigned int> sphereIndices;
-    generateSphere(0.5f, 20, 20, sphereVertices, sphereIndices);
+    const void* sphereVertexData;
+    const void* sphereIndexData;
+    size_t sphereVertexBytes;
+    GLsizei sphereIndexCount;
+    const AssetEntry* sphereMesh = assetPack.find(SPHERE_MESH_NAME, ASSET_MESH);
+    if (sphereMesh != nullptr && sphereMesh->vertexStride == 8 * sizeof(float)) {
+        sphereVertexData = assetPack.data(*sphereMesh);
+        sphereVertexBytes = size_t(sphereMesh->vertexCount) * sphereMesh->vertexStride;
+        sphereIndexData = assetPack.data(*sphereMesh) + sphereVertexBytes;
+        sphereIndexCount = GLsizei(sphereMesh->indexCount);
+    }
+    else {
+        generateSphere(SPHERE_RADIUS, SPHERE_RINGS, SPHERE_SECTORS, sphereVertices, sphereIndices);
+        sphereVertexData = sphereVertices.data();
+        sphereVertexBytes = sphereVertices.size() * sizeof(float);
+        sphereIndexData = sphereIndices.data();
+        sphereIndexCount = GLsizei(sphereIndices.size());
+    }
 
     unsigned int sphereVao, sphereVbo, sphereIbo;
     glGenVertexArrays(1, &sphereVao);
@@ -643,12 +1904,12 @@ int main(void)
     // Vertex Buffer Object
     glGenBuffers(1, &sphereVbo);
     glBindBuffer(GL_ARRAY_BUFFER, sphereVbo);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(float), sphereVertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sphereVertexBytes, sphereVertexData, GL_STATIC_DRAW);
 
     // Element Buffer Object
     glGenBuffers(1, &sphereIbo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereIbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), sphereIndices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndexCount * sizeof(unsigned int), sphereIndexData, GL_STATIC_DRAW);
 
     // Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (const void*)0); // Position
@@ -671,37 +1932,35 @@ int main(void)
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 6, (void*)(sizeof(float) * 3)); // Normal
     glEnableVertexAttribArray(1);
 
-	// Load shaders
-    ShaderProgramSource source = ParseShader("res/shaders/Basic.shader");
-    std::cout << "VERTEX SHADERS" << std::endl;
-    std::cout << source.VertexSource << std::endl;
-    std::cout << "FRAGMENT SHADERS" << std::endl;
-	std::cout << source.FragmentSource << std::endl;
-
-    unsigned int shader = CreateShader(source.VertexSource, source.FragmentSource);
-    glUseProgram(shader);
-
-    // Define the model matrices for the cube and the sphere
-    glm::mat4 modelCube = glm::translate(glm::mat4(1.0f), glm::vec3(-0.75f, 0.0f, 0.0f)); // Move the cube to the left
-    glm::mat4 modelSphere = glm::translate(glm::mat4(1.0f), glm::vec3(0.75f, 0.0f, 0.0f)); // Move the sphere to the right
-
-    // Define the view and projection matrices
-    // Use camera position and front vector for view matrix
-    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 model = glm::mat4(1.0f); // Identity matrix for the model
-
-    // Get uniform locations
-    int modelLoc = glGetUniformLocation(shader, "model");
-    int viewLoc = glGetUniformLocation(shader, "view");
-    int projLoc = glGetUniformLocation(shader, "projection");
+	// Load shaders: every program the renderer draws with is submitted now and built while the rest
+    // of startup runs. Warm starts load the programs the driver linked on an earlier run.
+    startup.begin("shader-submit");
+    auto programsStart = std::chrono::steady_clock::now();
+    for (const ShaderPermutation& permutation : { LIT_PERMUTATION, LIT_VIRTUAL_PERMUTATION, EMISSIVE_PERMUTATION, EMISSIVE_VIRTUAL_PERMUTATION, LINE_PERMUTATION })
+        shaderProgram(SHADER_PATH, permutation);
+    shaderProgram(FEEDBACK_SHADER_PATH, DEFAULT_PERMUTATION);
+    size_t startupPrograms = programBuilds.size();
+    startup.end();
 
     glEnable(GL_DEPTH_TEST);
 
-    loadTextures();
+    // Decode the textures in parallel while the first frames render with placeholders
+    startup.begin("textures");
+    createUploadBuffer();
+    ImageDecodeQueue textureDecodeQueue(decodeImageFile);
+    loadTextures(solarSystem.catalog.texturePaths, textureDecodeQueue);
+    startup.begin("virtual-textures");
+    createVirtualTextureCache();
+    ImageDecodeQueue virtualTileQueue(loadVirtualTile);
+    loadVirtualTextures(solarSystem.catalog.texturePaths, virtualTileQueue);
+    startup.begin("file-watcher");
+    if (!assetWatcher.start({ "res", "textures" }, { TEXTURE_CACHE_DIRECTORY, VIRTUAL_TEXTURE_DIRECTORY, PROGRAM_CACHE_DIRECTORY }))
+        std::cerr << "Failed to watch res/ and textures/; hot reload is off" << std::endl;
+    double firstFrameMilliseconds = 0.0;
+    double texturesReadyMilliseconds = 0.0;
 
     // Setup ImGui context
+    startup.begin("imgui-init");
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -712,32 +1971,114 @@ int main(void)
     // Initialize ImGui for GLFW and OpenGL3
     ImGui_ImplGlfw_InitForOpenGL(window, true);  // Your GLFW window
     ImGui_ImplOpenGL3_Init("#version 130");  // GLSL version (adjust as needed)
+    startup.end();
+
+    // The blend of the last two simulation ticks that gets rendered
+    SimulationState renderState;
 
-    // Load the asteroid texture
-    GLuint asteroidTexture = loadTexture("textures/asteroid.jpg");
+    // Camera-relative copies of the rendered positions, rebuilt every frame
+    RelativePositions relativeAsteroids, relativeRingAsteroids;
 
-    // Generate asteroid data
-    std::vector<glm::vec3> asteroidPositions;
-    std::vector<float> asteroidSizes;
-    std::vector<float> asteroidRotationSpeeds;
-    generateAsteroids(asteroidPositions, asteroidSizes, asteroidRotationSpeeds);
+    // Transform hierarchy of the sun, planets, moon and ring, posed from the rendered state
+    TransformGraph sceneGraph;
+    SceneFrames sceneFrames;
+    {
+        ScopedStartupPhase phase(&startup, "scene-graph");
+        buildSceneGraph(world, sceneGraph, sceneFrames);
+    }
+
+    FixedTimestep timestep = { SIMULATION_TIME_STEP, MAX_SIMULATION_TICKS_PER_FRAME };
+    float timeScale = float(simulationClock.timeScale); // ImGui copy of simulationClock.timeScale
+    double seekTarget = 0.0;
+    double lastSeekMilliseconds = 0.0;
+    double lastSnapshotMilliseconds = 0.0;
+    size_t replayFrame = 0;
+    std::vector<double> replayFrameMilliseconds;
+
+    // Show a loading frame until the programs are built
+    startup.begin("shader-compile");
+    while (finishProgramBuilds() > 0 && !glfwWindowShouldClose(window)) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+        ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+        ImGui::Text("Compiling shaders: %zu of %zu built", startupPrograms - programBuilds.size(), startupPrograms);
+        ImGui::End();
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    programMilliseconds = millisecondsSince(programsStart);
+    std::cout << "Shader programs built in " << programMilliseconds << " ms (" << (programsCompiled == 0 ? "warm" : "cold") << " start: "
+        << programsCompiled << " compiled, " << programsFromCache << " from the program cache; slowest " << slowestProgramMilliseconds << " ms, "
+        << (parallelShaderCompile ? "compiled in parallel" : "no parallel compilation") << ")" << std::endl;
 
-    std::vector<glm::vec3> ringAsteroidPositions;
-    std::vector<float> ringAsteroidSizes;
-    std::vector<float> ringAsteroidOrbitSpeeds;
-    generateRingAsteroids(ringAsteroidPositions, ringAsteroidSizes, ringAsteroidOrbitSpeeds);
+    startup.begin("first-frame");
+    lastFrame = glfwGetTime();
+    double firstFrame = lastFrame;
 
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window))
     {
-        float currentTime = glfwGetTime();
+        // Measure the real time since the last frame
+        double frameStart = glfwGetTime();
+        double realFrameTime = frameStart - lastFrame;
+        deltaTime = float(realFrameTime);
+        lastFrame = frameStart;
+
+        // Rebuild the shaders and reload the textures that changed on disk
+        for (const std::string& path : assetWatcher.takeChanged()) {
+            bool isShader = path.compare(0, strlen(SHADER_DIRECTORY), SHADER_DIRECTORY) == 0;
+            bool isTexture = std::find(solarSystem.catalog.texturePaths.begin(), solarSystem.catalog.texturePaths.end(), path) != solarSystem.catalog.texturePaths.end();
+            if (isShader || isTexture)
+                assetsChangedOnDisk.insert(path);
+            if (isShader) {
+                // Every permutation built from the file, or from a file including it
+                for (const auto& dependent : shaderPrograms.dependents(path))
+                    startPermutationBuild(dependent.first, dependent.second);
+            }
+            else if (isTexture)
+                reloadTexture(path, solarSystem.catalog.texturePaths, textureDecodeQueue);
+        }
+        finishProgramBuilds(); // Rebuilt programs replace the old ones once the driver has built them
+
+        // Upload the textures that finished decoding, within the frame's upload budget; the rest
+        // keep showing the placeholder
+        uploadDecodedTextures(textureDecodeQueue);
+        streamTextures();
+        loadVirtualTiles(virtualTileQueue);
+        issueTextureUploads();
+        updateVirtualIndirection();
+        if (texturesReadyMilliseconds == 0.0 && textureDecodeQueue.pending() == 0 && textureUploads.pendingCount() == 0) {
+            texturesReadyMilliseconds = millisecondsSince(processStart);
+            TextureStats textureStats = textureManager.stats();
+            std::cout << "Textures resident " << texturesReadyMilliseconds << " ms after start: " << textureStats.textures << " loaded in "
+                << textureStats.decodeMilliseconds << " ms of decoding, " << textureStats.gpuBytes / 1048576.0 << " MiB ("
+                << textureStats.uncompressedBytes / 1048576.0 << " MiB uncompressed), " << textureStats.shared << " shared saving "
+                << textureStats.savedBytes / 1048576.0 << " MiB" << std::endl;
+        }
 
         // Close window on pressing ESC
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
 
+        // A replay sets the camera and clock itself, and simulates the recorded frame time
+        if (replayActive) {
+            if (replayFrame == recording.frames.size())
+                break;
+            if (replayFrame > 0)
+                replayFrameMilliseconds.push_back(realFrameTime * 1000.0);
+            const ReplayFrame& frame = recording.frames[replayFrame++];
+            applyReplayFrame(frame, simulationClock);
+            timeScale = float(simulationClock.timeScale);
+            deltaTime = float(frame.frameTime);
+        }
+        uint32_t keys = replayActive ? 0 : heldCameraKeys(window);
+
         // Reset camera on pressing 'R'
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+        if (keys & REPLAY_KEY_RESET)
         {
             cameraPos = initialCameraPos;
             cameraYaw = initialYaw;
@@ -745,42 +2086,53 @@ int main(void)
             cameraFront = initialCameraFront;
         }
 
-        // Keyboard input for camera movement
-        float deltaTime = 0.1f;  // Can adjust or calculate based on actual time elapsed
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            cameraPos += cameraSpeed * deltaTime * cameraFront;
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            cameraPos -= cameraSpeed * deltaTime * cameraFront;
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed * deltaTime;
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed * deltaTime;
+        // Keyboard input for camera movement, scaled by the real frame time
+        float cameraStep = cameraSpeed * CAMERA_MOVE_RATE * deltaTime;
+        if (keys & REPLAY_KEY_FORWARD)
+            cameraPos += glm::dvec3(cameraStep * cameraFront);
+        if (keys & REPLAY_KEY_BACK)
+            cameraPos -= glm::dvec3(cameraStep * cameraFront);
+        if (keys & REPLAY_KEY_LEFT)
+            cameraPos -= glm::dvec3(glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraStep);
+        if (keys & REPLAY_KEY_RIGHT)
+            cameraPos += glm::dvec3(glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraStep);
+
+        if (!recordPath.empty())
+            recording.frames.push_back(recordFrame(window, frameStart - firstFrame, realFrameTime, keys, simulationClock));
+
+        // Advance the simulation in fixed ticks for the time that has passed
+        int ticks = beginFrame(timestep, deltaTime);
+        double tickLength = simulatedTickLength(simulationClock, timestep);
+        for (int tick = 0; tick < ticks && tickLength > 0.0; ++tick) {
+            solarSystem.nbodySettings.openingAngle = nbodyOpeningAngle;
+            stepSolarSystem(solarSystem, tickLength);
+        }
+
+        // Render between the last two ticks, unless time warp spreads them too far apart
+        double alpha = simulationClock.timeScale > MAX_INTERPOLATED_TIME_SCALE ? 1.0 : interpolationFactor(timestep);
+        interpolateStates(solarSystem.previousState, solarSystem.currentState, alpha, renderState);
 
         /* Render here */
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Set the uniform matrices
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Set up the locations of the shader uniforms
-        int lightColorLoc = glGetUniformLocation(shader, "lightColor");
-        int objectColorLoc = glGetUniformLocation(shader, "objectColor");
+        // Camera/View transformation; positions are already relative to the camera
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), cameraFront, cameraUp);
+        glm::mat4 projection = glm::perspective(glm::radians(FIELD_OF_VIEW), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
 
-        // Camera/View transformation
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+        // Pose the hierarchy, then move everything into camera-relative single precision before it reaches the GPU
+        updateSceneGraph(world, sceneGraph, renderState);
+        toCameraRelative(renderState.asteroidPositions, cameraPos, relativeAsteroids);
+        toCameraRelative(renderState.ringAsteroidPositions, cameraPos - worldPosition(sceneGraph, sceneFrames.ring), relativeRingAsteroids);
 
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
+        // Each program is given the view, projection and light the first time it is used this frame
+        ++frameUniforms.frame;
+        frameUniforms.view = view;
+        frameUniforms.projection = projection;
+        frameUniforms.lightPos = glm::vec3(worldPosition(sceneGraph, sceneFrames.primary) - cameraPos);
 
-        // Set the projection matrix in the shader
-        unsigned int projectionLoc = glGetUniformLocation(shader, "projection");
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Pass light and view data to the shader
-        glUniform3f(lightColorLoc, 1.0f, 1.0f, 1.0f); // White light
-        glUniform3f(objectColorLoc, 0.5f, 0.1f, 0.3f); // Object color
+        // Find the virtual texture tiles in view
+        if (virtualTexturing && !virtualTextures.empty())
+            renderVirtualFeedback(sphereVao, sphereIndexCount, world, sceneGraph, cameraPos);
 
         glActiveTexture(GL_TEXTURE0); // Activate texture unit 0
 
@@ -791,63 +2143,34 @@ int main(void)
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        // Set the alpha value for orbit lines
-        glUniform1f(glGetUniformLocation(shader, "orbitAlpha"), 0.25f);
-
-        // For orbit lines
-        glUniform1i(glGetUniformLocation(shader, "isOrbitLine"), true);
-        glUniform3f(glGetUniformLocation(shader, "orbitColor"), 1.0f, 1.0f, 1.0f); // Example: White color for orbit lines
-
-        // Rendering the sun
-        glUniform1i(glGetUniformLocation(shader, "isSun"), true);
-
-        // Set emission color to orange-ish yellow
-        glm::vec3 emissionColor = glm::vec3(1.0f, 0.65f, 0.0f); // RGB values for orange-ish yellow
-        float emissionStrength = 0.10f; // Adjust strength based on desired brightness
-
-        int emissionColorLoc = glGetUniformLocation(shader, "emissionColor");
-        int emissionStrengthLoc = glGetUniformLocation(shader, "emissionStrength");
-
-        glUniform3fv(emissionColorLoc, 1, glm::value_ptr(emissionColor));
-        glUniform1f(emissionStrengthLoc, emissionStrength);
-
-        // Rendering the planets
-        glUniform1i(glGetUniformLocation(shader, "isSun"), false);
+        // Orbit lines are unlit, in the line permutation
+        bool drawOrbits = useShader(SHADER_PATH, LINE_PERMUTATION) != 0;
 
         // Draw orbits for each planet
-        for (int i = 1; i < positions.size(); i++) {  // Start from 1 to skip the Sun
+        for (size_t i = 0; i < planetOrbits.size() && drawOrbits; i++) {
+            if (planetOrbits.semiMajorAxis[i] <= 0.0)
+                continue; // The sun does not orbit
             glColor3f(1.0f, 1.0f, 1.0f); // Set orbit color (white)
-            drawOrbit(orbitalRadii[i], 100); // 100 segments for smoothness
+            drawOrbit(planetOrbits, i, 100, sceneGraph.world[sceneFrames.primary], cameraPos); // 100 segments for smoothness
         }
 
-        // Calculate Earth's position
-        float earthAngle = angularVelocities[3] * currentTime;
-        float earthX = orbitalRadii[3] * cos(earthAngle);
-        float earthZ = orbitalRadii[3] * sin(earthAngle);
-
-        // Draw the moon's orbit around the Earth
-        glColor3f(0.5f, 0.5f, 0.5f); // Set orbit color (gray)
-        drawMoonOrbit(earthX, earthZ, moonOrbitRadius, 100); // 100 segments for smoothness
+        // Draw each moon's orbit around its parent
+        world.forEach<Satellite>([&](size_t count, const Entity*, Satellite* satellite) {
+            for (size_t i = 0; i < count && drawOrbits; ++i) {
+                glColor3f(0.5f, 0.5f, 0.5f); // Set orbit color (gray)
+                const glm::dmat4& parentWorld = sceneGraph.world[world.get<SceneNode>(satellite[i].parent)->frame];
+                drawMoonOrbit(parentWorld, satellite[i].orbitRadius, 100, cameraPos); // 100 segments for smoothness
+            }
+        });
 
         // For textured objects
-        glUniform1i(glGetUniformLocation(shader, "isOrbitLine"), false);
-        renderSpheres(shader, modelLoc, sphereVao, sphereIndices);
-
-        // Calculate Saturn's position
-        float saturnAngle = angularVelocities[6] * currentTime;
-        float saturnX = orbitalRadii[6] * cos(saturnAngle);
-        float saturnZ = orbitalRadii[6] * sin(saturnAngle);
+        renderSpheres(sphereVao, sphereIndexCount, world, sceneGraph, sceneFrames.primary, cameraPos);
 
-        // Update positions
-        updateAsteroidPositions(ringAsteroidPositions, ringAsteroidOrbitSpeeds, deltaTime);
-
-        renderSaturnRingAsteroids(shader, modelLoc, sphereVao, sphereIndices, asteroidTexture, ringAsteroidPositions, ringAsteroidSizes, saturnX, saturnZ);
-
-        // Update asteroid positions
-        updateAsteroids(asteroidPositions, asteroidRotationSpeeds);
+        // Render Saturn's ring
+        renderPopulation<RingParticle>(sphereVao, sphereIndexCount, world, relativeRingAsteroids);
 
         // Render the asteroid belt
-        renderAsteroids(shader, modelLoc, sphereVao, sphereIndices, asteroidTexture, asteroidPositions, asteroidSizes);
+        renderPopulation<BeltAsteroid>(sphereVao, sphereIndexCount, world, relativeAsteroids);
 
         // Start the ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -886,6 +2209,82 @@ int main(void)
         ImGui::SliderFloat("Camera Speed", &cameraSpeed, 0.1f, 5.0f, "Speed: %.1f");
         ImGui::End();
 
+        // Simulation mode control
+        ImGui::Begin("Simulation", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+        ImGui::Checkbox("N-body gravity", &solarSystem.nbodyEnabled);
+        ImGui::SliderFloat("Opening angle", &nbodyOpeningAngle, 0.1f, float(MAX_OPENING_ANGLE), "%.2f");
+        ImGui::Text("Frame time: %.2f ms, ticks this frame: %d", deltaTime * 1000.0f, timestep.ticksThisFrame);
+        ImGui::Text("Startup: first frame %.0f ms, textures %.0f ms (%zu decode threads)", firstFrameMilliseconds, texturesReadyMilliseconds, parallelThreadCount());
+        ImGui::Text("Shader programs: %zu permutations in %.1f ms (slowest %.1f ms%s), %zu compiled, %zu from the program cache", shaderPrograms.size(),
+            programMilliseconds, slowestProgramMilliseconds, parallelShaderCompile ? ", in parallel" : "", programsCompiled, programsFromCache);
+        TextureStats textureStats = textureManager.stats();
+        ImGui::Text("Textures: %zu loaded in %.0f ms of decoding, %zu shared", textureStats.textures, textureStats.decodeMilliseconds, textureStats.shared);
+        ImGui::Text("Texture memory: %.1f MiB (%.1f MiB uncompressed, %.1f MiB saved by sharing)",
+            textureStats.gpuBytes / 1048576.0, textureStats.uncompressedBytes / 1048576.0, textureStats.savedBytes / 1048576.0);
+        ImGui::Text("Streamed mip levels: %.1f of %d MiB", textureStreamer.residentBytes() / 1048576.0, textureBudgetMiB);
+        ImGui::SliderInt("Texture budget (MiB)", &textureBudgetMiB, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+        ImGui::Text("Uploads: %zu queued (%.1f MiB), %.2f MiB this frame, %s", textureUploads.pendingCount(), textureUploads.pendingBytes() / 1048576.0,
+            uploadedBytesThisFrame / 1048576.0, uploadBuffer != 0 ? "staged" : "from client memory");
+        ImGui::SliderInt("Upload budget (MiB/frame)", &uploadBudgetMiB, 1, 64, "%d", ImGuiSliderFlags_Logarithmic);
+        ImGui::Checkbox("Virtual textures", &virtualTexturing);
+        ImGui::SameLine();
+        ImGui::Text("%zu open, tiles: %zu of %d resident, %zu loading", virtualTextures.size(), virtualTiles.residentCount(),
+            VIRTUAL_CACHE_SLOTS * VIRTUAL_CACHE_SLOTS, virtualTiles.loadingCount());
+        if (reloadCount > 0)
+            ImGui::Text("Hot reloads: %zu, last %s in %.1f ms", reloadCount, lastReloadPath.c_str(), lastReloadMilliseconds);
+        else
+            ImGui::Text("Hot reload: %s", assetWatcher.isWatching() ? "watching res/ and textures/" : "off");
+        ImGui::Text("Simulation time: %.2f s, dropped: %.2f s", solarSystem.currentState.time, timestep.droppedTime);
+        ImGui::Text("Planet positions: %s", solarSystem.nbodyRunning ? "N-body" : solarSystem.planetEphemeris.covers(solarSystem.currentState.time) ? "ephemeris" : "Kepler");
+
+        // Time warp and seek
+        ImGui::Checkbox("Paused", &simulationClock.paused);
+        ImGui::SliderFloat("Time scale", &timeScale, 1.0f, float(MAX_TIME_SCALE), "%.0fx", ImGuiSliderFlags_Logarithmic);
+        simulationClock.timeScale = timeScale;
+        ImGui::InputDouble("Seek time (s)", &seekTarget, 100.0, 10000.0, "%.1f");
+        if (ImGui::Button("Seek")) {
+            // Jump straight to the target by evaluating every orbit there; the N-body mode restarts from it
+            double seekStart = glfwGetTime();
+            seekSolarSystem(solarSystem, seekTarget);
+            lastSeekMilliseconds = (glfwGetTime() - seekStart) * 1000.0;
+        }
+        ImGui::SameLine();
+        ImGui::Text("last seek: %.2f ms", lastSeekMilliseconds);
+
+        // Snapshots of the whole simulation; a restore maps the file and uses it in place
+        if (ImGui::Button("Save snapshot"))
+            writeSnapshot(SNAPSHOT_PATH, solarSystem, simulationClock);
+        ImGui::SameLine();
+        if (ImGui::Button("Load snapshot")) {
+            double loadStart = glfwGetTime();
+            std::vector<std::string> texturePaths = solarSystem.catalog.texturePaths;
+            if (loadSnapshot(SNAPSHOT_PATH, solarSystemSettings.ephemerisPath, solarSystem, simulationClock)) {
+                if (solarSystem.catalog.texturePaths != texturePaths) {
+                    loadTextures(solarSystem.catalog.texturePaths, textureDecodeQueue);
+                    loadVirtualTextures(solarSystem.catalog.texturePaths, virtualTileQueue);
+                }
+                sceneGraph = TransformGraph();
+                buildSceneGraph(world, sceneGraph, sceneFrames);
+                timeScale = float(simulationClock.timeScale);
+            }
+            lastSnapshotMilliseconds = (glfwGetTime() - loadStart) * 1000.0;
+        }
+        ImGui::SameLine();
+        ImGui::Text("last load: %.2f ms", lastSnapshotMilliseconds);
+        if (solarSystem.nbodyRunning) {
+            ImGui::Text("Tree build: %.2f ms, forces: %.2f ms", solarSystem.nbodyTimings.treeBuild, solarSystem.nbodyTimings.forces);
+            ImGui::Text("Energy: %.6e", totalEnergy(solarSystem.nbodyState));
+        }
+        ImGui::Text("Touching asteroids: %zu in the belt, %zu in the ring", solarSystem.beltCollisions.size(), solarSystem.ringCollisions.size());
+        uint32_t nearestAsteroid;
+        double nearestDistance;
+        if (findNearest(solarSystem.beltHash, cameraPos, NEAREST_ASTEROID_RANGE, nearestAsteroid, nearestDistance))
+            ImGui::Text("Nearest asteroid: #%u, %.3f away", nearestAsteroid, nearestDistance);
+        else
+            ImGui::Text("Nearest asteroid: none within %.1f", NEAREST_ASTEROID_RANGE);
+        ImGui::Text("Entities: %zu in %zu archetypes, %zu chunks", world.entityCount(), world.archetypeCount(), world.chunkCount());
+        ImGui::End();
+
         // Mouse sensitivity control
         ImGui::Begin("Mouse Sensitivity", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
         ImGui::SliderFloat("Mouse Sensitivity", &mouseSensitivity, 0.1f, 5.0f, "Speed: %.1f");
@@ -898,9 +2297,35 @@ int main(void)
         // Swap buffers and poll IO
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrameMilliseconds == 0.0) {
+            firstFrameMilliseconds = millisecondsSince(processStart);
+            std::cout << "First frame " << firstFrameMilliseconds << " ms after start" << std::endl;
+
+            startup.end();
+            std::cout << "Startup phases:" << std::endl << startup.report();
+            if (!startupReportPath.empty()) {
+                std::ofstream report(startupReportPath);
+                if (!(report << startup.json()))
+                    std::cerr << "Failed to write startup report: " << startupReportPath << std::endl;
+            }
+            if (checkStartupBudgets) {
+                std::vector<std::string> overruns;
+                startupOverBudget = !checkStartupBudget(startup, startupBudgets, overruns);
+                for (const std::string& overrun : overruns)
+                    std::cerr << "Startup budget exceeded: " << overrun << std::endl;
+                std::cout << "Startup " << (startupOverBudget ? "over" : "within") << " budget" << std::endl;
+                break;
+            }
+        }
     }
 
-    glDeleteProgram(shader);
+    assetWatcher.stop();
+    for (const ProgramBuild& build : programBuilds)
+        glDeleteProgram(build.program);
+    programBuilds.clear();
+    for (GLuint program : shaderPrograms.clear())
+        glDeleteProgram(program);
     glDeleteVertexArrays(1, &sphereVao);
     glDeleteBuffers(1, &sphereVbo);
     glDeleteBuffers(1, &sphereIbo);
@@ -909,5 +2334,16 @@ int main(void)
     ImGui::DestroyContext();
 
     glfwTerminate();
-    return 0;
+
+    if (!recordPath.empty() && !writeRecording(recordPath, recording)) {
+        std::cerr << "Failed to write recording: " << recordPath << std::endl;
+        return 1;
+    }
+
+    if (benchmarkReplay) {
+        FrameTimeStats stats = frameTimeStats(replayFrameMilliseconds);
+        std::cout << "Replay: " << stats.frames << " frames, mean " << stats.mean << " ms, p50 " << stats.p50 << " ms, p95 " << stats.p95
+                  << " ms, p99 " << stats.p99 << " ms, max " << stats.max << " ms" << std::endl;
+    }
+    return startupOverBudget ? 1 : 0;
 }
\ No newline at end of file
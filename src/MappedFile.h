@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Memory mapping of a whole file (mmap on POSIX, file mappings on Windows). Mappings are read-only,
+// or copy-on-write when asked: pages written through writableData() become private to the process
+// and never reach the file.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Function to map a file, replacing any previous mapping. Returns false if it cannot be opened.
+    bool open(const std::string& filePath, bool copyOnWrite = false);
+
+    // Function to unmap the file
+    void close();
+
+    const unsigned char* data() const { return view; }
+    unsigned char* writableData() const { return copyOnWrite ? view : nullptr; }
+    size_t size() const { return length; }
+    bool isOpen() const { return view != nullptr; }
+
+private:
+    unsigned char* view = nullptr;
+    size_t length = 0;
+    bool copyOnWrite = false;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,214 @@
+#include "MipChain.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+// Output texels a worker takes at a time, so small levels stay on one thread
+const size_t MIP_CHAIN_CHUNK_TEXELS = 16384;
+
+// Entries in the linear to sRGB table; fine enough that dark values keep every 8-bit step
+const int LINEAR_TO_SRGB_STEPS = 4096;
+
+// Function to get the sRGB to linear table for 8-bit values
+static const float* srgbToLinearTable()
+{
+    static const std::vector<float> table = []()
+    {
+        std::vector<float> values(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            double srgb = i / 255.0;
+            values[i] = float(srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4));
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Function to get the linear to 8-bit sRGB table, indexed by linear * (LINEAR_TO_SRGB_STEPS - 1)
+static const unsigned char* linearToSrgbTable()
+{
+    static const std::vector<unsigned char> table = []()
+    {
+        std::vector<unsigned char> values(LINEAR_TO_SRGB_STEPS);
+        for (int i = 0; i < LINEAR_TO_SRGB_STEPS; ++i)
+        {
+            double linear = double(i) / (LINEAR_TO_SRGB_STEPS - 1);
+            double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            values[i] = static_cast<unsigned char>(std::lround(std::min(std::max(srgb, 0.0), 1.0) * 255.0));
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// Function to expand a row of 8-bit texels to four linear floats each; unused lanes are zero
+static void decodeRow(const unsigned char* row, int width, int channels, float* linear)
+{
+    const float* toLinear = srgbToLinearTable();
+    bool alpha = channels % 2 == 0;
+    int colourChannels = alpha ? channels - 1 : channels;
+    for (int x = 0; x < width; ++x, row += channels, linear += 4)
+    {
+        linear[0] = linear[1] = linear[2] = linear[3] = 0.0f;
+        for (int c = 0; c < colourChannels; ++c)
+            linear[c] = toLinear[row[c]];
+        if (alpha)
+            linear[colourChannels] = row[colourChannels] / 255.0f;
+    }
+}
+
+// Function to pack a row of linear texels back into 8-bit texels
+static void encodeRow(const float* linear, int width, int channels, unsigned char* row)
+{
+    const unsigned char* toSrgb = linearToSrgbTable();
+    bool alpha = channels % 2 == 0;
+    int colourChannels = alpha ? channels - 1 : channels;
+    for (int x = 0; x < width; ++x, row += channels, linear += 4)
+    {
+        int steps[4];
+#ifdef MIP_CHAIN_SSE2
+        // Round colour to the table's steps and alpha to 8 bits in one go
+        const __m128 scale = _mm_setr_ps(float(LINEAR_TO_SRGB_STEPS - 1), float(LINEAR_TO_SRGB_STEPS - 1), float(LINEAR_TO_SRGB_STEPS - 1), 0.0f);
+        __m128 scaled = _mm_mul_ps(_mm_loadu_ps(linear), scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(steps), _mm_cvtps_epi32(scaled));
+#else
+        for (int c = 0; c < 4; ++c)
+            steps[c] = int(std::lround(linear[c] * (LINEAR_TO_SRGB_STEPS - 1)));
+#endif
+        for (int c = 0; c < colourChannels; ++c)
+            row[c] = toSrgb[std::min(std::max(steps[c], 0), LINEAR_TO_SRGB_STEPS - 1)];
+        if (alpha)
+            row[colourChannels] = static_cast<unsigned char>(std::lround(std::min(std::max(linear[colourChannels], 0.0f), 1.0f) * 255.0f));
+    }
+}
+
+// Source texels one output texel is filtered from along an axis, and their weights
+struct MipTaps
+{
+    int first;
+    int count;
+    float weights[3];
+};
+
+// Function to get the taps of output texel i along an axis of a level. Even sizes average pairs.
+// Odd sizes 2n + 1 halve to n texels of three taps each, weighted by how much of each source
+// texel falls in the output texel's footprint, so every source texel contributes equally and
+// the level does not shift towards the first texel. A size of one keeps its texel.
+static MipTaps mipTaps(int i, int sourceSize)
+{
+    if (sourceSize == 1)
+        return { 0, 1, { 1.0f, 0.0f, 0.0f } };
+    if (sourceSize % 2 == 0)
+        return { 2 * i, 2, { 0.5f, 0.5f, 0.0f } };
+
+    int n = sourceSize / 2;
+    float scale = 1.0f / float(sourceSize);
+    return { 2 * i, 3, { float(n - i) * scale, float(n) * scale, float(i + 1) * scale } };
+}
+
+// Function to filter one output row from the rows of linear texels its row taps name, weighting
+// each tap of each column by the product of the row and column weights
+static void filterRows(const float* const* rows, const MipTaps& rowTaps, const std::vector<MipTaps>& columnTaps, float* out, int width)
+{
+    for (int x = 0; x < width; ++x, out += 4)
+    {
+        const MipTaps& columns = columnTaps[x];
+#ifdef MIP_CHAIN_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int r = 0; r < rowTaps.count; ++r)
+        {
+            for (int c = 0; c < columns.count; ++c)
+            {
+                __m128 weight = _mm_set1_ps(rowTaps.weights[r] * columns.weights[c]);
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[r] + (columns.first + c) * 4), weight));
+            }
+        }
+        _mm_storeu_ps(out, sum);
+#else
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+        for (int r = 0; r < rowTaps.count; ++r)
+        {
+            for (int c = 0; c < columns.count; ++c)
+            {
+                float weight = rowTaps.weights[r] * columns.weights[c];
+                const float* texel = rows[r] + (columns.first + c) * 4;
+                for (int channel = 0; channel < 4; ++channel)
+                    out[channel] += texel[channel] * weight;
+            }
+        }
+#endif
+    }
+}
+
+bool buildMipChain(const unsigned char* pixels, int width, int height, int channels, MipChain& chain)
+{
+    chain.channels = channels;
+    chain.levels.clear();
+    chain.pixels.clear();
+    if (pixels == nullptr || width < 1 || height < 1 || channels < 1 || channels > 4)
+        return false;
+
+    size_t size = 0;
+    for (int levelWidth = width, levelHeight = height; levelWidth > 1 || levelHeight > 1;)
+    {
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+        chain.levels.push_back({ levelWidth, levelHeight, size });
+        size += size_t(levelWidth) * levelHeight * channels;
+    }
+    chain.pixels.resize(size);
+
+    // The image is read once, a few rows at a time, and never expanded to floats as a whole
+    std::vector<float> previous, current;
+    int sourceWidth = width, sourceHeight = height;
+    for (const MipLevel& level : chain.levels)
+    {
+        current.resize(size_t(level.width) * level.height * 4);
+        bool fromImage = previous.empty();
+        std::vector<MipTaps> columnTaps(level.width);
+        for (int x = 0; x < level.width; ++x)
+            columnTaps[x] = mipTaps(x, sourceWidth);
+
+        parallelFor(size_t(level.height), std::max<size_t>(1, MIP_CHAIN_CHUNK_TEXELS / level.width), [&](size_t begin, size_t end)
+        {
+            std::vector<float> decoded[3];
+            if (fromImage)
+            {
+                for (std::vector<float>& row : decoded)
+                    row.resize(size_t(sourceWidth) * 4);
+            }
+            for (size_t y = begin; y < end; ++y)
+            {
+                MipTaps rowTaps = mipTaps(int(y), sourceHeight);
+                const float* rows[3];
+                for (int r = 0; r < rowTaps.count; ++r)
+                {
+                    size_t row = size_t(rowTaps.first + r);
+                    if (fromImage)
+                    {
+                        decodeRow(pixels + row * sourceWidth * channels, sourceWidth, channels, decoded[r].data());
+                        rows[r] = decoded[r].data();
+                    }
+                    else
+                        rows[r] = previous.data() + row * sourceWidth * 4;
+                }
+
+                float* out = current.data() + y * level.width * 4;
+                filterRows(rows, rowTaps, columnTaps, out, level.width);
+                encodeRow(out, level.width, channels, chain.pixels.data() + level.offset + y * level.width * channels);
+            }
+        });
+
+        previous.swap(current);
+        sourceWidth = level.width;
+        sourceHeight = level.height;
+    }
+    return true;
+}
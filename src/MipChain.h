@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Where one mip level sits in a MipChain
+struct MipLevel
+{
+    int width;
+    int height;
+    size_t offset;      // Into MipChain::pixels
+};
+
+// The mip levels below an 8-bit image, from half its size down to 1x1, tightly packed with the
+// image's channel count. Level 0 is the image itself and is not copied, so levels[0] is mip 1.
+struct MipChain
+{
+    int channels = 0;
+    std::vector<MipLevel> levels;
+    std::vector<unsigned char> pixels;
+
+    const unsigned char* level(size_t index) const { return pixels.data() + levels[index].offset; }
+};
+
+// Function to build the mip chain of an image (1 to 4 channels) with a gamma-correct box filter:
+// colour channels are treated as sRGB and averaged in linear light, alpha is averaged as is. Even
+// sides average pairs of texels; odd sides take three weighted taps, so no texel is dropped. Each level is filtered from the previous one kept in linear floats, so rounding does not
+// build up down the chain. Rows of each level are split across the worker pool (see parallelFor).
+// Returns false if the image is empty.
+bool buildMipChain(const unsigned char* pixels, int width, int height, int channels, MipChain& chain);
@@ -0,0 +1,474 @@
+#include "NBody.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// Bits per axis in a Morton code (3 * 21 = 63 bits)
+static const int MORTON_BITS = 21;
+
+// Radix sort digit width; 8 passes cover the 63-bit codes
+static const int RADIX_BITS = 8;
+static const size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+
+// Levels of the tree built serially before the subtrees are handed to worker threads
+static const int PARALLEL_BUILD_LEVELS = 2;
+
+// Deepest possible traversal stack: at most seven pending siblings per level
+static const int TRAVERSAL_STACK_SIZE = 8 * (MORTON_BITS + 1);
+
+// Minimum items per parallel chunk for the cheap per-particle passes
+static const size_t PARTICLE_CHUNK = 4096;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Function to spread the low 21 bits of a value so there are two zero bits between each
+static uint64_t spreadBits(uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffull;
+    value = (value | value << 16) & 0x1f0000ff0000ffull;
+    value = (value | value << 8) & 0x100f00f00f00f00full;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+    value = (value | value << 2) & 0x1249249249249249ull;
+    return value;
+}
+
+void addBody(NBodyState& state, const glm::dvec3& position, const glm::dvec3& velocity, double mass, bool massive)
+{
+    state.position.x.push_back(position.x);
+    state.position.y.push_back(position.y);
+    state.position.z.push_back(position.z);
+    state.velocity.x.push_back(velocity.x);
+    state.velocity.y.push_back(velocity.y);
+    state.velocity.z.push_back(velocity.z);
+    state.mass.push_back(mass);
+    state.acceleration.resize(state.size());
+    state.potential.resize(state.size());
+
+    if (massive)
+        state.massiveCount = state.size();
+}
+
+// Function to sort Morton codes (with their particle indices) using a parallel LSD radix sort
+static void sortByCode(BarnesHutTree& tree)
+{
+    size_t count = tree.codes.size();
+    size_t chunkCount = std::min<size_t>(parallelThreadCount() * 4, std::max<size_t>(count / PARTICLE_CHUNK, 1));
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    std::vector<size_t> histograms(chunkCount * RADIX_BUCKETS);
+
+    tree.codeScratch.resize(count);
+    tree.orderScratch.resize(count);
+
+    for (int shift = 0; shift < 3 * MORTON_BITS; shift += RADIX_BITS)
+    {
+        std::fill(histograms.begin(), histograms.end(), 0);
+
+        // Count digits per chunk
+        parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+        {
+            for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+            {
+                size_t* histogram = &histograms[chunk * RADIX_BUCKETS];
+                size_t end = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                    ++histogram[(tree.codes[i] >> shift) & (RADIX_BUCKETS - 1)];
+            }
+        });
+
+        // Turn counts into output offsets, digit-major so the sort stays stable
+        size_t offset = 0;
+        for (size_t digit = 0; digit < RADIX_BUCKETS; ++digit)
+        {
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                size_t& slot = histograms[chunk * RADIX_BUCKETS + digit];
+                size_t digitCount = slot;
+                slot = offset;
+                offset += digitCount;
+            }
+        }
+
+        // Scatter
+        parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+        {
+            for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+            {
+                size_t* offsets = &histograms[chunk * RADIX_BUCKETS];
+                size_t end = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    size_t destination = offsets[(tree.codes[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+                    tree.codeScratch[destination] = tree.codes[i];
+                    tree.orderScratch[destination] = tree.order[i];
+                }
+            }
+        });
+
+        tree.codes.swap(tree.codeScratch);
+        tree.order.swap(tree.orderScratch);
+    }
+}
+
+// Function to set the mass and centre of mass of a node from its particles or children
+static void summarizeNode(const BarnesHutTree& tree, std::vector<OctreeNode>& nodes, size_t nodeIndex)
+{
+    OctreeNode& node = nodes[nodeIndex];
+    double mass = 0.0, sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+
+    if (node.childCount == 0)
+    {
+        for (uint32_t i = node.begin; i < node.end; ++i)
+        {
+            mass += tree.mass[i];
+            sumX += tree.mass[i] * tree.x[i];
+            sumY += tree.mass[i] * tree.y[i];
+            sumZ += tree.mass[i] * tree.z[i];
+        }
+    }
+    else
+    {
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c)
+        {
+            const OctreeNode& child = nodes[c];
+            mass += child.mass;
+            sumX += child.mass * child.centerX;
+            sumY += child.mass * child.centerY;
+            sumZ += child.mass * child.centerZ;
+        }
+    }
+
+    node.mass = mass;
+    if (mass > 0.0)
+    {
+        node.centerX = sumX / mass;
+        node.centerY = sumY / mass;
+        node.centerZ = sumZ / mass;
+    }
+}
+
+// Function to split a node into its non-empty octants, recursing until maxLevel.
+// Nodes at maxLevel that still need splitting are appended to pending.
+static void buildSubtree(const BarnesHutTree& tree, const BarnesHutSettings& settings, std::vector<OctreeNode>& nodes,
+                         size_t nodeIndex, int level, int maxLevel, std::vector<std::pair<size_t, int>>* pending)
+{
+    uint32_t begin = nodes[nodeIndex].begin;
+    uint32_t end = nodes[nodeIndex].end;
+
+    if (end - begin <= settings.leafSize || level == MORTON_BITS)
+    {
+        summarizeNode(tree, nodes, nodeIndex);
+        return;
+    }
+
+    if (level == maxLevel)
+    {
+        pending->push_back(std::make_pair(nodeIndex, level));
+        return;
+    }
+
+    // Codes in the range share their top 3 * level bits, so the octant is monotonic in the range
+    int shift = 3 * (MORTON_BITS - 1 - level);
+    uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+    double childSize = nodes[nodeIndex].size * 0.5;
+
+    uint32_t childBegin = begin;
+    while (childBegin < end)
+    {
+        uint64_t octant = (tree.codes[childBegin] >> shift) & 7;
+        uint32_t childEnd = static_cast<uint32_t>(std::upper_bound(tree.codes.begin() + childBegin, tree.codes.begin() + end, octant,
+            [shift](uint64_t value, uint64_t code) { return value < ((code >> shift) & 7); }) - tree.codes.begin());
+
+        OctreeNode child = {};
+        child.size = childSize;
+        child.begin = childBegin;
+        child.end = childEnd;
+        nodes.push_back(child);
+
+        childBegin = childEnd;
+    }
+
+    uint32_t childCount = static_cast<uint32_t>(nodes.size()) - firstChild;
+    nodes[nodeIndex].firstChild = firstChild;
+    nodes[nodeIndex].childCount = childCount;
+
+    for (uint32_t c = firstChild; c < firstChild + childCount; ++c)
+        buildSubtree(tree, settings, nodes, c, level + 1, maxLevel, pending);
+
+    summarizeNode(tree, nodes, nodeIndex);
+}
+
+void buildTree(const NBodyState& state, const BarnesHutSettings& settings, BarnesHutTree& tree)
+{
+    size_t first = state.massiveCount;
+    size_t count = state.size() - first;
+
+    tree.nodes.clear();
+    if (count == 0)
+        return;
+
+    // Bounding cube of the particles
+    double minX = std::numeric_limits<double>::max(), minY = minX, minZ = minX;
+    double maxX = -minX, maxY = -minX, maxZ = -minX;
+    for (size_t i = first; i < state.size(); ++i)
+    {
+        minX = std::min(minX, state.position.x[i]); maxX = std::max(maxX, state.position.x[i]);
+        minY = std::min(minY, state.position.y[i]); maxY = std::max(maxY, state.position.y[i]);
+        minZ = std::min(minZ, state.position.z[i]); maxZ = std::max(maxZ, state.position.z[i]);
+    }
+    double size = std::max(std::max(maxX - minX, maxY - minY), std::max(maxZ - minZ, 1e-9)) * 1.0001;
+    double cellsPerUnit = double(1 << MORTON_BITS) / size;
+
+    // Morton code of every particle
+    tree.codes.resize(count);
+    tree.order.resize(count);
+    parallelFor(count, PARTICLE_CHUNK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            uint64_t cellX = static_cast<uint64_t>((state.position.x[first + i] - minX) * cellsPerUnit);
+            uint64_t cellY = static_cast<uint64_t>((state.position.y[first + i] - minY) * cellsPerUnit);
+            uint64_t cellZ = static_cast<uint64_t>((state.position.z[first + i] - minZ) * cellsPerUnit);
+            tree.codes[i] = spreadBits(cellX) << 2 | spreadBits(cellY) << 1 | spreadBits(cellZ);
+            tree.order[i] = static_cast<uint32_t>(first + i);
+        }
+    });
+
+    sortByCode(tree);
+
+    // Gather the particles in Morton order
+    tree.x.resize(count);
+    tree.y.resize(count);
+    tree.z.resize(count);
+    tree.mass.resize(count);
+    parallelFor(count, PARTICLE_CHUNK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            uint32_t source = tree.order[i];
+            tree.x[i] = state.position.x[source];
+            tree.y[i] = state.position.y[source];
+            tree.z[i] = state.position.z[source];
+            tree.mass[i] = state.mass[source];
+        }
+    });
+
+    // Top levels serially
+    OctreeNode root = {};
+    root.size = size;
+    root.begin = 0;
+    root.end = static_cast<uint32_t>(count);
+    tree.nodes.push_back(root);
+
+    std::vector<std::pair<size_t, int>> pending;
+    buildSubtree(tree, settings, tree.nodes, 0, 0, PARALLEL_BUILD_LEVELS, &pending);
+    size_t topNodeCount = tree.nodes.size();
+
+    // Remaining subtrees in parallel, each into its own node list
+    std::vector<std::vector<OctreeNode>> subtrees(pending.size());
+    parallelFor(pending.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t p = begin; p < end; ++p)
+        {
+            subtrees[p].push_back(tree.nodes[pending[p].first]);
+            buildSubtree(tree, settings, subtrees[p], 0, pending[p].second, MORTON_BITS, nullptr);
+        }
+    });
+
+    // Splice the subtrees in; local index k > 0 moves to k + offset
+    for (size_t p = 0; p < pending.size(); ++p)
+    {
+        const std::vector<OctreeNode>& subtree = subtrees[p];
+        uint32_t offset = static_cast<uint32_t>(tree.nodes.size()) - 1;
+
+        OctreeNode subtreeRoot = subtree[0];
+        if (subtreeRoot.childCount > 0)
+            subtreeRoot.firstChild += offset;
+        tree.nodes[pending[p].first] = subtreeRoot;
+
+        for (size_t k = 1; k < subtree.size(); ++k)
+        {
+            OctreeNode node = subtree[k];
+            if (node.childCount > 0)
+                node.firstChild += offset;
+            tree.nodes.push_back(node);
+        }
+    }
+
+    // Children always come after their parent, so a reverse pass fixes up the top levels
+    for (size_t i = topNodeCount; i-- > 0;)
+    {
+        if (tree.nodes[i].childCount > 0)
+            summarizeNode(tree, tree.nodes, i);
+    }
+}
+
+// Function to accumulate the tree's pull on a point, skipping the particle with index self
+static void treeGravity(const BarnesHutTree& tree, const BarnesHutSettings& settings, double px, double py, double pz, uint32_t self,
+                        double& ax, double& ay, double& az, double& potential)
+{
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    double softening2 = settings.softening * settings.softening;
+    double openingAngle = std::min(settings.openingAngle, MAX_OPENING_ANGLE);
+    double openingAngle2 = openingAngle * openingAngle;
+
+    while (stackSize > 0)
+    {
+        const OctreeNode& node = tree.nodes[stack[--stackSize]];
+
+        double dx = node.centerX - px;
+        double dy = node.centerY - py;
+        double dz = node.centerZ - pz;
+        double distance2 = dx * dx + dy * dy + dz * dz;
+
+        if (node.size * node.size < openingAngle2 * distance2)
+        {
+            // Far enough away to treat as a point mass
+            double inverseDistance = 1.0 / sqrt(distance2 + softening2);
+            double strength = node.mass * inverseDistance;
+            double scale = strength * inverseDistance * inverseDistance;
+            ax += dx * scale;
+            ay += dy * scale;
+            az += dz * scale;
+            potential -= strength;
+        }
+        else if (node.childCount == 0)
+        {
+            for (uint32_t i = node.begin; i < node.end; ++i)
+            {
+                if (tree.order[i] == self)
+                    continue;
+
+                double ex = tree.x[i] - px;
+                double ey = tree.y[i] - py;
+                double ez = tree.z[i] - pz;
+                double inverseDistance = 1.0 / sqrt(ex * ex + ey * ey + ez * ez + softening2);
+                double strength = tree.mass[i] * inverseDistance;
+                double scale = strength * inverseDistance * inverseDistance;
+                ax += ex * scale;
+                ay += ey * scale;
+                az += ez * scale;
+                potential -= strength;
+            }
+        }
+        else
+        {
+            for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c)
+                stack[stackSize++] = c;
+        }
+    }
+}
+
+// Function to accumulate the pull of the massive bodies on a point by direct summation
+static void massiveGravity(const NBodyState& state, size_t self, double px, double py, double pz,
+                           double& ax, double& ay, double& az, double& potential)
+{
+    for (size_t j = 0; j < state.massiveCount; ++j)
+    {
+        if (j == self)
+            continue;
+
+        double dx = state.position.x[j] - px;
+        double dy = state.position.y[j] - py;
+        double dz = state.position.z[j] - pz;
+        double inverseDistance = 1.0 / sqrt(dx * dx + dy * dy + dz * dz);
+        double strength = state.mass[j] * inverseDistance;
+        double scale = strength * inverseDistance * inverseDistance;
+        ax += dx * scale;
+        ay += dy * scale;
+        az += dz * scale;
+        potential -= strength;
+    }
+}
+
+void computeGravity(NBodyState& state, const BarnesHutSettings& settings, BarnesHutTree& tree, NBodyTimings* timings)
+{
+    auto start = std::chrono::steady_clock::now();
+    buildTree(state, settings, tree);
+    if (timings != nullptr)
+        timings->treeBuild = millisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    double g = settings.gravitationalConstant;
+    bool hasTree = !tree.nodes.empty();
+
+    // Walk particles in Morton order so neighbouring threads touch neighbouring cells
+    auto evaluate = [&](size_t body)
+    {
+        double ax = 0.0, ay = 0.0, az = 0.0, potential = 0.0;
+        double px = state.position.x[body], py = state.position.y[body], pz = state.position.z[body];
+
+        massiveGravity(state, body, px, py, pz, ax, ay, az, potential);
+        if (hasTree)
+            treeGravity(tree, settings, px, py, pz, static_cast<uint32_t>(body), ax, ay, az, potential);
+
+        state.acceleration.x[body] = g * ax;
+        state.acceleration.y[body] = g * ay;
+        state.acceleration.z[body] = g * az;
+        state.potential[body] = g * potential;
+    };
+
+    for (size_t body = 0; body < state.massiveCount; ++body)
+        evaluate(body);
+
+    parallelFor(tree.order.size(), 256, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            evaluate(tree.order[i]);
+    });
+
+    if (timings != nullptr)
+        timings->forces = millisecondsSince(start);
+}
+
+// Function to apply half a kick or a full drift to every body
+static void advance(std::vector<double>& target, const std::vector<double>& rate, double step)
+{
+    parallelFor(target.size(), PARTICLE_CHUNK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            target[i] += rate[i] * step;
+    });
+}
+
+void leapfrogStep(NBodyState& state, double timeStep, const BarnesHutSettings& settings, BarnesHutTree& tree, NBodyTimings* timings)
+{
+    double halfStep = 0.5 * timeStep;
+
+    advance(state.velocity.x, state.acceleration.x, halfStep);
+    advance(state.velocity.y, state.acceleration.y, halfStep);
+    advance(state.velocity.z, state.acceleration.z, halfStep);
+
+    advance(state.position.x, state.velocity.x, timeStep);
+    advance(state.position.y, state.velocity.y, timeStep);
+    advance(state.position.z, state.velocity.z, timeStep);
+
+    computeGravity(state, settings, tree, timings);
+
+    advance(state.velocity.x, state.acceleration.x, halfStep);
+    advance(state.velocity.y, state.acceleration.y, halfStep);
+    advance(state.velocity.z, state.acceleration.z, halfStep);
+}
+
+double totalEnergy(const NBodyState& state)
+{
+    double kinetic = 0.0, potential = 0.0;
+    for (size_t i = 0; i < state.size(); ++i)
+    {
+        double speed2 = state.velocity.x[i] * state.velocity.x[i] + state.velocity.y[i] * state.velocity.y[i] + state.velocity.z[i] * state.velocity.z[i];
+        kinetic += 0.5 * state.mass[i] * speed2;
+
+        // Every pair appears in both bodies' potentials, hence the half
+        potential += 0.5 * state.mass[i] * state.potential[i];
+    }
+    return kinetic + potential;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Kepler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Largest opening angle the solver uses; larger settings are clamped to it. A particle can lie
+// up to sqrt(3) cell sizes from its cell's centre of mass, so above 1/sqrt(3) the cell holding a
+// particle could pass as a point mass and pull the particle towards itself.
+const double MAX_OPENING_ANGLE = 0.55;
+
+// Parameters of the Barnes-Hut gravity solver
+struct BarnesHutSettings
+{
+    double gravitationalConstant = 1.0;
+    double openingAngle = 0.5;   // Cells smaller than openingAngle * distance are treated as a point mass (at most MAX_OPENING_ANGLE)
+    double softening = 0.001;    // Plummer softening length for particle-particle forces
+    size_t leafSize = 8;         // Maximum particles in a leaf cell
+};
+
+// State of the gravity simulation as structure-of-arrays. The first massiveCount entries are
+// the sun and planets, which interact with everything by direct summation; the remaining
+// entries are belt particles whose mutual gravity goes through the octree.
+struct NBodyState
+{
+    Vec3Array position;
+    Vec3Array velocity;
+    Vec3Array acceleration;
+    std::vector<double> mass;
+    std::vector<double> potential;
+    size_t massiveCount = 0;
+
+    size_t size() const { return mass.size(); }
+};
+
+// Octree cell; children of a cell are stored contiguously
+struct OctreeNode
+{
+    double mass;
+    double centerX, centerY, centerZ; // Centre of mass
+    double size;                      // Edge length of the cell
+    uint32_t begin, end;              // Range of sorted particles in the cell
+    uint32_t firstChild;
+    uint32_t childCount;
+};
+
+// Barnes-Hut octree over the belt particles, built from sorted Morton codes
+struct BarnesHutTree
+{
+    std::vector<OctreeNode> nodes;
+
+    // Particles in Morton order, copied out so leaf loops read contiguous memory
+    std::vector<uint64_t> codes;
+    std::vector<uint32_t> order;      // Index of each sorted particle in the state arrays
+    std::vector<double> x, y, z, mass;
+
+    // Scratch space for the radix sort
+    std::vector<uint64_t> codeScratch;
+    std::vector<uint32_t> orderScratch;
+};
+
+// Timings of the last gravity evaluation, in milliseconds
+struct NBodyTimings
+{
+    double treeBuild = 0.0;
+    double forces = 0.0;
+};
+
+// Function to append a body to the simulation; massive bodies must be added before any particle
+void addBody(NBodyState& state, const glm::dvec3& position, const glm::dvec3& velocity, double mass, bool massive);
+
+// Function to build the octree over the belt particles of the state
+void buildTree(const NBodyState& state, const BarnesHutSettings& settings, BarnesHutTree& tree);
+
+// Function to rebuild the tree and evaluate accelerations and potentials for every body
+void computeGravity(NBodyState& state, const BarnesHutSettings& settings, BarnesHutTree& tree, NBodyTimings* timings = nullptr);
+
+// Function to advance the simulation by one kick-drift-kick leapfrog step.
+// Accelerations must be current (call computeGravity once after setting up the state).
+void leapfrogStep(NBodyState& state, double timeStep, const BarnesHutSettings& settings, BarnesHutTree& tree, NBodyTimings* timings = nullptr);
+
+// Function to get the total kinetic plus potential energy from the last gravity evaluation
+double totalEnergy(const NBodyState& state);
@@ -0,0 +1,147 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads shared by every parallel loop in the program
+class WorkerPool
+{
+public:
+    WorkerPool()
+    {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        size_t workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+
+        for (size_t i = 0; i < workerCount; ++i)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    size_t workerCount() const { return workers.size(); }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+private:
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+static WorkerPool& workerPool()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+size_t parallelThreadCount()
+{
+    return workerPool().workerCount() + 1;
+}
+
+void parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    size_t threads = parallelThreadCount();
+    size_t chunkSize = std::max<size_t>(minChunk, 1);
+
+    // Aim for a few chunks per thread so uneven chunks still balance out
+    chunkSize = std::max(chunkSize, (count + threads * 4 - 1) / (threads * 4));
+    size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    if (chunkCount == 1 || threads == 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    // Shared between the caller and the helpers; helpers may outlive this call
+    // if they are dequeued after all chunks are already taken
+    struct LoopState
+    {
+        std::atomic<size_t> nextChunk{ 0 };
+        std::atomic<size_t> finishedChunks{ 0 };
+    };
+    auto state = std::make_shared<LoopState>();
+    const std::function<void(size_t, size_t)>* loopBody = &body;
+
+    auto runChunks = [state, loopBody, count, chunkSize, chunkCount]()
+    {
+        for (;;)
+        {
+            size_t chunk = state->nextChunk.fetch_add(1);
+            if (chunk >= chunkCount)
+                return;
+
+            size_t begin = chunk * chunkSize;
+            size_t end = std::min(begin + chunkSize, count);
+            (*loopBody)(begin, end);
+            state->finishedChunks.fetch_add(1, std::memory_order_release);
+        }
+    };
+
+    size_t helpers = std::min(threads - 1, chunkCount - 1);
+    for (size_t i = 0; i < helpers; ++i)
+        workerPool().submit(runChunks);
+
+    runChunks();
+
+    // Wait for chunks still running on other threads
+    while (state->finishedChunks.load(std::memory_order_acquire) < chunkCount)
+        std::this_thread::yield();
+}
+
+void parallelSubmit(std::function<void()> task)
+{
+    if (workerPool().workerCount() == 0)
+    {
+        task();
+        return;
+    }
+    workerPool().submit(std::move(task));
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Number of threads that take part in parallelFor (workers plus the calling thread)
+size_t parallelThreadCount();
+
+// Function to split [0, count) into chunks of at least minChunk items and run body(begin, end)
+// on the worker pool. The calling thread also processes chunks, so nested calls are safe.
+void parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& body);
+
+// Function to run a task on a worker thread without waiting for it
+void parallelSubmit(std::function<void()> task);
@@ -0,0 +1,56 @@
+#include "ProgramCache.h"
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+uint64_t programCacheKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& vendor,
+    const std::string& renderer, const std::string& version)
+{
+    // Each part is hashed with its terminator, so moving text between parts changes the key
+    uint64_t hash = hashBytes(&PROGRAM_BINARY_VERSION, sizeof(PROGRAM_BINARY_VERSION));
+    for (const std::string* part : { &vertexSource, &fragmentSource, &vendor, &renderer, &version })
+        hash = hashBytes(part->c_str(), part->size() + 1, hash);
+    return hash;
+}
+
+std::string programCachePath(const std::string& directory, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory + "/" + name;
+}
+
+bool writeProgramBinary(const std::string& filePath, uint64_t key, uint32_t format, const std::vector<unsigned char>& binary)
+{
+    ProgramBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_BINARY_VERSION;
+    header.format = format;
+    header.key = key;
+    header.size = binary.size();
+
+    std::vector<unsigned char> bytes(sizeof(header) + binary.size());
+    memcpy(bytes.data(), &header, sizeof(header));
+    if (!binary.empty())
+        memcpy(bytes.data() + sizeof(header), binary.data(), binary.size());
+    return writeFileAtomically(filePath, bytes);
+}
+
+bool readProgramBinary(const std::string& filePath, uint64_t key, uint32_t& format, std::vector<unsigned char>& binary)
+{
+    std::vector<unsigned char> bytes;
+    ProgramBinaryHeader header;
+    if (!readFileBytes(filePath, bytes) || bytes.size() < sizeof(header))
+        return false;
+
+    memcpy(&header, bytes.data(), sizeof(header));
+    if (memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) != 0 || header.version != PROGRAM_BINARY_VERSION ||
+        header.key != key || header.size == 0 || header.size != bytes.size() - sizeof(header))
+        return false;
+
+    format = header.format;
+    binary.assign(bytes.begin() + sizeof(header), bytes.end());
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linked shader programs as the driver's binaries (glGetProgramBinary), so later runs load them
+// with glProgramBinary instead of compiling. An entry is keyed by the program's sources and the
+// GL vendor, renderer and version strings, so an edited shader or a different driver misses and
+// the program is compiled and cached again. The driver may still refuse a binary it wrote (after
+// an update that kept the version string), so callers fall back to compiling on a failed load.
+//
+// Binary layout (little-endian): ProgramBinaryHeader, then the driver's binary.
+const char PROGRAM_CACHE_DIRECTORY[] = "res/shaders/cache";
+const char PROGRAM_BINARY_MAGIC[8] = { 'S', 'O', 'L', 'P', 'R', 'O', 'G', '1' };
+const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+struct ProgramBinaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;        // Binary format the driver reported with it
+    uint64_t key;           // programCacheKey of the program
+    uint64_t size;          // Bytes of binary after the header
+};
+
+// Function to get the key of a program built from these sources by this driver
+uint64_t programCacheKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& vendor,
+    const std::string& renderer, const std::string& version);
+
+// Function to get the cache entry for a program key
+std::string programCachePath(const std::string& directory, uint64_t key);
+
+// Function to write a program binary to the cache. Returns false if it cannot be written.
+bool writeProgramBinary(const std::string& filePath, uint64_t key, uint32_t format, const std::vector<unsigned char>& binary);
+
+// Function to read a cached program binary. Returns false if it is missing, malformed, or was
+// written for another key.
+bool readProgramBinary(const std::string& filePath, uint64_t key, uint32_t& format, std::vector<unsigned char>& binary);
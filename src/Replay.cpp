@@ -0,0 +1,116 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const double PI = 3.14159265358979323846;
+
+bool writeRecording(const std::string& filePath, const InputRecording& recording)
+{
+    std::ofstream stream(filePath, std::ios::binary);
+    if (!stream)
+        return false;
+
+    ReplayFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.seed = recording.seed;
+    header.frameCount = recording.frames.size();
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(recording.frames.data()), recording.frames.size() * sizeof(ReplayFrame));
+    return static_cast<bool>(stream);
+}
+
+bool loadRecording(const std::string& filePath, InputRecording& recording)
+{
+    std::ifstream stream(filePath, std::ios::binary);
+    if (!stream)
+    {
+        std::cerr << "Failed to open recording: " << filePath << std::endl;
+        return false;
+    }
+
+    ReplayFileHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 || header.version != REPLAY_VERSION)
+    {
+        std::cerr << "Not a valid recording: " << filePath << std::endl;
+        return false;
+    }
+
+    // Check the frame count against the file size before allocating
+    std::streamoff start = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    std::streamoff available = stream.tellg() - start;
+    stream.seekg(start);
+    if (header.frameCount > uint64_t(available) / sizeof(ReplayFrame))
+    {
+        std::cerr << "Truncated recording: " << filePath << std::endl;
+        return false;
+    }
+
+    recording.seed = header.seed;
+    recording.frames.resize(size_t(header.frameCount));
+    stream.read(reinterpret_cast<char*>(recording.frames.data()), recording.frames.size() * sizeof(ReplayFrame));
+    return static_cast<bool>(stream);
+}
+
+void makeStandardFlythrough(InputRecording& recording)
+{
+    recording.seed = REPLAY_SEED;
+    recording.frames.clear();
+
+    for (int i = 0; i < REPLAY_FLYTHROUGH_FRAMES; ++i)
+    {
+        double t = double(i) / (REPLAY_FLYTHROUGH_FRAMES - 1);
+
+        // Two turns: in to Mars's orbit while dropping to the orbital plane, then out and up again
+        double angle = 4.0 * PI * t;
+        double radius = t < 0.5 ? 30.0 - 44.0 * t : 8.0 + 20.0 * (t - 0.5);
+        double height = 12.0 * std::fabs(cos(PI * t)) + 0.2;
+
+        ReplayFrame frame;
+        std::memset(&frame, 0, sizeof(frame));
+        frame.time = i * REPLAY_FLYTHROUGH_FRAME_TIME;
+        frame.frameTime = REPLAY_FLYTHROUGH_FRAME_TIME;
+        frame.cameraX = radius * cos(angle);
+        frame.cameraY = height;
+        frame.cameraZ = radius * sin(angle);
+
+        // Face the sun at the origin
+        frame.cameraYaw = float(atan2(-frame.cameraZ, -frame.cameraX) * 180.0 / PI);
+        frame.cameraPitch = float(atan2(-height, radius) * 180.0 / PI);
+        frame.timeScale = float(REPLAY_FLYTHROUGH_TIME_SCALE);
+        recording.frames.push_back(frame);
+    }
+}
+
+FrameTimeStats frameTimeStats(std::vector<double> frameMilliseconds)
+{
+    FrameTimeStats stats;
+    stats.frames = frameMilliseconds.size();
+    if (frameMilliseconds.empty())
+        return stats;
+
+    std::sort(frameMilliseconds.begin(), frameMilliseconds.end());
+    for (double milliseconds : frameMilliseconds)
+        stats.mean += milliseconds;
+    stats.mean /= frameMilliseconds.size();
+
+    // Nearest-rank percentiles
+    auto percentile = [&](double fraction)
+    {
+        size_t rank = size_t(std::ceil(fraction * frameMilliseconds.size()));
+        return frameMilliseconds[std::min(std::max(rank, size_t(1)), frameMilliseconds.size()) - 1];
+    };
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = frameMilliseconds.back();
+    return stats;
+}
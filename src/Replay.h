@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Recording of the app's input and camera, one sample per rendered frame, so performance runs
+// can see exactly the same frames. A replay drives the camera from the recorded state and the
+// simulation clock from the recorded frame times, so it does not depend on the machine's speed.
+
+// Binary replay file layout (little-endian): ReplayFileHeader, then ReplayFrame[frameCount]
+const char REPLAY_MAGIC[8] = { 'S', 'O', 'L', 'R', 'E', 'P', 'L', 'Y' };
+const uint32_t REPLAY_VERSION = 1;
+
+// Keys held during a frame
+const uint32_t REPLAY_KEY_FORWARD = 1 << 0;    // W
+const uint32_t REPLAY_KEY_BACK = 1 << 1;       // S
+const uint32_t REPLAY_KEY_LEFT = 1 << 2;       // A
+const uint32_t REPLAY_KEY_RIGHT = 1 << 3;      // D
+const uint32_t REPLAY_KEY_RESET = 1 << 4;      // R
+
+// Seed for the belt and ring while recording, so the replay regenerates the same scene
+const uint32_t REPLAY_SEED = 20240601;
+
+// Standard flythrough used by the replay benchmark when no recording is given
+const int REPLAY_FLYTHROUGH_FRAMES = 2400;           // Forty seconds at 60 Hz
+const double REPLAY_FLYTHROUGH_FRAME_TIME = 1.0 / 60.0;
+const double REPLAY_FLYTHROUGH_TIME_SCALE = 200.0;
+
+struct ReplayFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t seed;
+    uint64_t frameCount;
+};
+
+// Input events and the resulting camera and clock state of one frame
+struct ReplayFrame
+{
+    double time;            // Real seconds since the recording started
+    double frameTime;       // Real seconds since the previous frame
+    double cursorX, cursorY;
+    double cameraX, cameraY, cameraZ;
+    float cameraYaw, cameraPitch;   // In degrees, as in the app
+    float timeScale;
+    uint32_t keys;          // REPLAY_KEY_* bits
+    uint32_t paused;
+    uint32_t reserved;
+};
+
+struct InputRecording
+{
+    uint32_t seed = REPLAY_SEED;
+    std::vector<ReplayFrame> frames;
+};
+
+// Frame time distribution of a run, in milliseconds
+struct FrameTimeStats
+{
+    size_t frames = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Function to write a recording to a binary file. Returns false on failure.
+bool writeRecording(const std::string& filePath, const InputRecording& recording);
+
+// Function to load a recording. Returns false if the file is missing or malformed.
+bool loadRecording(const std::string& filePath, InputRecording& recording);
+
+// Function to build the standard flythrough: a spiral around the sun from beyond Neptune down to
+// Mars's orbit, low over the belt, then out past Saturn, always facing the sun
+void makeStandardFlythrough(InputRecording& recording);
+
+// Function to get the mean and percentiles of a list of frame times
+FrameTimeStats frameTimeStats(std::vector<double> frameMilliseconds);
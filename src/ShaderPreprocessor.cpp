@@ -0,0 +1,215 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+// Function to strip the spaces and tabs at both ends of a line
+static std::string trimmed(const std::string& line)
+{
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return std::string();
+    size_t last = line.find_last_not_of(" \t\r");
+    return line.substr(first, last - first + 1);
+}
+
+// Function to check whether a trimmed line is a given directive, such as "#include"
+static bool isDirective(const std::string& line, const std::string& directive)
+{
+    return line.compare(0, directive.size(), directive) == 0 &&
+        (line.size() == directive.size() || line[directive.size()] == ' ' || line[directive.size()] == '\t');
+}
+
+// Function to resolve an include against the directory of the file including it, folding "." and
+// ".." so each file has one path however it is reached
+static std::string includePath(const std::string& includer, const std::string& name)
+{
+    size_t slash = includer.find_last_of("/\\");
+    std::string joined = slash == std::string::npos ? name : includer.substr(0, slash + 1) + name;
+
+    std::vector<std::string> parts;
+    std::stringstream stream(joined);
+    std::string part;
+    while (std::getline(stream, part, '/'))
+    {
+        if (part.empty() || part == ".")
+            continue;
+        if (part == ".." && !parts.empty() && parts.back() != "..")
+            parts.pop_back();
+        else
+            parts.push_back(part);
+    }
+
+    std::string path;
+    for (const std::string& segment : parts)
+        path += (path.empty() ? "" : "/") + segment;
+    return path;
+}
+
+// Expands the includes of one stage, each file once
+struct StageExpander
+{
+    const ShaderFileReader& reader;
+    std::vector<std::string>& files;
+    std::string& error;
+    std::set<std::string> included;
+
+    // Function to append lines of a file to a stage, expanding their includes
+    bool expand(const std::string& file, const std::vector<std::string>& lines, size_t firstLine, std::string& out)
+    {
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            std::string line = trimmed(lines[i]);
+            if (!isDirective(line, "#include"))
+            {
+                out += lines[i] + "\n";
+                continue;
+            }
+
+            std::string where = file + ":" + std::to_string(firstLine + i + 1) + ": ";
+            size_t open = line.find('"');
+            size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+            if (close == std::string::npos || close == open + 1)
+            {
+                error = where + "expected #include \"file\"";
+                return false;
+            }
+
+            std::string path = includePath(file, line.substr(open + 1, close - open - 1));
+            if (!included.insert(path).second)
+                continue;
+
+            std::string text;
+            if (!reader(path, text))
+            {
+                error = where + "cannot read " + path;
+                return false;
+            }
+            if (std::find(files.begin(), files.end(), path) == files.end())
+                files.push_back(path);
+
+            std::vector<std::string> includedLines;
+            std::stringstream stream(text);
+            std::string includedLine;
+            while (std::getline(stream, includedLine))
+                includedLines.push_back(includedLine);
+            if (!expand(path, includedLines, 0, out))
+                return false;
+        }
+        return true;
+    }
+};
+
+bool preprocessShader(const std::string& path, const std::vector<std::string>& defines, const ShaderFileReader& reader,
+    PreprocessedShader& shader, std::string& error)
+{
+    shader = PreprocessedShader();
+    error.clear();
+
+    std::string text;
+    if (!reader(path, text))
+    {
+        error = path + ": cannot read the file";
+        return false;
+    }
+    shader.files.push_back(path);
+
+    // Shared lines, then each stage's lines, with the line each part starts on for messages
+    enum { COMMON = 0, VERTEX = 1, FRAGMENT = 2 };
+    std::vector<std::string> parts[3];
+    size_t firstLines[3] = { 0, 0, 0 };
+    int part = COMMON;
+
+    std::stringstream stream(text);
+    std::string line;
+    for (size_t number = 0; std::getline(stream, line); ++number)
+    {
+        std::string directive = trimmed(line);
+        if (isDirective(directive, "#shader"))
+        {
+            if (directive.find("vertex") != std::string::npos)
+                part = VERTEX;
+            else if (directive.find("fragment") != std::string::npos)
+                part = FRAGMENT;
+            else
+            {
+                error = path + ":" + std::to_string(number + 1) + ": unknown shader stage";
+                return false;
+            }
+            firstLines[part] = number + 1;
+            continue;
+        }
+        parts[part].push_back(line);
+    }
+
+    std::string defineLines;
+    for (const std::string& define : defines)
+        defineLines += "#define " + define + "\n";
+
+    std::string* outputs[3] = { nullptr, &shader.vertexSource, &shader.fragmentSource };
+    for (int stage = VERTEX; stage <= FRAGMENT; ++stage)
+    {
+        // #version must come first, so the defines and shared lines go straight after it
+        const std::vector<std::string>& lines = parts[stage];
+        size_t version = 0;
+        while (version < lines.size() && trimmed(lines[version]).empty())
+            ++version;
+        bool hasVersion = version < lines.size() && isDirective(trimmed(lines[version]), "#version");
+
+        std::string& out = *outputs[stage];
+        size_t bodyStart = 0;
+        if (hasVersion)
+        {
+            out += lines[version] + "\n";
+            bodyStart = version + 1;
+        }
+        out += defineLines;
+
+        StageExpander expander{ reader, shader.files, error, {} };
+        std::vector<std::string> body(lines.begin() + bodyStart, lines.end());
+        if (!expander.expand(path, parts[COMMON], firstLines[COMMON], out) ||
+            !expander.expand(path, body, firstLines[stage] + bodyStart, out))
+            return false;
+    }
+    return true;
+}
+
+bool ShaderPermutationCache::find(const std::string& path, const std::string& permutation, uint32_t& program) const
+{
+    auto found = programs.find(std::make_pair(path, permutation));
+    if (found == programs.end())
+        return false;
+    program = found->second.program;
+    return true;
+}
+
+void ShaderPermutationCache::insert(const std::string& path, const ShaderPermutation& permutation, uint32_t program,
+    const std::vector<std::string>& files)
+{
+    programs[std::make_pair(path, permutation.name)] = { permutation, program, files };
+}
+
+std::vector<std::pair<std::string, ShaderPermutation>> ShaderPermutationCache::dependents(const std::string& file) const
+{
+    std::vector<std::pair<std::string, ShaderPermutation>> found;
+    for (const auto& entry : programs)
+    {
+        const std::vector<std::string>& files = entry.second.files;
+        if (std::find(files.begin(), files.end(), file) != files.end())
+            found.push_back(std::make_pair(entry.first.first, entry.second.permutation));
+    }
+    return found;
+}
+
+std::vector<uint32_t> ShaderPermutationCache::clear()
+{
+    std::vector<uint32_t> released;
+    for (const auto& entry : programs)
+    {
+        if (entry.second.program != 0)
+            released.push_back(entry.second.program);
+    }
+    programs.clear();
+    return released;
+}
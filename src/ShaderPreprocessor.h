@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Named set of #defines a shader file is compiled with. Each permutation is its own program, so
+// what the defines select is decided at compile time instead of by branching on uniforms.
+struct ShaderPermutation
+{
+    std::string name;
+    std::vector<std::string> defines;   // "NAME" or "NAME VALUE"
+};
+
+// Function that reads a shader file's text, such as from the asset pack. Returns false if the
+// file is missing.
+typedef std::function<bool(const std::string& path, std::string& text)> ShaderFileReader;
+
+// Shader stages ready to compile, and the files they were read from
+struct PreprocessedShader
+{
+    std::string vertexSource;
+    std::string fragmentSource;
+    std::vector<std::string> files;     // The shader file first, then everything it includes
+};
+
+// Function to preprocess a shader file. "#shader vertex" and "#shader fragment" lines start each
+// stage; lines before the first are shared by both. '#include "file"' inserts a file, relative to
+// the directory of the file including it, at most once per stage (so includes need no guards);
+// includes are expanded whatever #ifdef they sit in, so files lists every file a permutation might
+// read. The defines go straight after each stage's #version line, then the shared lines. Returns
+// false with a message naming the file and line if a file is missing or an include is malformed.
+bool preprocessShader(const std::string& path, const std::vector<std::string>& defines, const ShaderFileReader& reader,
+    PreprocessedShader& shader, std::string& error);
+
+// Programs built from shader permutations, by shader file and permutation name, with the files
+// each was preprocessed from, so an edited include rebuilds every program that uses it. Programs
+// are opaque handles here (GL program names in the app); 0 records a permutation that failed to
+// build, so it is not retried every frame.
+class ShaderPermutationCache
+{
+public:
+    // Function to look up a permutation. Returns false if it has not been built.
+    bool find(const std::string& path, const std::string& permutation, uint32_t& program) const;
+
+    // Function to record a built permutation, replacing any earlier build of it
+    void insert(const std::string& path, const ShaderPermutation& permutation, uint32_t program, const std::vector<std::string>& files);
+
+    // Function to list the shader file and permutation of every program built from a file
+    std::vector<std::pair<std::string, ShaderPermutation>> dependents(const std::string& file) const;
+
+    // Function to forget every program; returns them so the caller can delete them
+    std::vector<uint32_t> clear();
+
+    size_t size() const { return programs.size(); }
+
+private:
+    struct Program
+    {
+        ShaderPermutation permutation;
+        uint32_t program;
+        std::vector<std::string> files;
+    };
+
+    std::map<std::pair<std::string, std::string>, Program> programs;
+};
@@ -0,0 +1,77 @@
+#include "Simulation.h"
+#include "Parallel.h"
+
+#include <algorithm>
+
+int beginFrame(FixedTimestep& timestep, double frameTime)
+{
+    timestep.accumulator += std::max(frameTime, 0.0);
+
+    int ticks = static_cast<int>(timestep.accumulator / timestep.tickLength);
+    if (ticks > timestep.maxTicksPerFrame)
+    {
+        // Drop the backlog instead of trying to catch up, keeping the partial tick
+        double excess = (ticks - timestep.maxTicksPerFrame) * timestep.tickLength;
+        timestep.droppedTime += excess;
+        timestep.accumulator -= excess;
+        ticks = timestep.maxTicksPerFrame;
+    }
+
+    timestep.accumulator -= ticks * timestep.tickLength;
+    timestep.ticksThisFrame = ticks;
+    return ticks;
+}
+
+double interpolationFactor(const FixedTimestep& timestep)
+{
+    return std::min(timestep.accumulator / timestep.tickLength, 1.0);
+}
+
+double simulatedTickLength(const SimulationClock& clock, const FixedTimestep& timestep)
+{
+    if (clock.paused)
+        return 0.0;
+    return timestep.tickLength * std::min(std::max(clock.timeScale, 0.0), MAX_TIME_SCALE);
+}
+
+void evaluateKeplerState(const KeplerBatch& planetOrbits, const KeplerBatch& asteroidOrbits, const KeplerBatch& ringAsteroidOrbits,
+                         double time, SimulationState& state, const Ephemeris* planetEphemeris)
+{
+    state.time = time;
+    if (planetEphemeris != nullptr && planetEphemeris->covers(time))
+        evaluateEphemeris(*planetEphemeris, time, state.planetPositions);
+    else
+        propagateOrbits(planetOrbits, time, state.planetPositions);
+    propagateOrbits(asteroidOrbits, time, state.asteroidPositions);
+    propagateOrbits(ringAsteroidOrbits, time, state.ringAsteroidPositions);
+}
+
+// Function to blend one array of positions
+static void interpolatePositions(const Vec3Array& previous, const Vec3Array& current, double alpha, Vec3Array& result)
+{
+    // A population that changed size between ticks (e.g. a mode switch) cannot be blended
+    if (previous.size() != current.size())
+    {
+        result = current;
+        return;
+    }
+
+    result.resize(current.size());
+    parallelFor(current.size(), 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            result.x[i] = previous.x[i] + (current.x[i] - previous.x[i]) * alpha;
+            result.y[i] = previous.y[i] + (current.y[i] - previous.y[i]) * alpha;
+            result.z[i] = previous.z[i] + (current.z[i] - previous.z[i]) * alpha;
+        }
+    });
+}
+
+void interpolateStates(const SimulationState& previous, const SimulationState& current, double alpha, SimulationState& result)
+{
+    result.time = previous.time + (current.time - previous.time) * alpha;
+    interpolatePositions(previous.planetPositions, current.planetPositions, alpha, result.planetPositions);
+    interpolatePositions(previous.asteroidPositions, current.asteroidPositions, alpha, result.asteroidPositions);
+    interpolatePositions(previous.ringAsteroidPositions, current.ringAsteroidPositions, alpha, result.ringAsteroidPositions);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Ephemeris.h"
+#include "Kepler.h"
+
+// Positions of everything that moves, at one simulation time
+struct SimulationState
+{
+    double time = 0.0;
+    Vec3Array planetPositions;
+    Vec3Array asteroidPositions;
+    Vec3Array ringAsteroidPositions; // Relative to Saturn
+};
+
+// Simulation clock controls
+const double MAX_TIME_SCALE = 1e6;
+
+struct SimulationClock
+{
+    double timeScale = 1.0; // Simulated seconds per real second
+    bool paused = false;
+};
+
+// Fixed-timestep accumulator: real frame time is banked and spent in whole simulation ticks
+struct FixedTimestep
+{
+    double tickLength;          // Simulated seconds per tick
+    int maxTicksPerFrame;       // Cap on ticks per frame so a slow frame cannot snowball
+    double accumulator = 0.0;   // Real time not yet simulated
+    double droppedTime = 0.0;   // Real time discarded because of the cap
+    int ticksThisFrame = 0;
+};
+
+// Function to bank a frame's real time and return how many ticks to run this frame
+int beginFrame(FixedTimestep& timestep, double frameTime);
+
+// Function to get the fraction of a tick between the last two states to render at
+double interpolationFactor(const FixedTimestep& timestep);
+
+// Function to get the simulated time covered by one tick at the clock's time scale
+double simulatedTickLength(const SimulationClock& clock, const FixedTimestep& timestep);
+
+// Function to evaluate every Keplerian body directly at the given time; this is O(N) parallel
+// work regardless of how far the time is from the current one, so it also serves as seek.
+// Planets are read from the ephemeris instead when one is given and it covers the time.
+void evaluateKeplerState(const KeplerBatch& planetOrbits, const KeplerBatch& asteroidOrbits, const KeplerBatch& ringAsteroidOrbits,
+                         double time, SimulationState& state, const Ephemeris* planetEphemeris = nullptr);
+
+// Function to blend two simulation states; alpha = 0 gives previous, alpha = 1 gives current
+void interpolateStates(const SimulationState& previous, const SimulationState& current, double alpha, SimulationState& result);
@@ -0,0 +1,724 @@
+#include "Snapshot.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    const char* const SECTION_NAMES[SNAPSHOT_SECTION_COUNT] = {
+        "clock", "catalog", "components", "archetypes", "chunks", "entities", "planet orbits",
+        "asteroid orbits", "ring orbits", "body data", "previous state", "current state", "n-body state"
+    };
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Function to copy an array out of the mapping on the worker pool; the copy is what a restore
+    // spends most of its time on, and page faults on the mapping overlap better across threads
+    template<typename T>
+    void copyArray(const T* values, uint64_t count, std::vector<T>& target)
+    {
+        target.resize(size_t(count));
+        parallelFor(size_t(count), 1 << 16, [&](size_t begin, size_t end)
+        {
+            std::memcpy(target.data() + begin, values + begin, (end - begin) * sizeof(T));
+        });
+    }
+
+    // Sequential writer that pads arrays and sections to SNAPSHOT_ALIGNMENT with zeros. It writes
+    // a temporary file and renames it over the target once complete, so saving over the snapshot
+    // a restore still maps (and reads from while writing) never truncates it underneath the mapping.
+    class SnapshotWriter
+    {
+    public:
+        explicit SnapshotWriter(const std::string& filePath)
+            : filePath(filePath), temporaryPath(filePath + ".tmp"), stream(temporaryPath, std::ios::binary)
+        {
+            // The header and section table are filled in by finish()
+            std::vector<char> zeros(sizeof(SnapshotFileHeader) + SNAPSHOT_SECTION_COUNT * sizeof(SnapshotSection), 0);
+            write(zeros.data(), zeros.size());
+        }
+
+        bool good() const { return static_cast<bool>(stream); }
+
+        void beginSection(SnapshotSectionId id)
+        {
+            pad();
+            SnapshotSection section = { id, 0, offset, 0 };
+            sections.push_back(section);
+        }
+
+        void endSection()
+        {
+            sections.back().size = offset - sections.back().offset;
+        }
+
+        void write(const void* data, size_t size)
+        {
+            stream.write(static_cast<const char*>(data), size);
+            offset += size;
+        }
+
+        template<typename T>
+        void writeValue(const T& value)
+        {
+            write(&value, sizeof(T));
+        }
+
+        template<typename T>
+        void writeArray(const T* values, size_t count)
+        {
+            pad();
+            write(values, count * sizeof(T));
+        }
+
+        // Function to write a count followed by the array it counts
+        template<typename T>
+        void writeCountedArray(const T* values, size_t count)
+        {
+            writeValue(uint64_t(count));
+            writeArray(values, count);
+        }
+
+        void pad()
+        {
+            static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+            write(zeros, alignUp(offset, SNAPSHOT_ALIGNMENT) - offset);
+        }
+
+        bool finish()
+        {
+            pad();
+
+            SnapshotFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+            header.version = SNAPSHOT_VERSION;
+            header.sectionCount = uint32_t(sections.size());
+            header.fileSize = offset;
+
+            stream.seekp(0);
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            stream.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(SnapshotSection));
+            stream.close();
+            if (stream.fail())
+                return false;
+
+#ifdef _WIN32
+            // Renaming onto an existing file fails on Windows; a mapped target cannot be removed
+            // either, and then the save fails with the old snapshot intact
+            std::remove(filePath.c_str());
+#endif
+            renamed = std::rename(temporaryPath.c_str(), filePath.c_str()) == 0;
+            return renamed;
+        }
+
+        ~SnapshotWriter()
+        {
+            if (!renamed)
+            {
+                stream.close();
+                std::remove(temporaryPath.c_str());
+            }
+        }
+
+    private:
+        std::string filePath;
+        std::string temporaryPath;
+        std::ofstream stream;
+        bool renamed = false;
+        uint64_t offset = 0;
+        std::vector<SnapshotSection> sections;
+    };
+
+    // Bounds-checked reader over one section of a mapped snapshot. Reads past the end set failed
+    // and return zeros or nullptr, so callers check once after parsing a section.
+    struct SectionReader
+    {
+        const unsigned char* file = nullptr;
+        size_t position = 0;
+        size_t end = 0;
+        bool failed = false;
+
+        template<typename T>
+        T readValue()
+        {
+            T value;
+            std::memset(&value, 0, sizeof(T));
+            if (failed || end - position < sizeof(T))
+            {
+                failed = true;
+                return value;
+            }
+            std::memcpy(&value, file + position, sizeof(T));
+            position += sizeof(T);
+            return value;
+        }
+
+        template<typename T>
+        const T* readArray(uint64_t count)
+        {
+            size_t start = alignUp(position, SNAPSHOT_ALIGNMENT);
+            if (failed || start > end || count > (end - start) / sizeof(T))
+            {
+                failed = true;
+                return nullptr;
+            }
+            position = start + size_t(count) * sizeof(T);
+            return reinterpret_cast<const T*>(file + start);
+        }
+
+        template<typename T>
+        const T* readCountedArray(uint64_t& count)
+        {
+            count = readValue<uint64_t>();
+            return readArray<T>(count);
+        }
+    };
+
+    // Function to find a section in a mapped snapshot, checking that it lies inside the file
+    bool findSection(const MappedFile& file, SnapshotSectionId id, SectionReader& reader)
+    {
+        SnapshotFileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        for (uint32_t i = 0; i < header.sectionCount; ++i)
+        {
+            SnapshotSection section;
+            std::memcpy(&section, file.data() + sizeof(header) + i * sizeof(SnapshotSection), sizeof(section));
+            if (section.id != id)
+                continue;
+            if (section.offset % SNAPSHOT_ALIGNMENT != 0 || section.offset > file.size() || section.size > file.size() - section.offset)
+                return false;
+
+            reader.file = file.data();
+            reader.position = size_t(section.offset);
+            reader.end = size_t(section.offset + section.size);
+            reader.failed = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Function to map a snapshot and check its header and section table
+    bool openSnapshot(const std::string& filePath, MappedFile& file, bool copyOnWrite)
+    {
+        if (!file.open(filePath, copyOnWrite))
+        {
+            std::cerr << "Failed to open snapshot: " << filePath << std::endl;
+            return false;
+        }
+
+        SnapshotFileHeader header;
+        if (file.size() >= sizeof(header))
+            std::memcpy(&header, file.data(), sizeof(header));
+        if (file.size() < sizeof(header) || std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != SNAPSHOT_VERSION || header.fileSize != file.size() ||
+            header.sectionCount > (file.size() - sizeof(header)) / sizeof(SnapshotSection))
+        {
+            std::cerr << "Not a valid snapshot file: " << filePath << std::endl;
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    void writeOrbits(SnapshotWriter& writer, SnapshotSectionId id, const KeplerBatch& orbits)
+    {
+        writer.beginSection(id);
+        writer.writeValue(uint64_t(orbits.size()));
+        for (const DoubleColumn* column : keplerColumns(orbits))
+            writer.writeArray(column->data(), column->size());
+        writer.endSection();
+    }
+
+    bool readOrbits(const MappedFile& file, SnapshotSectionId id, KeplerBatch& orbits)
+    {
+        SectionReader reader;
+        if (!findSection(file, id, reader))
+            return false;
+
+        uint64_t count = reader.readValue<uint64_t>();
+        for (DoubleColumn* column : keplerColumns(orbits))
+        {
+            const double* values = reader.readArray<double>(count);
+            if (values != nullptr)
+                column->setView(values, size_t(count));
+        }
+        return !reader.failed;
+    }
+
+    void writeVec3Array(SnapshotWriter& writer, const Vec3Array& values)
+    {
+        writer.writeArray(values.x.data(), values.size());
+        writer.writeArray(values.y.data(), values.size());
+        writer.writeArray(values.z.data(), values.size());
+    }
+
+    void readVec3Array(SectionReader& reader, uint64_t count, Vec3Array& values)
+    {
+        const double* x = reader.readArray<double>(count);
+        const double* y = reader.readArray<double>(count);
+        const double* z = reader.readArray<double>(count);
+        if (reader.failed)
+            return;
+        copyArray(x, count, values.x);
+        copyArray(y, count, values.y);
+        copyArray(z, count, values.z);
+    }
+
+    void writeState(SnapshotWriter& writer, SnapshotSectionId id, const SimulationState& state)
+    {
+        SnapshotStateHeader header = { state.time, state.planetPositions.size(), state.asteroidPositions.size(), state.ringAsteroidPositions.size() };
+        writer.beginSection(id);
+        writer.writeValue(header);
+        writeVec3Array(writer, state.planetPositions);
+        writeVec3Array(writer, state.asteroidPositions);
+        writeVec3Array(writer, state.ringAsteroidPositions);
+        writer.endSection();
+    }
+
+    bool readState(const MappedFile& file, SnapshotSectionId id, SimulationState& state)
+    {
+        SectionReader reader;
+        if (!findSection(file, id, reader))
+            return false;
+
+        SnapshotStateHeader header = reader.readValue<SnapshotStateHeader>();
+        state.time = header.time;
+        readVec3Array(reader, header.planetCount, state.planetPositions);
+        readVec3Array(reader, header.asteroidCount, state.asteroidPositions);
+        readVec3Array(reader, header.ringAsteroidCount, state.ringAsteroidPositions);
+        return !reader.failed;
+    }
+
+    // Function to write the archetypes and an image of every chunk. Rows past a chunk's count and
+    // the padding between columns are zeroed so the bytes only depend on the entities.
+    void writeWorld(SnapshotWriter& writer, const EcsWorld& world)
+    {
+        const std::vector<EcsArchetype>& archetypes = world.archetypeList();
+
+        // Number the component types the archetypes use; ids in the file follow this order
+        ComponentMask used = 0;
+        for (const EcsArchetype& archetype : archetypes)
+            used |= archetype.mask;
+
+        std::vector<SnapshotComponent> components;
+        uint32_t fileId[MAX_COMPONENT_TYPES];
+        for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+        {
+            if ((used & (ComponentMask(1) << component)) == 0)
+                continue;
+
+            SnapshotComponent record;
+            std::memset(&record, 0, sizeof(record));
+            std::strncpy(record.name, componentName(component), sizeof(record.name) - 1);
+            record.size = componentSize(component);
+            fileId[component] = uint32_t(components.size());
+            components.push_back(record);
+        }
+
+        writer.beginSection(SNAPSHOT_COMPONENTS);
+        writer.writeCountedArray(components.data(), components.size());
+        writer.endSection();
+
+        std::vector<SnapshotArchetype> records;
+        std::vector<uint32_t> chunkCounts;
+        uint64_t chunkOffset = 0;
+        for (const EcsArchetype& archetype : archetypes)
+        {
+            SnapshotArchetype record;
+            std::memset(&record, 0, sizeof(record));
+            record.capacity = archetype.capacity;
+            record.chunkBytes = archetype.chunkBytes;
+            record.entityOffset = archetype.entityOffset;
+            record.chunkCount = uint32_t(archetype.chunks.size());
+            record.firstChunk = chunkCounts.size();
+            record.chunkOffset = chunkOffset;
+            for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+            {
+                if (archetype.mask & (ComponentMask(1) << component))
+                {
+                    record.mask |= ComponentMask(1) << fileId[component];
+                    record.columnOffset[fileId[component]] = archetype.columnOffset[component];
+                }
+            }
+            records.push_back(record);
+
+            for (const EcsChunk& chunk : archetype.chunks)
+                chunkCounts.push_back(chunk.count);
+            chunkOffset += archetype.chunks.size() * alignUp(archetype.chunkBytes, SNAPSHOT_ALIGNMENT);
+        }
+
+        writer.beginSection(SNAPSHOT_ARCHETYPES);
+        writer.writeCountedArray(records.data(), records.size());
+        writer.writeArray(chunkCounts.data(), chunkCounts.size());
+        writer.endSection();
+
+        writer.beginSection(SNAPSHOT_CHUNKS);
+        std::vector<unsigned char> image;
+        for (const EcsArchetype& archetype : archetypes)
+        {
+            image.resize(alignUp(archetype.chunkBytes, SNAPSHOT_ALIGNMENT));
+            for (const EcsChunk& chunk : archetype.chunks)
+            {
+                std::fill(image.begin(), image.end(), 0);
+                std::memcpy(image.data() + archetype.entityOffset, chunk.data + archetype.entityOffset, chunk.count * sizeof(Entity));
+                for (size_t component = 0; component < MAX_COMPONENT_TYPES; ++component)
+                {
+                    size_t size = (archetype.mask & (ComponentMask(1) << component)) ? componentSize(component) : 0;
+                    if (size > 0)
+                        std::memcpy(image.data() + archetype.columnOffset[component], chunk.data + archetype.columnOffset[component], chunk.count * size);
+                }
+                writer.write(image.data(), image.size());
+            }
+        }
+        writer.endSection();
+
+        writer.beginSection(SNAPSHOT_ENTITIES);
+        writer.writeCountedArray(world.locationList().data(), world.locationList().size());
+        writer.writeCountedArray(world.freeList().data(), world.freeList().size());
+        writer.endSection();
+    }
+
+    // Function to check that a column of capacity entries of the given size fits in a chunk
+    bool columnFits(uint32_t offset, uint32_t capacity, size_t size, uint32_t chunkBytes)
+    {
+        return uint64_t(offset) + uint64_t(capacity) * size <= chunkBytes;
+    }
+
+    // Function to rebuild the archetypes over the chunk images in the mapping, translating the
+    // file's component ids to this process's
+    bool readWorld(const MappedFile& file, std::vector<EcsArchetype>& archetypes, std::vector<EcsWorld::EntityLocation>& locations, std::vector<Entity>& freeEntities)
+    {
+        SectionReader reader;
+        if (!findSection(file, SNAPSHOT_COMPONENTS, reader))
+            return false;
+
+        uint64_t componentCount;
+        const SnapshotComponent* components = reader.readCountedArray<SnapshotComponent>(componentCount);
+        if (reader.failed || componentCount > MAX_COMPONENT_TYPES)
+            return false;
+
+        size_t localId[MAX_COMPONENT_TYPES];
+        for (size_t i = 0; i < componentCount; ++i)
+        {
+            char name[sizeof(components[i].name) + 1] = {};
+            std::memcpy(name, components[i].name, sizeof(components[i].name));
+            localId[i] = findComponentType(name);
+            if (localId[i] == MAX_COMPONENT_TYPES || componentSize(localId[i]) != components[i].size)
+            {
+                std::cerr << "Snapshot component does not match this build: " << name << std::endl;
+                return false;
+            }
+        }
+
+        SectionReader chunkReader;
+        if (!findSection(file, SNAPSHOT_ARCHETYPES, reader) || !findSection(file, SNAPSHOT_CHUNKS, chunkReader))
+            return false;
+
+        uint64_t archetypeCount;
+        const SnapshotArchetype* records = reader.readCountedArray<SnapshotArchetype>(archetypeCount);
+        uint64_t chunkTotal = 0;
+        for (uint64_t i = 0; records != nullptr && i < archetypeCount; ++i)
+            chunkTotal += records[i].chunkCount;
+        const uint32_t* chunkCounts = reader.readArray<uint32_t>(chunkTotal);
+        if (reader.failed)
+            return false;
+
+        unsigned char* chunkData = file.writableData() + chunkReader.position;
+        size_t chunkBytesAvailable = chunkReader.end - chunkReader.position;
+
+        archetypes.clear();
+        for (uint64_t i = 0; i < archetypeCount; ++i)
+        {
+            const SnapshotArchetype& record = records[i];
+            size_t paddedBytes = alignUp(record.chunkBytes, SNAPSHOT_ALIGNMENT);
+            if (record.capacity == 0 || !columnFits(record.entityOffset, record.capacity, sizeof(Entity), record.chunkBytes) ||
+                record.firstChunk + record.chunkCount > chunkTotal || record.chunkOffset % SNAPSHOT_ALIGNMENT != 0 ||
+                record.chunkOffset > chunkBytesAvailable || record.chunkCount > (chunkBytesAvailable - record.chunkOffset) / paddedBytes)
+                return false;
+
+            EcsArchetype archetype;
+            archetype.capacity = record.capacity;
+            archetype.chunkBytes = record.chunkBytes;
+            archetype.entityOffset = record.entityOffset;
+            std::fill(archetype.columnOffset, archetype.columnOffset + MAX_COMPONENT_TYPES, 0);
+            for (size_t component = 0; component < componentCount; ++component)
+            {
+                if ((record.mask & (ComponentMask(1) << component)) == 0)
+                    continue;
+                if (!columnFits(record.columnOffset[component], record.capacity, componentSize(localId[component]), record.chunkBytes))
+                    return false;
+                archetype.mask |= ComponentMask(1) << localId[component];
+                archetype.columnOffset[localId[component]] = record.columnOffset[component];
+            }
+            if (componentCount < MAX_COMPONENT_TYPES && (record.mask >> componentCount) != 0)
+                return false;
+
+            for (uint32_t chunkIndex = 0; chunkIndex < record.chunkCount; ++chunkIndex)
+            {
+                EcsChunk chunk;
+                chunk.data = chunkData + size_t(record.chunkOffset) + chunkIndex * paddedBytes;
+                chunk.count = chunkCounts[record.firstChunk + chunkIndex];
+                if (chunk.count == 0 || chunk.count > record.capacity)
+                    return false;
+                archetype.chunks.push_back(std::move(chunk));
+            }
+            archetypes.push_back(std::move(archetype));
+        }
+
+        if (!findSection(file, SNAPSHOT_ENTITIES, reader))
+            return false;
+
+        uint64_t locationCount, freeCount;
+        const EcsWorld::EntityLocation* savedLocations = reader.readCountedArray<EcsWorld::EntityLocation>(locationCount);
+        const Entity* savedFreeEntities = reader.readCountedArray<Entity>(freeCount);
+        if (reader.failed)
+            return false;
+
+        for (uint64_t i = 0; i < locationCount; ++i)
+        {
+            const EcsWorld::EntityLocation& location = savedLocations[i];
+            if (location.archetype != NO_ENTITY && (location.archetype >= archetypes.size() || location.chunk >= archetypes[location.archetype].chunks.size() ||
+                                                    location.row >= archetypes[location.archetype].chunks[location.chunk].count))
+                return false;
+        }
+
+        copyArray(savedLocations, locationCount, locations);
+        freeEntities.assign(savedFreeEntities, savedFreeEntities + freeCount);
+        return true;
+    }
+
+    void clearEphemeris(Ephemeris& ephemeris)
+    {
+        ephemeris.file.close();
+        ephemeris.bodies.clear();
+        ephemeris.storage.clear();
+        ephemeris.coefficients = nullptr;
+    }
+}
+
+bool writeSnapshot(const std::string& filePath, const SolarSystem& system, const SimulationClock& clock)
+{
+    SnapshotWriter writer(filePath);
+    if (!writer.good())
+    {
+        std::cerr << "Failed to create snapshot: " << filePath << std::endl;
+        return false;
+    }
+
+    SnapshotClock clockRecord;
+    std::memset(&clockRecord, 0, sizeof(clockRecord));
+    clockRecord.timeScale = clock.timeScale;
+    clockRecord.referenceRadius = system.referenceRadius;
+    clockRecord.referenceMeanMotion = system.referenceMeanMotion;
+    clockRecord.paused = clock.paused;
+    clockRecord.nbodyEnabled = system.nbodyEnabled;
+    clockRecord.nbodyRunning = system.nbodyRunning;
+    clockRecord.findCollisions = system.findCollisions;
+    writer.beginSection(SNAPSHOT_CLOCK);
+    writer.writeValue(clockRecord);
+    writer.endSection();
+
+    std::string catalog;
+    for (const std::string& path : system.catalog.texturePaths)
+        catalog += path + "\n";
+    writer.beginSection(SNAPSHOT_CATALOG);
+    writer.writeCountedArray(catalog.data(), catalog.size());
+    writer.endSection();
+
+    writeWorld(writer, system.world);
+    writeOrbits(writer, SNAPSHOT_PLANET_ORBITS, system.planetOrbits);
+    writeOrbits(writer, SNAPSHOT_ASTEROID_ORBITS, system.asteroidOrbits);
+    writeOrbits(writer, SNAPSHOT_RING_ORBITS, system.ringAsteroidOrbits);
+
+    writer.beginSection(SNAPSHOT_BODY_DATA);
+    writer.writeCountedArray(system.asteroidSizes.data(), system.asteroidSizes.size());
+    writer.writeCountedArray(system.ringAsteroidSizes.data(), system.ringAsteroidSizes.size());
+    writer.writeCountedArray(system.planetMasses.data(), system.planetMasses.size());
+    writer.endSection();
+
+    writeState(writer, SNAPSHOT_PREVIOUS_STATE, system.previousState);
+    writeState(writer, SNAPSHOT_CURRENT_STATE, system.currentState);
+
+    // The N-body state is only meaningful while the mode runs
+    const NBodyState& nbody = system.nbodyState;
+    SnapshotNBodyHeader nbodyHeader = { system.nbodyRunning ? nbody.size() : 0, system.nbodyRunning ? nbody.massiveCount : 0,
+                                        system.nbodySettings.gravitationalConstant, system.nbodySettings.openingAngle };
+    writer.beginSection(SNAPSHOT_NBODY);
+    writer.writeValue(nbodyHeader);
+    for (const Vec3Array* values : { &nbody.position, &nbody.velocity, &nbody.acceleration })
+    {
+        writer.writeArray(values->x.data(), size_t(nbodyHeader.count));
+        writer.writeArray(values->y.data(), size_t(nbodyHeader.count));
+        writer.writeArray(values->z.data(), size_t(nbodyHeader.count));
+    }
+    writer.writeArray(nbody.mass.data(), size_t(nbodyHeader.count));
+    writer.writeArray(nbody.potential.data(), size_t(nbodyHeader.count));
+    writer.endSection();
+
+    if (!writer.finish())
+    {
+        std::cerr << "Failed to write snapshot: " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshot(const std::string& filePath, const std::string& ephemerisPath, SolarSystem& system, SimulationClock& clock)
+{
+    // Component types are matched by name, so they must all be registered first
+    registerBodyComponents();
+
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    if (!openSnapshot(filePath, *file, true))
+        return false;
+
+    // Parse everything before touching the system, so a bad file leaves it as it was
+    SectionReader reader;
+    SnapshotClock clockRecord;
+    bool valid = findSection(*file, SNAPSHOT_CLOCK, reader);
+    clockRecord = reader.readValue<SnapshotClock>();
+    valid = valid && !reader.failed;
+
+    BodyCatalog catalog;
+    uint64_t catalogLength = 0;
+    const char* catalogText = valid && findSection(*file, SNAPSHOT_CATALOG, reader) ? reader.readCountedArray<char>(catalogLength) : nullptr;
+    valid = valid && catalogText != nullptr;
+    for (size_t start = 0; valid && start < catalogLength;)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(catalogText + start, '\n', size_t(catalogLength) - start));
+        size_t end = newline != nullptr ? size_t(newline - catalogText) : size_t(catalogLength);
+        catalog.texturePaths.push_back(std::string(catalogText + start, end - start));
+        start = end + 1;
+    }
+
+    std::vector<EcsArchetype> archetypes;
+    std::vector<EcsWorld::EntityLocation> locations;
+    std::vector<Entity> freeEntities;
+    valid = valid && readWorld(*file, archetypes, locations, freeEntities);
+
+    KeplerBatch planetOrbits, asteroidOrbits, ringAsteroidOrbits;
+    valid = valid && readOrbits(*file, SNAPSHOT_PLANET_ORBITS, planetOrbits) && readOrbits(*file, SNAPSHOT_ASTEROID_ORBITS, asteroidOrbits) &&
+            readOrbits(*file, SNAPSHOT_RING_ORBITS, ringAsteroidOrbits);
+
+    std::vector<float> asteroidSizes, ringAsteroidSizes;
+    std::vector<double> planetMasses;
+    if (valid && findSection(*file, SNAPSHOT_BODY_DATA, reader))
+    {
+        uint64_t count;
+        const float* sizes = reader.readCountedArray<float>(count);
+        if (sizes != nullptr)
+            copyArray(sizes, count, asteroidSizes);
+        sizes = reader.readCountedArray<float>(count);
+        if (sizes != nullptr)
+            copyArray(sizes, count, ringAsteroidSizes);
+        const double* masses = reader.readCountedArray<double>(count);
+        if (masses != nullptr)
+            planetMasses.assign(masses, masses + count);
+        valid = !reader.failed;
+    }
+    else
+        valid = false;
+
+    SimulationState previousState, currentState;
+    valid = valid && readState(*file, SNAPSHOT_PREVIOUS_STATE, previousState) && readState(*file, SNAPSHOT_CURRENT_STATE, currentState);
+
+    NBodyState nbodyState;
+    SnapshotNBodyHeader nbodyHeader = {};
+    if (valid && findSection(*file, SNAPSHOT_NBODY, reader))
+    {
+        nbodyHeader = reader.readValue<SnapshotNBodyHeader>();
+        readVec3Array(reader, nbodyHeader.count, nbodyState.position);
+        readVec3Array(reader, nbodyHeader.count, nbodyState.velocity);
+        readVec3Array(reader, nbodyHeader.count, nbodyState.acceleration);
+        const double* mass = reader.readArray<double>(nbodyHeader.count);
+        const double* potential = reader.readArray<double>(nbodyHeader.count);
+        if (!reader.failed)
+        {
+            copyArray(mass, nbodyHeader.count, nbodyState.mass);
+            copyArray(potential, nbodyHeader.count, nbodyState.potential);
+            nbodyState.massiveCount = size_t(nbodyHeader.massiveCount);
+        }
+        valid = !reader.failed && nbodyHeader.massiveCount <= nbodyHeader.count;
+    }
+    else
+        valid = false;
+
+    // Every population must agree with its state arrays
+    valid = valid && planetMasses.size() == planetOrbits.size() && asteroidSizes.size() == asteroidOrbits.size() &&
+            ringAsteroidSizes.size() == ringAsteroidOrbits.size() && currentState.planetPositions.size() == planetOrbits.size() &&
+            currentState.asteroidPositions.size() == asteroidOrbits.size() && currentState.ringAsteroidPositions.size() == ringAsteroidOrbits.size() &&
+            (nbodyHeader.count == 0 || nbodyHeader.count == planetOrbits.size() + asteroidOrbits.size());
+    if (!valid)
+    {
+        std::cerr << "Malformed snapshot: " << filePath << std::endl;
+        return false;
+    }
+
+    // Replace the world and orbits before the mapping that may back the old ones
+    system.world.restore(std::move(archetypes), std::move(locations), std::move(freeEntities));
+    system.catalog = std::move(catalog);
+    system.referenceRadius = clockRecord.referenceRadius;
+    system.referenceMeanMotion = clockRecord.referenceMeanMotion;
+    system.planetOrbits = planetOrbits;
+    system.asteroidOrbits = asteroidOrbits;
+    system.ringAsteroidOrbits = ringAsteroidOrbits;
+    system.asteroidSizes = std::move(asteroidSizes);
+    system.ringAsteroidSizes = std::move(ringAsteroidSizes);
+    system.planetMasses = std::move(planetMasses);
+    system.previousState = std::move(previousState);
+    system.currentState = std::move(currentState);
+
+    system.nbodyEnabled = clockRecord.nbodyEnabled != 0;
+    system.nbodyRunning = clockRecord.nbodyRunning != 0 && nbodyHeader.count > 0;
+    system.nbodyState = std::move(nbodyState);
+    system.nbodySettings.gravitationalConstant = nbodyHeader.gravitationalConstant;
+    system.nbodySettings.openingAngle = nbodyHeader.openingAngle;
+
+    // Collisions are found again on the next tick
+    system.findCollisions = clockRecord.findCollisions != 0;
+    system.beltCollisions.clear();
+    system.ringCollisions.clear();
+    system.snapshotFile = std::move(file);
+
+    clearEphemeris(system.planetEphemeris);
+    if (!ephemerisPath.empty())
+        loadPlanetEphemeris(ephemerisPath, system.planetOrbits, system.planetEphemeris);
+
+    clock.timeScale = clockRecord.timeScale;
+    clock.paused = clockRecord.paused != 0;
+    return true;
+}
+
+bool diffSnapshots(const std::string& firstPath, const std::string& secondPath, std::ostream& report)
+{
+    MappedFile first, second;
+    if (!openSnapshot(firstPath, first, false) || !openSnapshot(secondPath, second, false))
+        return false;
+
+    bool identical = true;
+    for (uint32_t id = SNAPSHOT_CLOCK; id <= SNAPSHOT_SECTION_COUNT; ++id)
+    {
+        SectionReader a, b;
+        bool hasFirst = findSection(first, SnapshotSectionId(id), a);
+        bool hasSecond = findSection(second, SnapshotSectionId(id), b);
+        if (!hasFirst && !hasSecond)
+            continue;
+
+        size_t sizeA = a.end - a.position, sizeB = b.end - b.position;
+        if (hasFirst != hasSecond || sizeA != sizeB || std::memcmp(a.file + a.position, b.file + b.position, sizeA) != 0)
+        {
+            report << "Snapshot section differs: " << SECTION_NAMES[id - 1] << std::endl;
+            identical = false;
+        }
+    }
+    return identical;
+}
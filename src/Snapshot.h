@@ -0,0 +1,119 @@
+#pragma once
+
+#include "SolarSystem.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Binary snapshot of a whole solar system: the clock, the ECS world, the orbit batches and the
+// last two states. Every section, and every array within a section, starts on a 64-byte boundary,
+// so a restore maps the file and uses the orbit columns and ECS chunks where they lie instead of
+// parsing them. Unused bytes are written as zeros, so equal states give byte-identical files.
+//
+// File layout (little-endian):
+//   SnapshotFileHeader
+//   SnapshotSection[sectionCount]
+//   sections, in the order of SnapshotSectionId
+const char SNAPSHOT_MAGIC[8] = { 'S', 'O', 'L', 'S', 'N', 'A', 'P', '1' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_ALIGNMENT = 64;
+
+// Default file for the app's save and load buttons
+const std::string SNAPSHOT_PATH = "snapshot.bin";
+
+enum SnapshotSectionId : uint32_t
+{
+    SNAPSHOT_CLOCK = 1,         // SnapshotClock
+    SNAPSHOT_CATALOG,           // uint64 length, texture paths separated by '\n'
+    SNAPSHOT_COMPONENTS,        // uint64 count, SnapshotComponent[count]
+    SNAPSHOT_ARCHETYPES,        // uint64 count, SnapshotArchetype[count], uint32 entities per chunk[]
+    SNAPSHOT_CHUNKS,            // Chunk images, each archetype's padded to a multiple of 64 bytes
+    SNAPSHOT_ENTITIES,          // uint64 count, entity locations[count], uint64 count, free entities[count]
+    SNAPSHOT_PLANET_ORBITS,     // uint64 count, then the KeplerBatch columns in declaration order
+    SNAPSHOT_ASTEROID_ORBITS,
+    SNAPSHOT_RING_ORBITS,
+    SNAPSHOT_BODY_DATA,         // uint64 counts and arrays of asteroid sizes, ring sizes and planet masses
+    SNAPSHOT_PREVIOUS_STATE,    // SnapshotStateHeader, then x, y, z of the planets, belt and ring
+    SNAPSHOT_CURRENT_STATE,
+    SNAPSHOT_NBODY,             // SnapshotNBodyHeader, then position, velocity, acceleration x, y, z, mass, potential
+    SNAPSHOT_SECTION_COUNT = SNAPSHOT_NBODY
+};
+
+struct SnapshotFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+};
+
+struct SnapshotSection
+{
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;    // From the start of the file, a multiple of SNAPSHOT_ALIGNMENT
+    uint64_t size;
+};
+
+struct SnapshotClock
+{
+    double timeScale;
+    double referenceRadius;
+    double referenceMeanMotion;
+    uint8_t paused;
+    uint8_t nbodyEnabled;
+    uint8_t nbodyRunning;
+    uint8_t findCollisions;
+    uint32_t reserved;
+};
+
+// Component types are matched by name, since ids depend on registration order
+struct SnapshotComponent
+{
+    char name[56];
+    uint64_t size;
+};
+
+// An archetype's chunk layout, in file component ids
+struct SnapshotArchetype
+{
+    uint64_t mask;
+    uint32_t capacity;
+    uint32_t chunkBytes;
+    uint32_t entityOffset;
+    uint32_t chunkCount;
+    uint64_t firstChunk;        // Index of the archetype's first entry in the entities-per-chunk array
+    uint64_t chunkOffset;       // Offset of its first chunk image in the chunk section
+    uint32_t columnOffset[MAX_COMPONENT_TYPES];
+};
+
+struct SnapshotStateHeader
+{
+    double time;
+    uint64_t planetCount;
+    uint64_t asteroidCount;
+    uint64_t ringAsteroidCount;
+};
+
+struct SnapshotNBodyHeader
+{
+    uint64_t count;
+    uint64_t massiveCount;
+    double gravitationalConstant;
+    double openingAngle;
+};
+
+// Function to write a snapshot of a solar system and its clock. Returns false on failure.
+bool writeSnapshot(const std::string& filePath, const SolarSystem& system, const SimulationClock& clock);
+
+// Function to restore a solar system and clock from a snapshot. The file stays mapped
+// copy-on-write: the orbit batches view it and the ECS chunks live in it, so restoring costs
+// little more than copying the state arrays. The planet ephemeris is not part of a snapshot and
+// is loaded from ephemerisPath as createSolarSystem does (empty for none). Returns false, leaving
+// the system untouched, if the file is missing, malformed or written by a build with other components.
+bool loadSnapshot(const std::string& filePath, const std::string& ephemerisPath, SolarSystem& system, SimulationClock& clock);
+
+// Function to compare two snapshots section by section, for determinism checks. Writes the name
+// of every differing section to report and returns true if the files are identical.
+bool diffSnapshots(const std::string& firstPath, const std::string& secondPath, std::ostream& report);
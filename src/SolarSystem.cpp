@@ -0,0 +1,279 @@
+#include "SolarSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+
+static const double PI = 3.14159265358979323846;
+
+// Function to generate random float between min and max
+static float randomFloat(float min, float max)
+{
+    return min + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (max - min)));
+}
+
+// Function to get the orbit that generated orbits are anchored to by Kepler's third law
+static bool referenceOrbit(EcsWorld& world, double& radius, double& meanMotion)
+{
+    Entity reference = findBody(world, REFERENCE_BODY);
+    if (reference == NO_ENTITY || !world.has<Orbit>(reference) || world.get<Orbit>(reference)->elements.semiMajorAxis <= 0.0)
+    {
+        std::cerr << "Missing reference body: " << REFERENCE_BODY << std::endl;
+        return false;
+    }
+
+    radius = world.get<Orbit>(reference)->elements.semiMajorAxis;
+    meanMotion = world.get<Orbit>(reference)->elements.meanMotion;
+    return true;
+}
+
+// Function to create a belt asteroid entity
+static void addBeltAsteroid(EcsWorld& world, uint32_t slot, uint32_t texture, const OrbitalElements& elements)
+{
+    world.create(BeltAsteroid(), StateSlot{ slot }, Orbit{ elements }, Appearance{ texture, randomFloat(ASTEROID_MIN_RADIUS, ASTEROID_MAX_RADIUS) });
+}
+
+// Function to generate the asteroid belt entities
+static void generateAsteroids(const SolarSystemSettings& settings, SolarSystem& system)
+{
+    uint32_t texture = textureIndex(system.catalog, ASTEROID_TEXTURE_PATH);
+    uint32_t slot = 0;
+
+    for (int i = 0; i < settings.asteroidCount; ++i)
+    {
+        OrbitalElements elements;
+        elements.semiMajorAxis = randomFloat(BELT_INNER_RADIUS, BELT_OUTER_RADIUS);
+        elements.eccentricity = randomFloat(0.0f, ASTEROID_MAX_ECCENTRICITY);
+        elements.inclination = randomFloat(0.0f, ASTEROID_MAX_INCLINATION) * PI / 180.0;
+        elements.ascendingNode = randomFloat(0.0f, 2.0f * PI);
+        elements.argumentOfPeriapsis = randomFloat(0.0f, 2.0f * PI);
+        elements.meanAnomalyAtEpoch = randomFloat(0.0f, 2.0f * PI);
+
+        // Kepler's third law, anchored to the reference orbit
+        elements.meanMotion = meanMotionForSemiMajorAxis(elements.semiMajorAxis, system.referenceRadius, system.referenceMeanMotion);
+
+        addBeltAsteroid(system.world, slot++, texture, elements);
+    }
+
+    // Append any catalogued minor bodies
+    std::vector<OrbitalElements> minorBodies;
+    if (!settings.minorBodiesPath.empty())
+        loadOrbitalElements(settings.minorBodiesPath, minorBodies, system.referenceRadius, system.referenceMeanMotion);
+    for (const OrbitalElements& elements : minorBodies)
+        addBeltAsteroid(system.world, slot++, texture, elements);
+}
+
+// Function to generate the entities of Saturn's ring, orbiting the ring frame
+static void generateRingAsteroids(const SolarSystemSettings& settings, SolarSystem& system)
+{
+    uint32_t texture = textureIndex(system.catalog, ASTEROID_TEXTURE_PATH);
+
+    for (int i = 0; i < settings.ringAsteroidCount; ++i)
+    {
+        OrbitalElements elements;
+        elements.semiMajorAxis = randomFloat(RING_INNER_RADIUS, RING_OUTER_RADIUS);
+        elements.eccentricity = 0.0; // Ring particles stay on near-circular orbits
+        elements.inclination = asin(randomFloat(0.0f, RING_THICKNESS) / elements.semiMajorAxis); // Small vertical variation for thickness
+        elements.ascendingNode = randomFloat(0.0f, 2.0f * PI);
+        elements.argumentOfPeriapsis = 0.0;
+        elements.meanAnomalyAtEpoch = randomFloat(0.0f, 2.0f * PI);
+        elements.meanMotion = randomFloat(RING_ASTEROID_MIN_ORBIT_SPEED, RING_ASTEROID_MAX_ORBIT_SPEED);
+
+        system.world.create(RingParticle(), StateSlot{ uint32_t(i) }, Orbit{ elements },
+                            Appearance{ texture, randomFloat(RING_ASTEROID_MIN_RADIUS, RING_ASTEROID_MAX_RADIUS) });
+    }
+}
+
+// Function to set up the N-body state from the sun, planets and belt at the given time
+static void seedNBodyState(SolarSystem& system, double time)
+{
+    const KeplerBatch& planetOrbits = system.planetOrbits;
+    const std::vector<double>& planetMasses = system.planetMasses;
+
+    Vec3Array planetPositions, planetVelocities, asteroidPositions, asteroidVelocities;
+    propagateOrbits(planetOrbits, time, planetPositions, &planetVelocities);
+    propagateOrbits(system.asteroidOrbits, time, asteroidPositions, &asteroidVelocities);
+
+    // The sun's gravity is chosen so the belt's Keplerian mean motions are consistent
+    double sunGM = system.referenceMeanMotion * system.referenceMeanMotion * pow(system.referenceRadius, 3.0);
+    system.nbodySettings.gravitationalConstant = sunGM;
+
+    // Planets move at the speed gravity gives their orbit rather than the display speed
+    std::vector<glm::dvec3> velocities(planetPositions.size(), glm::dvec3(0.0));
+    glm::dvec3 momentum(0.0);
+    for (size_t i = 1; i < planetPositions.size(); ++i)
+    {
+        if (planetOrbits.semiMajorAxis[i] <= 0.0 || planetOrbits.meanMotion[i] <= 0.0)
+            continue;
+        double gravityMeanMotion = sqrt(sunGM / pow(planetOrbits.semiMajorAxis[i], 3.0));
+        velocities[i] = planetVelocities[i] * (gravityMeanMotion / planetOrbits.meanMotion[i]);
+        momentum += planetMasses[i] * velocities[i];
+    }
+
+    // Give the sun the opposite momentum so the system does not drift
+    velocities[0] = -momentum / planetMasses[0];
+
+    NBodyState& state = system.nbodyState;
+    state = NBodyState();
+    for (size_t i = 0; i < planetPositions.size(); ++i)
+        addBody(state, planetPositions[i], velocities[i], planetMasses[i], true);
+
+    double asteroidMass = NBODY_BELT_MASS / std::max<size_t>(asteroidPositions.size(), 1);
+    for (size_t i = 0; i < asteroidPositions.size(); ++i)
+        addBody(state, asteroidPositions[i], asteroidVelocities[i], asteroidMass, false);
+}
+
+// Function to copy the N-body state back into the planet and asteroid position arrays
+static void readNBodyPositions(const NBodyState& state, Vec3Array& planetPositions, Vec3Array& asteroidPositions)
+{
+    planetPositions.resize(state.massiveCount);
+    asteroidPositions.resize(state.size() - state.massiveCount);
+
+    for (size_t i = 0; i < state.size(); ++i)
+    {
+        Vec3Array& target = i < state.massiveCount ? planetPositions : asteroidPositions;
+        size_t index = i < state.massiveCount ? i : i - state.massiveCount;
+        target.x[index] = state.position.x[i];
+        target.y[index] = state.position.y[i];
+        target.z[index] = state.position.z[i];
+    }
+}
+
+// Function to find asteroids that touch (ring positions are relative to Saturn)
+static void updateCollisions(SolarSystem& system)
+{
+    buildSpatialHash(system.currentState.asteroidPositions, BELT_HASH_CELL_SIZE, system.beltHash);
+    findCollisions(system.beltHash, system.asteroidSizes, system.beltCollisions);
+    buildSpatialHash(system.currentState.ringAsteroidPositions, RING_HASH_CELL_SIZE, system.ringHash);
+    findCollisions(system.ringHash, system.ringAsteroidSizes, system.ringCollisions);
+}
+
+bool createSolarSystem(const SolarSystemSettings& settings, SolarSystem& system)
+{
+    StartupProfiler* profiler = settings.profiler;
+    {
+        ScopedStartupPhase phase(profiler, "bodies");
+        if (!loadBodies(settings.bodiesPath, system.world, system.catalog) ||
+            !referenceOrbit(system.world, system.referenceRadius, system.referenceMeanMotion))
+            return false;
+    }
+
+    // Generate the asteroid belt and Saturn's ring
+    srand(settings.seed != 0 ? settings.seed : static_cast<unsigned int>(time(0))); // Seed for random number generation
+    {
+        ScopedStartupPhase phase(profiler, "asteroid-belt");
+        generateAsteroids(settings, system);
+    }
+    {
+        ScopedStartupPhase phase(profiler, "ring-asteroids");
+        generateRingAsteroids(settings, system);
+    }
+
+    ScopedStartupPhase phase(profiler, "orbits-and-ephemeris");
+    gatherOrbits<MajorBody>(system.world, system.planetOrbits);
+    gatherOrbits<BeltAsteroid>(system.world, system.asteroidOrbits);
+    gatherRadii<BeltAsteroid>(system.world, system.asteroidSizes);
+    gatherOrbits<RingParticle>(system.world, system.ringAsteroidOrbits);
+    gatherRadii<RingParticle>(system.world, system.ringAsteroidSizes);
+
+    // Masses for the N-body mode, in planet order
+    system.planetMasses.clear();
+    for (Entity body : populationBySlot<MajorBody>(system.world))
+        system.planetMasses.push_back(system.world.get<Mass>(body)->solarMasses);
+
+    if (!settings.ephemerisPath.empty())
+        loadPlanetEphemeris(settings.ephemerisPath, system.planetOrbits, system.planetEphemeris);
+
+    system.findCollisions = settings.findCollisions;
+    seekSolarSystem(system, 0.0);
+    return true;
+}
+
+void stepSolarSystem(SolarSystem& system, double tickLength)
+{
+    std::swap(system.previousState, system.currentState);
+    SimulationState& currentState = system.currentState;
+    currentState.time = system.previousState.time + tickLength;
+
+    if (system.nbodyEnabled)
+    {
+        // Start from the current Keplerian state when the mode is switched on
+        if (!system.nbodyRunning)
+        {
+            seedNBodyState(system, system.previousState.time);
+            computeGravity(system.nbodyState, system.nbodySettings, system.nbodyTree);
+            system.nbodyRunning = true;
+        }
+
+        // Split warped ticks into several leapfrog steps, up to a limit
+        int substeps = std::max(std::min(int(ceil(tickLength / NBODY_MAX_TIME_STEP)), NBODY_MAX_SUBSTEPS), 1);
+        for (int substep = 0; substep < substeps; ++substep)
+            leapfrogStep(system.nbodyState, tickLength / substeps, system.nbodySettings, system.nbodyTree, &system.nbodyTimings);
+
+        readNBodyPositions(system.nbodyState, currentState.planetPositions, currentState.asteroidPositions);
+        propagateOrbits(system.ringAsteroidOrbits, currentState.time, currentState.ringAsteroidPositions);
+    }
+    else
+    {
+        system.nbodyRunning = false;
+
+        // Propagate every body along its orbit
+        evaluateKeplerState(system.planetOrbits, system.asteroidOrbits, system.ringAsteroidOrbits, currentState.time, currentState, &system.planetEphemeris);
+    }
+
+    if (system.findCollisions)
+        updateCollisions(system);
+}
+
+void seekSolarSystem(SolarSystem& system, double time)
+{
+    evaluateKeplerState(system.planetOrbits, system.asteroidOrbits, system.ringAsteroidOrbits, time, system.currentState, &system.planetEphemeris);
+    system.previousState = system.currentState;
+    system.nbodyRunning = false;
+
+    if (system.findCollisions)
+        updateCollisions(system);
+}
+
+void buildPlanetEphemeris(const KeplerBatch& orbits, Ephemeris& ephemeris)
+{
+    std::vector<double> segmentLengths;
+    for (size_t i = 0; i < orbits.size(); ++i)
+    {
+        double period = orbits.meanMotion[i] > 0.0 ? 2.0 * PI / orbits.meanMotion[i] : EPHEMERIS_SPAN; // The sun does not move
+        segmentLengths.push_back(period / EPHEMERIS_SEGMENTS_PER_ORBIT);
+    }
+
+    fitEphemeris([&](size_t body, double time)
+    {
+        return orbitPosition(orbits, body, time);
+    }, segmentLengths, 0.0, EPHEMERIS_SPAN, EPHEMERIS_COEFFICIENTS, ephemeris);
+}
+
+void loadPlanetEphemeris(const std::string& filePath, const KeplerBatch& orbits, Ephemeris& ephemeris)
+{
+    // Orbits agreeing at time zero can still differ in their periods, so the cached table is
+    // checked at times across the whole span
+    if (loadEphemeris(filePath, ephemeris) && ephemeris.size() == orbits.size() &&
+        ephemeris.startTime == 0.0 && ephemeris.endTime == EPHEMERIS_SPAN)
+    {
+        bool upToDate = true;
+        Vec3Array positions;
+        for (int sample = 0; sample <= EPHEMERIS_CHECK_SAMPLES && upToDate; ++sample)
+        {
+            double time = EPHEMERIS_SPAN * sample / EPHEMERIS_CHECK_SAMPLES;
+            propagateOrbits(orbits, time, positions);
+            for (size_t i = 0; i < orbits.size(); ++i)
+                upToDate = upToDate && glm::length(ephemerisPosition(ephemeris, i, time) - positions[i]) < EPHEMERIS_TOLERANCE;
+        }
+        if (upToDate)
+            return;
+    }
+
+    std::cout << "Generating planet ephemeris: " << filePath << std::endl;
+    buildPlanetEphemeris(orbits, ephemeris);
+    if (!writeEphemeris(filePath, ephemeris))
+        std::cerr << "Failed to write ephemeris: " << filePath << std::endl;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Bodies.h"
+#include "Ecs.h"
+#include "Ephemeris.h"
+#include "Kepler.h"
+#include "MappedFile.h"
+#include "NBody.h"
+#include "Simulation.h"
+#include "SpatialHash.h"
+#include "StartupProfiler.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Everything the simulation needs, without a window or GL context. The app renders it; the
+// tests and the benchmark step it directly.
+
+// The sun, planets and moons are data (see loadBodies)
+const std::string BODIES_PATH = "res/bodies.txt";
+const std::string REFERENCE_BODY = "Earth"; // Generated orbits follow Kepler's third law from this body's orbit
+const std::string RING_PARENT = "Saturn";
+const std::string ASTEROID_TEXTURE_PATH = "textures/asteroid.jpg";
+
+// Define constants for the asteroid belt
+const int NUM_ASTEROIDS = 5000;
+const float ASTEROID_MIN_RADIUS = 0.001f;
+const float ASTEROID_MAX_RADIUS = 0.030f;
+const float BELT_INNER_RADIUS = 10.0f; // Between Mars (8.0f) and Jupiter (14.0f)
+const float BELT_OUTER_RADIUS = 12.0f;
+const float ASTEROID_MAX_ECCENTRICITY = 0.08f;
+const float ASTEROID_MAX_INCLINATION = 2.5f; // In degrees, gives roughly the old +-0.5 vertical spread
+
+// Optional file with extra minor-body orbits appended to the belt (see loadOrbitalElements)
+const std::string MINOR_BODIES_PATH = "res/orbits/minor_bodies.txt";
+
+// Precomputed planet ephemeris, rebuilt from the orbits when missing or out of date
+const std::string PLANET_EPHEMERIS_PATH = "res/planets.eph";
+const double EPHEMERIS_SPAN = 1.0e5; // Simulated seconds covered, starting at time zero
+const int EPHEMERIS_COEFFICIENTS = 12; // Chebyshev terms per axis and segment
+const double EPHEMERIS_SEGMENTS_PER_ORBIT = 8.0; // Shorter segments for faster planets
+const double EPHEMERIS_TOLERANCE = 1e-6; // Largest allowed difference from the orbits at a check time
+const int EPHEMERIS_CHECK_SAMPLES = 16; // Times across the span a cached ephemeris is checked at
+
+// N-body gravity mode parameters
+const double NBODY_BELT_MASS = 1.2e-9; // Total mass of the belt (in solar masses)
+const double NBODY_MAX_TIME_STEP = 1.0 / 60.0; // Longest leapfrog step (in simulated seconds)
+const int NBODY_MAX_SUBSTEPS = 16; // Leapfrog steps per tick at most; time warp beyond this lengthens the steps
+
+// Constants for Saturn's ring
+const int NUM_RING_ASTEROIDS = 5000; // Number of small asteroids in the ring
+const float RING_INNER_RADIUS = 0.75f; // Inner radius of the ring
+const float RING_OUTER_RADIUS = 1.0f; // Outer radius of the ring
+const float RING_ASTEROID_MIN_RADIUS = 0.001f; // Minimum radius of the asteroids
+const float RING_ASTEROID_MAX_RADIUS = 0.010f; // Maximum radius of the asteroids
+const float RING_ASTEROID_MIN_ORBIT_SPEED = 0.006f; // Minimum orbit speed of the asteroids (in radians per second)
+const float RING_ASTEROID_MAX_ORBIT_SPEED = 0.06f; // Maximum orbit speed of the asteroids (in radians per second)
+const float RING_THICKNESS = 0.01f; // Maximum height of the asteroids above or below the ring plane
+
+// Spatial hash parameters; cells must be at least as wide as two of the largest asteroids
+const double BELT_HASH_CELL_SIZE = 2.0 * ASTEROID_MAX_RADIUS;
+const double RING_HASH_CELL_SIZE = 2.0 * RING_ASTEROID_MAX_RADIUS;
+
+struct SolarSystemSettings
+{
+    std::string bodiesPath = BODIES_PATH;
+    std::string minorBodiesPath = MINOR_BODIES_PATH;
+    std::string ephemerisPath = PLANET_EPHEMERIS_PATH; // Empty to always propagate the planet orbits
+    int asteroidCount = NUM_ASTEROIDS;
+    int ringAsteroidCount = NUM_RING_ASTEROIDS;
+    unsigned int seed = 0; // Seed for the generated belt and ring; 0 seeds from the clock
+    bool findCollisions = true; // Rebuild the spatial hashes and find touching asteroids every tick
+    StartupProfiler* profiler = nullptr; // Times the steps of createSolarSystem as startup phases when set
+};
+
+struct SolarSystem
+{
+    // Snapshot the world chunks and orbit batches live in after loadSnapshot (see Snapshot.h)
+    std::unique_ptr<MappedFile> snapshotFile;
+
+    // Every body as an entity, and the texture paths their Appearance refers to
+    EcsWorld world;
+    BodyCatalog catalog;
+
+    // Orbit that generated orbits are anchored to by Kepler's third law
+    double referenceRadius = 0.0;
+    double referenceMeanMotion = 0.0;
+
+    // Each population gathered in StateSlot order for the propagator
+    KeplerBatch planetOrbits;
+    KeplerBatch asteroidOrbits;
+    KeplerBatch ringAsteroidOrbits;  // Relative to the ring's parent
+    std::vector<float> asteroidSizes;
+    std::vector<float> ringAsteroidSizes;
+    std::vector<double> planetMasses;
+
+    // Planet positions come from the precomputed table while it covers the simulation time
+    Ephemeris planetEphemeris;
+
+    // State for the optional N-body gravity mode
+    bool nbodyEnabled = false;  // Integrate the belt with mutual gravity instead of fixed orbits
+    bool nbodyRunning = false;
+    NBodyState nbodyState;
+    BarnesHutSettings nbodySettings;
+    BarnesHutTree nbodyTree;
+    NBodyTimings nbodyTimings;
+
+    // Proximity structures over the belt and the ring, rebuilt every tick
+    bool findCollisions = true;
+    SpatialHash beltHash, ringHash;
+    std::vector<CollisionPair> beltCollisions, ringCollisions;
+
+    // The last two simulation ticks
+    SimulationState previousState, currentState;
+};
+
+// Function to load the bodies, generate the belt and ring and evaluate the state at time zero.
+// Returns false if the body file is missing or malformed, or lacks the reference body.
+bool createSolarSystem(const SolarSystemSettings& settings, SolarSystem& system);
+
+// Function to advance the simulation by one tick of the given simulated length
+void stepSolarSystem(SolarSystem& system, double tickLength);
+
+// Function to jump straight to a time by evaluating every orbit there; the N-body mode restarts from it
+void seekSolarSystem(SolarSystem& system, double time);
+
+// Function to fit the planet ephemeris to the Keplerian orbits
+void buildPlanetEphemeris(const KeplerBatch& orbits, Ephemeris& ephemeris);
+
+// Function to map the planet ephemeris, regenerating the file if it does not match the orbits
+void loadPlanetEphemeris(const std::string& filePath, const KeplerBatch& orbits, Ephemeris& ephemeris);
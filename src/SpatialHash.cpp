@@ -0,0 +1,405 @@
+#include "SpatialHash.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Table size limits; the table gets about two slots per particle
+static const int MIN_TABLE_BITS = 10;
+static const int MAX_TABLE_BITS = 24;
+
+// The sort handles slots in two 12-bit digits
+static const int RADIX_BITS = 12;
+static const size_t RADIX_BUCKETS = size_t(1) << RADIX_BITS;
+
+// Particles per chunk for the parallel passes
+static const size_t PARTICLE_CHUNK = 4096;
+
+// Grid cell of a position along one axis
+static inline int64_t cellCoordinate(double value, double inverseCellSize)
+{
+    return static_cast<int64_t>(std::floor(value * inverseCellSize));
+}
+
+// Function to hash a grid cell into a table slot. Only the row (y, z) is hashed (Teschner et al.
+// primes folded with a multiplicative hash); x is added on top, so the cells along a row land in
+// consecutive slots and a 3x3x3 neighbourhood is nine contiguous slot ranges.
+static inline uint64_t rowSlot(int64_t cellY, int64_t cellZ, int tableBits)
+{
+    uint64_t h = (uint64_t(cellY) * 19349663u) ^ (uint64_t(cellZ) * 83492791u);
+    return (h * 0x9E3779B97F4A7C15ull) >> (64 - tableBits);
+}
+
+static inline uint32_t slotOf(int64_t cellX, int64_t cellY, int64_t cellZ, int tableBits)
+{
+    uint64_t mask = (uint64_t(1) << tableBits) - 1;
+    return static_cast<uint32_t>((rowSlot(cellY, cellZ, tableBits) + uint64_t(cellX)) & mask);
+}
+
+// Range of table slots [begin, end)
+struct SlotRange
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Function to collect the slots covering a box of cells as sorted, non-overlapping ranges.
+// Rows that wrap around the end of the table are split, and rows that share slots are merged
+// so no particle is visited twice.
+static void collectSlotRanges(int tableBits, const int64_t minCell[3], const int64_t maxCell[3], std::vector<SlotRange>& ranges)
+{
+    uint64_t tableSize = uint64_t(1) << tableBits;
+    uint64_t rowLength = std::min<uint64_t>(uint64_t(maxCell[0] - minCell[0] + 1), tableSize);
+
+    ranges.clear();
+    for (int64_t cellY = minCell[1]; cellY <= maxCell[1]; ++cellY)
+    {
+        for (int64_t cellZ = minCell[2]; cellZ <= maxCell[2]; ++cellZ)
+        {
+            uint64_t first = (rowSlot(cellY, cellZ, tableBits) + uint64_t(minCell[0])) & (tableSize - 1);
+            uint64_t last = first + rowLength;
+            if (last <= tableSize)
+            {
+                ranges.push_back({ uint32_t(first), uint32_t(last) });
+            }
+            else
+            {
+                ranges.push_back({ uint32_t(first), uint32_t(tableSize) });
+                ranges.push_back({ 0, uint32_t(last - tableSize) });
+            }
+        }
+    }
+
+    // Usually only nine rows, where insertion sort beats std::sort
+    if (ranges.size() <= 32)
+    {
+        for (size_t i = 1; i < ranges.size(); ++i)
+        {
+            SlotRange range = ranges[i];
+            size_t j = i;
+            for (; j > 0 && ranges[j - 1].begin > range.begin; --j)
+                ranges[j] = ranges[j - 1];
+            ranges[j] = range;
+        }
+    }
+    else
+    {
+        std::sort(ranges.begin(), ranges.end(), [](const SlotRange& a, const SlotRange& b) { return a.begin < b.begin; });
+    }
+
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); ++i)
+    {
+        if (ranges[i].begin <= ranges[merged].end)
+            ranges[merged].end = std::max(ranges[merged].end, ranges[i].end);
+        else
+            ranges[++merged] = ranges[i];
+    }
+    if (!ranges.empty())
+        ranges.resize(merged + 1);
+}
+
+// Function to sort the particles by slot with a parallel LSD counting sort, keeping equal slots in input order
+static void sortBySlot(SpatialHash& hash)
+{
+    size_t count = hash.keys.size();
+    size_t chunkCount = std::min<size_t>(parallelThreadCount() * 4, std::max<size_t>(count / PARTICLE_CHUNK, 1));
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    std::vector<size_t> histograms(chunkCount * RADIX_BUCKETS);
+
+    hash.keyScratch.resize(count);
+    hash.orderScratch.resize(count);
+
+    for (int shift = 0; shift < hash.tableBits; shift += RADIX_BITS)
+    {
+        std::fill(histograms.begin(), histograms.end(), 0);
+
+        // Count digits per chunk
+        parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+        {
+            for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+            {
+                size_t* histogram = &histograms[chunk * RADIX_BUCKETS];
+                size_t end = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                    ++histogram[(hash.keys[i] >> shift) & (RADIX_BUCKETS - 1)];
+            }
+        });
+
+        // Turn counts into output offsets, digit-major so the sort stays stable
+        size_t offset = 0;
+        for (size_t digit = 0; digit < RADIX_BUCKETS; ++digit)
+        {
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                size_t& slot = histograms[chunk * RADIX_BUCKETS + digit];
+                size_t digitCount = slot;
+                slot = offset;
+                offset += digitCount;
+            }
+        }
+
+        // Scatter
+        parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+        {
+            for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+            {
+                size_t* offsets = &histograms[chunk * RADIX_BUCKETS];
+                size_t end = std::min(count, (chunk + 1) * chunkSize);
+                for (size_t i = chunk * chunkSize; i < end; ++i)
+                {
+                    size_t destination = offsets[(hash.keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+                    hash.keyScratch[destination] = hash.keys[i];
+                    hash.orderScratch[destination] = hash.order[i];
+                }
+            }
+        });
+
+        hash.keys.swap(hash.keyScratch);
+        hash.order.swap(hash.orderScratch);
+    }
+}
+
+void buildSpatialHash(const Vec3Array& positions, double cellSize, SpatialHash& hash)
+{
+    size_t count = positions.size();
+    double inverseCellSize = 1.0 / cellSize;
+
+    int tableBits = MIN_TABLE_BITS;
+    while (tableBits < MAX_TABLE_BITS && (size_t(1) << tableBits) < 2 * count)
+        ++tableBits;
+    size_t tableSize = size_t(1) << tableBits;
+
+    hash.cellSize = cellSize;
+    hash.tableBits = tableBits;
+    hash.keys.resize(count);
+    hash.order.resize(count);
+
+    // Slot of every particle
+    parallelFor(count, PARTICLE_CHUNK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            hash.keys[i] = slotOf(cellCoordinate(positions.x[i], inverseCellSize),
+                                  cellCoordinate(positions.y[i], inverseCellSize),
+                                  cellCoordinate(positions.z[i], inverseCellSize), tableBits);
+            hash.order[i] = static_cast<uint32_t>(i);
+        }
+    });
+
+    sortBySlot(hash);
+
+    // Copy positions into sorted order and mark where each slot starts. Every sorted particle
+    // fills the start of its own slot and of any empty slots just before it.
+    hash.x.resize(count);
+    hash.y.resize(count);
+    hash.z.resize(count);
+    hash.cellStart.resize(tableSize + 1);
+    if (count == 0)
+        std::fill(hash.cellStart.begin(), hash.cellStart.end(), 0);
+
+    parallelFor(count, PARTICLE_CHUNK, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            uint32_t source = hash.order[i];
+            hash.x[i] = positions.x[source];
+            hash.y[i] = positions.y[source];
+            hash.z[i] = positions.z[source];
+
+            size_t firstSlot = i == 0 ? 0 : size_t(hash.keys[i - 1]) + 1;
+            for (size_t slot = firstSlot; slot <= hash.keys[i]; ++slot)
+                hash.cellStart[slot] = static_cast<uint32_t>(i);
+
+            // Slots after the last particle are empty
+            if (i == count - 1)
+            {
+                for (size_t slot = size_t(hash.keys[i]) + 1; slot <= tableSize; ++slot)
+                    hash.cellStart[slot] = static_cast<uint32_t>(count);
+            }
+        }
+    });
+}
+
+// Function to get the cell box around a sphere, or return false if it spans more cells than
+// there are particles (a linear scan is cheaper then)
+static bool cellBox(const SpatialHash& hash, const glm::dvec3& center, double radius, int64_t minCell[3], int64_t maxCell[3])
+{
+    double inverseCellSize = 1.0 / hash.cellSize;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        minCell[axis] = cellCoordinate(center[axis] - radius, inverseCellSize);
+        maxCell[axis] = cellCoordinate(center[axis] + radius, inverseCellSize);
+    }
+
+    double cells = double(maxCell[0] - minCell[0] + 1) * double(maxCell[1] - minCell[1] + 1) * double(maxCell[2] - minCell[2] + 1);
+    return cells <= double(hash.size());
+}
+
+size_t queryRadius(const SpatialHash& hash, const glm::dvec3& center, double radius, std::vector<uint32_t>& results)
+{
+    size_t found = 0;
+    double radiusSquared = radius * radius;
+
+    auto testRange = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            double dx = hash.x[i] - center.x, dy = hash.y[i] - center.y, dz = hash.z[i] - center.z;
+            if (dx * dx + dy * dy + dz * dz <= radiusSquared)
+            {
+                results.push_back(hash.order[i]);
+                ++found;
+            }
+        }
+    };
+
+    int64_t minCell[3], maxCell[3];
+    if (!cellBox(hash, center, radius, minCell, maxCell))
+    {
+        testRange(0, hash.size());
+        return found;
+    }
+
+    std::vector<SlotRange> ranges;
+    collectSlotRanges(hash.tableBits, minCell, maxCell, ranges);
+    for (const SlotRange& range : ranges)
+        testRange(hash.cellStart[range.begin], hash.cellStart[range.end]);
+
+    return found;
+}
+
+bool findNearest(const SpatialHash& hash, const glm::dvec3& point, double maxDistance, uint32_t& nearest, double& distance)
+{
+    double bestSquared = maxDistance * maxDistance;
+    bool found = false;
+
+    auto testRange = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            double dx = hash.x[i] - point.x, dy = hash.y[i] - point.y, dz = hash.z[i] - point.z;
+            double distanceSquared = dx * dx + dy * dy + dz * dz;
+            if (distanceSquared <= bestSquared)
+            {
+                bestSquared = distanceSquared;
+                nearest = hash.order[i];
+                found = true;
+            }
+        }
+    };
+
+    // Searching the whole range cell by cell would visit more cells than there are particles
+    int64_t minCell[3], maxCell[3];
+    if (!cellBox(hash, point, maxDistance, minCell, maxCell))
+    {
+        testRange(0, hash.size());
+        distance = sqrt(bestSquared);
+        return found;
+    }
+
+    // Search growing boxes of cells around the point's cell. Once the best match is closer than
+    // the distance from the point to the edge of the box, nothing outside the box can beat it.
+    // Rescanning the inner cells is cheap next to the cache misses of jumping between rows.
+    double inverseCellSize = 1.0 / hash.cellSize;
+    int64_t center[3] = { cellCoordinate(point.x, inverseCellSize), cellCoordinate(point.y, inverseCellSize), cellCoordinate(point.z, inverseCellSize) };
+    int64_t shells = 0;
+    for (int axis = 0; axis < 3; ++axis)
+        shells = std::max(shells, std::max(center[axis] - minCell[axis], maxCell[axis] - center[axis]));
+
+    std::vector<SlotRange> ranges;
+    for (int64_t shell = 0;; shell = std::min(std::max<int64_t>(shell * 2, shell + 1), shells))
+    {
+        int64_t low[3], high[3];
+        double reach = 1e300;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            low[axis] = std::max(center[axis] - shell, minCell[axis]);
+            high[axis] = std::min(center[axis] + shell, maxCell[axis]);
+            reach = std::min(reach, point[axis] - double(low[axis]) * hash.cellSize);
+            reach = std::min(reach, double(high[axis] + 1) * hash.cellSize - point[axis]);
+        }
+
+        collectSlotRanges(hash.tableBits, low, high, ranges);
+        for (const SlotRange& range : ranges)
+            testRange(hash.cellStart[range.begin], hash.cellStart[range.end]);
+
+        if ((found && bestSquared <= reach * reach) || shell == shells)
+            break;
+    }
+
+    distance = sqrt(bestSquared);
+    return found;
+}
+
+void findCollisions(const SpatialHash& hash, const std::vector<float>& radii, std::vector<CollisionPair>& collisions)
+{
+    size_t count = hash.size();
+    size_t chunkCount = std::min<size_t>(parallelThreadCount() * 4, std::max<size_t>(count / PARTICLE_CHUNK, 1));
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    std::vector<std::vector<CollisionPair>> chunkCollisions(chunkCount);
+    double inverseCellSize = 1.0 / hash.cellSize;
+
+    double maxRadius = 0.0;
+    for (float radius : radii)
+        maxRadius = std::max(maxRadius, double(radius));
+
+    // Each pair is reported once, by whichever particle comes first in sorted order, from the 27 cells around it
+    parallelFor(chunkCount, 1, [&](size_t firstChunk, size_t lastChunk)
+    {
+        std::vector<SlotRange> ranges;
+        for (size_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+        {
+            std::vector<CollisionPair>& found = chunkCollisions[chunk];
+            int64_t lastCell[3] = { INT64_MIN, INT64_MIN, INT64_MIN };
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+
+            for (size_t i = chunk * chunkSize; i < end; ++i)
+            {
+                int64_t cell[3] = { cellCoordinate(hash.x[i], inverseCellSize),
+                                    cellCoordinate(hash.y[i], inverseCellSize),
+                                    cellCoordinate(hash.z[i], inverseCellSize) };
+
+                // Particles in the same cell are sorted next to each other, so reuse its ranges
+                if (cell[0] != lastCell[0] || cell[1] != lastCell[1] || cell[2] != lastCell[2])
+                {
+                    int64_t low[3] = { cell[0] - 1, cell[1] - 1, cell[2] - 1 };
+                    int64_t high[3] = { cell[0] + 1, cell[1] + 1, cell[2] + 1 };
+                    collectSlotRanges(hash.tableBits, low, high, ranges);
+                    std::copy(cell, cell + 3, lastCell);
+                }
+
+                // Only look up the other radius (a random access) for particles within reach of the largest one
+                uint32_t self = hash.order[i];
+                double radius = radii[self];
+                double maxReach = radius + maxRadius;
+                for (const SlotRange& range : ranges)
+                {
+                    size_t begin = std::max<size_t>(hash.cellStart[range.begin], i + 1);
+                    for (size_t j = begin; j < hash.cellStart[range.end]; ++j)
+                    {
+                        double dx = hash.x[j] - hash.x[i], dy = hash.y[j] - hash.y[i], dz = hash.z[j] - hash.z[i];
+                        double distanceSquared = dx * dx + dy * dy + dz * dz;
+                        if (distanceSquared >= maxReach * maxReach)
+                            continue;
+
+                        uint32_t other = hash.order[j];
+                        double reach = radius + radii[other];
+                        if (distanceSquared < reach * reach)
+                            found.push_back({ std::min(self, other), std::max(self, other) });
+                    }
+                }
+            }
+        }
+    });
+
+    collisions.clear();
+    for (const std::vector<CollisionPair>& found : chunkCollisions)
+        collisions.insert(collisions.end(), found.begin(), found.end());
+
+    std::sort(collisions.begin(), collisions.end(), [](const CollisionPair& a, const CollisionPair& b)
+    {
+        return a.first != b.first ? a.first < b.first : a.second < b.second;
+    });
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Kepler.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over particle positions, hashed into a power-of-two table of cells.
+// Particles are counting-sorted by cell so each cell is a contiguous range of the sorted arrays.
+// Different grid cells can share a table slot, so queries always check real distances.
+struct SpatialHash
+{
+    double cellSize = 1.0;
+    int tableBits = 0;                 // The table has 2^tableBits slots
+
+    std::vector<uint32_t> cellStart;   // Particles of slot c are [cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> keys;        // Slot of each sorted particle
+    std::vector<uint32_t> order;       // Index of each sorted particle in the input arrays
+    std::vector<double> x, y, z;       // Sorted copies of the positions
+
+    // Scratch space for the sort
+    std::vector<uint32_t> keyScratch;
+    std::vector<uint32_t> orderScratch;
+
+    size_t size() const { return order.size(); }
+};
+
+// Two particles whose spheres overlap (indices into the input arrays, first < second)
+struct CollisionPair
+{
+    uint32_t first;
+    uint32_t second;
+};
+
+// Function to rebuild the hash over a set of positions. The cell size should be about the
+// typical query radius, and at least twice the largest collision radius.
+void buildSpatialHash(const Vec3Array& positions, double cellSize, SpatialHash& hash);
+
+// Function to append the indices of every particle within radius of the centre. Returns the number found.
+size_t queryRadius(const SpatialHash& hash, const glm::dvec3& center, double radius, std::vector<uint32_t>& results);
+
+// Function to find the particle nearest to a point, searching up to maxDistance away.
+// Returns false if there is none in range.
+bool findNearest(const SpatialHash& hash, const glm::dvec3& point, double maxDistance, uint32_t& nearest, double& distance);
+
+// Function to find every pair of particles closer than the sum of their radii, ordered by first index
+void findCollisions(const SpatialHash& hash, const std::vector<float>& radii, std::vector<CollisionPair>& collisions);
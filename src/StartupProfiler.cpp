@@ -0,0 +1,186 @@
+#include "StartupProfiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+double processCpuMilliseconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    uint64_t kernelTicks = uint64_t(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime;
+    uint64_t userTicks = uint64_t(user.dwHighDateTime) << 32 | user.dwLowDateTime;
+    return double(kernelTicks + userTicks) / 10000.0; // 100 ns ticks
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+#endif
+}
+
+size_t peakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss); // Bytes on macOS
+#else
+    return size_t(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
+
+StartupProfiler::StartupProfiler()
+    : created(std::chrono::steady_clock::now())
+{
+}
+
+void StartupProfiler::begin(const std::string& name)
+{
+    end();
+    current = StartupPhase();
+    current.name = name;
+    running = true;
+    startedCpuMilliseconds = processCpuMilliseconds();
+    started = std::chrono::steady_clock::now();
+}
+
+void StartupProfiler::end()
+{
+    if (!running)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    current.wallMilliseconds = std::chrono::duration<double, std::milli>(now - started).count();
+    current.cpuMilliseconds = processCpuMilliseconds() - startedCpuMilliseconds;
+    current.peakResidentBytes = peakResidentBytes();
+    finished.push_back(current);
+    total = std::chrono::duration<double, std::milli>(now - created).count();
+    running = false;
+}
+
+std::string StartupProfiler::report() const
+{
+    size_t width = 5;
+    for (const StartupPhase& phase : finished)
+        width = std::max(width, phase.name.size());
+
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-*s %10s %10s %10s\n", int(width), "Phase", "Wall ms", "CPU ms", "Peak MiB");
+    out << line;
+    for (const StartupPhase& phase : finished)
+    {
+        std::snprintf(line, sizeof(line), "%-*s %10.1f %10.1f %10.1f\n", int(width), phase.name.c_str(), phase.wallMilliseconds,
+            phase.cpuMilliseconds, phase.peakResidentBytes / 1048576.0);
+        out << line;
+    }
+    std::snprintf(line, sizeof(line), "%-*s %10.1f\n", int(width), STARTUP_TOTAL_NAME, total);
+    out << line;
+    return out.str();
+}
+
+// Function to quote a string for JSON
+static std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::string StartupProfiler::json() const
+{
+    std::ostringstream out;
+    out << "{\n  \"totalMilliseconds\": " << total << ",\n  \"phases\": [";
+    for (size_t i = 0; i < finished.size(); ++i)
+    {
+        const StartupPhase& phase = finished[i];
+        out << (i == 0 ? "\n" : ",\n") << "    { \"name\": " << jsonString(phase.name) << ", \"wallMilliseconds\": " << phase.wallMilliseconds
+            << ", \"cpuMilliseconds\": " << phase.cpuMilliseconds << ", \"peakResidentBytes\": " << phase.peakResidentBytes << " }";
+    }
+    out << (finished.empty() ? "]\n}\n" : "\n  ]\n}\n");
+    return out.str();
+}
+
+bool readStartupBudget(const std::string& filePath, std::map<std::string, double>& budgets)
+{
+    std::ifstream stream(filePath);
+    if (!stream)
+    {
+        std::cerr << "Failed to open startup budget: " << filePath << std::endl;
+        return false;
+    }
+
+    budgets.clear();
+    int lineNumber = 0;
+    std::string line;
+    while (getline(stream, line))
+    {
+        ++lineNumber;
+        std::istringstream fields(line);
+        std::string name, extra;
+        double milliseconds;
+        if (!(fields >> name) || name[0] == '#')
+            continue;
+        if (!(fields >> milliseconds) || milliseconds < 0.0 || (fields >> extra))
+        {
+            std::cerr << "Malformed budget in " << filePath << ":" << lineNumber << ": " << line << std::endl;
+            return false;
+        }
+        budgets[name] = milliseconds;
+    }
+    return true;
+}
+
+bool checkStartupBudget(const StartupProfiler& profiler, const std::map<std::string, double>& budgets, std::vector<std::string>& overruns)
+{
+    std::map<std::string, double> spent;
+    for (const StartupPhase& phase : profiler.phases())
+        spent[phase.name] += phase.wallMilliseconds;
+    spent[STARTUP_TOTAL_NAME] = profiler.totalMilliseconds();
+
+    overruns.clear();
+    for (const auto& budget : budgets)
+    {
+        auto phase = spent.find(budget.first);
+        if (phase == spent.end() || phase->second <= budget.second)
+            continue;
+        std::ostringstream overrun;
+        overrun << budget.first << " took " << phase->second << " ms, over its budget of " << budget.second << " ms";
+        overruns.push_back(overrun.str());
+    }
+    return overruns.empty();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Default budget file for --startup-budget
+const char STARTUP_BUDGET_PATH[] = "res/startup-budget.txt";
+
+// Name a budget file gives the time from the profiler's creation to the end of the last phase
+const char STARTUP_TOTAL_NAME[] = "total";
+
+// What one phase of startup cost
+struct StartupPhase
+{
+    std::string name;
+    double wallMilliseconds = 0.0;
+    double cpuMilliseconds = 0.0;   // CPU time of the whole process, worker threads included
+    size_t peakResidentBytes = 0;   // Peak resident set size of the process when the phase ended
+};
+
+// Function to get the CPU time the process has used so far, on every thread, in milliseconds
+double processCpuMilliseconds();
+
+// Function to get the most memory the process has had resident so far, in bytes (0 if unknown)
+size_t peakResidentBytes();
+
+// Times the phases of startup one after another: wall time, process CPU time, and the peak
+// resident set size as each phase ends. Phases do not nest; beginning one ends the one before.
+class StartupProfiler
+{
+public:
+    StartupProfiler();
+
+    // Function to start a phase, ending the current one if there is one
+    void begin(const std::string& name);
+
+    // Function to end the current phase, if there is one
+    void end();
+
+    const std::vector<StartupPhase>& phases() const { return finished; }
+
+    // Wall time from the profiler's creation to the end of the last phase, which includes the
+    // gaps between phases
+    double totalMilliseconds() const { return total; }
+
+    // Function to format the phases as a table for the console
+    std::string report() const;
+
+    // Function to format the phases as a JSON object
+    std::string json() const;
+
+private:
+    std::chrono::steady_clock::time_point created;
+    std::chrono::steady_clock::time_point started;
+    double startedCpuMilliseconds = 0.0;
+    bool running = false;
+    StartupPhase current;
+    std::vector<StartupPhase> finished;
+    double total = 0.0;
+};
+
+// Times a phase for as long as it is in scope
+class ScopedStartupPhase
+{
+public:
+    ScopedStartupPhase(StartupProfiler* profiler, const std::string& name) : profiler(profiler)
+    {
+        if (profiler != nullptr)
+            profiler->begin(name);
+    }
+    ~ScopedStartupPhase()
+    {
+        if (profiler != nullptr)
+            profiler->end();
+    }
+
+    ScopedStartupPhase(const ScopedStartupPhase&) = delete;
+    ScopedStartupPhase& operator=(const ScopedStartupPhase&) = delete;
+
+private:
+    StartupProfiler* profiler;
+};
+
+// Function to read a budget file: lines of a phase name and its wall time budget in milliseconds,
+// with '#' starting a comment line. STARTUP_TOTAL_NAME bounds the total. Returns false if the file
+// cannot be read or a line is malformed.
+bool readStartupBudget(const std::string& filePath, std::map<std::string, double>& budgets);
+
+// Function to compare the phases with their budgets, describing each one over budget (phases
+// without a budget have none). A phase timed several times is compared on its sum. Returns true if
+// every budget was met.
+bool checkStartupBudget(const StartupProfiler& profiler, const std::map<std::string, double>& budgets, std::vector<std::string>& overruns);
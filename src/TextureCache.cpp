@@ -0,0 +1,210 @@
+#include "TextureCache.h"
+
+extern "C"
+{
+#include <SOIL2/image_DXT.h>
+}
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const uint32_t DDS_MAGIC = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+static const uint32_t FOURCC_DXT1 = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
+static const uint32_t FOURCC_DXT5 = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+
+size_t compressedLevelBytes(int width, int height, bool alpha)
+{
+    return size_t((width + 3) / 4) * size_t((height + 3) / 4) * (alpha ? 16 : 8);
+}
+
+int mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        ++levels;
+    return levels;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string textureCachePath(const std::string& directory, uint64_t contentHash)
+{
+    uint64_t hash = hashBytes(&TEXTURE_COOKER_VERSION, sizeof(TEXTURE_COOKER_VERSION), contentHash);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.dds", static_cast<unsigned long long>(hash));
+    return directory + "/" + name;
+}
+
+bool cookTexture(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& dds)
+{
+    MipChain mips;
+    return buildMipChain(pixels, width, height, channels, mips) && cookTexture(pixels, width, height, channels, mips, dds);
+}
+
+bool cookTexture(const unsigned char* pixels, int width, int height, int channels, const MipChain& mips, std::vector<unsigned char>& dds)
+{
+    dds.clear();
+    if (pixels == nullptr || width < 1 || height < 1 || channels < 1 || channels > 4 ||
+        mips.channels != channels || int(mips.levels.size()) + 1 != mipLevelCount(width, height))
+        return false;
+
+    // Grey and RGB images have no alpha; grey-alpha and RGBA do
+    bool alpha = channels % 2 == 0;
+    int levels = mipLevelCount(width, height);
+
+    DDS_header header;
+    memset(&header, 0, sizeof(header));
+    header.dwMagic = DDS_MAGIC;
+    header.dwSize = 124;
+    header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE | DDSD_MIPMAPCOUNT;
+    header.dwWidth = width;
+    header.dwHeight = height;
+    header.dwPitchOrLinearSize = static_cast<uint32_t>(compressedLevelBytes(width, height, alpha));
+    header.dwMipMapCount = levels;
+    header.sPixelFormat.dwSize = 32;
+    header.sPixelFormat.dwFlags = DDPF_FOURCC;
+    header.sPixelFormat.dwFourCC = alpha ? FOURCC_DXT5 : FOURCC_DXT1;
+    header.sCaps.dwCaps1 = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    const unsigned char* headerBytes = reinterpret_cast<const unsigned char*>(&header);
+    dds.assign(headerBytes, headerBytes + sizeof(header));
+
+    // The image, then each level of its chain
+    const unsigned char* source = pixels;
+    for (int i = 0; i < levels; ++i)
+    {
+        int levelWidth = std::max(width >> i, 1);
+        int levelHeight = std::max(height >> i, 1);
+
+        int compressedSize = 0;
+        unsigned char* compressed = alpha
+            ? convert_image_to_DXT5(source, levelWidth, levelHeight, channels, &compressedSize)
+            : convert_image_to_DXT1(source, levelWidth, levelHeight, channels, &compressedSize);
+        if (compressed == nullptr)
+        {
+            dds.clear();
+            return false;
+        }
+        dds.insert(dds.end(), compressed, compressed + compressedSize);
+        free(compressed);
+
+        if (i + 1 < levels)
+            source = mips.level(i);
+    }
+    return true;
+}
+
+bool readCookedTextureInfo(const std::vector<unsigned char>& dds, CookedTextureInfo& info)
+{
+    DDS_header header;
+    if (dds.size() < sizeof(header))
+        return false;
+    memcpy(&header, dds.data(), sizeof(header));
+
+    if (header.dwMagic != DDS_MAGIC || header.dwSize != 124 || !(header.sPixelFormat.dwFlags & DDPF_FOURCC) ||
+        (header.sPixelFormat.dwFourCC != FOURCC_DXT1 && header.sPixelFormat.dwFourCC != FOURCC_DXT5) ||
+        header.dwWidth < 1 || header.dwHeight < 1 || header.dwWidth > 65536 || header.dwHeight > 65536)
+        return false;
+
+    info.width = int(header.dwWidth);
+    info.height = int(header.dwHeight);
+    info.alpha = header.sPixelFormat.dwFourCC == FOURCC_DXT5;
+    info.mipLevels = int(header.dwMipMapCount);
+    if (info.mipLevels != mipLevelCount(info.width, info.height))
+        return false;
+
+    info.dataBytes = 0;
+    for (int i = 0; i < info.mipLevels; ++i)
+        info.dataBytes += compressedLevelBytes(std::max(info.width >> i, 1), std::max(info.height >> i, 1), info.alpha);
+    return dds.size() == sizeof(header) + info.dataBytes;
+}
+
+bool readFileBytes(const std::string& filePath, std::vector<unsigned char>& bytes)
+{
+    bytes.clear();
+    std::ifstream stream(filePath, std::ios::binary | std::ios::ate);
+    if (!stream)
+        return false;
+
+    std::streamoff size = stream.tellg();
+    stream.seekg(0);
+    bytes.resize(size_t(size));
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+bool writeFileAtomically(const std::string& filePath, const std::vector<unsigned char>& bytes)
+{
+    // The thread goes into the temporary name, since two threads may cook identical images at once
+    std::string temporaryPath = filePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream stream(temporaryPath, std::ios::binary);
+        if (!stream || !stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size()))
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporaryPath.c_str(), filePath.c_str()) != 0)
+    {
+        // Renaming onto an existing file fails on Windows; another writer got there first
+        std::remove(temporaryPath.c_str());
+        return static_cast<bool>(std::ifstream(filePath));
+    }
+    return true;
+}
+
+bool readFileStamp(const std::string& filePath, uint64_t& size, int64_t& modified)
+{
+#ifdef _WIN32
+    struct _stat64 status;
+    if (_stat64(filePath.c_str(), &status) != 0)
+        return false;
+    modified = int64_t(status.st_mtime) * 1000000000;
+#else
+    struct stat status;
+    if (stat(filePath.c_str(), &status) != 0)
+        return false;
+#ifdef __APPLE__
+    modified = int64_t(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+    modified = int64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+#endif
+    size = uint64_t(status.st_size);
+    return true;
+}
+
+bool createDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    int result = _mkdir(path.c_str());
+#else
+    int result = mkdir(path.c_str(), 0755);
+#endif
+    return result == 0 || errno == EEXIST;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "MipChain.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cache of textures cooked once into DDS files: DXT1 (BC1) for grey and RGB images, DXT5 (BC3)
+// when there is alpha, each with its full mip chain so nothing is decoded or generated at load
+// time. Entries are named by a hash of the source file's bytes, so editing an image gives it a
+// new entry and the stale one is never looked up again.
+
+const char TEXTURE_CACHE_DIRECTORY[] = "textures/cache";
+
+// Part of every cache key; bump it when the cooked output changes so old entries are ignored
+const uint32_t TEXTURE_COOKER_VERSION = 3;
+
+// Size and format of a cooked texture, read from its DDS header
+struct CookedTextureInfo
+{
+    int width = 0;
+    int height = 0;
+    int mipLevels = 0;
+    bool alpha = false;     // DXT5 rather than DXT1
+    size_t dataBytes = 0;   // Compressed size of every mip level, which is what the GPU holds
+};
+
+// Function to get the compressed size of one mip level: 4x4 blocks of 8 bytes (DXT1) or 16 bytes (DXT5)
+size_t compressedLevelBytes(int width, int height, bool alpha);
+
+// Function to count the mip levels down to 1x1, halving (and rounding down) each side as GL does
+int mipLevelCount(int width, int height);
+
+// Function to hash bytes with 64-bit FNV-1a, continuing from a previous hash if one is given
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+// Function to get the cache entry for a source image, from the hashBytes of its contents
+std::string textureCachePath(const std::string& directory, uint64_t contentHash);
+
+// Function to compress an image (1 to 4 channels, rows in upload order) with every mip level
+// down to 1x1 into a DDS file in memory, taking the levels below the image from its mip chain.
+// Returns false if the image is empty or the chain is not the image's.
+bool cookTexture(const unsigned char* pixels, int width, int height, int channels, const MipChain& mips, std::vector<unsigned char>& dds);
+
+// Function to cook an image, building its mip chain first (see buildMipChain)
+bool cookTexture(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& dds);
+
+// Function to check that a DDS file is one cookTexture wrote and read its size. Returns false if
+// it is truncated or in another format, so the caller can cook it again.
+bool readCookedTextureInfo(const std::vector<unsigned char>& dds, CookedTextureInfo& info);
+
+// Function to read a whole file. Returns false if it cannot be opened.
+bool readFileBytes(const std::string& filePath, std::vector<unsigned char>& bytes);
+
+// Function to write a file under a temporary name and rename it into place, so readers on other
+// threads or processes never see it half written. Returns false on failure.
+bool writeFileAtomically(const std::string& filePath, const std::vector<unsigned char>& bytes);
+
+// Function to get a file's size and modification time (in nanoseconds where the platform keeps
+// them; only compared). Returns false if the file is missing.
+bool readFileStamp(const std::string& filePath, uint64_t& size, int64_t& modified);
+
+// Function to create a directory if it does not exist yet. Returns false if it cannot be created.
+bool createDirectory(const std::string& path);
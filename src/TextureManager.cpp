@@ -0,0 +1,165 @@
+#include "TextureManager.h"
+
+#include <algorithm>
+
+size_t TextureManager::acquire(const std::string& path, bool& isNew)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = pathIds.find(path);
+    if (found != pathIds.end())
+    {
+        ++entries[found->second].references;
+        isNew = false;
+        return found->second;
+    }
+
+    size_t id = nextId++;
+    Entry& entry = entries[id];
+    entry.paths.push_back(path);
+    entry.references = 1;
+    pathIds[path] = id;
+    isNew = true;
+    return id;
+}
+
+size_t TextureManager::claimContent(size_t id, uint64_t contentHash)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto entry = entries.find(id);
+    if (entry == entries.end())
+        return id;
+
+    auto found = contentIds.find(contentHash);
+    if (found == contentIds.end() || found->second == id)
+    {
+        contentIds[contentHash] = id;
+        entry->second.contentHash = contentHash;
+        entry->second.hashed = true;
+        return id;
+    }
+
+    // Move the references and paths over to the texture that already has these bytes
+    size_t owner = found->second;
+    Entry& target = entries[owner];
+    target.references += entry->second.references;
+    for (const std::string& path : entry->second.paths)
+    {
+        target.paths.push_back(path);
+        pathIds[path] = owner;
+    }
+    entries.erase(entry);
+    mergedIds[id] = owner;
+    return owner;
+}
+
+void TextureManager::setResident(size_t id, uint32_t handle, size_t gpuBytes, size_t uncompressedBytes, double decodeMilliseconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto entry = entries.find(resolveLocked(id));
+    if (entry == entries.end())
+        return;
+
+    entry->second.handle = handle;
+    entry->second.gpuBytes = gpuBytes;
+    entry->second.uncompressedBytes = uncompressedBytes;
+    entry->second.decodeMilliseconds = decodeMilliseconds;
+}
+
+void TextureManager::setGpuBytes(size_t id, size_t gpuBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto entry = entries.find(resolveLocked(id));
+    if (entry != entries.end())
+        entry->second.gpuBytes = gpuBytes;
+}
+
+void TextureManager::forgetPath(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = pathIds.find(path);
+    if (found == pathIds.end())
+        return;
+
+    std::vector<std::string>& paths = entries[found->second].paths;
+    paths.erase(std::remove(paths.begin(), paths.end(), path), paths.end());
+    pathIds.erase(found);
+}
+
+uint32_t TextureManager::release(size_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    id = resolveLocked(id);
+    auto entry = entries.find(id);
+    if (entry == entries.end() || --entry->second.references > 0)
+        return 0;
+
+    for (const std::string& path : entry->second.paths)
+        pathIds.erase(path);
+    if (entry->second.hashed)
+        contentIds.erase(entry->second.contentHash);
+    for (auto merged = mergedIds.begin(); merged != mergedIds.end();)
+    {
+        if (merged->second == id)
+            merged = mergedIds.erase(merged);
+        else
+            ++merged;
+    }
+
+    uint32_t handle = entry->second.handle;
+    entries.erase(entry);
+    return handle;
+}
+
+uint32_t TextureManager::handle(size_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto entry = entries.find(resolveLocked(id));
+    return entry != entries.end() ? entry->second.handle : 0;
+}
+
+bool TextureManager::holds(size_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.count(resolveLocked(id)) != 0;
+}
+
+size_t TextureManager::resolve(size_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return resolveLocked(id);
+}
+
+size_t TextureManager::resolveLocked(size_t id) const
+{
+    // A texture is only ever merged into one that is not merged itself
+    auto merged = mergedIds.find(id);
+    return merged != mergedIds.end() ? merged->second : id;
+}
+
+TextureStats TextureManager::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    TextureStats stats;
+    for (const auto& item : entries)
+    {
+        const Entry& entry = item.second;
+        if (entry.handle == 0)
+            continue;
+
+        ++stats.textures;
+        stats.shared += entry.references - 1;
+        stats.gpuBytes += entry.gpuBytes;
+        stats.uncompressedBytes += entry.uncompressedBytes;
+        stats.savedBytes += entry.gpuBytes * (entry.references - 1);
+        stats.decodeMilliseconds += entry.decodeMilliseconds;
+    }
+    return stats;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Totals over the textures held by a TextureManager
+struct TextureStats
+{
+    size_t textures = 0;                // Distinct textures, each loaded once
+    size_t shared = 0;                  // References served by a texture another user already held
+    size_t gpuBytes = 0;                // Memory of the resident textures
+    size_t uncompressedBytes = 0;       // What they would take as uncompressed RGBA with mipmaps
+    size_t savedBytes = 0;              // What the shared references would take as separate copies
+    double decodeMilliseconds = 0.0;    // Worker time spent loading the resident textures
+};
+
+// Reference-counted textures shared by path and by content. The first acquire of a path creates a
+// texture for the caller to load; later acquires of the same path share it. While loading, the
+// hash of the source bytes is claimed, and a texture whose bytes match one claimed earlier is
+// merged into it without being decoded. Handles are opaque here (GL texture names in the app), so
+// the bookkeeping needs no GL context. claimContent is called from the decode workers, so every
+// call takes the manager's lock.
+class TextureManager
+{
+public:
+    // Function to get the texture of a path, adding a reference. Sets isNew if the caller has to
+    // load it and report back with claimContent and setResident.
+    size_t acquire(const std::string& path, bool& isNew);
+
+    // Function to record the hash of a loading texture's source bytes. Returns its id if no other
+    // texture has the same bytes; otherwise it is merged into the one that does, whose id is returned.
+    size_t claimContent(size_t id, uint64_t contentHash);
+
+    // Function to record a loaded texture's handle and costs
+    void setResident(size_t id, uint32_t handle, size_t gpuBytes, size_t uncompressedBytes, double decodeMilliseconds);
+
+    // Function to update a resident texture's memory, for textures whose mip levels are streamed
+    void setGpuBytes(size_t id, size_t gpuBytes);
+
+    // Function to make the next acquire of a path load it again, as a new texture, for a file
+    // that changed on disk. The current texture keeps its references and is released as usual.
+    void forgetPath(const std::string& path);
+
+    // Function to drop a reference. Returns the handle to delete once nothing uses it, or 0.
+    uint32_t release(size_t id);
+
+    // Function to get a texture's handle; 0 while it is still loading
+    uint32_t handle(size_t id) const;
+
+    // Function to check whether a texture still has references. A texture released while it was
+    // loading is gone, and whatever was loaded for it has to be thrown away.
+    bool holds(size_t id) const;
+
+    // Function to follow merges to the id that now holds a texture
+    size_t resolve(size_t id) const;
+
+    TextureStats stats() const;
+
+private:
+    struct Entry
+    {
+        std::vector<std::string> paths;
+        uint64_t contentHash = 0;
+        bool hashed = false;
+        uint32_t handle = 0;
+        size_t references = 0;
+        size_t gpuBytes = 0;
+        size_t uncompressedBytes = 0;
+        double decodeMilliseconds = 0.0;
+    };
+
+    size_t resolveLocked(size_t id) const;
+
+    mutable std::mutex mutex;
+    std::map<size_t, Entry> entries;
+    std::unordered_map<std::string, size_t> pathIds;
+    std::unordered_map<uint64_t, size_t> contentIds;
+    std::unordered_map<size_t, size_t> mergedIds;   // Texture merged away, and the one it was merged into
+    size_t nextId = 0;
+};
@@ -0,0 +1,125 @@
+#include "TextureStreaming.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Function to get the memory of one mip level
+static size_t levelBytes(const CookedTextureInfo& info, int level)
+{
+    return compressedLevelBytes(std::max(info.width >> level, 1), std::max(info.height >> level, 1), info.alpha);
+}
+
+int TextureStreamer::add(size_t id, const CookedTextureInfo& info)
+{
+    Stream stream;
+    stream.info = info;
+    while (stream.tailBase + 1 < info.mipLevels &&
+        std::max(info.width >> stream.tailBase, info.height >> stream.tailBase) > TEXTURE_STREAMING_TAIL_SIZE)
+        ++stream.tailBase;
+    stream.residentBase = stream.tailBase;
+    stream.wantedBase = stream.tailBase;
+    stream.lastUsed = frame;
+    streams[id] = stream;
+    return stream.tailBase;
+}
+
+void TextureStreamer::remove(size_t id)
+{
+    streams.erase(id);
+}
+
+void TextureStreamer::request(size_t id, double screenPixels)
+{
+    auto found = streams.find(id);
+    if (found == streams.end())
+        return;
+
+    Stream& stream = found->second;
+    int level = levelForScreenSize(stream.info, screenPixels);
+    if (!stream.requested || level < stream.wantedBase)
+        stream.wantedBase = level;
+    stream.requested = true;
+    stream.lastUsed = frame;
+}
+
+std::vector<TextureStreamStep> TextureStreamer::update(size_t budgetBytes)
+{
+    struct Plan
+    {
+        size_t id;
+        Stream* stream;
+        int need;       // Finest level the texture was asked for, or its tail
+        int target;
+    };
+
+    // Refine one level towards what was asked for, keeping finer levels that are already resident
+    std::vector<Plan> plans;
+    size_t total = 0;
+    for (auto& item : streams)
+    {
+        Stream& stream = item.second;
+        int need = stream.requested ? std::min(stream.wantedBase, stream.tailBase) : stream.tailBase;
+        int target = stream.residentBase > need ? stream.residentBase - 1 : stream.residentBase;
+        plans.push_back({ item.first, &stream, need, target });
+        total += chainBytes(stream.info, target);
+    }
+
+    // Over budget: drop levels nobody asked for, least recently used first, then asked-for levels
+    std::stable_sort(plans.begin(), plans.end(), [](const Plan& a, const Plan& b) { return a.stream->lastUsed < b.stream->lastUsed; });
+    for (int pass = 0; pass < 2 && total > budgetBytes; ++pass)
+    {
+        for (Plan& plan : plans)
+        {
+            int floor = pass == 0 ? plan.need : plan.stream->tailBase;
+            while (total > budgetBytes && plan.target < floor)
+                total -= levelBytes(plan.stream->info, plan.target++);
+        }
+    }
+
+    std::vector<TextureStreamStep> steps;
+    for (Plan& plan : plans)
+    {
+        if (plan.target != plan.stream->residentBase)
+        {
+            steps.push_back({ plan.id, plan.stream->residentBase, plan.target });
+            plan.stream->residentBase = plan.target;
+        }
+        plan.stream->requested = false;
+    }
+    ++frame;
+    return steps;
+}
+
+int TextureStreamer::residentBase(size_t id) const
+{
+    auto found = streams.find(id);
+    return found != streams.end() ? found->second.residentBase : -1;
+}
+
+size_t TextureStreamer::residentBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& item : streams)
+        bytes += chainBytes(item.second.info, item.second.residentBase);
+    return bytes;
+}
+
+size_t TextureStreamer::chainBytes(const CookedTextureInfo& info, int baseLevel)
+{
+    size_t bytes = 0;
+    for (int level = baseLevel; level < info.mipLevels; ++level)
+        bytes += levelBytes(info, level);
+    return bytes;
+}
+
+int TextureStreamer::levelForScreenSize(const CookedTextureInfo& info, double screenPixels)
+{
+    // Keep at least one texel per pixel across the visible half of the texture
+    double texels = info.width / 2.0;
+    if (screenPixels >= texels)
+        return 0;
+    if (screenPixels < 1.0)
+        return info.mipLevels - 1;
+    int level = int(std::floor(std::log2(texels / screenPixels)));
+    return std::min(std::max(level, 0), info.mipLevels - 1);
+}
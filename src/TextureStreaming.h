@@ -0,0 +1,72 @@
+#pragma once
+
+#include "TextureCache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Mips at most this many texels on a side are always resident, so a texture can be drawn at once
+const int TEXTURE_STREAMING_TAIL_SIZE = 64;
+
+// Default GPU memory for streamed textures
+const size_t DEFAULT_TEXTURE_BUDGET_MIB = 128;
+
+// Change of a streamed texture's finest resident mip level
+struct TextureStreamStep
+{
+    size_t id;
+    int previousBase;
+    int baseLevel;      // Levels from here to the smallest must be resident after the step
+};
+
+// Decides which mip levels of compressed textures are resident. Each texture starts with only its
+// smallest mips and is refined one level per update towards what the frame's requests ask for,
+// within a memory budget. When over budget, levels beyond what a texture was last asked for are
+// dropped first, least recently used texture first, then requested levels in the same order.
+// Only the bookkeeping lives here; the caller uploads and frees levels as the steps say, which in
+// GL means clamping GL_TEXTURE_BASE_LEVEL.
+class TextureStreamer
+{
+public:
+    // Function to add a texture with its smallest mips resident; returns the base level to upload
+    int add(size_t id, const CookedTextureInfo& info);
+
+    // Function to forget a texture
+    void remove(size_t id);
+
+    // Function to ask for a texture to look sharp on an object this many pixels across on screen
+    void request(size_t id, double screenPixels);
+
+    // Function to end a frame: picks each texture's levels within the budget and returns the
+    // changes to make, refining at most one level per texture per call
+    std::vector<TextureStreamStep> update(size_t budgetBytes);
+
+    // Function to get a texture's finest resident level, or -1 if it is not streamed
+    int residentBase(size_t id) const;
+
+    // Memory of the resident levels of every texture
+    size_t residentBytes() const;
+
+    // Function to get the memory of a texture's levels from baseLevel to the smallest
+    static size_t chainBytes(const CookedTextureInfo& info, int baseLevel);
+
+    // Function to get the finest level worth having for an object this many pixels across, given
+    // that a sphere shows half the texture's width
+    static int levelForScreenSize(const CookedTextureInfo& info, double screenPixels);
+
+private:
+    struct Stream
+    {
+        CookedTextureInfo info;
+        int tailBase = 0;       // Finest level of the always-resident tail
+        int residentBase = 0;
+        int wantedBase = 0;     // Finest level asked for in the current frame
+        bool requested = false;
+        uint64_t lastUsed = 0;
+    };
+
+    std::map<size_t, Stream> streams;
+    uint64_t frame = 1;
+};
@@ -0,0 +1,140 @@
+#include "TextureUploads.h"
+
+#include <cstring>
+#include <iostream>
+
+// Alignment of staged uploads in the ring, enough for any pixel row alignment
+const size_t UPLOAD_ALIGNMENT = 16;
+
+void StagingRing::reset(size_t capacity)
+{
+    size = capacity;
+    head = 0;
+    tail = 0;
+    usedBytes = 0;
+    frameBytes = 0;
+    frames.clear();
+}
+
+bool StagingRing::allocate(size_t bytes, size_t alignment, size_t& offset)
+{
+    if (bytes > size)
+        return false;
+    if (usedBytes == 0)
+    {
+        head = 0;
+        tail = 0;
+    }
+
+    // Free space is [head, size) and [0, tail) until the ring wraps, then [head, tail)
+    size_t start = (head + alignment - 1) / alignment * alignment;
+    bool wrapped = head < tail || (head == tail && usedBytes > 0);
+    if (wrapped)
+    {
+        if (start + bytes > tail)
+            return false;
+    }
+    else if (start + bytes > size)
+    {
+        // The end of the ring is skipped and counted as used until this frame retires
+        if (bytes > tail)
+            return false;
+        usedBytes += size - head;
+        frameBytes += size - head;
+        head = 0;
+        start = 0;
+    }
+
+    usedBytes += start + bytes - head;
+    frameBytes += start + bytes - head;
+    head = start + bytes;
+    offset = start;
+    return true;
+}
+
+uint64_t StagingRing::endFrame()
+{
+    if (frameBytes > 0)
+        frames.push_back({ currentFrame, head, frameBytes });
+    frameBytes = 0;
+    return currentFrame++;
+}
+
+void StagingRing::retire(uint64_t frame)
+{
+    while (!frames.empty() && frames.front().frame <= frame)
+    {
+        tail = frames.front().end;
+        usedBytes -= frames.front().bytes;
+        frames.pop_front();
+    }
+}
+
+void UploadScheduler::enqueue(StagedUpload upload)
+{
+    uploads.push_back(std::move(upload));
+}
+
+void UploadScheduler::cancel(size_t owner, int belowLevel)
+{
+    for (auto upload = uploads.begin(); upload != uploads.end();)
+    {
+        if (upload->owner == owner && upload->level < belowLevel)
+            upload = uploads.erase(upload);
+        else
+            ++upload;
+    }
+}
+
+size_t UploadScheduler::issue(size_t budgetBytes, StagingRing* ring, unsigned char* mapped)
+{
+    size_t issued = 0;
+    while (!uploads.empty())
+    {
+        if (issued > 0 && issued + uploads.front().bytes > budgetBytes)
+            break;
+
+        // Waits for older frames to retire if the ring is full
+        const void* pixels = uploads.front().data;
+        if (ring != nullptr && mapped != nullptr)
+        {
+            if (uploads.front().bytes > ring->capacity())
+            {
+                std::cerr << "Texture upload of " << uploads.front().bytes << " bytes does not fit the staging ring" << std::endl;
+                uploads.pop_front();
+                continue;
+            }
+
+            size_t offset;
+            if (!ring->allocate(uploads.front().bytes, UPLOAD_ALIGNMENT, offset))
+                break;
+            memcpy(mapped + offset, uploads.front().data, uploads.front().bytes);
+            pixels = reinterpret_cast<const void*>(offset);
+        }
+
+        // Taken off the queue first, so the callback may enqueue or cancel
+        StagedUpload upload = std::move(uploads.front());
+        uploads.pop_front();
+        upload.issue(pixels);
+        issued += upload.bytes;
+    }
+    return issued;
+}
+
+bool UploadScheduler::pending(size_t owner) const
+{
+    for (const StagedUpload& upload : uploads)
+    {
+        if (upload.owner == owner)
+            return true;
+    }
+    return false;
+}
+
+size_t UploadScheduler::pendingBytes() const
+{
+    size_t bytes = 0;
+    for (const StagedUpload& upload : uploads)
+        bytes += upload.bytes;
+    return bytes;
+}
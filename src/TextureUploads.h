@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Default bytes of texture data uploaded per frame
+const size_t DEFAULT_UPLOAD_BUDGET_MIB = 4;
+
+// Frames whose uploads may still be read by the GPU while the next one is staged; the staging
+// ring holds this many frames of budget
+const size_t UPLOAD_FRAMES_IN_FLIGHT = 3;
+
+// Ring of staging memory, such as a persistently mapped pixel unpack buffer. Allocations are made
+// in order during a frame; endFrame closes the frame, and retire frees whole frames once the
+// caller knows the GPU has finished reading them (in GL, from a fence per frame).
+class StagingRing
+{
+public:
+    // Function to empty the ring and give it a new size
+    void reset(size_t capacity);
+
+    // Function to take size bytes at an alignment for the current frame. Returns false if the
+    // ring is too full until earlier frames retire.
+    bool allocate(size_t size, size_t alignment, size_t& offset);
+
+    // Function to close the current frame's allocations; returns the frame number to fence
+    uint64_t endFrame();
+
+    // Function to free every allocation of the frames up to and including this one
+    void retire(uint64_t frame);
+
+    size_t capacity() const { return size; }
+    size_t used() const { return usedBytes; }
+
+private:
+    struct Frame
+    {
+        uint64_t frame;
+        size_t end;         // Where the next frame's allocations began
+        size_t bytes;       // Including alignment padding and space skipped at the wrap
+    };
+
+    size_t size = 0;
+    size_t head = 0;        // Next free byte
+    size_t tail = 0;        // Oldest byte still in use
+    size_t usedBytes = 0;
+    size_t frameBytes = 0;
+    uint64_t currentFrame = 1;
+    std::deque<Frame> frames;
+};
+
+// One texture upload waiting for its turn
+struct StagedUpload
+{
+    size_t owner = 0;           // Texture it belongs to, so the uploads of a dropped texture can be cancelled
+    int level = 0;              // Mip level it fills
+    const unsigned char* data = nullptr;
+    size_t bytes = 0;
+    std::shared_ptr<const void> keepAlive;  // Owner of data, held until the upload is issued
+
+    // Called on the GL thread with the pixels to pass to glTexSubImage2D and friends: an offset
+    // into the bound staging buffer, or data itself when it was not staged
+    std::function<void(const void* pixels)> issue;
+};
+
+// Queue of texture uploads issued in order under a per-frame byte budget, so a burst of loading
+// or streaming is spread over frames instead of stalling one. The data is copied into the staging
+// ring and issued from there, or issued from the source memory when there is no ring. Callers
+// split large uploads so each fits the ring; one that never could is dropped. The first upload of
+// a frame always goes, so one larger than the budget still makes progress.
+class UploadScheduler
+{
+public:
+    void enqueue(StagedUpload upload);
+
+    // Function to drop the queued uploads of a texture for levels finer than belowLevel; all of
+    // them by default
+    void cancel(size_t owner, int belowLevel = INT32_MAX);
+
+    // Function to issue queued uploads until budgetBytes have gone this frame or the ring is full.
+    // mapped is where the ring's memory is written, or nullptr to issue without staging. Returns
+    // the bytes issued.
+    size_t issue(size_t budgetBytes, StagingRing* ring, unsigned char* mapped);
+
+    // Function to check whether a texture still has uploads queued
+    bool pending(size_t owner) const;
+
+    size_t pendingCount() const { return uploads.size(); }
+    size_t pendingBytes() const;
+
+private:
+    std::deque<StagedUpload> uploads;
+};
@@ -0,0 +1,54 @@
+#include "TransformGraph.h"
+
+#include <algorithm>
+#include <cassert>
+
+uint32_t addTransform(TransformGraph& graph, uint32_t parent, const glm::dmat4& local)
+{
+    assert(parent == NO_PARENT || parent < graph.size());
+
+    uint32_t node = static_cast<uint32_t>(graph.size());
+    graph.parent.push_back(parent);
+    graph.local.push_back(local);
+    graph.world.push_back(local);
+    graph.dirty.push_back(1);
+    return node;
+}
+
+void setLocalTransform(TransformGraph& graph, uint32_t node, const glm::dmat4& local)
+{
+    graph.local[node] = local;
+    graph.dirty[node] = 1;
+}
+
+void updateTransforms(TransformGraph& graph)
+{
+    // Parents come first, so a dirty parent has already been updated and has passed its flag on
+    // by the time its children are visited
+    for (size_t node = 0; node < graph.size(); ++node)
+    {
+        uint32_t parent = graph.parent[node];
+        if (parent != NO_PARENT)
+            graph.dirty[node] |= graph.dirty[parent];
+
+        if (!graph.dirty[node])
+            continue;
+
+        graph.world[node] = parent == NO_PARENT ? graph.local[node] : graph.world[parent] * graph.local[node];
+    }
+
+    std::fill(graph.dirty.begin(), graph.dirty.end(), uint8_t(0));
+}
+
+glm::dvec3 worldPosition(const TransformGraph& graph, uint32_t node)
+{
+    return glm::dvec3(graph.world[node][3]);
+}
+
+glm::mat4 relativeTransform(const TransformGraph& graph, uint32_t node, const glm::dvec3& origin)
+{
+    // Subtract the origin in double before narrowing, so distant nodes keep their precision
+    glm::dmat4 relative = graph.world[node];
+    relative[3] -= glm::dvec4(origin, 0.0);
+    return glm::mat4(relative);
+}
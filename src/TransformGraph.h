@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Parent index of root nodes
+const uint32_t NO_PARENT = 0xFFFFFFFFu;
+
+// Flat transform hierarchy. Nodes are stored in topological order (every parent before its
+// children), so one linear pass updates the whole graph. Matrices are kept in double precision
+// and only narrowed to float relative to the camera, for use with the floating origin.
+struct TransformGraph
+{
+    std::vector<uint32_t> parent;
+    std::vector<glm::dmat4> local;   // Relative to the parent
+    std::vector<glm::dmat4> world;
+    std::vector<uint8_t> dirty;      // Local transform changed since the last update
+
+    size_t size() const { return parent.size(); }
+};
+
+// Function to append a node; the parent must already be in the graph. Returns the node index.
+uint32_t addTransform(TransformGraph& graph, uint32_t parent, const glm::dmat4& local = glm::dmat4(1.0));
+
+// Function to replace a node's local transform and mark it dirty
+void setLocalTransform(TransformGraph& graph, uint32_t node, const glm::dmat4& local);
+
+// Function to recompute the world transforms of dirty nodes and their descendants
+void updateTransforms(TransformGraph& graph);
+
+// Function to get the world-space origin of a node
+glm::dvec3 worldPosition(const TransformGraph& graph, uint32_t node);
+
+// Function to get a node's world matrix relative to the given origin, in single precision
+glm::mat4 relativeTransform(const TransformGraph& graph, uint32_t node, const glm::dvec3& origin);
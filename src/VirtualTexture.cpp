@@ -0,0 +1,406 @@
+#include "VirtualTexture.h"
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Where the tiles start, so each one is page-aligned in the mapping
+const uint64_t VIRTUAL_TEXTURE_DATA_OFFSET = 4096;
+
+std::vector<VirtualLevel> virtualLevels(int width, int height)
+{
+    std::vector<VirtualLevel> levels;
+    if (width < 1 || height < 1)
+        return levels;
+
+    uint64_t firstTile = 0;
+    int tableRow = 0;
+    for (int level = 0;; ++level)
+    {
+        VirtualLevel grid;
+        grid.width = std::max(width >> level, 1);
+        grid.height = std::max(height >> level, 1);
+        grid.tilesX = (grid.width + VIRTUAL_TILE_PAYLOAD - 1) / VIRTUAL_TILE_PAYLOAD;
+        grid.tilesY = (grid.height + VIRTUAL_TILE_PAYLOAD - 1) / VIRTUAL_TILE_PAYLOAD;
+        grid.firstTile = firstTile;
+        grid.tableRow = tableRow;
+        levels.push_back(grid);
+
+        firstTile += uint64_t(grid.tilesX) * grid.tilesY;
+        tableRow += grid.tilesY;
+        if (grid.tilesX == 1 && grid.tilesY == 1)
+            return levels;
+    }
+}
+
+std::string virtualTexturePath(const std::string& directory, const std::string& texturePath)
+{
+    size_t nameStart = texturePath.find_last_of("/\\");
+    std::string name = nameStart == std::string::npos ? texturePath : texturePath.substr(nameStart + 1);
+    size_t extension = name.find_last_of('.');
+    if (extension != std::string::npos && extension > 0)
+        name.erase(extension);
+    return directory + "/" + name + ".vtex";
+}
+
+bool writeVirtualTexture(const std::string& filePath, const unsigned char* pixels, int width, int height, int channels)
+{
+    if (pixels == nullptr || width < 1 || height < 1 || channels < 1 || channels > 4)
+        return false;
+
+    std::vector<VirtualLevel> levels = virtualLevels(width, height);
+    if (int(levels.size()) > MAX_VIRTUAL_LEVELS || levels[0].tilesX > MAX_VIRTUAL_TILES_PER_SIDE || levels[0].tilesY > MAX_VIRTUAL_TILES_PER_SIDE)
+    {
+        std::cerr << "Image too large for a virtual texture: " << width << "x" << height << std::endl;
+        return false;
+    }
+
+    MipChain mips;
+    if (levels.size() > 1 && !buildMipChain(pixels, width, height, channels, mips))
+        return false;
+
+    std::ofstream stream(filePath, std::ios::binary);
+    if (!stream)
+        return false;
+
+    VirtualTextureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version = VIRTUAL_TEXTURE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.tileSize = VIRTUAL_TILE_SIZE;
+    header.border = VIRTUAL_TILE_BORDER;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.tileCount = levels.back().firstTile + 1;
+    header.dataOffset = VIRTUAL_TEXTURE_DATA_OFFSET;
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<char> padding(size_t(VIRTUAL_TEXTURE_DATA_OFFSET - sizeof(header)), 0);
+    stream.write(padding.data(), padding.size());
+
+    // Grey is spread to RGB; images without alpha are opaque
+    bool alpha = channels % 2 == 0;
+    int colourChannels = alpha ? channels - 1 : channels;
+    std::vector<unsigned char> tile(VIRTUAL_TILE_BYTES);
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        const VirtualLevel& grid = levels[level];
+        const unsigned char* source = level == 0 ? pixels : mips.level(level - 1);
+        for (int tileY = 0; tileY < grid.tilesY; ++tileY)
+        {
+            for (int tileX = 0; tileX < grid.tilesX; ++tileX)
+            {
+                unsigned char* texel = tile.data();
+                for (int j = 0; j < VIRTUAL_TILE_SIZE; ++j)
+                {
+                    int y = std::min(std::max(tileY * VIRTUAL_TILE_PAYLOAD + j - VIRTUAL_TILE_BORDER, 0), grid.height - 1);
+                    for (int i = 0; i < VIRTUAL_TILE_SIZE; ++i, texel += 4)
+                    {
+                        int x = (tileX * VIRTUAL_TILE_PAYLOAD + i - VIRTUAL_TILE_BORDER) % grid.width;
+                        if (x < 0)
+                            x += grid.width;
+                        const unsigned char* pixel = source + (size_t(y) * grid.width + x) * channels;
+                        for (int c = 0; c < 3; ++c)
+                            texel[c] = pixel[colourChannels == 1 ? 0 : c];
+                        texel[3] = alpha ? pixel[colourChannels] : 255;
+                    }
+                }
+                stream.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+            }
+        }
+    }
+    return static_cast<bool>(stream);
+}
+
+bool VirtualTexture::open(const std::string& filePath)
+{
+    close();
+    if (!file.open(filePath))
+        return false;
+
+    VirtualTextureHeader header;
+    bool valid = file.size() >= sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, file.data(), sizeof(header));
+        levelGrid = virtualLevels(int(std::min<uint32_t>(header.width, INT32_MAX)), int(std::min<uint32_t>(header.height, INT32_MAX)));
+        valid = memcmp(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(header.magic)) == 0 && header.version == VIRTUAL_TEXTURE_VERSION &&
+            header.tileSize == uint32_t(VIRTUAL_TILE_SIZE) && header.border == uint32_t(VIRTUAL_TILE_BORDER) && !levelGrid.empty() &&
+            header.levelCount == levelGrid.size() && int(levelGrid.size()) <= MAX_VIRTUAL_LEVELS &&
+            levelGrid[0].tilesX <= MAX_VIRTUAL_TILES_PER_SIDE && levelGrid[0].tilesY <= MAX_VIRTUAL_TILES_PER_SIDE &&
+            header.tileCount == levelGrid.back().firstTile + 1 && header.dataOffset >= sizeof(header) && header.dataOffset <= file.size() &&
+            header.tileCount <= (file.size() - header.dataOffset) / VIRTUAL_TILE_BYTES;
+    }
+    if (!valid)
+    {
+        std::cerr << "Not a valid virtual texture: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    dataOffset = header.dataOffset;
+    return true;
+}
+
+void VirtualTexture::close()
+{
+    file.close();
+    dataOffset = 0;
+    levelGrid.clear();
+}
+
+const unsigned char* VirtualTexture::tile(int level, int x, int y) const
+{
+    if (level < 0 || level >= int(levelGrid.size()))
+        return nullptr;
+    const VirtualLevel& grid = levelGrid[level];
+    if (x < 0 || y < 0 || x >= grid.tilesX || y >= grid.tilesY)
+        return nullptr;
+    return file.data() + dataOffset + (grid.firstTile + uint64_t(y) * grid.tilesX + x) * VIRTUAL_TILE_BYTES;
+}
+
+uint32_t virtualTileId(int texture, int level, int x, int y)
+{
+    return uint32_t(x) | uint32_t(y) << 12 | uint32_t(level) << 24 | uint32_t(texture) << 28;
+}
+
+int virtualTileTexture(uint32_t tile)
+{
+    return int(tile >> 28);
+}
+
+int virtualTileLevel(uint32_t tile)
+{
+    return int((tile >> 24) & 15);
+}
+
+int virtualTileX(uint32_t tile)
+{
+    return int(tile & 4095);
+}
+
+int virtualTileY(uint32_t tile)
+{
+    return int((tile >> 12) & 4095);
+}
+
+void decodeVirtualFeedback(const unsigned char* pixels, size_t pixelCount, std::vector<uint32_t>& tiles)
+{
+    tiles.clear();
+    for (size_t i = 0; i < pixelCount; ++i, pixels += 4)
+    {
+        int texture = pixels[3] >> 4;
+        if (texture == 0)
+            continue;
+        int x = pixels[0] | (pixels[2] & 15) << 8;
+        int y = pixels[1] | (pixels[2] >> 4) << 8;
+        tiles.push_back(virtualTileId(texture - 1, pixels[3] & 15, x, y));
+    }
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+}
+
+void VirtualTileCache::reset(int slotsPerSide)
+{
+    slotsAcross = slotsPerSide;
+    textures.clear();
+    tiles.clear();
+    requested.clear();
+    freeSlots.clear();
+    for (int slot = slotsPerSide * slotsPerSide - 1; slot >= 0; --slot)
+        freeSlots.push_back(slot);
+}
+
+int VirtualTileCache::addTexture(const std::vector<VirtualLevel>& levels)
+{
+    if (int(textures.size()) >= MAX_VIRTUAL_TEXTURES || levels.empty() || int(levels.size()) > MAX_VIRTUAL_LEVELS)
+        return -1;
+
+    Texture texture;
+    texture.levels = levels;
+    textures.push_back(texture);
+    return int(textures.size()) - 1;
+}
+
+bool VirtualTileCache::isPinned(uint32_t tile) const
+{
+    return virtualTileLevel(tile) == int(textures[virtualTileTexture(tile)].levels.size()) - 1;
+}
+
+void VirtualTileCache::request(uint32_t tile)
+{
+    int texture = virtualTileTexture(tile);
+    int level = virtualTileLevel(tile);
+    if (texture >= int(textures.size()) || level >= int(textures[texture].levels.size()))
+        return;
+
+    // Feedback is read from the GPU, so out-of-range tiles are clamped rather than trusted
+    const std::vector<VirtualLevel>& levels = textures[texture].levels;
+    int x = std::min(virtualTileX(tile), levels[level].tilesX - 1);
+    int y = std::min(virtualTileY(tile), levels[level].tilesY - 1);
+    for (; level < int(levels.size()); ++level, x /= 2, y /= 2)
+    {
+        x = std::min(x, levels[level].tilesX - 1);
+        y = std::min(y, levels[level].tilesY - 1);
+        uint32_t id = virtualTileId(texture, level, x, y);
+        if (!requested.insert(id).second)
+            break; // Its ancestors were requested along with it
+        auto found = tiles.find(id);
+        if (found != tiles.end())
+            found->second.lastUsed = frame;
+    }
+}
+
+std::vector<uint32_t> VirtualTileCache::takeMissing(size_t maxCount)
+{
+    // Top-level tiles are always wanted
+    std::vector<uint32_t> candidates(requested.begin(), requested.end());
+    for (size_t texture = 0; texture < textures.size(); ++texture)
+        candidates.push_back(virtualTileId(int(texture), int(textures[texture].levels.size()) - 1, 0, 0));
+    std::stable_sort(candidates.begin(), candidates.end(), [](uint32_t a, uint32_t b) { return virtualTileLevel(a) > virtualTileLevel(b); });
+
+    std::vector<uint32_t> missing;
+    for (uint32_t tile : candidates)
+    {
+        if (missing.size() >= maxCount)
+            break;
+        if (tiles.count(tile) != 0)
+            continue;
+        Tile& entry = tiles[tile];
+        entry.lastUsed = frame;
+        missing.push_back(tile);
+    }
+    return missing;
+}
+
+int VirtualTileCache::place(uint32_t tile)
+{
+    auto found = tiles.find(tile);
+    if (found == tiles.end() || found->second.state != TILE_LOADING)
+        return -1;
+
+    int slot = -1;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        auto victim = tiles.end();
+        for (auto candidate = tiles.begin(); candidate != tiles.end(); ++candidate)
+        {
+            const Tile& entry = candidate->second;
+            if (entry.state == TILE_RESIDENT && entry.lastUsed < frame && !isPinned(candidate->first) &&
+                (victim == tiles.end() || entry.lastUsed < victim->second.lastUsed))
+                victim = candidate;
+        }
+        if (victim == tiles.end())
+        {
+            tiles.erase(found);
+            return -1;
+        }
+        slot = victim->second.slot;
+        textures[virtualTileTexture(victim->first)].dirty = true;
+        tiles.erase(victim);
+        found = tiles.find(tile);
+    }
+
+    found->second.state = TILE_PLACED;
+    found->second.slot = slot;
+    found->second.lastUsed = frame;
+    return slot;
+}
+
+void VirtualTileCache::setResident(uint32_t tile)
+{
+    auto found = tiles.find(tile);
+    if (found == tiles.end() || found->second.state != TILE_PLACED)
+        return;
+    found->second.state = TILE_RESIDENT;
+    textures[virtualTileTexture(tile)].dirty = true;
+}
+
+void VirtualTileCache::cancel(uint32_t tile)
+{
+    auto found = tiles.find(tile);
+    if (found == tiles.end())
+        return;
+    if (found->second.slot >= 0)
+        freeSlots.push_back(found->second.slot);
+    if (found->second.state == TILE_RESIDENT)
+        textures[virtualTileTexture(tile)].dirty = true;
+    tiles.erase(found);
+}
+
+void VirtualTileCache::endFrame()
+{
+    requested.clear();
+    ++frame;
+}
+
+void VirtualTileCache::indirectionSize(int texture, int& width, int& height) const
+{
+    const std::vector<VirtualLevel>& levels = textures[texture].levels;
+    width = levels[0].tilesX;
+    height = levels.back().tableRow + levels.back().tilesY;
+}
+
+bool VirtualTileCache::updateIndirection(int texture, std::vector<unsigned char>& table)
+{
+    if (texture < 0 || texture >= int(textures.size()) || !textures[texture].dirty)
+        return false;
+
+    int width, height;
+    indirectionSize(texture, width, height);
+    table.assign(size_t(width) * height * 4, 0);
+
+    // From the top down, so each tile can fall back to its parent's entry
+    const std::vector<VirtualLevel>& levels = textures[texture].levels;
+    for (int level = int(levels.size()) - 1; level >= 0; --level)
+    {
+        const VirtualLevel& grid = levels[level];
+        for (int y = 0; y < grid.tilesY; ++y)
+        {
+            for (int x = 0; x < grid.tilesX; ++x)
+            {
+                unsigned char* entry = &table[(size_t(grid.tableRow + y) * width + x) * 4];
+                auto found = tiles.find(virtualTileId(texture, level, x, y));
+                if (found != tiles.end() && found->second.state == TILE_RESIDENT)
+                {
+                    entry[0] = static_cast<unsigned char>(found->second.slot % slotsAcross);
+                    entry[1] = static_cast<unsigned char>(found->second.slot / slotsAcross);
+                    entry[2] = static_cast<unsigned char>(level);
+                    entry[3] = 255;
+                }
+                else if (level + 1 < int(levels.size()))
+                {
+                    const VirtualLevel& parent = levels[level + 1];
+                    int parentX = std::min(x / 2, parent.tilesX - 1);
+                    int parentY = std::min(y / 2, parent.tilesY - 1);
+                    memcpy(entry, &table[(size_t(parent.tableRow + parentY) * width + parentX) * 4], 4);
+                }
+            }
+        }
+    }
+    textures[texture].dirty = false;
+    return true;
+}
+
+size_t VirtualTileCache::residentCount() const
+{
+    size_t count = 0;
+    for (const auto& tile : tiles)
+        count += tile.second.state == TILE_RESIDENT;
+    return count;
+}
+
+size_t VirtualTileCache::loadingCount() const
+{
+    size_t count = 0;
+    for (const auto& tile : tiles)
+        count += tile.second.state != TILE_RESIDENT;
+    return count;
+}
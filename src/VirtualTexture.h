@@ -0,0 +1,183 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Virtual textures: a large image cut into fixed-size tiles at every mip level and stored in one
+// file, so only the tiles the frame shows need to be in memory. A low-resolution feedback pass
+// reports the tiles in view, a worker copies them out of the mapped file, and they are placed in
+// slots of one fixed-size physical cache texture. A per-texture indirection table maps each tile
+// to the slot of the finest resident tile covering it, so memory stays fixed however large the
+// source is.
+//
+// Binary layout (little-endian): VirtualTextureHeader, zero padding up to dataOffset, then the
+// tiles of every level, largest level first and row by row within a level. Each tile is
+// VIRTUAL_TILE_SIZE texels square in RGBA, with VIRTUAL_TILE_BORDER texels copied from its
+// neighbours on each side so bilinear filtering does not need them. Columns wrap and rows clamp,
+// as on an equirectangular map.
+const char VIRTUAL_TEXTURE_MAGIC[8] = { 'S', 'O', 'L', 'V', 'T', 'E', 'X', '1' };
+const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+const char VIRTUAL_TEXTURE_DIRECTORY[] = "textures/virtual";
+const int VIRTUAL_TILE_SIZE = 128;
+const int VIRTUAL_TILE_BORDER = 4;
+const int VIRTUAL_TILE_PAYLOAD = VIRTUAL_TILE_SIZE - 2 * VIRTUAL_TILE_BORDER;
+const size_t VIRTUAL_TILE_BYTES = size_t(VIRTUAL_TILE_SIZE) * VIRTUAL_TILE_SIZE * 4;
+
+// Limits set by the 32-bit tile ids, which the feedback pass writes as RGBA8
+const int MAX_VIRTUAL_TEXTURES = 15;
+const int MAX_VIRTUAL_LEVELS = 16;
+const int MAX_VIRTUAL_TILES_PER_SIDE = 4096;
+
+// Physical cache: this many tile slots on each side of one texture
+const int VIRTUAL_CACHE_SLOTS = 16;
+
+struct VirtualTextureHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width;         // Of level 0, in texels
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t border;
+    uint32_t levelCount;
+    uint64_t tileCount;
+    uint64_t dataOffset;
+};
+
+// Tile grid of one level
+struct VirtualLevel
+{
+    int width;              // In texels
+    int height;
+    int tilesX;
+    int tilesY;
+    uint64_t firstTile;     // Index of its first tile in the file
+    int tableRow;           // Where its rows start in the indirection table
+};
+
+// Function to lay out the levels of a virtual texture, down to the first that fits in one tile
+std::vector<VirtualLevel> virtualLevels(int width, int height);
+
+// Function to get the virtual texture file built for a texture, named after the texture's file
+std::string virtualTexturePath(const std::string& directory, const std::string& texturePath);
+
+// Function to cut an image (1 to 4 channels, rows in upload order) and its mip chain into a
+// virtual texture file. The whole image is held in memory while this runs. Returns false if the
+// image is empty or too large for the tile ids, or the file cannot be written.
+bool writeVirtualTexture(const std::string& filePath, const unsigned char* pixels, int width, int height, int channels);
+
+// Mapped virtual texture file; tiles are read in place, from any thread
+class VirtualTexture
+{
+public:
+    // Function to map and check a file. Returns false if it is missing or malformed.
+    bool open(const std::string& filePath);
+
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    int width() const { return levelGrid.empty() ? 0 : levelGrid[0].width; }
+    int height() const { return levelGrid.empty() ? 0 : levelGrid[0].height; }
+    const std::vector<VirtualLevel>& levels() const { return levelGrid; }
+
+    // Function to get a tile's RGBA texels, or nullptr if it is outside the texture
+    const unsigned char* tile(int level, int x, int y) const;
+
+private:
+    MappedFile file;
+    uint64_t dataOffset = 0;
+    std::vector<VirtualLevel> levelGrid;
+};
+
+// Tile of one of the virtual textures, packed as the feedback pass writes it: x in bits 0-11,
+// y in bits 12-23, level in bits 24-27, texture in bits 28-31
+uint32_t virtualTileId(int texture, int level, int x, int y);
+int virtualTileTexture(uint32_t tile);
+int virtualTileLevel(uint32_t tile);
+int virtualTileX(uint32_t tile);
+int virtualTileY(uint32_t tile);
+
+// Function to collect the distinct tiles in a read-back feedback image. Each RGBA8 pixel holds
+// x & 255, y & 255, (x >> 8) | (y >> 8) << 4, and level | (texture + 1) << 4; pixels with no
+// texture are zero.
+void decodeVirtualFeedback(const unsigned char* pixels, size_t pixelCount, std::vector<uint32_t>& tiles);
+
+// Which tiles of the virtual textures are in the physical cache. Tiles are requested each frame
+// from the feedback, loaded, placed in a slot (evicting the least recently requested tile), and
+// become resident once their texels have been uploaded. A texture's single top-level tile is
+// always kept, so every lookup finds at least a blurry tile. The indirection tables are built
+// here; only the uploads are left to the caller.
+class VirtualTileCache
+{
+public:
+    // Function to set up the slots, forgetting every texture and tile
+    void reset(int slotsPerSide);
+
+    // Function to add a virtual texture's levels; returns its index, or -1 if there are too many
+    int addTexture(const std::vector<VirtualLevel>& levels);
+
+    // Function to ask for a tile this frame, along with the coarser tiles that cover it
+    void request(uint32_t tile);
+
+    // Function to take up to maxCount requested tiles that are neither resident nor on their way,
+    // coarsest first, and mark them loading
+    std::vector<uint32_t> takeMissing(size_t maxCount);
+
+    // Function to give a loaded tile a slot, evicting the least recently requested tile not used
+    // this frame if none is free. Returns the slot, or -1 if the tile was dropped (it will be
+    // requested again).
+    int place(uint32_t tile);
+
+    // Function to record that a placed tile's texels are in its slot
+    void setResident(uint32_t tile);
+
+    // Function to forget a tile that failed to load, so it can be requested again
+    void cancel(uint32_t tile);
+
+    // Function to end the frame's requests
+    void endFrame();
+
+    // Function to rebuild a texture's indirection table if its residency changed since the last
+    // call. The table is levels[0].tilesX wide with the levels stacked from tableRow; each RGBA8
+    // entry holds the slot x and y and the level of the finest resident tile covering that tile,
+    // and 255 alpha, or zero when nothing covers it. Returns false if it did not change.
+    bool updateIndirection(int texture, std::vector<unsigned char>& table);
+
+    // Function to get the size of a texture's indirection table
+    void indirectionSize(int texture, int& width, int& height) const;
+
+    int slotsPerSide() const { return slotsAcross; }
+    size_t residentCount() const;
+    size_t loadingCount() const;
+
+private:
+    enum TileState { TILE_LOADING, TILE_PLACED, TILE_RESIDENT };
+
+    struct Tile
+    {
+        TileState state = TILE_LOADING;
+        int slot = -1;
+        uint64_t lastUsed = 0;
+    };
+
+    struct Texture
+    {
+        std::vector<VirtualLevel> levels;
+        bool dirty = true;
+    };
+
+    bool isPinned(uint32_t tile) const;
+
+    int slotsAcross = 0;
+    std::vector<Texture> textures;
+    std::unordered_map<uint32_t, Tile> tiles;
+    std::set<uint32_t> requested;
+    std::vector<int> freeSlots;
+    uint64_t frame = 1;
+};
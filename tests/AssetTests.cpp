@@ -0,0 +1,615 @@
+#include "AssetPack.h"
+#include "FileWatcher.h"
+#include "ImageDecodeQueue.h"
+#include "MipChain.h"
+#include "ProgramCache.h"
+#include "ShaderPreprocessor.h"
+#include "TextureCache.h"
+#include "TextureManager.h"
+#include "TextureStreaming.h"
+#include "TextureUploads.h"
+#include "VirtualTexture.h"
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every submitted image comes back once, decoded on the worker pool, with failures reported
+static void testDecodeQueue()
+{
+    ImageDecodeQueue queue([](const std::string& path, DecodedImage& image)
+    {
+        if (path == "missing")
+            return false;
+        image.width = int(path.size());
+        image.height = 1;
+        image.channels = 1;
+        image.pixels.reset(new unsigned char[path.size()], [](unsigned char* pixels) { delete[] pixels; });
+        std::memcpy(image.pixels.get(), path.data(), path.size());
+        return true;
+    });
+
+    std::vector<std::string> paths = { "sun", "earth", "missing", "saturn" };
+    for (size_t i = 0; i < paths.size(); ++i)
+        queue.submit(i, paths[i]);
+    queue.waitForAll();
+    CHECK(queue.pending() == paths.size());
+
+    std::set<size_t> seen;
+    DecodedImage image;
+    while (queue.poll(image))
+    {
+        CHECK(image.path == paths[image.index]);
+        CHECK(image.decoded == (image.path != "missing"));
+        if (image.decoded)
+            CHECK(std::memcmp(image.pixels.get(), image.path.data(), image.path.size()) == 0);
+        seen.insert(image.index);
+    }
+    CHECK(seen.size() == paths.size());
+    CHECK(queue.pending() == 0);
+}
+
+// Flipping swaps rows top to bottom and leaves the middle row of an odd height alone
+static void testFlipImageRows()
+{
+    unsigned char pixels[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    flipImageRows(pixels, 1, 3, 3);
+    const unsigned char expected[] = { 7, 8, 9, 4, 5, 6, 1, 2, 3 };
+    CHECK(std::memcmp(pixels, expected, sizeof(pixels)) == 0);
+}
+
+// Cooked textures carry every mip level down to 1x1, DXT1 without alpha and DXT5 with it
+static void testCookTexture()
+{
+    std::vector<unsigned char> pixels(8 * 5 * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<unsigned char>(i * 7);
+
+    std::vector<unsigned char> dds;
+    CookedTextureInfo info;
+    CHECK(cookTexture(pixels.data(), 8, 5, 3, dds));
+    CHECK(readCookedTextureInfo(dds, info));
+    CHECK(info.width == 8 && info.height == 5);
+    CHECK(info.mipLevels == 4);             // 8x5, 4x2, 2x1, 1x1
+    CHECK(!info.alpha);
+    CHECK(info.dataBytes == (4 + 1 + 1 + 1) * 8);
+
+    CHECK(cookTexture(pixels.data(), 8, 5, 4, dds));
+    CHECK(readCookedTextureInfo(dds, info));
+    CHECK(info.alpha);
+    CHECK(info.dataBytes == (4 + 1 + 1 + 1) * 16);
+
+    // A truncated entry is rejected so it gets cooked again
+    dds.pop_back();
+    CHECK(!readCookedTextureInfo(dds, info));
+    CHECK(!cookTexture(nullptr, 8, 5, 3, dds));
+}
+
+// Mips average colour in linear light and alpha as is, down to 1x1 from odd sizes too, where the
+// last column and row are weighted in rather than dropped
+static void testMipChain()
+{
+    // Black and white columns average to the sRGB value of half the light, not 128
+    std::vector<unsigned char> pixels(4 * 2 * 4);
+    for (int x = 0; x < 4; ++x)
+    {
+        for (int y = 0; y < 2; ++y)
+        {
+            unsigned char value = x % 2 == 0 ? 0 : 255;
+            for (int c = 0; c < 4; ++c)
+                pixels[(y * 4 + x) * 4 + c] = value;
+        }
+    }
+
+    MipChain chain;
+    CHECK(buildMipChain(pixels.data(), 4, 2, 4, chain));
+    CHECK(chain.levels.size() == 2);
+    CHECK(chain.levels[0].width == 2 && chain.levels[0].height == 1);
+    CHECK(chain.levels[1].width == 1 && chain.levels[1].height == 1);
+    const unsigned char* texel = chain.level(1);
+    CHECK(texel[0] == 188 && texel[1] == 188 && texel[2] == 188);
+    CHECK(texel[3] == 128);
+
+    // Opaque only in the last column and the last row: the two texels of the 2x1 level take
+    // thirds of the rows, and fifths (2, 2, 1 and 1, 2, 2) of the columns
+    std::vector<unsigned char> edges(5 * 3 * 2, 0);
+    for (int y = 0; y < 3; ++y)
+    {
+        for (int x = 0; x < 5; ++x)
+            edges[(y * 5 + x) * 2 + 1] = x == 4 || y == 2 ? 255 : 0;
+    }
+    CHECK(buildMipChain(edges.data(), 5, 3, 2, chain));
+    CHECK(chain.levels.size() == 2);            // 2x1, 1x1
+    CHECK(chain.pixels.size() == 6);
+    CHECK(chain.level(0)[1] == 85);             // 1/3
+    CHECK(chain.level(0)[3] == 153);            // 1/3 + 2/3 * 2/5
+    CHECK(chain.level(1)[1] == 119);
+    CHECK(!buildMipChain(nullptr, 5, 3, 1, chain));
+}
+
+// Cache entries follow the source's bytes, not its name
+static void testTextureCachePath()
+{
+    unsigned char source[] = { 1, 2, 3, 4 };
+    std::string path = textureCachePath("cache", hashBytes(source, sizeof(source)));
+    CHECK(path == textureCachePath("cache", hashBytes(source, sizeof(source))));
+    CHECK(path.size() == std::string("cache/").size() + 16 + 4);
+
+    source[3] = 5;
+    CHECK(path != textureCachePath("cache", hashBytes(source, sizeof(source))));
+}
+
+// Textures are shared by path and by identical bytes, and deleted with their last reference
+static void testTextureSharing()
+{
+    TextureManager manager;
+    bool isNew;
+    size_t moon = manager.acquire("moon.jpg", isNew);
+    CHECK(isNew);
+    size_t asteroid = manager.acquire("asteroid.jpg", isNew);
+    CHECK(isNew);
+    CHECK(manager.acquire("moon.jpg", isNew) == moon);
+    CHECK(!isNew);
+
+    // The asteroid has the moon's bytes, so it is merged before being decoded
+    CHECK(manager.claimContent(moon, 42) == moon);
+    CHECK(manager.claimContent(asteroid, 42) == moon);
+    CHECK(manager.resolve(asteroid) == moon);
+    CHECK(manager.acquire("asteroid.jpg", isNew) == moon);
+    CHECK(!isNew);
+    CHECK(manager.handle(asteroid) == 0);
+
+    manager.setResident(moon, 7, 1000, 8000, 3.0);
+    CHECK(manager.handle(asteroid) == 7);
+    TextureStats stats = manager.stats();
+    CHECK(stats.textures == 1);
+    CHECK(stats.shared == 3);
+    CHECK(stats.gpuBytes == 1000);
+    CHECK(stats.savedBytes == 3000);
+
+    // Four references: two for each path
+    CHECK(manager.release(moon) == 0);
+    CHECK(manager.release(asteroid) == 0);
+    CHECK(manager.release(moon) == 0);
+    CHECK(manager.release(asteroid) == 7);
+    CHECK(manager.stats().textures == 0);
+
+    // Once released, the path and the bytes load afresh
+    size_t again = manager.acquire("asteroid.jpg", isNew);
+    CHECK(isNew);
+    CHECK(manager.claimContent(again, 42) == again);
+
+    // A file changed on disk loads as a new texture while the old one keeps its reference
+    manager.setResident(again, 9, 1000, 8000, 3.0);
+    manager.forgetPath("asteroid.jpg");
+    size_t reloaded = manager.acquire("asteroid.jpg", isNew);
+    CHECK(isNew && reloaded != again);
+    CHECK(manager.claimContent(reloaded, 43) == reloaded);
+    CHECK(manager.release(again) == 9);
+    CHECK(manager.acquire("asteroid.jpg", isNew) == reloaded && !isNew);
+
+    // A texture released before it finished loading is no longer held
+    CHECK(manager.holds(reloaded));
+    CHECK(manager.release(reloaded) == 0);
+    CHECK(manager.release(reloaded) == 0);
+    CHECK(!manager.holds(reloaded));
+}
+
+// Program binaries round-trip under their key, and a changed source or driver gets another key
+static void testProgramCache()
+{
+    uint64_t key = programCacheKey("vertex", "fragment", "Vendor", "Renderer", "4.6");
+    CHECK(key == programCacheKey("vertex", "fragment", "Vendor", "Renderer", "4.6"));
+    CHECK(key != programCacheKey("vertex", "fragment2", "Vendor", "Renderer", "4.6"));
+    CHECK(key != programCacheKey("vertex", "fragment", "Vendor", "Renderer", "4.5"));
+    CHECK(key != programCacheKey("vertexf", "ragment", "Vendor", "Renderer", "4.6"));
+    CHECK(programCachePath("cache", 0x1f) == "cache/000000000000001f.bin");
+
+    const std::string path = "AssetTests.program";
+    std::vector<unsigned char> binary = { 1, 2, 3, 4, 5 };
+    CHECK(writeProgramBinary(path, key, 0x8741, binary));
+    uint32_t format = 0;
+    std::vector<unsigned char> loaded;
+    CHECK(readProgramBinary(path, key, format, loaded));
+    CHECK(format == 0x8741 && loaded == binary);
+    CHECK(!readProgramBinary(path, key + 1, format, loaded));
+
+    // A truncated file is refused
+    std::vector<unsigned char> bytes;
+    CHECK(readFileBytes(path, bytes));
+    bytes.pop_back();
+    CHECK(writeFileAtomically(path, bytes));
+    CHECK(!readProgramBinary(path, key, format, loaded));
+    std::remove(path.c_str());
+    CHECK(!readProgramBinary(path, key, format, loaded));
+}
+
+// Includes expand once per stage relative to the including file, and defines follow #version
+static void testShaderPreprocessor()
+{
+    std::map<std::string, std::string> files = {
+        { "shaders/Basic.shader", "// shared\n#include \"common/Light.glsl\"\n#shader vertex\n#version 330 core\nvoid vertex();\n"
+            "#shader fragment\n#version 330 core\n#ifdef LIT\n#include \"common/Light.glsl\"\n#endif\nvoid fragment();\n" },
+        { "shaders/common/Light.glsl", "#include \"../Util.glsl\"\nvoid light();\n" },
+        { "shaders/Util.glsl", "void util();\n" },
+        { "shaders/Broken.shader", "#shader vertex\n#version 330 core\n\n#include \"Missing.glsl\"\n" },
+    };
+    ShaderFileReader reader = [&](const std::string& path, std::string& text)
+    {
+        auto found = files.find(path);
+        if (found == files.end())
+            return false;
+        text = found->second;
+        return true;
+    };
+
+    PreprocessedShader shader;
+    std::string error;
+    CHECK(preprocessShader("shaders/Basic.shader", { "LIT", "LEVELS 4" }, reader, shader, error));
+    CHECK(shader.vertexSource == "#version 330 core\n#define LIT\n#define LEVELS 4\n// shared\nvoid util();\nvoid light();\nvoid vertex();\n");
+    CHECK(shader.fragmentSource == "#version 330 core\n#define LIT\n#define LEVELS 4\n// shared\nvoid util();\nvoid light();\n"
+        "#ifdef LIT\n#endif\nvoid fragment();\n");
+    CHECK((shader.files == std::vector<std::string>{ "shaders/Basic.shader", "shaders/common/Light.glsl", "shaders/Util.glsl" }));
+
+    // A missing include names the file and line that asked for it
+    CHECK(!preprocessShader("shaders/Broken.shader", {}, reader, shader, error));
+    CHECK(error == "shaders/Broken.shader:4: cannot read shaders/Missing.glsl");
+    CHECK(!preprocessShader("shaders/None.shader", {}, reader, shader, error));
+
+    // Permutations are cached by file and name, failures included, and found by any file they read
+    ShaderPermutationCache cache;
+    uint32_t program = 0;
+    CHECK(!cache.find("shaders/Basic.shader", "lit", program));
+    cache.insert("shaders/Basic.shader", { "lit", { "LIT" } }, 7, { "shaders/Basic.shader", "shaders/common/Light.glsl" });
+    cache.insert("shaders/Basic.shader", { "line", {} }, 0, { "shaders/Basic.shader" });
+    cache.insert("shaders/Other.shader", { "lit", { "LIT" } }, 9, { "shaders/Other.shader", "shaders/common/Light.glsl" });
+    CHECK(cache.find("shaders/Basic.shader", "lit", program) && program == 7);
+    CHECK(cache.find("shaders/Basic.shader", "line", program) && program == 0);
+    CHECK(cache.dependents("shaders/common/Light.glsl").size() == 2);
+    std::vector<std::pair<std::string, ShaderPermutation>> dependents = cache.dependents("shaders/Basic.shader");
+    CHECK(dependents.size() == 2 && dependents[0].first == "shaders/Basic.shader");
+    CHECK(cache.dependents("shaders/Util.glsl").empty());
+
+    cache.insert("shaders/Basic.shader", { "lit", { "LIT" } }, 8, { "shaders/Basic.shader" });
+    CHECK(cache.find("shaders/Basic.shader", "lit", program) && program == 8 && cache.size() == 3);
+    std::vector<uint32_t> released = cache.clear();
+    std::sort(released.begin(), released.end());
+    CHECK((released == std::vector<uint32_t>{ 8, 9 }) && cache.size() == 0);
+}
+
+// Files written under a watched directory are reported once they settle; ignored directories are not
+static void testFileWatcher()
+{
+    const std::string directory = "AssetTests.watch";
+    const std::string ignored = directory + "/ignored";
+    createDirectory(directory);
+    createDirectory(ignored);
+
+    FileWatcher watcher;
+    CHECK(watcher.start({ directory }, { ignored }));
+    for (const std::string& path : { directory + "/a.txt", ignored + "/b.txt" })
+    {
+        std::ofstream stream(path);
+        stream << "changed";
+    }
+
+    std::vector<std::string> changed;
+    for (int attempt = 0; attempt < 100 && changed.empty(); ++attempt)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        changed = watcher.takeChanged();
+    }
+    CHECK(changed.size() == 1 && changed[0] == directory + "/a.txt");
+    CHECK(watcher.takeChanged().empty());
+    watcher.stop();
+
+    std::remove((directory + "/a.txt").c_str());
+    std::remove((ignored + "/b.txt").c_str());
+    std::remove(ignored.c_str());
+    std::remove(directory.c_str());
+}
+
+// Textures start with their small mips, refine one level per update towards what is asked for,
+// and give levels back least recently used first when over budget
+static void testTextureStreaming()
+{
+    CookedTextureInfo info;
+    info.width = 1024;
+    info.height = 512;
+    info.mipLevels = mipLevelCount(info.width, info.height);
+    info.dataBytes = TextureStreamer::chainBytes(info, 0);
+
+    CHECK(TextureStreamer::levelForScreenSize(info, 512.0) == 0);
+    CHECK(TextureStreamer::levelForScreenSize(info, 128.0) == 2);
+    CHECK(TextureStreamer::levelForScreenSize(info, 0.5) == info.mipLevels - 1);
+
+    TextureStreamer streamer;
+    CHECK(streamer.add(1, info) == 4);
+    CHECK(streamer.add(2, info) == 4);
+    size_t tail = TextureStreamer::chainBytes(info, 4);
+    CHECK(streamer.residentBytes() == 2 * tail);
+
+    const size_t unlimited = size_t(-1);
+    for (int level = 3; level >= 0; --level)
+    {
+        streamer.request(1, 512.0);
+        std::vector<TextureStreamStep> steps = streamer.update(unlimited);
+        CHECK(steps.size() == 1);
+        CHECK(steps[0].id == 1 && steps[0].previousBase == level + 1 && steps[0].baseLevel == level);
+    }
+    CHECK(streamer.update(unlimited).empty());
+
+    // Room for one full chain and a tail: the texture nobody asked for this frame gives way
+    streamer.request(2, 128.0);
+    std::vector<TextureStreamStep> steps = streamer.update(info.dataBytes + tail);
+    CHECK(steps.size() == 2);
+    CHECK(streamer.residentBase(1) == 1);
+    CHECK(streamer.residentBase(2) == 3);
+
+    // With no budget, everything falls back to the tails
+    streamer.update(0);
+    CHECK(streamer.residentBase(1) == 4 && streamer.residentBase(2) == 4);
+    CHECK(streamer.residentBytes() == 2 * tail);
+    streamer.remove(1);
+    CHECK(streamer.residentBase(1) == -1);
+}
+
+// The staging ring hands out aligned space in order, wraps once earlier frames retire, and the
+// scheduler stages uploads under the frame budget
+static void testTextureUploads()
+{
+    StagingRing ring;
+    ring.reset(100);
+    size_t offset = 1;
+    CHECK(ring.allocate(60, 16, offset) && offset == 0);
+    uint64_t first = ring.endFrame();
+    CHECK(ring.allocate(30, 16, offset) && offset == 64);
+    CHECK(!ring.allocate(50, 16, offset));      // Neither the end nor the start has room yet
+    ring.endFrame();
+    ring.retire(first);
+    CHECK(ring.allocate(50, 16, offset) && offset == 0);
+    CHECK(!ring.allocate(20, 16, offset));      // Would run into the second frame's data
+    ring.retire(ring.endFrame());
+    CHECK(ring.used() == 0);
+
+    std::vector<unsigned char> mapped(100);
+    std::vector<unsigned char> data(30, 9);
+    std::vector<size_t> issued;
+    UploadScheduler scheduler;
+    for (size_t owner = 1; owner <= 3; ++owner)
+    {
+        StagedUpload upload;
+        upload.owner = owner;
+        upload.data = data.data();
+        upload.bytes = data.size();
+        upload.issue = [&issued](const void* pixels) { issued.push_back(reinterpret_cast<size_t>(pixels)); };
+        scheduler.enqueue(upload);
+    }
+    CHECK(scheduler.pendingBytes() == 90);
+
+    // The first upload goes even though two would pass the budget
+    ring.reset(100);
+    CHECK(scheduler.issue(50, &ring, mapped.data()) == 30);
+    CHECK(issued.size() == 1 && issued[0] == 0);
+    CHECK(mapped[0] == 9 && mapped[29] == 9 && mapped[30] == 0);
+
+    scheduler.cancel(2);
+    CHECK(!scheduler.pending(2) && scheduler.pending(3));
+    CHECK(scheduler.issue(1000, &ring, mapped.data()) == 30);
+    CHECK(issued.size() == 2 && issued[1] == 32);
+    CHECK(scheduler.pendingCount() == 0);
+
+    // Without a ring the source memory is passed through
+    StagedUpload direct;
+    direct.data = data.data();
+    direct.bytes = data.size();
+    direct.issue = [&issued](const void* pixels) { issued.push_back(reinterpret_cast<size_t>(pixels)); };
+    scheduler.enqueue(direct);
+    scheduler.issue(50, nullptr, nullptr);
+    CHECK(issued.size() == 3 && issued[2] == reinterpret_cast<size_t>(data.data()));
+}
+
+// Virtual textures are cut into bordered tiles, read back in place, and cached with fallbacks to
+// coarser tiles
+static void testVirtualTexture()
+{
+    std::vector<VirtualLevel> levels = virtualLevels(250, 130);
+    CHECK(levels.size() == 3);
+    CHECK(levels[0].tilesX == 3 && levels[0].tilesY == 2 && levels[0].tableRow == 0);
+    CHECK(levels[1].width == 125 && levels[1].tilesX == 2 && levels[1].tilesY == 1 && levels[1].firstTile == 6 && levels[1].tableRow == 2);
+    CHECK(levels[2].tilesX == 1 && levels[2].tilesY == 1 && levels[2].firstTile == 8);
+    CHECK(virtualTexturePath("textures/virtual", "textures/earth.jpg") == "textures/virtual/earth.vtex");
+
+    const char* path = "AssetTests.vtex";
+    std::vector<unsigned char> pixels(250 * 130 * 3);
+    for (int y = 0; y < 130; ++y)
+    {
+        for (int x = 0; x < 250; ++x)
+        {
+            pixels[(y * 250 + x) * 3] = static_cast<unsigned char>(x);
+            pixels[(y * 250 + x) * 3 + 1] = static_cast<unsigned char>(y);
+            pixels[(y * 250 + x) * 3 + 2] = 7;
+        }
+    }
+    CHECK(writeVirtualTexture(path, pixels.data(), 250, 130, 3));
+
+    VirtualTexture texture;
+    CHECK(texture.open(path));
+    CHECK(texture.width() == 250 && texture.height() == 130 && texture.levels().size() == 3);
+    const unsigned char* tile = texture.tile(0, 1, 0);
+    CHECK(tile != nullptr);
+    if (tile != nullptr)
+    {
+        const unsigned char* texel = tile + (VIRTUAL_TILE_BORDER * VIRTUAL_TILE_SIZE + VIRTUAL_TILE_BORDER) * 4;
+        CHECK(texel[0] == 120 && texel[1] == 0 && texel[2] == 7 && texel[3] == 255);
+    }
+    tile = texture.tile(0, 0, 0);
+    if (tile != nullptr)
+        CHECK(tile[0] == 246 && tile[1] == 0);  // The border wraps across columns and clamps at the bottom row
+    CHECK(texture.tile(0, 3, 0) == nullptr && texture.tile(3, 0, 0) == nullptr);
+    texture.close();
+    std::remove(path);
+
+    uint32_t id = virtualTileId(14, 15, 4095, 4094);
+    CHECK(virtualTileTexture(id) == 14 && virtualTileLevel(id) == 15 && virtualTileX(id) == 4095 && virtualTileY(id) == 4094);
+    const unsigned char feedback[] = { 0, 0, 0, 0, 2, 1, 0, 0x10, 2, 1, 0, 0x10, 44, 3, 0x21, 0x21 };
+    std::vector<uint32_t> tiles;
+    decodeVirtualFeedback(feedback, 4, tiles);
+    CHECK(tiles.size() == 2);
+    CHECK(std::find(tiles.begin(), tiles.end(), virtualTileId(0, 0, 2, 1)) != tiles.end());
+    CHECK(std::find(tiles.begin(), tiles.end(), virtualTileId(1, 1, 300, 515)) != tiles.end());
+
+    // Requests bring their parents along, coarsest first
+    VirtualTileCache cache;
+    cache.reset(2);
+    CHECK(cache.addTexture(levels) == 0);
+    cache.request(virtualTileId(0, 0, 2, 1));
+    std::vector<uint32_t> missing = cache.takeMissing(10);
+    CHECK(missing.size() == 3);
+    CHECK(missing.size() == 3 && virtualTileLevel(missing[0]) == 2 && virtualTileLevel(missing[2]) == 0);
+    CHECK(cache.takeMissing(10).empty());
+    int slots[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        slots[i] = cache.place(missing[i]);
+        CHECK(slots[i] == i);
+        cache.setResident(missing[i]);
+    }
+    CHECK(cache.place(missing[0]) < 0 && cache.residentCount() == 3);
+
+    // Tiles map to their own slot, or to the nearest resident ancestor's
+    std::vector<unsigned char> table;
+    int width, height;
+    cache.indirectionSize(0, width, height);
+    CHECK(width == 3 && height == 4);
+    CHECK(cache.updateIndirection(0, table) && table.size() == 3 * 4 * 4);
+    const unsigned char* entry = &table[(1 * 3 + 2) * 4];
+    CHECK(entry[0] == 0 && entry[1] == 1 && entry[2] == 0 && entry[3] == 255);
+    entry = &table[0];
+    CHECK(entry[0] == 0 && entry[1] == 0 && entry[2] == 2 && entry[3] == 255);
+    CHECK(!cache.updateIndirection(0, table));
+    cache.endFrame();
+
+    // A full cache evicts a tile not used this frame, never the top-level tile
+    cache.request(virtualTileId(0, 0, 0, 0));
+    missing = cache.takeMissing(10);
+    CHECK(missing.size() == 2);
+    int slot = cache.place(missing[0]);
+    CHECK(slot == 3);
+    int evicted = cache.place(missing[1]);
+    CHECK(evicted == 1 || evicted == 2);
+    cache.setResident(missing[0]);
+    cache.setResident(missing[1]);
+    CHECK(cache.residentCount() == 4 && cache.loadingCount() == 0);
+    CHECK(cache.updateIndirection(0, table));
+    CHECK(table[2] == 0 && table[3] == 255);
+    cache.cancel(missing[1]);
+    CHECK(cache.residentCount() == 3);
+}
+
+// Packs round-trip through the mapping with page-aligned blobs, identical assets share a blob, and
+// an asset whose source file changed is reported as stale
+static void testAssetPack()
+{
+    const char* path = "AssetTests.pack";
+    const char* sourcePath = "AssetTests.glsl";
+
+    std::vector<unsigned char> pixels(8 * 4 * 3, 200);
+    std::vector<unsigned char> dds;
+    CookedTextureInfo info;
+    CHECK(cookTexture(pixels.data(), 8, 4, 3, dds));
+    CHECK(readCookedTextureInfo(dds, info));
+
+    std::vector<AssetPackInput> assets;
+    for (const char* name : { "textures/moon.jpg", "textures/asteroid.jpg" })
+    {
+        AssetPackInput texture = makeAssetInput(name, ASSET_TEXTURE);
+        texture.entry.format = ASSET_FORMAT_DXT1;
+        texture.entry.width = info.width;
+        texture.entry.height = info.height;
+        texture.entry.mipLevels = info.mipLevels;
+        texture.entry.contentHash = 42;
+        texture.data.assign(dds.end() - info.dataBytes, dds.end());
+        assets.push_back(texture);
+    }
+
+    AssetPackInput shader = makeAssetInput("res/shaders/Basic.shader", ASSET_SHADER);
+    const std::string source = "#shader vertex\n";
+    shader.data.assign(source.begin(), source.end());
+    assets.push_back(shader);
+
+    AssetPackInput mesh = makeAssetInput("meshes/triangle", ASSET_MESH);
+    float vertices[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f };
+    uint32_t indices[] = { 0, 1, 2 };
+    mesh.entry.vertexCount = 3;
+    mesh.entry.vertexStride = 2 * sizeof(float);
+    mesh.entry.indexCount = 3;
+    mesh.data.assign(reinterpret_cast<unsigned char*>(vertices), reinterpret_cast<unsigned char*>(vertices) + sizeof(vertices));
+    mesh.data.insert(mesh.data.end(), reinterpret_cast<unsigned char*>(indices), reinterpret_cast<unsigned char*>(indices) + sizeof(indices));
+    assets.push_back(mesh);
+
+    std::ofstream(sourcePath) << "#shader fragment\n";
+    AssetPackInput included = makeAssetInput(sourcePath, ASSET_SHADER);
+    CHECK(stampAssetSource(included.entry));
+    CHECK(readFileBytes(sourcePath, included.data));
+    assets.push_back(included);
+    CHECK(writeAssetPack(path, assets));
+
+    AssetPack pack;
+    CHECK(pack.open(path));
+    CHECK(pack.size() == assets.size());
+    const AssetEntry* moon = pack.find("textures/moon.jpg", ASSET_TEXTURE);
+    const AssetEntry* asteroid = pack.find("textures/asteroid.jpg", ASSET_TEXTURE);
+    CHECK(moon != nullptr && asteroid != nullptr);
+    if (moon != nullptr && asteroid != nullptr)
+    {
+        CHECK(moon->offset == asteroid->offset);
+        CHECK(moon->offset % ASSET_PACK_ALIGNMENT == 0);
+        CHECK(reinterpret_cast<uintptr_t>(pack.data(*moon)) % ASSET_PACK_ALIGNMENT == 0);
+        CHECK(std::memcmp(pack.data(*moon), &dds[dds.size() - info.dataBytes], info.dataBytes) == 0);
+    }
+    const AssetEntry* packedShader = pack.find("res/shaders/Basic.shader", ASSET_SHADER);
+    CHECK(packedShader != nullptr && std::string(reinterpret_cast<const char*>(pack.data(*packedShader)), size_t(packedShader->size)) == source);
+    const AssetEntry* packedMesh = pack.find("meshes/triangle", ASSET_MESH);
+    CHECK(packedMesh != nullptr && packedMesh->offset % ASSET_PACK_ALIGNMENT == 0 && packedMesh->indexCount == 3);
+    CHECK(pack.find("meshes/triangle", ASSET_TEXTURE) == nullptr);
+
+    CHECK(pack.staleAssets().empty());
+    std::ofstream(sourcePath) << "#shader fragment\n// Edited\n";
+    std::vector<std::string> stale = pack.staleAssets();
+    CHECK(stale.size() == 1 && stale[0] == sourcePath);
+    std::remove(sourcePath);
+    CHECK(pack.staleAssets().size() == 1);
+    pack.close();
+
+    // A texture whose size does not match its mip chain is refused
+    assets[0].data.pop_back();
+    CHECK(!writeAssetPack(path, assets));
+    std::remove(path);
+}
+
+int main()
+{
+    RUN_TEST(testDecodeQueue);
+    RUN_TEST(testFlipImageRows);
+    RUN_TEST(testMipChain);
+    RUN_TEST(testCookTexture);
+    RUN_TEST(testTextureCachePath);
+    RUN_TEST(testTextureSharing);
+    RUN_TEST(testFileWatcher);
+    RUN_TEST(testProgramCache);
+    RUN_TEST(testShaderPreprocessor);
+    RUN_TEST(testTextureStreaming);
+    RUN_TEST(testTextureUploads);
+    RUN_TEST(testVirtualTexture);
+    RUN_TEST(testAssetPack);
+    return testFailures();
+}
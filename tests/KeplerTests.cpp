@@ -0,0 +1,211 @@
+#include "Ephemeris.h"
+#include "Kepler.h"
+#include "TestSupport.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+static const double PI = 3.14159265358979323846;
+
+// Function to build a batch holding a single orbit
+static KeplerBatch singleOrbit(double a, double e, double inclination, double node, double periapsis, double meanAnomaly, double meanMotion)
+{
+    KeplerBatch batch;
+    OrbitalElements elements = { a, e, inclination, node, periapsis, meanAnomaly, meanMotion };
+    addOrbit(batch, elements);
+    return batch;
+}
+
+// Function to get the position and velocity of the first orbit in a batch
+static void stateAt(const KeplerBatch& batch, double time, glm::dvec3& position, glm::dvec3& velocity)
+{
+    Vec3Array positions, velocities;
+    propagateOrbits(batch, time, positions, &velocities);
+    position = positions[0];
+    velocity = velocities[0];
+}
+
+// A circular orbit keeps its radius and returns to its start after one period
+static void testCircularOrbit()
+{
+    const double n = 0.017;
+    KeplerBatch batch = singleOrbit(6.0, 0.0, 0.0, 0.0, 0.0, 0.3, n);
+    double period = 2.0 * PI / n;
+
+    glm::dvec3 start, velocity;
+    stateAt(batch, 0.0, start, velocity);
+    for (int i = 0; i < 16; ++i)
+    {
+        glm::dvec3 position;
+        stateAt(batch, period * i / 16.0, position, velocity);
+        CHECK_NEAR(glm::length(position), 6.0, 1e-12);
+        CHECK_NEAR(glm::length(velocity), 6.0 * n, 1e-12);
+    }
+
+    glm::dvec3 end;
+    stateAt(batch, period, end, velocity);
+    CHECK_NEAR(glm::length(end - start), 0.0, 1e-9);
+}
+
+// An eccentric orbit starts at periapsis a(1 - e) and reaches apoapsis a(1 + e) half a period later
+static void testApsides()
+{
+    const double a = 10.0, e = 0.3, n = 0.01;
+    KeplerBatch batch = singleOrbit(a, e, 0.2, 1.0, 0.5, 0.0, n);
+
+    glm::dvec3 position, velocity;
+    stateAt(batch, 0.0, position, velocity);
+    CHECK_NEAR(glm::length(position), a * (1.0 - e), 1e-12);
+    CHECK_NEAR(glm::dot(position, velocity), 0.0, 1e-12);
+
+    stateAt(batch, PI / n, position, velocity);
+    CHECK_NEAR(glm::length(position), a * (1.0 + e), 1e-12);
+}
+
+// Function to solve Kepler's equation by bisection, as an independent reference
+static double solveKeplerByBisection(double meanAnomaly, double e)
+{
+    double low = meanAnomaly - 1.0, high = meanAnomaly + 1.0;
+    for (int i = 0; i < 200; ++i)
+    {
+        double middle = 0.5 * (low + high);
+        if (middle - e * sin(middle) < meanAnomaly)
+            low = middle;
+        else
+            high = middle;
+    }
+    return 0.5 * (low + high);
+}
+
+// The propagator's fixed iteration count must still converge on very eccentric orbits
+static void testKeplerEquationAtHighEccentricity()
+{
+    const double e[] = { 0.5, 0.9, 0.97 };
+    for (double eccentricity : e)
+    {
+        const double n = 1.0;
+        KeplerBatch batch = singleOrbit(3.0, eccentricity, 0.4, 0.7, 2.1, 0.0, n);
+
+        for (int i = 1; i < 64; ++i)
+        {
+            double meanAnomaly = 2.0 * PI * i / 64.0;
+            Vec3Array positions;
+            propagateOrbits(batch, meanAnomaly / n, positions);
+
+            glm::dvec3 expected = orbitPoint(batch, 0, solveKeplerByBisection(meanAnomaly, eccentricity));
+            CHECK_NEAR(glm::length(positions[0] - expected), 0.0, 1e-9);
+        }
+    }
+}
+
+// Speed follows the vis-viva equation and angular momentum is constant
+static void testVisVivaAndAngularMomentum()
+{
+    const double a = 4.0, e = 0.6, n = 0.05;
+    const double gm = n * n * a * a * a;
+    KeplerBatch batch = singleOrbit(a, e, 0.3, 2.0, 1.0, 0.0, n);
+
+    glm::dvec3 position, velocity;
+    stateAt(batch, 0.0, position, velocity);
+    glm::dvec3 angularMomentum = glm::cross(position, velocity);
+
+    for (int i = 0; i < 32; ++i)
+    {
+        stateAt(batch, 2.0 * PI / n * i / 32.0, position, velocity);
+        double r = glm::length(position);
+        CHECK_NEAR(glm::dot(velocity, velocity), gm * (2.0 / r - 1.0 / a), 1e-10);
+        CHECK_NEAR(glm::length(glm::cross(position, velocity) - angularMomentum), 0.0, 1e-10);
+    }
+}
+
+// The orbit plane is tilted from the x-z plane (pole +y) by the inclination
+static void testInclination()
+{
+    const double inclinations[] = { 0.0, 0.1, 0.8, 1.5 };
+    for (double inclination : inclinations)
+    {
+        KeplerBatch batch = singleOrbit(5.0, 0.1, inclination, 0.9, 0.3, 1.0, 0.02);
+
+        glm::dvec3 position, velocity;
+        stateAt(batch, 10.0, position, velocity);
+        glm::dvec3 pole = glm::normalize(glm::cross(position, velocity));
+        CHECK_NEAR(atan2(glm::length(glm::dvec2(pole.x, pole.z)), std::fabs(pole.y)), inclination, 1e-12);
+    }
+}
+
+// Kepler's third law: four times the distance gives an eighth of the mean motion
+static void testThirdLaw()
+{
+    CHECK_NEAR(meanMotionForSemiMajorAxis(24.0, 6.0, 0.016), 0.002, 1e-15);
+    CHECK_NEAR(meanMotionForSemiMajorAxis(6.0, 6.0, 0.016), 0.016, 1e-15);
+}
+
+// Many orbits propagated together give the same result as one at a time
+static void testBatchMatchesSingleOrbits()
+{
+    KeplerBatch batch;
+    std::vector<KeplerBatch> singles;
+    for (int i = 0; i < 1000; ++i)
+    {
+        OrbitalElements elements = { 1.0 + i * 0.01, (i % 90) * 0.01, (i % 7) * 0.1, i * 0.37, i * 0.11, i * 0.05, 0.1 / (1.0 + i * 0.01) };
+        addOrbit(batch, elements);
+        if (i % 97 == 0)
+            singles.push_back(singleOrbit(elements.semiMajorAxis, elements.eccentricity, elements.inclination, elements.ascendingNode,
+                                          elements.argumentOfPeriapsis, elements.meanAnomalyAtEpoch, elements.meanMotion));
+    }
+
+    Vec3Array positions;
+    propagateOrbits(batch, 123.4, positions);
+    for (size_t i = 0; i < singles.size(); ++i)
+    {
+        Vec3Array single;
+        propagateOrbits(singles[i], 123.4, single);
+        CHECK_NEAR(glm::length(positions[i * 97] - single[0]), 0.0, 0.0);
+        CHECK_NEAR(glm::length(positions[i * 97] - orbitPosition(batch, i * 97, 123.4)), 0.0, 1e-12);
+    }
+}
+
+// A fitted ephemeris reproduces the orbits it was fitted to
+static void testEphemerisMatchesOrbits()
+{
+    KeplerBatch orbits;
+    OrbitalElements inner = { 2.0, 0.2056, 0.122, 0.843, 0.508, 3.05, 0.033 };
+    OrbitalElements outer = { 16.0, 0.0542, 0.043, 1.984, 1.614, 0.75, 0.007 };
+    addOrbit(orbits, inner);
+    addOrbit(orbits, outer);
+
+    std::vector<double> segmentLengths;
+    for (size_t i = 0; i < orbits.size(); ++i)
+        segmentLengths.push_back(2.0 * PI / orbits.meanMotion[i] / 8.0);
+
+    Ephemeris ephemeris;
+    fitEphemeris([&](size_t body, double time)
+    {
+        Vec3Array positions;
+        propagateOrbits(orbits, time, positions);
+        return positions[body];
+    }, segmentLengths, 0.0, 5000.0, 12, ephemeris);
+
+    for (int i = 0; i <= 100; ++i)
+    {
+        double time = 5000.0 * i / 100.0;
+        Vec3Array positions;
+        propagateOrbits(orbits, time, positions);
+        for (size_t body = 0; body < orbits.size(); ++body)
+            CHECK_NEAR(glm::length(ephemerisPosition(ephemeris, body, time) - positions[body]), 0.0, 1e-8);
+    }
+}
+
+int main()
+{
+    RUN_TEST(testCircularOrbit);
+    RUN_TEST(testApsides);
+    RUN_TEST(testKeplerEquationAtHighEccentricity);
+    RUN_TEST(testVisVivaAndAngularMomentum);
+    RUN_TEST(testInclination);
+    RUN_TEST(testThirdLaw);
+    RUN_TEST(testBatchMatchesSingleOrbits);
+    RUN_TEST(testEphemerisMatchesOrbits);
+    return testFailures();
+}
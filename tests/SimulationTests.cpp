@@ -0,0 +1,377 @@
+#include "Replay.h"
+#include "Snapshot.h"
+#include "SolarSystem.h"
+#include "SpatialHash.h"
+#include "StartupProfiler.h"
+#include "TestSupport.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// Tests run from the repository root (see CMakeLists.txt), where the body file lives
+
+// Function to create a small, reproducible solar system without touching the ephemeris file
+static bool createTestSolarSystem(SolarSystem& system, unsigned int seed = 7)
+{
+    SolarSystemSettings settings;
+    settings.ephemerisPath.clear();
+    settings.minorBodiesPath.clear();
+    settings.asteroidCount = 2000;
+    settings.ringAsteroidCount = 1000;
+    settings.seed = seed;
+    return createSolarSystem(settings, system);
+}
+
+// Function to get the largest distance between matching positions of two arrays
+static double largestDifference(const Vec3Array& a, const Vec3Array& b)
+{
+    double largest = 0.0;
+    for (size_t i = 0; i < a.size(); ++i)
+        largest = std::max(largest, glm::length(a[i] - b[i]));
+    return largest;
+}
+
+// Real time is spent in whole ticks, and a slow frame cannot bank more than the cap
+static void testFixedTimestep()
+{
+    FixedTimestep timestep = { 0.01, 4 };
+    CHECK(beginFrame(timestep, 0.025) == 2);
+    CHECK_NEAR(interpolationFactor(timestep), 0.5, 1e-9);
+    CHECK(beginFrame(timestep, 0.005) == 1);
+    CHECK(beginFrame(timestep, 1.0) == 4);
+    CHECK(timestep.droppedTime > 0.9);
+
+    SimulationClock clock;
+    clock.timeScale = 10.0;
+    CHECK_NEAR(simulatedTickLength(clock, timestep), 0.1, 1e-12);
+    clock.paused = true;
+    CHECK_NEAR(simulatedTickLength(clock, timestep), 0.0, 0.0);
+}
+
+// The body file gives every planet an orbit between its apsides, and the moon a parent
+static void testBodiesLoad()
+{
+    SolarSystem system;
+    CHECK(createTestSolarSystem(system));
+    CHECK(system.planetOrbits.size() == 9);
+    CHECK(system.planetMasses.size() == system.planetOrbits.size());
+    CHECK(system.asteroidOrbits.size() >= 2000);
+    CHECK(system.ringAsteroidOrbits.size() == 1000);
+    CHECK_NEAR(system.referenceRadius, 6.0, 0.0);
+
+    const Vec3Array& positions = system.currentState.planetPositions;
+    for (size_t i = 1; i < system.planetOrbits.size(); ++i)
+    {
+        double a = system.planetOrbits.semiMajorAxis[i], e = system.planetOrbits.eccentricity[i];
+        double r = glm::length(positions[i] - positions[0]);
+        CHECK(r >= a * (1.0 - e) - 1e-9 && r <= a * (1.0 + e) + 1e-9);
+    }
+
+    Entity moon = findBody(system.world, "Moon");
+    CHECK(moon != NO_ENTITY);
+    CHECK(system.world.get<Satellite>(moon) != nullptr && system.world.get<Satellite>(moon)->parent == findBody(system.world, REFERENCE_BODY));
+}
+
+// Stepping to a time and seeking straight to it give the same positions
+static void testStepMatchesSeek()
+{
+    SolarSystem stepped, seeked;
+    CHECK(createTestSolarSystem(stepped));
+    CHECK(createTestSolarSystem(seeked));
+
+    const double tickLength = 1.0 / 60.0;
+    for (int tick = 0; tick < 300; ++tick)
+        stepSolarSystem(stepped, tickLength);
+    seekSolarSystem(seeked, stepped.currentState.time);
+
+    CHECK(largestDifference(stepped.currentState.planetPositions, seeked.currentState.planetPositions) < 1e-9);
+    CHECK(largestDifference(stepped.currentState.asteroidPositions, seeked.currentState.asteroidPositions) < 1e-9);
+    CHECK(largestDifference(stepped.currentState.ringAsteroidPositions, seeked.currentState.ringAsteroidPositions) < 1e-9);
+}
+
+// The same seed gives the same belt; the collision pass reports each touching pair once
+static void testDeterministicBelt()
+{
+    SolarSystem first, second;
+    CHECK(createTestSolarSystem(first, 99));
+    CHECK(createTestSolarSystem(second, 99));
+    CHECK(largestDifference(first.currentState.asteroidPositions, second.currentState.asteroidPositions) == 0.0);
+
+    for (const CollisionPair& pair : first.beltCollisions)
+    {
+        CHECK(pair.first < pair.second);
+        double distance = glm::length(first.currentState.asteroidPositions[pair.first] - first.currentState.asteroidPositions[pair.second]);
+        CHECK(distance < first.asteroidSizes[pair.first] + first.asteroidSizes[pair.second]);
+    }
+}
+
+// Blending two states at alpha = 0 and 1 gives the states themselves
+static void testInterpolation()
+{
+    SolarSystem system;
+    CHECK(createTestSolarSystem(system));
+    stepSolarSystem(system, 10.0);
+
+    SimulationState blended;
+    interpolateStates(system.previousState, system.currentState, 0.0, blended);
+    CHECK(largestDifference(blended.asteroidPositions, system.previousState.asteroidPositions) == 0.0);
+    interpolateStates(system.previousState, system.currentState, 1.0, blended);
+    CHECK(largestDifference(blended.asteroidPositions, system.currentState.asteroidPositions) < 1e-12);
+    CHECK_NEAR(blended.time, system.currentState.time, 1e-12);
+}
+
+// Switching to N-body gravity starts from the Keplerian state and keeps the planets near their orbits
+static void testNBodyMode()
+{
+    SolarSystem system;
+    CHECK(createTestSolarSystem(system));
+    Vec3Array keplerPlanets = system.currentState.planetPositions;
+
+    system.nbodyEnabled = true;
+    stepSolarSystem(system, 1.0 / 60.0);
+    CHECK(system.nbodyRunning);
+    CHECK(system.currentState.asteroidPositions.size() == system.asteroidOrbits.size());
+    CHECK(largestDifference(system.currentState.planetPositions, keplerPlanets) < 0.1);
+
+    double startEnergy = totalEnergy(system.nbodyState);
+    for (int tick = 0; tick < 60; ++tick)
+        stepSolarSystem(system, 1.0 / 60.0);
+    CHECK(std::fabs(totalEnergy(system.nbodyState) - startEnergy) < 1e-6 * std::fabs(startEnergy));
+
+    // Opening angles past the self-force limit are clamped to it
+    NBodyState wide = system.nbodyState;
+    NBodyState limited = system.nbodyState;
+    BarnesHutSettings settings = system.nbodySettings;
+    BarnesHutTree tree;
+    settings.openingAngle = 1.5;
+    computeGravity(wide, settings, tree);
+    settings.openingAngle = MAX_OPENING_ANGLE;
+    computeGravity(limited, settings, tree);
+    CHECK(largestDifference(wide.acceleration, limited.acceleration) == 0.0);
+
+    system.nbodyEnabled = false;
+    stepSolarSystem(system, 1.0 / 60.0);
+    CHECK(!system.nbodyRunning);
+}
+
+// A cached ephemeris is rebuilt when an orbit's period changes, even though the planets still
+// start where they did
+static void testStaleEphemeris()
+{
+    const char* path = "SimulationTests.eph";
+    OrbitalElements earth = { 10.0, 0.0167, 0.0, 0.0, 1.796, 0.0, 0.01 };
+    OrbitalElements mars = { 15.2, 0.0934, 0.032, 0.865, 5.0, 0.3, 0.0053 };
+    KeplerBatch orbits, retimed;
+    addOrbit(orbits, earth);
+    addOrbit(orbits, mars);
+    mars.meanMotion *= 1.01;
+    addOrbit(retimed, earth);
+    addOrbit(retimed, mars);
+
+    {
+        Ephemeris ephemeris;
+        loadPlanetEphemeris(path, orbits, ephemeris);
+    }
+    Ephemeris ephemeris;
+    CHECK(loadEphemeris(path, ephemeris) && ephemeris.size() == 2);
+
+    loadPlanetEphemeris(path, retimed, ephemeris);
+    Vec3Array positions;
+    propagateOrbits(retimed, EPHEMERIS_SPAN, positions);
+    CHECK_NEAR(glm::length(ephemerisPosition(ephemeris, 1, EPHEMERIS_SPAN) - positions[1]), 0.0, EPHEMERIS_TOLERANCE);
+    ephemeris.file.close();
+    std::remove(path);
+}
+
+// The growing search boxes of findNearest end on the box covering maxDistance, even when doubling
+// the last one would overshoot it
+static void testNearestAtEdgeOfRange()
+{
+    // Enough far away particles that the search goes cell by cell over the 12^3 cell box
+    Vec3Array positions;
+    for (int i = 0; i < 2000; ++i)
+    {
+        positions.x.push_back(100.0 + i);
+        positions.y.push_back(0.5);
+        positions.z.push_back(0.5);
+    }
+    positions.x.push_back(5.1);
+    positions.y.push_back(0.5);
+    positions.z.push_back(0.5);
+
+    SpatialHash hash;
+    buildSpatialHash(positions, 1.0, hash);
+    uint32_t nearest = 0;
+    double distance = 0.0;
+    CHECK(findNearest(hash, glm::dvec3(0.5, 0.5, 0.5), 5.5, nearest, distance));
+    CHECK(nearest == 2000);
+    CHECK_NEAR(distance, 4.6, 1e-12);
+}
+
+// Runs from the same seed give byte-identical snapshots, and a restored system carries on exactly
+// as the original does
+static void testSnapshotRoundTrip()
+{
+    const char* firstPath = "SimulationTests_first.snapshot";
+    const char* secondPath = "SimulationTests_second.snapshot";
+    const double tickLength = 1.0 / 60.0;
+
+    SolarSystem original, twin;
+    CHECK(createTestSolarSystem(original, 99));
+    CHECK(createTestSolarSystem(twin, 99));
+    for (int tick = 0; tick < 30; ++tick)
+    {
+        stepSolarSystem(original, tickLength);
+        stepSolarSystem(twin, tickLength);
+    }
+
+    SimulationClock clock;
+    clock.timeScale = 250.0;
+    CHECK(writeSnapshot(firstPath, original, clock));
+    CHECK(writeSnapshot(secondPath, twin, clock));
+    std::ostringstream report;
+    CHECK(diffSnapshots(firstPath, secondPath, report));
+
+    SolarSystem restored;
+    SimulationClock restoredClock;
+    CHECK(loadSnapshot(firstPath, "", restored, restoredClock));
+    CHECK_NEAR(restoredClock.timeScale, 250.0, 0.0);
+    CHECK(restored.world.entityCount() == original.world.entityCount());
+    CHECK(restored.asteroidOrbits.semiMajorAxis.isView());
+    CHECK(largestDifference(restored.currentState.asteroidPositions, original.currentState.asteroidPositions) == 0.0);
+    Entity moon = findBody(restored.world, "Moon");
+    CHECK(moon != NO_ENTITY && restored.world.get<Satellite>(moon)->parent == findBody(restored.world, REFERENCE_BODY));
+
+    for (int tick = 0; tick < 30; ++tick)
+    {
+        stepSolarSystem(original, tickLength);
+        stepSolarSystem(restored, tickLength);
+    }
+    CHECK(largestDifference(restored.currentState.ringAsteroidPositions, original.currentState.ringAsteroidPositions) == 0.0);
+    CHECK(restored.beltCollisions.size() == original.beltCollisions.size());
+
+    CHECK(writeSnapshot(firstPath, original, clock));
+    CHECK(writeSnapshot(secondPath, restored, clock));
+    CHECK(diffSnapshots(firstPath, secondPath, report));
+
+    // Saving over the snapshot a restore still maps, with different contents, leaves both intact
+    for (int tick = 0; tick < 30; ++tick)
+        stepSolarSystem(restored, tickLength);
+    CHECK(writeSnapshot(firstPath, restored, clock));
+    CHECK(!std::ifstream(std::string(firstPath) + ".tmp"));
+    SolarSystem resaved;
+    CHECK(loadSnapshot(firstPath, "", resaved, restoredClock));
+    CHECK(largestDifference(resaved.currentState.asteroidPositions, restored.currentState.asteroidPositions) == 0.0);
+    CHECK(largestDifference(resaved.currentState.asteroidPositions, original.currentState.asteroidPositions) > 0.0);
+
+    // Restored chunks are copy-on-write, so entities can still come and go
+    Entity extra = restored.world.create(BeltAsteroid(), StateSlot{ 0 }, Appearance{ 0, 1.0f });
+    CHECK(restored.world.has<BeltAsteroid>(extra));
+    restored.world.destroyEntity(findBody(restored.world, "Moon"));
+    CHECK(findBody(restored.world, "Moon") == NO_ENTITY);
+
+    std::remove(firstPath);
+    std::remove(secondPath);
+}
+
+// Recordings survive a round trip, and frame time percentiles use nearest rank
+static void testReplayRecording()
+{
+    const char* path = "SimulationTests.replay";
+    InputRecording flythrough, loaded;
+    makeStandardFlythrough(flythrough);
+    CHECK(flythrough.frames.size() == size_t(REPLAY_FLYTHROUGH_FRAMES));
+    CHECK(writeRecording(path, flythrough));
+    CHECK(loadRecording(path, loaded));
+    CHECK(loaded.seed == flythrough.seed && loaded.frames.size() == flythrough.frames.size());
+    CHECK(std::memcmp(loaded.frames.data(), flythrough.frames.data(), loaded.frames.size() * sizeof(ReplayFrame)) == 0);
+    std::remove(path);
+
+    std::vector<double> frameMilliseconds;
+    for (int i = 100; i >= 1; --i)
+        frameMilliseconds.push_back(double(i));
+    FrameTimeStats stats = frameTimeStats(frameMilliseconds);
+    CHECK(stats.frames == 100);
+    CHECK_NEAR(stats.mean, 50.5, 1e-12);
+    CHECK_NEAR(stats.p50, 50.0, 0.0);
+    CHECK_NEAR(stats.p95, 95.0, 0.0);
+    CHECK_NEAR(stats.p99, 99.0, 0.0);
+    CHECK_NEAR(stats.max, 100.0, 0.0);
+}
+
+// createSolarSystem times its steps as startup phases, which are checked against budgets
+static void testStartupProfiler()
+{
+    StartupProfiler profiler;
+    SolarSystemSettings settings;
+    settings.ephemerisPath.clear();
+    settings.minorBodiesPath.clear();
+    settings.asteroidCount = 2000;
+    settings.ringAsteroidCount = 1000;
+    settings.seed = 7;
+    settings.profiler = &profiler;
+    SolarSystem system;
+    CHECK(createSolarSystem(settings, system));
+    {
+        ScopedStartupPhase phase(&profiler, "bodies"); // Timed twice, so budgeted on the sum
+    }
+
+    const std::vector<StartupPhase>& phases = profiler.phases();
+    CHECK(phases.size() == 5);
+    CHECK(phases[0].name == "bodies" && phases[1].name == "asteroid-belt" && phases[2].name == "ring-asteroids");
+    double wall = 0.0;
+    for (const StartupPhase& phase : phases)
+    {
+        CHECK(phase.wallMilliseconds >= 0.0 && phase.cpuMilliseconds >= 0.0);
+        wall += phase.wallMilliseconds;
+    }
+    CHECK(profiler.totalMilliseconds() >= wall);
+#ifndef _WIN32
+    CHECK(phases.back().peakResidentBytes > 0 && phases.back().peakResidentBytes >= phases.front().peakResidentBytes);
+#endif
+    CHECK(profiler.report().find("asteroid-belt") != std::string::npos);
+    CHECK(profiler.json().find("{ \"name\": \"ring-asteroids\", \"wallMilliseconds\": ") != std::string::npos);
+
+    // Budgets: phases over theirs are reported, phases without one are not checked
+    const std::string path = "SimulationTests.budget";
+    {
+        std::ofstream stream(path);
+        stream << "# Test budgets\n\nasteroid-belt 0\nbodies 1e9\nunknown-phase 0\ntotal 1e9\n";
+    }
+    std::map<std::string, double> budgets;
+    CHECK(readStartupBudget(path, budgets) && budgets.size() == 4);
+    std::vector<std::string> overruns;
+    CHECK(!checkStartupBudget(profiler, budgets, overruns) && overruns.size() == 1 && overruns[0].find("asteroid-belt took") == 0);
+    budgets["asteroid-belt"] = 1e9;
+    CHECK(checkStartupBudget(profiler, budgets, overruns) && overruns.empty());
+    budgets[STARTUP_TOTAL_NAME] = 0.0;
+    CHECK(!checkStartupBudget(profiler, budgets, overruns) && overruns.size() == 1 && overruns[0].find("total took") == 0);
+
+    {
+        std::ofstream stream(path);
+        stream << "bodies fast\n";
+    }
+    CHECK(!readStartupBudget(path, budgets));
+    std::remove(path.c_str());
+    CHECK(!readStartupBudget(path, budgets));
+}
+
+int main()
+{
+    RUN_TEST(testFixedTimestep);
+    RUN_TEST(testBodiesLoad);
+    RUN_TEST(testStepMatchesSeek);
+    RUN_TEST(testDeterministicBelt);
+    RUN_TEST(testInterpolation);
+    RUN_TEST(testNBodyMode);
+    RUN_TEST(testStaleEphemeris);
+    RUN_TEST(testNearestAtEdgeOfRange);
+    RUN_TEST(testSnapshotRoundTrip);
+    RUN_TEST(testReplayRecording);
+    RUN_TEST(testStartupProfiler);
+    return testFailures();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal checks for the test executables: failures are printed and counted, and main returns
+// the count so CTest sees a non-zero exit code.
+
+inline int& testFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++testFailures(); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double checkActual = (actual), checkExpected = (expected); \
+        if (!(std::fabs(checkActual - checkExpected) <= (tolerance))) \
+        { \
+            printf("%s:%d: %s = %.12g, expected %.12g within %g\n", __FILE__, __LINE__, #actual, checkActual, checkExpected, double(tolerance)); \
+            ++testFailures(); \
+        } \
+    } while (0)
+
+// Function to run one test function and report it
+#define RUN_TEST(test) \
+    do { \
+        int failuresBefore = testFailures(); \
+        test(); \
+        printf("%s %s\n", testFailures() == failuresBefore ? "[pass]" : "[FAIL]", #test); \
+    } while (0)